@@ -0,0 +1,727 @@
+/*
+ * Conversion API for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+/*
+ * Include necessary headers.
+ */
+
+#define _HTMLDOC_CXX_
+#include "htmldoc.h"
+#include "markdown.h"
+#include "api.h"
+
+
+/*
+ * Local types...
+ */
+
+typedef struct hd_buffer_s		/* Growable output buffer */
+{
+  char		*data;			/* Output data */
+  size_t	length,			/* Length of output data */
+		alloc;			/* Allocated size of buffer */
+} hd_buffer_t;
+
+typedef struct hd_sink_s		/* Output callback stream */
+{
+  hd_write_cb_t	cb;			/* Output callback */
+  void		*ctx;			/* Callback data */
+  long		bytes;			/* Bytes written so far */
+  int		status;			/* 1 while the callback succeeds */
+} hd_sink_t;
+
+
+/*
+ * Local functions...
+ */
+
+static int	append_buffer(void *buffer, const void *data, size_t bytes);
+static int	copy_output(FILE *fp, hd_sink_t *sink);
+static FILE	*open_sink(hd_sink_t *sink);
+static int	read_input(const hd_input_t *input, tree_t **document);
+static int	set_options(const hd_options_t *options);
+static int	write_sink(hd_sink_t *sink, const char *buffer, size_t bytes);
+#ifdef HAVE_FOPENCOOKIE
+static ssize_t	sink_write(void *sink, const char *buffer, size_t bytes);
+static int	sink_seek(void *sink, off64_t *offset, int whence);
+#elif defined(HAVE_FUNOPEN)
+static int	sink_write(void *sink, const char *buffer, int bytes);
+static fpos_t	sink_seek(void *sink, fpos_t offset, int whence);
+#endif /* HAVE_FOPENCOOKIE */
+
+
+/*
+ * 'hd_convert()' - Convert documents and send the output to a callback.
+ *
+ * PostScript output is passed to the callback as it is written.  PDF output
+ * refers back to earlier parts of the file, so it is written to an anonymous
+ * temporary file and then passed to the callback in blocks.
+ *
+ * The conversion state is global, so only one conversion may run at a time
+ * in a process.  Errors are reported using the usual HTMLDOC messages on
+ * stderr.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+hd_convert(
+    const hd_options_t *options,	/* I - Conversion options */
+    const hd_input_t   *inputs,		/* I - Input documents */
+    size_t             num_inputs,	/* I - Number of input documents */
+    hd_write_cb_t      cb,		/* I - Output callback */
+    void               *ctx)		/* I - Callback data */
+{
+  FILE		*fp;			/* Output stream */
+  hd_sink_t	sink;			/* Output callback stream */
+  int		status;			/* Status of conversion */
+
+
+  if (!cb)
+  {
+    progress_error(HD_ERROR_INTERNAL_ERROR, "No output callback specified.");
+    return (0);
+  }
+
+  sink.cb     = cb;
+  sink.ctx    = ctx;
+  sink.bytes  = 0;
+  sink.status = 1;
+
+  if (options && options->format && !strncasecmp(options->format, "ps", 2) &&
+      (fp = open_sink(&sink)) != NULL)
+  {
+   /*
+    * Send PostScript straight to the callback...
+    */
+
+    status = hd_convert_file(options, inputs, num_inputs, fp);
+
+    fclose(fp);
+  }
+  else
+  {
+   /*
+    * Write to an anonymous temporary file and copy it to the callback...
+    */
+
+    if ((fp = tmpfile()) == NULL)
+    {
+      progress_error(HD_ERROR_WRITE_ERROR, "Unable to create temporary file: %s",
+                     strerror(errno));
+      return (0);
+    }
+
+    if ((status = hd_convert_file(options, inputs, num_inputs, fp)) != 0)
+      copy_output(fp, &sink);
+
+    fclose(fp);
+  }
+
+  if (status && !sink.status)
+  {
+    progress_error(HD_ERROR_WRITE_ERROR, "Unable to write output.");
+    status = 0;
+  }
+
+  return (status);
+}
+
+
+/*
+ * 'hd_convert_buffer()' - Convert documents to a memory buffer.
+ *
+ * The buffer is allocated with malloc() and must be freed by the caller.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+hd_convert_buffer(
+    const hd_options_t *options,	/* I - Conversion options */
+    const hd_input_t   *inputs,		/* I - Input documents */
+    size_t             num_inputs,	/* I - Number of input documents */
+    void               **data,		/* O - Output data */
+    size_t             *length)		/* O - Length of output data */
+{
+  hd_buffer_t	buffer;			/* Output buffer */
+
+
+  if (!data || !length)
+  {
+    progress_error(HD_ERROR_INTERNAL_ERROR, "No output buffer specified.");
+    return (0);
+  }
+
+  *data   = NULL;
+  *length = 0;
+
+  memset(&buffer, 0, sizeof(buffer));
+
+  if (!hd_convert(options, inputs, num_inputs, append_buffer, &buffer))
+  {
+    free(buffer.data);
+    return (0);
+  }
+
+  *data   = buffer.data;
+  *length = buffer.length;
+
+  return (1);
+}
+
+
+/*
+ * 'hd_convert_file()' - Convert documents to a file.
+ *
+ * The file must be opened for writing and, for PDF output, be seekable; it is
+ * not closed.  Only errors are reported, the "PAGES:" and "BYTES:" status
+ * messages of the htmldoc program are not shown.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+hd_convert_file(
+    const hd_options_t *options,	/* I - Conversion options */
+    const hd_input_t   *inputs,		/* I - Input documents */
+    size_t             num_inputs,	/* I - Number of input documents */
+    FILE               *fp)		/* I - Output file */
+{
+  size_t	i;			/* Looping var */
+  tree_t	*document = NULL,	/* Document tree */
+		*toc;			/* Table of contents */
+
+
+  Errors         = 0;
+  StatusMessages = 0;
+
+  if (!options || !fp || (!inputs && num_inputs > 0))
+  {
+    progress_error(HD_ERROR_INTERNAL_ERROR, "Bad conversion arguments.");
+    return (0);
+  }
+
+  if (!set_options(options))
+    return (0);
+
+ /*
+  * Read the input documents...
+  */
+
+  for (i = 0; i < num_inputs; i ++)
+    read_input(inputs + i, &document);
+
+  if (!document)
+  {
+    progress_error(HD_ERROR_NO_FILES, "No HTML files!");
+  }
+  else
+  {
+   /*
+    * Generate the output file...
+    */
+
+    while (document->prev != NULL)
+      document = document->prev;
+
+    htmlFixLinks(document, document);
+
+    if (OutputType == OUTPUT_BOOK && TocLevels > 0)
+    {
+      toc = toc_build(document);
+    }
+    else
+    {
+      if (TocNumbers)
+        htmlDeleteTree(toc_build(document));
+
+      toc = NULL;
+    }
+
+    OutputFile = fp;
+
+    pspdf_export(document, toc);
+
+    OutputFile = NULL;
+
+    htmlDeleteTree(document);
+    htmlDeleteTree(toc);
+  }
+
+  file_cleanup();
+  image_flush_cache();
+
+  return (Errors == 0);
+}
+
+
+/*
+ * 'hd_options_init()' - Initialize conversion options to the defaults.
+ *
+ * The defaults produce a PDF file with one or more web pages on Universal
+ * (8.27x11in) paper.
+ */
+
+void
+hd_options_init(hd_options_t *options)	/* I - Conversion options */
+{
+  if (!options)
+    return;
+
+  memset(options, 0, sizeof(hd_options_t));
+
+  options->format      = "pdf";
+  options->mode        = HD_MODE_WEBPAGE;
+  options->charset     = "iso-8859-1";
+  options->media       = "universal";
+  options->left        = 72;
+  options->right       = 36;
+  options->top         = 36;
+  options->bottom      = 36;
+  options->header      = ".t.";
+  options->footer      = "h.1";
+  options->fontsize    = 11.0;
+  options->fontspacing = 1.2;
+  options->toc_levels  = 3;
+  options->title_page  = 1;
+  options->compression = 1;
+  options->embed_fonts = 1;
+  options->links       = 1;
+  options->color       = 1;
+  options->linearize   = 0;
+}
+
+
+/*
+ * 'prefs_load()' - Load HTMLDOC preferences (not used).
+ */
+
+void
+prefs_load(void)
+{
+}
+
+
+/*
+ * 'prefs_save()' - Save HTMLDOC preferences (not used).
+ */
+
+void
+prefs_save(void)
+{
+}
+
+
+/*
+ * 'append_buffer()' - Add output data to a growable buffer.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+append_buffer(void       *buffer,	/* I - Output buffer */
+              const void *data,		/* I - Data to add */
+              size_t     bytes)		/* I - Number of bytes */
+{
+  hd_buffer_t	*b = (hd_buffer_t *)buffer;
+					/* Output buffer */
+  char		*temp;			/* New buffer */
+  size_t	alloc;			/* New size of buffer */
+
+
+  if (bytes > b->alloc - b->length)
+  {
+    for (alloc = b->alloc ? b->alloc : 65536; alloc - b->length < bytes; alloc *= 2);
+
+    if ((temp = (char *)realloc(b->data, alloc)) == NULL)
+    {
+      progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for output.");
+      return (0);
+    }
+
+    b->data  = temp;
+    b->alloc = alloc;
+  }
+
+  memcpy(b->data + b->length, data, bytes);
+  b->length += bytes;
+
+  return (1);
+}
+
+
+/*
+ * 'copy_output()' - Copy a finished output file to the output callback.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+copy_output(FILE      *fp,		/* I - Output file */
+            hd_sink_t *sink)		/* I - Output callback stream */
+{
+  size_t	bytes;			/* Bytes read */
+  char		buffer[65536];		/* Copy buffer */
+
+
+  rewind(fp);
+
+  while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    if (!write_sink(sink, buffer, bytes))
+      return (0);
+
+  return (1);
+}
+
+
+/*
+ * 'open_sink()' - Open a stream that writes to the output callback.
+ *
+ * Returns NULL when custom streams are not supported, in which case the
+ * caller falls back to a temporary file.
+ */
+
+static FILE *				/* O - Output stream or NULL */
+open_sink(hd_sink_t *sink)		/* I - Output callback stream */
+{
+#ifdef HAVE_FOPENCOOKIE
+  cookie_io_functions_t	funcs;		/* Stream functions */
+
+
+  memset(&funcs, 0, sizeof(funcs));
+  funcs.write = sink_write;
+  funcs.seek  = sink_seek;
+
+  return (fopencookie(sink, "wb", funcs));
+
+#elif defined(HAVE_FUNOPEN)
+  return (funopen(sink, NULL, sink_write, sink_seek, NULL));
+
+#else
+  (void)sink;
+
+  return (NULL);
+#endif /* HAVE_FOPENCOOKIE */
+}
+
+
+/*
+ * 'read_input()' - Read an input document.
+ */
+
+static int				/* O  - 1 on success, 0 on failure */
+read_input(const hd_input_t *input,	/* I  - Input document */
+           tree_t           **document)	/* IO - Document tree */
+{
+  FILE		*fp;			/* Document file */
+  tree_t	*file;			/* HTML document file */
+  const char	*name,			/* Name of document */
+		*realname,		/* Real name of file */
+		*ext;			/* Extension of filename */
+  char		base[1024];		/* Base directory name of file */
+
+
+  name = input->name ? input->name : "document.html";
+
+  if (input->data)
+  {
+   /*
+    * Read from memory...
+    */
+
+#ifdef HAVE_FMEMOPEN
+    if (input->length > 0)
+      fp = fmemopen((void *)input->data, input->length, "rb");
+    else
+#endif /* HAVE_FMEMOPEN */
+    if ((fp = tmpfile()) != NULL)
+    {
+      fwrite(input->data, 1, input->length, fp);
+      rewind(fp);
+    }
+
+    if (!fp)
+    {
+      progress_error(HD_ERROR_READ_ERROR, "Unable to read \"%s\" from memory: %s",
+                     name, strerror(errno));
+      return (0);
+    }
+  }
+  else if ((realname = file_find(Path, name)) == NULL)
+  {
+    progress_error(HD_ERROR_FILE_NOT_FOUND, "Unable to find \"%s\"...", name);
+    return (0);
+  }
+  else if ((fp = file_open(realname, "rb")) == NULL)
+  {
+    progress_error(HD_ERROR_FILE_NOT_FOUND, "Unable to open \"%s\" for reading...", name);
+    return (0);
+  }
+
+  _htmlPPI = 72.0f * _htmlBrowserWidth / (PageWidth - PageLeft - PageRight);
+
+  if (input->name && file_directory(input->name))
+    strlcpy(base, file_directory(input->name), sizeof(base));
+  else
+    strlcpy(base, ".", sizeof(base));
+
+  ext = file_extension(name);
+
+  file = htmlAddTree(NULL, MARKUP_FILE, NULL);
+  htmlSetVariable(file, (uchar *)"_HD_URL", (uchar *)name);
+  htmlSetVariable(file, (uchar *)"_HD_FILENAME", (uchar *)file_basename(name));
+  htmlSetVariable(file, (uchar *)"_HD_BASE", (uchar *)base);
+
+  if (ext && !strcmp(ext, "md"))
+  {
+    mdReadFile(file, fp, base);
+  }
+  else
+  {
+    _htmlCurrentFile = name;
+    htmlReadFile(file, fp, base);
+  }
+
+  fclose(fp);
+
+  if (*document == NULL)
+    *document = file;
+  else
+  {
+    while ((*document)->next != NULL)
+      *document = (*document)->next;
+
+    (*document)->next = file;
+    file->prev        = *document;
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'set_options()' - Set the global options for a conversion.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+set_options(const hd_options_t *options)/* I - Conversion options */
+{
+  const char	*format;		/* Output format */
+  const char	*charset;		/* Character set */
+
+
+ /*
+  * Output format...
+  */
+
+  format      = options->format ? options->format : "pdf";
+  Compression = options->compression;
+
+  if (!strcasecmp(format, "pdf") || !strcasecmp(format, "pdf14"))
+  {
+    PSLevel    = 0;
+    PDFVersion = 14;
+  }
+  else if (!strcasecmp(format, "pdf15"))
+  {
+    PSLevel    = 0;
+    PDFVersion = 15;
+  }
+  else if (!strcasecmp(format, "pdf13"))
+  {
+    PSLevel    = 0;
+    PDFVersion = 13;
+  }
+  else if (!strcasecmp(format, "pdf12"))
+  {
+    PSLevel    = 0;
+    PDFVersion = 12;
+  }
+  else if (!strcasecmp(format, "pdf11"))
+  {
+    PSLevel     = 0;
+    PDFVersion  = 11;
+    Compression = 0;
+  }
+  else if (!strcasecmp(format, "ps1"))
+    PSLevel = 1;
+  else if (!strcasecmp(format, "ps") || !strcasecmp(format, "ps2"))
+    PSLevel = 2;
+  else if (!strcasecmp(format, "ps3"))
+    PSLevel = 3;
+  else
+  {
+    progress_error(HD_ERROR_BAD_FORMAT, "Unsupported output format \"%s\".", format);
+    return (0);
+  }
+
+  OutputPath[0] = '\0';
+  OutputFiles   = 0;
+
+ /*
+  * Layout mode...
+  */
+
+  switch (options->mode)
+  {
+    case HD_MODE_BOOK :
+        OutputType   = OUTPUT_BOOK;
+	TocLevels    = options->toc_levels;
+	TitlePage    = options->title_page;
+	PDFPageMode  = PDF_OUTLINE;
+	PDFFirstPage = PDF_CHAPTER_1;
+        break;
+
+    case HD_MODE_CONTINUOUS :
+        OutputType   = OUTPUT_CONTINUOUS;
+	TocLevels    = 0;
+	TitlePage    = 0;
+	PDFPageMode  = PDF_DOCUMENT;
+	PDFFirstPage = PDF_PAGE_1;
+        break;
+
+    default :
+        OutputType   = OUTPUT_WEBPAGES;
+	TocLevels    = 0;
+	TitlePage    = 0;
+	PDFPageMode  = PDF_DOCUMENT;
+	PDFFirstPage = PDF_PAGE_1;
+        break;
+  }
+
+ /*
+  * Files and character set...
+  */
+
+  if (options->datadir)
+    _htmlData = options->datadir;
+
+  strlcpy(Path, options->path ? options->path : "", sizeof(Path));
+
+  charset = options->charset ? options->charset : "iso-8859-1";
+
+  if (!_htmlInitialized || strcmp(charset, _htmlCharSet))
+    htmlSetCharSet(charset);
+
+ /*
+  * Page layout...
+  */
+
+  set_page_size(options->media ? options->media : "universal");
+
+  Landscape  = options->landscape;
+  PageLeft   = options->left;
+  PageRight  = options->right;
+  PageTop    = options->top;
+  PageBottom = options->bottom;
+
+  get_format(options->header ? options->header : "...", Header);
+  get_format(options->footer ? options->footer : "...", Footer);
+  get_format(".t.", TocHeader);
+  get_format("..i", TocFooter);
+
+  htmlSetBaseSize(options->fontsize, options->fontspacing);
+
+ /*
+  * Content...
+  */
+
+  OutputJPEG     = options->jpeg;
+  EmbedFonts     = options->embed_fonts;
+  Links          = options->links;
+  OutputColor    = options->color;
+  PDFLinearize   = options->linearize;
+  _htmlGrayscale = !options->color;
+
+  return (1);
+}
+
+
+#ifdef HAVE_FOPENCOOKIE
+/*
+ * 'sink_seek()' - Report the current position of the output callback stream.
+ *
+ * Only ftell() is supported; the output cannot be rewritten.
+ */
+
+static int				/* O  - 0 on success, -1 on error */
+sink_seek(void    *sink,		/* I  - Output callback stream */
+          off64_t *offset,		/* IO - Offset */
+          int     whence)		/* I  - Seek mode */
+{
+  if (whence != SEEK_CUR || *offset != 0)
+    return (-1);
+
+  *offset = ((hd_sink_t *)sink)->bytes;
+
+  return (0);
+}
+
+
+/*
+ * 'sink_write()' - Write to the output callback stream.
+ */
+
+static ssize_t				/* O - Bytes written or -1 on error */
+sink_write(void       *sink,		/* I - Output callback stream */
+           const char *buffer,		/* I - Data to write */
+           size_t     bytes)		/* I - Number of bytes */
+{
+  return (write_sink((hd_sink_t *)sink, buffer, bytes) ? (ssize_t)bytes : -1);
+}
+
+
+#elif defined(HAVE_FUNOPEN)
+/*
+ * 'sink_seek()' - Report the current position of the output callback stream.
+ *
+ * Only ftell() is supported; the output cannot be rewritten.
+ */
+
+static fpos_t				/* O - Position or -1 on error */
+sink_seek(void   *sink,			/* I - Output callback stream */
+          fpos_t offset,		/* I - Offset */
+          int    whence)		/* I - Seek mode */
+{
+  if (whence != SEEK_CUR || offset != 0)
+    return (-1);
+
+  return ((fpos_t)((hd_sink_t *)sink)->bytes);
+}
+
+
+/*
+ * 'sink_write()' - Write to the output callback stream.
+ */
+
+static int				/* O - Bytes written or -1 on error */
+sink_write(void       *sink,		/* I - Output callback stream */
+           const char *buffer,		/* I - Data to write */
+           int        bytes)		/* I - Number of bytes */
+{
+  return (write_sink((hd_sink_t *)sink, buffer, (size_t)bytes) ? bytes : -1);
+}
+#endif /* HAVE_FOPENCOOKIE */
+
+
+/*
+ * 'write_sink()' - Pass output data to the output callback.
+ *
+ * Once the callback fails the remaining output is discarded.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+write_sink(hd_sink_t  *sink,		/* I - Output callback stream */
+           const char *buffer,		/* I - Data to write */
+           size_t     bytes)		/* I - Number of bytes */
+{
+  if (!sink->status)
+    return (0);
+
+  if (bytes > 0 && !(*sink->cb)(sink->ctx, buffer, bytes))
+  {
+    sink->status = 0;
+    return (0);
+  }
+
+  sink->bytes += (long)bytes;
+
+  return (1);
+}
@@ -0,0 +1,108 @@
+/*
+ * Conversion API definitions for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+#ifndef _API_H_
+#  define _API_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include <stdio.h>
+#  include <stdlib.h>
+
+#  ifdef __cplusplus
+extern "C" {
+#  endif /* __cplusplus */
+
+
+/*
+ * Document layout modes...
+ */
+
+typedef enum hd_mode_e
+{
+  HD_MODE_WEBPAGE,			/* Each document starts a new page */
+  HD_MODE_CONTINUOUS,			/* Documents are not separated */
+  HD_MODE_BOOK				/* Chapters with TOC and title page */
+} hd_mode_t;
+
+
+/*
+ * Conversion options - initialize with hd_options_init() and then change
+ * the values as needed...
+ */
+
+typedef struct hd_options_s
+{
+  const char	*format;		/* "pdf", "pdf11"-"pdf15", "ps", "ps1"-"ps3" */
+  hd_mode_t	mode;			/* Layout mode */
+  const char	*datadir;		/* Data directory or NULL for the default */
+  const char	*path;			/* Search path for files or NULL */
+  const char	*charset;		/* Character set */
+  const char	*media;			/* Page size ("letter", "a4", "WxHin", ...) */
+  int		landscape;		/* Landscape orientation? */
+  int		left,			/* Left margin in points */
+		right,			/* Right margin in points */
+		top,			/* Top margin in points */
+		bottom;			/* Bottom margin in points */
+  const char	*header,		/* Header format ("fff") */
+		*footer;		/* Footer format ("fff") */
+  double	fontsize,		/* Base font size in points */
+		fontspacing;		/* Line spacing */
+  int		toc_levels;		/* Table of contents levels for books */
+  int		title_page;		/* Generate a title page for books? */
+  int		compression;		/* Compression level (0-9) */
+  int		jpeg;			/* JPEG quality (0 for no JPEG) */
+  int		embed_fonts;		/* Embed fonts? */
+  int		links;			/* Include links? */
+  int		color;			/* Color output? */
+  int		linearize;		/* Linearize PDF output for fast web view? */
+} hd_options_t;
+
+
+/*
+ * Input document - HTML or Markdown (when the name ends with ".md") from
+ * memory, or a file or URL when there is no data...
+ */
+
+typedef struct hd_input_s
+{
+  const char	*name;			/* Filename or URL, used for relative links */
+  const void	*data;			/* Document data or NULL to read "name" */
+  size_t	length;			/* Length of document data */
+} hd_input_t;
+
+
+/*
+ * Output callback - returns 1 on success or 0 to report an error...
+ */
+
+typedef int (*hd_write_cb_t)(void *ctx, const void *buffer, size_t bytes);
+
+
+/*
+ * Prototypes...
+ */
+
+extern int	hd_convert(const hd_options_t *options, const hd_input_t *inputs,
+		           size_t num_inputs, hd_write_cb_t cb, void *ctx);
+extern int	hd_convert_buffer(const hd_options_t *options,
+		                  const hd_input_t *inputs, size_t num_inputs,
+				  void **data, size_t *length);
+extern int	hd_convert_file(const hd_options_t *options,
+		                const hd_input_t *inputs, size_t num_inputs,
+				FILE *fp);
+extern void	hd_options_init(hd_options_t *options);
+
+#  ifdef __cplusplus
+}
+#  endif /* __cplusplus */
+
+#endif /* !_API_H_ */
@@ -0,0 +1,205 @@
+/*
+ * Memory arena functions for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "arena.h"
+#include "stats.h"
+#include <string.h>
+
+
+/*
+ * Local types...
+ */
+
+typedef struct hd_block_s		/* Arena block */
+{
+  struct hd_block_s	*next;		/* Next (older) block */
+  size_t		size,		/* Usable size of block */
+			used;		/* Bytes used in block */
+} hd_block_t;
+
+struct hd_arena_s			/* Arena */
+{
+  hd_block_t		*blocks;	/* Blocks, newest first */
+  size_t		blocksize,	/* Size of normal blocks */
+			used,		/* Total bytes handed out */
+			allocated;	/* Total bytes allocated from heap */
+  int			num_blocks;	/* Number of blocks */
+};
+
+
+/*
+ * Local globals...
+ */
+
+#define HD_ARENA_ALIGN	sizeof(double)	/* Alignment of allocations */
+#define HD_BLOCK_HEADER	((sizeof(hd_block_t) + HD_ARENA_ALIGN - 1) & ~(HD_ARENA_ALIGN - 1))
+
+
+/*
+ * 'hd_arena_alloc()' - Allocate zeroed memory from an arena.
+ *
+ * Allocations larger than a quarter of the block size get a block of their
+ * own so that big strings do not waste the remainder of the current block.
+ */
+
+void *					/* O - Pointer to memory or NULL */
+hd_arena_alloc(hd_arena_t *a,		/* I - Arena */
+               size_t     bytes)	/* I - Number of bytes */
+{
+  hd_block_t	*b;			/* Current block */
+  size_t	size;			/* Size of new block */
+  char		*ptr;			/* Pointer to memory */
+
+
+  if (!a)
+    return (NULL);
+
+  bytes = (bytes + HD_ARENA_ALIGN - 1) & ~(HD_ARENA_ALIGN - 1);
+  if (bytes == 0)
+    bytes = HD_ARENA_ALIGN;
+
+  if ((b = a->blocks) == NULL || (b->size - b->used) < bytes)
+  {
+    if (bytes > (a->blocksize / 4))
+      size = bytes;
+    else
+      size = a->blocksize;
+
+    if ((b = (hd_block_t *)malloc(HD_BLOCK_HEADER + size)) == NULL)
+      return (NULL);
+
+    b->size = size;
+    b->used = 0;
+
+    if (size == bytes && a->blocks)
+    {
+     /*
+      * Keep the partially-filled current block in front so that small
+      * allocations continue to use it...
+      */
+
+      b->next         = a->blocks->next;
+      a->blocks->next = b;
+    }
+    else
+    {
+      b->next   = a->blocks;
+      a->blocks = b;
+    }
+
+    a->allocated += HD_BLOCK_HEADER + size;
+    a->num_blocks ++;
+  }
+
+  ptr     = (char *)b + HD_BLOCK_HEADER + b->used;
+  b->used += bytes;
+  a->used += bytes;
+
+  memset(ptr, 0, bytes);
+
+  if (hd_stats_enabled)
+  {
+    hd_stats_add(HD_COUNT_ALLOCS, 1);
+    hd_stats_add(HD_COUNT_ALLOC_BYTES, bytes);
+  }
+
+  return (ptr);
+}
+
+
+/*
+ * 'hd_arena_delete()' - Free an arena and everything allocated from it.
+ */
+
+void
+hd_arena_delete(hd_arena_t *a)		/* I - Arena */
+{
+  hd_block_t	*b,			/* Current block */
+		*next;			/* Next block */
+
+
+  if (!a)
+    return;
+
+  for (b = a->blocks; b; b = next)
+  {
+    next = b->next;
+    free(b);
+  }
+
+  free(a);
+}
+
+
+/*
+ * 'hd_arena_new()' - Create a new arena.
+ */
+
+hd_arena_t *				/* O - New arena or NULL */
+hd_arena_new(size_t blocksize)		/* I - Block size or 0 for default */
+{
+  hd_arena_t	*a;			/* New arena */
+
+
+  if ((a = (hd_arena_t *)calloc(1, sizeof(hd_arena_t))) == NULL)
+    return (NULL);
+
+  a->blocksize = blocksize > 0 ? blocksize : 65536 - HD_BLOCK_HEADER;
+
+  return (a);
+}
+
+
+/*
+ * 'hd_arena_stats()' - Get memory usage statistics for an arena.
+ */
+
+void
+hd_arena_stats(hd_arena_t *a,		/* I - Arena */
+               size_t     *used,	/* O - Bytes handed out */
+	       size_t     *allocated,	/* O - Bytes allocated from the heap */
+	       int        *blocks)	/* O - Number of blocks */
+{
+  if (used)
+    *used = a ? a->used : 0;
+
+  if (allocated)
+    *allocated = a ? a->allocated : 0;
+
+  if (blocks)
+    *blocks = a ? a->num_blocks : 0;
+}
+
+
+/*
+ * 'hd_arena_strdup()' - Copy a string into an arena.
+ */
+
+char *					/* O - New string or NULL */
+hd_arena_strdup(hd_arena_t *a,		/* I - Arena */
+                const char *s)		/* I - String to copy */
+{
+  char		*ptr;			/* New string */
+  size_t	len;			/* Length of string */
+
+
+  if (!s)
+    return (NULL);
+
+  len = strlen(s) + 1;
+
+  if ((ptr = (char *)hd_arena_alloc(a, len)) != NULL)
+    memcpy(ptr, s, len);
+
+  return (ptr);
+}
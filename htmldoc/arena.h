@@ -0,0 +1,47 @@
+/*
+ * Memory arena definitions for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+#ifndef _ARENA_H_
+#  define _ARENA_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include <stdlib.h>
+
+#  ifdef __cplusplus
+extern "C" {
+#  endif /* __cplusplus */
+
+
+/*
+ * Memory arena - a chain of large blocks that are carved up with a bump
+ * pointer and released all at once...
+ */
+
+typedef struct hd_arena_s hd_arena_t;
+
+
+/*
+ * Prototypes...
+ */
+
+extern void	*hd_arena_alloc(hd_arena_t *a, size_t bytes);
+extern void	hd_arena_delete(hd_arena_t *a);
+extern hd_arena_t *hd_arena_new(size_t blocksize);
+extern void	hd_arena_stats(hd_arena_t *a, size_t *used, size_t *allocated,
+		               int *blocks);
+extern char	*hd_arena_strdup(hd_arena_t *a, const char *s);
+
+#  ifdef __cplusplus
+}
+#  endif /* __cplusplus */
+
+#endif /* !_ARENA_H_ */
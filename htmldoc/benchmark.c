@@ -0,0 +1,788 @@
+/*
+ * Benchmark program for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ *
+ * Usage:
+ *
+ *   ./benchmark [options] [document ...]
+ *
+ * Options:
+ *
+ *   -b baseline.json   Compare against a saved baseline
+ *   -d directory       Directory for the corpus and output files
+ *   -f format[,...]    Output formats (default "pdf,ps,epub,html")
+ *   -h htmldoc         HTMLDOC program (default "./htmldoc")
+ *   -o results.json    Save the results
+ *   -s percent         Scale the corpus (default 100)
+ *   -t percent         Slowdown that counts as a regression (default 10)
+ *   -x "options"       Extra HTMLDOC options
+ *
+ * The documents are "table", "nested", "images", "anchors", "pre", and
+ * "markdown".  Each document is converted to each format with the --stats
+ * option, and the parse, format, and write times are reported along with
+ * the page and byte throughput.  HTMLDOC's messages for each run are saved
+ * in "directory/document-format.log", and runs that fail are reported and
+ * left out of the results.  The exit status is 1 if any run fails or
+ * regresses.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+/*
+ * Local types...
+ */
+
+typedef size_t (*gen_func_t)(FILE *fp, const char *dir, int count);
+
+typedef struct				/**** Benchmark document ****/
+{
+  const char	*name,			/* Name of document */
+		*ext,			/* Filename extension */
+		*description;		/* Description */
+  int		count;			/* Size at 100% */
+  gen_func_t	func;			/* Generator */
+} bench_doc_t;
+
+typedef struct				/**** Benchmark result ****/
+{
+  char		name[64];		/* "document-format" */
+  double	parse,			/* Parse time in seconds */
+		format,			/* Format time in seconds */
+		write,			/* Write time in seconds */
+		wall;			/* Total time in seconds */
+  long		pages;			/* Number of pages */
+  size_t	input_bytes,		/* Size of input */
+		output_bytes;		/* Size of output */
+  double	baseline;		/* Baseline total time or 0.0 */
+} bench_result_t;
+
+
+/*
+ * Local functions...
+ */
+
+static size_t	gen_anchors(FILE *fp, const char *dir, int count);
+static size_t	gen_images(FILE *fp, const char *dir, int count);
+static size_t	gen_markdown(FILE *fp, const char *dir, int count);
+static size_t	gen_nested(FILE *fp, const char *dir, int count);
+static size_t	gen_pre(FILE *fp, const char *dir, int count);
+static size_t	gen_table(FILE *fp, const char *dir, int count);
+static void	gen_table_level(FILE *fp, int level, int copy);
+static double	json_number(const char *json, const char *object, const char *key);
+static char	*read_file(const char *filename);
+static int	run_document(const char *htmldoc, const char *options, const char *dir, const bench_doc_t *doc, size_t input_bytes, const char *format, bench_result_t *r);
+static void	usage(void);
+
+
+/*
+ * Local globals...
+ */
+
+static const bench_doc_t documents[] =
+{
+  { "table",    "html", "100,000-row table",        100000,  gen_table },
+  { "nested",   "html", "10-level nested tables",   200,     gen_nested },
+  { "images",   "html", "5,000 images",             5000,    gen_images },
+  { "anchors",  "html", "1,000,000 anchors",        1000000, gen_anchors },
+  { "pre",      "html", "long preformatted blocks", 200000,  gen_pre },
+  { "markdown", "md",   "large Markdown file",      20000,   gen_markdown }
+};
+
+static const char * const words[] =	/* Words for generated text */
+{
+  "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing",
+  "elit", "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore",
+  "et", "dolore", "magna", "aliqua"
+};
+
+
+/*
+ * 'main()' - Generate the corpus and run the benchmarks.
+ */
+
+int					/* O - Exit status */
+main(int  argc,				/* I - Number of command-line args */
+     char *argv[])			/* I - Command-line arguments */
+{
+  int		i, j;			/* Looping vars */
+  const char	*opt,			/* Current option */
+		*baseline = NULL,	/* Baseline file */
+		*dir = "bench.d",	/* Corpus directory */
+		*formats = "pdf,ps,epub,html",
+					/* Output formats */
+		*htmldoc = "./htmldoc",	/* HTMLDOC program */
+		*output = NULL,		/* Results file */
+		*options = "";		/* Extra HTMLDOC options */
+  int		scale = 100,		/* Corpus scale in percent */
+		threshold = 10;		/* Regression threshold in percent */
+  int		num_selected = 0;	/* Number of selected documents */
+  const char	*selected[100];		/* Selected documents */
+  char		*bdata = NULL;		/* Baseline data */
+  bench_result_t results[100];		/* Results */
+  int		num_results = 0,	/* Number of results */
+		regressions = 0,	/* Number of regressions */
+		failures = 0;		/* Number of failed runs */
+  char		filename[1024],		/* Corpus filename */
+		format[32];		/* Current format */
+  const char	*fptr;			/* Pointer into formats */
+  FILE		*fp;			/* Corpus or results file */
+  size_t	input_bytes;		/* Size of corpus document */
+
+
+ /*
+  * Parse the command-line...
+  */
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (argv[i][0] == '-' && argv[i][1])
+    {
+      for (opt = argv[i] + 1; *opt; opt ++)
+      {
+        if (!strchr("bdfhostx", *opt))
+	  usage();
+
+        if ((i + 1) >= argc)
+	  usage();
+
+        switch (*opt)
+	{
+	  case 'b' :
+	      baseline = argv[++ i];
+	      break;
+	  case 'd' :
+	      dir = argv[++ i];
+	      break;
+	  case 'f' :
+	      formats = argv[++ i];
+	      break;
+	  case 'h' :
+	      htmldoc = argv[++ i];
+	      break;
+	  case 'o' :
+	      output = argv[++ i];
+	      break;
+	  case 's' :
+	      if ((scale = atoi(argv[++ i])) < 1)
+	        usage();
+	      break;
+	  case 't' :
+	      if ((threshold = atoi(argv[++ i])) < 1)
+	        usage();
+	      break;
+	  case 'x' :
+	      options = argv[++ i];
+	      break;
+	}
+      }
+    }
+    else if (num_selected < (int)(sizeof(selected) / sizeof(selected[0])))
+    {
+      for (j = 0; j < (int)(sizeof(documents) / sizeof(documents[0])); j ++)
+        if (!strcmp(argv[i], documents[j].name))
+	  break;
+
+      if (j >= (int)(sizeof(documents) / sizeof(documents[0])))
+      {
+        fprintf(stderr, "benchmark: Unknown document \"%s\".\n", argv[i]);
+	usage();
+      }
+
+      selected[num_selected ++] = argv[i];
+    }
+  }
+
+  if (baseline && (bdata = read_file(baseline)) == NULL)
+  {
+    fprintf(stderr, "benchmark: Unable to read baseline \"%s\": %s\n", baseline, strerror(errno));
+    return (1);
+  }
+
+  if (mkdir(dir, 0777) && errno != EEXIST)
+  {
+    fprintf(stderr, "benchmark: Unable to create \"%s\": %s\n", dir, strerror(errno));
+    return (1);
+  }
+
+  printf("%-9s %-6s %8s %8s %8s %8s %7s %8s %7s %8s\n", "Document", "Format", "Parse", "Format", "Write", "Total", "Pages", "Pages/s", "MB/s", "Change");
+
+  for (i = 0; i < (int)(sizeof(documents) / sizeof(documents[0])); i ++)
+  {
+    const bench_doc_t	*doc = documents + i;
+					/* Current document */
+    int			count;		/* Scaled size */
+
+    if (num_selected > 0)
+    {
+      for (j = 0; j < num_selected; j ++)
+        if (!strcmp(selected[j], doc->name))
+	  break;
+
+      if (j >= num_selected)
+        continue;
+    }
+
+   /*
+    * Generate the document...
+    */
+
+    if ((count = (int)((long long)doc->count * scale / 100)) < 1)
+      count = 1;
+
+    snprintf(filename, sizeof(filename), "%s/%s.%s", dir, doc->name, doc->ext);
+
+    if ((fp = fopen(filename, "w")) == NULL)
+    {
+      fprintf(stderr, "benchmark: Unable to create \"%s\": %s\n", filename, strerror(errno));
+      return (1);
+    }
+
+    input_bytes = (doc->func)(fp, dir, count);
+    input_bytes += (size_t)ftell(fp);
+
+    fclose(fp);
+
+   /*
+    * Then convert it to each format...
+    */
+
+    for (fptr = formats; *fptr && num_results < (int)(sizeof(results) / sizeof(results[0]));)
+    {
+      char	*ptr;			/* Pointer into format */
+
+      for (ptr = format; *fptr && *fptr != ',' && ptr < (format + sizeof(format) - 1); *ptr++ = *fptr++);
+      *ptr = '\0';
+
+      if (*fptr == ',')
+        fptr ++;
+
+      if (!format[0])
+        continue;
+
+      bench_result_t *r = results + num_results;
+
+      if (!run_document(htmldoc, options, dir, doc, input_bytes, format, r))
+      {
+        printf("%-9s %-6s FAILED\n", doc->name, format);
+        failures ++;
+	continue;
+      }
+
+      num_results ++;
+
+      if (bdata)
+      {
+        char	key[128];		/* Baseline key */
+	const char *bptr;		/* Pointer into baseline */
+
+        snprintf(key, sizeof(key), "\"name\": \"%s\"", r->name);
+
+        if ((bptr = strstr(bdata, key)) != NULL)
+	  r->baseline = json_number(bptr, NULL, "wall");
+      }
+
+      printf("%-9s %-6s %8.3f %8.3f %8.3f %8.3f %7ld ", doc->name, format, r->parse, r->format, r->write, r->wall, r->pages);
+
+      if (r->pages > 0 && (r->format + r->write) > 0.0)
+        printf("%8.1f ", r->pages / (r->format + r->write));
+      else
+        printf("%8s ", "-");
+
+      if (r->wall > 0.0)
+        printf("%7.2f ", r->input_bytes / r->wall / 1048576.0);
+      else
+        printf("%7s ", "-");
+
+      if (r->baseline > 0.0)
+      {
+        double change = 100.0 * (r->wall - r->baseline) / r->baseline;
+					/* Change from baseline */
+
+        printf("%+7.1f%%%s", change, change > threshold ? " REGRESSION" : "");
+
+	if (change > threshold)
+	  regressions ++;
+      }
+      else
+        printf("%8s", "-");
+
+      putchar('\n');
+      fflush(stdout);
+    }
+  }
+
+ /*
+  * Save the results as needed...
+  */
+
+  if (output)
+  {
+    if ((fp = fopen(output, "w")) == NULL)
+    {
+      fprintf(stderr, "benchmark: Unable to create \"%s\": %s\n", output, strerror(errno));
+      return (1);
+    }
+
+    fprintf(fp, "{\n  \"scale\": %d,\n  \"options\": \"%s\",\n  \"results\": [\n", scale, options);
+
+    for (i = 0; i < num_results; i ++)
+      fprintf(fp, "    { \"name\": \"%s\", \"parse\": %.6f, \"format\": %.6f, \"write\": %.6f, \"wall\": %.6f, \"pages\": %ld, \"input_bytes\": %lu, \"output_bytes\": %lu }%s\n", results[i].name, results[i].parse, results[i].format, results[i].write, results[i].wall, results[i].pages, (unsigned long)results[i].input_bytes, (unsigned long)results[i].output_bytes, i < (num_results - 1) ? "," : "");
+
+    fputs("  ]\n}\n", fp);
+    fclose(fp);
+  }
+
+  free(bdata);
+
+  if (regressions)
+    printf("%d regression(s) over %d%%.\n", regressions, threshold);
+
+  if (failures)
+    printf("%d failed run(s) not included in the results.\n", failures);
+
+  return (regressions || failures);
+}
+
+
+/*
+ * 'gen_anchors()' - Generate a document with many anchors.
+ */
+
+static size_t				/* O - Bytes of other input files */
+gen_anchors(FILE       *fp,		/* I - Document file */
+            const char *dir,		/* I - Corpus directory */
+	    int        count)		/* I - Number of anchors */
+{
+  int	i;				/* Looping var */
+
+
+  (void)dir;
+
+  fputs("<!DOCTYPE html>\n<html><head><title>Anchors</title></head><body>\n<h1>Anchors</h1>\n<p>", fp);
+
+  for (i = 0; i < count; i ++)
+  {
+    if (i > 0)
+      fprintf(fp, "<a name=\"a%d\" href=\"#a%d\">%s %d</a>\n", i, i - 1, words[i % 19], i);
+    else
+      fputs("<a name=\"a0\">first</a>\n", fp);
+
+    if ((i % 100) == 99)
+      fputs("</p>\n<p>", fp);
+  }
+
+  fputs("</p>\n</body></html>\n", fp);
+
+  return (0);
+}
+
+
+/*
+ * 'gen_images()' - Generate a document with many images.
+ *
+ * Each image is a separate 32x32 BMP file so that none of them are shared.
+ */
+
+static size_t				/* O - Bytes of other input files */
+gen_images(FILE       *fp,		/* I - Document file */
+           const char *dir,		/* I - Corpus directory */
+	   int        count)		/* I - Number of images */
+{
+  int		i, y, x;		/* Looping vars */
+  char		filename[1024];		/* Image filename */
+  FILE		*ifp;			/* Image file */
+  size_t	bytes = 0;		/* Bytes in image files */
+  unsigned char	header[54],		/* BMP header */
+		row[32 * 3];		/* Row of pixels */
+
+
+  snprintf(filename, sizeof(filename), "%s/img", dir);
+  if (mkdir(filename, 0777) && errno != EEXIST)
+  {
+    fprintf(stderr, "benchmark: Unable to create \"%s\": %s\n", filename, strerror(errno));
+    exit(1);
+  }
+
+  memset(header, 0, sizeof(header));
+  header[0]  = 'B';
+  header[1]  = 'M';
+  header[2]  = (54 + 32 * 32 * 3) & 255;
+  header[3]  = (54 + 32 * 32 * 3) >> 8;
+  header[10] = 54;
+  header[14] = 40;
+  header[18] = 32;
+  header[22] = 32;
+  header[26] = 1;
+  header[28] = 24;
+
+  fputs("<!DOCTYPE html>\n<html><head><title>Images</title></head><body>\n<h1>Images</h1>\n<p>", fp);
+
+  for (i = 0; i < count; i ++)
+  {
+    snprintf(filename, sizeof(filename), "%s/img/i%05d.bmp", dir, i);
+
+    if ((ifp = fopen(filename, "wb")) == NULL)
+    {
+      fprintf(stderr, "benchmark: Unable to create \"%s\": %s\n", filename, strerror(errno));
+      exit(1);
+    }
+
+    fwrite(header, 1, sizeof(header), ifp);
+
+    for (y = 0; y < 32; y ++)
+    {
+      for (x = 0; x < 32; x ++)
+      {
+        row[3 * x + 0] = (unsigned char)(i * 7 + x * 8);
+        row[3 * x + 1] = (unsigned char)(i * 13 + y * 8);
+        row[3 * x + 2] = (unsigned char)(i * 3 + (x ^ y) * 8);
+      }
+
+      fwrite(row, 1, sizeof(row), ifp);
+    }
+
+    bytes += (size_t)ftell(ifp);
+    fclose(ifp);
+
+    fprintf(fp, "<img src=\"img/i%05d.bmp\" width=\"32\" height=\"32\" alt=\"%d\">\n", i, i);
+
+    if ((i % 100) == 99)
+      fputs("</p>\n<p>", fp);
+  }
+
+  fputs("</p>\n</body></html>\n", fp);
+
+  return (bytes);
+}
+
+
+/*
+ * 'gen_markdown()' - Generate a large Markdown document.
+ */
+
+static size_t				/* O - Bytes of other input files */
+gen_markdown(FILE       *fp,		/* I - Document file */
+             const char *dir,		/* I - Corpus directory */
+	     int        count)		/* I - Number of sections */
+{
+  int	i, j;				/* Looping vars */
+
+
+  (void)dir;
+
+  fputs("---\ntitle: Markdown Benchmark\n---\n\n", fp);
+
+  for (i = 0; i < count; i ++)
+  {
+    if ((i % 20) == 0)
+      fprintf(fp, "# Chapter %d\n\n", i / 20 + 1);
+
+    fprintf(fp, "## Section %d\n\n", i + 1);
+
+    for (j = 0; j < 40; j ++)
+      fprintf(fp, "%s%s", j == 7 ? "*" : j == 15 ? "**" : j == 23 ? "`" : "", words[(i + j) % 19]);
+    fputs("\n\n", fp);
+
+    fprintf(fp, "- item %d with [a link](#section-%d)\n- item with `code`\n  - nested *item*\n\n", i, i + 1);
+    fprintf(fp, "```\nfor (i = 0; i < %d; i ++)\n  puts(\"%s\");\n```\n\n", i, words[i % 19]);
+    fprintf(fp, "> Quoted %s text for section %d.\n\n", words[i % 19], i + 1);
+
+    if ((i % 10) == 0)
+      fprintf(fp, "| Name | Value |\n| ---- | ----- |\n| %s | %d |\n| %s | %d |\n\n", words[i % 19], i, words[(i + 1) % 19], i + 1);
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'gen_nested()' - Generate a document with deeply nested tables.
+ */
+
+static size_t				/* O - Bytes of other input files */
+gen_nested(FILE       *fp,		/* I - Document file */
+           const char *dir,		/* I - Corpus directory */
+	   int        count)		/* I - Number of nested tables */
+{
+  int	i;				/* Looping var */
+
+
+  (void)dir;
+
+  fputs("<!DOCTYPE html>\n<html><head><title>Nested Tables</title></head><body>\n<h1>Nested Tables</h1>\n", fp);
+
+  for (i = 0; i < count; i ++)
+  {
+    gen_table_level(fp, 10, i);
+    fputs("<p>\n", fp);
+  }
+
+  fputs("</body></html>\n", fp);
+
+  return (0);
+}
+
+
+/*
+ * 'gen_pre()' - Generate a document with long preformatted blocks.
+ */
+
+static size_t				/* O - Bytes of other input files */
+gen_pre(FILE       *fp,			/* I - Document file */
+        const char *dir,		/* I - Corpus directory */
+	int        count)		/* I - Number of lines */
+{
+  int	i;				/* Looping var */
+
+
+  (void)dir;
+
+  fputs("<!DOCTYPE html>\n<html><head><title>Preformatted</title></head><body>\n<h1>Preformatted</h1>\n<pre>", fp);
+
+  for (i = 0; i < count; i ++)
+  {
+    fprintf(fp, "%8d  %-12s\t%s &amp; %s  0x%08x\n", i, words[i % 19], words[(i * 7) % 19], words[(i * 3) % 19], (unsigned)i * 2654435761U);
+
+    if ((i % 10000) == 9999)
+      fputs("</pre>\n<pre>", fp);
+  }
+
+  fputs("</pre>\n</body></html>\n", fp);
+
+  return (0);
+}
+
+
+/*
+ * 'gen_table()' - Generate a document with a very long table.
+ */
+
+static size_t				/* O - Bytes of other input files */
+gen_table(FILE       *fp,		/* I - Document file */
+          const char *dir,		/* I - Corpus directory */
+	  int        count)		/* I - Number of rows */
+{
+  int	i;				/* Looping var */
+
+
+  (void)dir;
+
+  fputs("<!DOCTYPE html>\n<html><head><title>Table</title></head><body>\n<h1>Table</h1>\n<table border=\"1\" cellpadding=\"2\" width=\"100%\">\n<thead><tr><th>Row</th><th>Name</th><th>Description</th><th align=\"right\">Value</th></tr></thead>\n", fp);
+
+  for (i = 0; i < count; i ++)
+    fprintf(fp, "<tr%s><td>%d</td><td>%s</td><td>%s %s %s</td><td align=\"right\">%d.%02d</td></tr>\n", (i & 1) ? " bgcolor=\"#eeeeee\"" : "", i + 1, words[i % 19], words[(i * 3) % 19], words[(i * 5) % 19], words[(i * 7) % 19], i * 37 % 10000, i % 100);
+
+  fputs("</table>\n</body></html>\n", fp);
+
+  return (0);
+}
+
+
+/*
+ * 'gen_table_level()' - Generate one level of a nested table.
+ */
+
+static void
+gen_table_level(FILE *fp,		/* I - Document file */
+                int  level,		/* I - Levels remaining */
+		int  copy)		/* I - Copy number */
+{
+  fprintf(fp, "<table border=\"1\" cellpadding=\"2\" width=\"100%%\"><tr><td>%s %d.%d</td><td>", words[(copy + level) % 19], copy + 1, level);
+
+  if (level > 1)
+    gen_table_level(fp, level - 1, copy);
+  else
+    fprintf(fp, "%s %s", words[copy % 19], words[(copy * 3) % 19]);
+
+  fputs("</td></tr></table>\n", fp);
+}
+
+
+/*
+ * 'json_number()' - Get a number from a JSON object.
+ *
+ * This only handles the flat objects written by "htmldoc --stats" and this
+ * program.
+ */
+
+static double				/* O - Number or 0.0 */
+json_number(const char *json,		/* I - JSON text */
+            const char *object,		/* I - Object name or NULL */
+	    const char *key)		/* I - Key */
+{
+  char		name[256];		/* Quoted name */
+  const char	*ptr,			/* Pointer into JSON */
+		*end;			/* End of object */
+
+
+  if (object)
+  {
+    snprintf(name, sizeof(name), "\"%s\":", object);
+
+    if ((ptr = strstr(json, name)) == NULL)
+      return (0.0);
+
+    json = ptr + strlen(name);
+  }
+
+  if ((end = strchr(json, '}')) == NULL)
+    end = json + strlen(json);
+
+  snprintf(name, sizeof(name), "\"%s\":", key);
+
+  if ((ptr = strstr(json, name)) == NULL || ptr > end)
+    return (0.0);
+
+  return (strtod(ptr + strlen(name), NULL));
+}
+
+
+/*
+ * 'read_file()' - Read a file into memory.
+ */
+
+static char *				/* O - File contents or NULL */
+read_file(const char *filename)		/* I - File to read */
+{
+  FILE		*fp;			/* File */
+  char		*data;			/* File contents */
+  long		length;			/* Length of file */
+
+
+  if ((fp = fopen(filename, "rb")) == NULL)
+    return (NULL);
+
+  fseek(fp, 0, SEEK_END);
+  length = ftell(fp);
+  rewind(fp);
+
+  if (length < 0 || (data = (char *)malloc((size_t)length + 1)) == NULL)
+  {
+    fclose(fp);
+    return (NULL);
+  }
+
+  data[fread(data, 1, (size_t)length, fp)] = '\0';
+  fclose(fp);
+
+  return (data);
+}
+
+
+/*
+ * 'run_document()' - Convert a document and collect the statistics.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+run_document(
+    const char        *htmldoc,		/* I - HTMLDOC program */
+    const char        *options,		/* I - Extra HTMLDOC options */
+    const char        *dir,		/* I - Corpus directory */
+    const bench_doc_t *doc,		/* I - Document */
+    size_t            input_bytes,	/* I - Size of input */
+    const char        *format,		/* I - Output format */
+    bench_result_t    *r)		/* O - Result */
+{
+  char		command[4096],		/* Command to run */
+		docname[1024],		/* Document filename */
+		outname[1024],		/* Output filename */
+		statsname[1024],	/* Statistics filename */
+		logname[1024],		/* Log filename */
+		*stats;			/* Statistics */
+  int		status;			/* Exit status of command */
+  struct stat	info;			/* Output file information */
+
+
+  memset(r, 0, sizeof(bench_result_t));
+
+  snprintf(r->name, sizeof(r->name), "%s-%s", doc->name, format);
+  snprintf(docname, sizeof(docname), "%s/%s.%s", dir, doc->name, doc->ext);
+  snprintf(outname, sizeof(outname), "%s/%s.%s", dir, r->name, !strncmp(format, "ps", 2) ? "ps" : !strncmp(format, "pdf", 3) ? "pdf" : format);
+  snprintf(statsname, sizeof(statsname), "%s/%s.json", dir, r->name);
+  snprintf(logname, sizeof(logname), "%s/%s.log", dir, r->name);
+
+  unlink(statsname);
+
+ /*
+  * Run HTMLDOC with its messages going to a log file for the run, and don't
+  * count runs that fail...
+  */
+
+  snprintf(command, sizeof(command), "\"%s\" --datadir .. --stats \"%s\" --webpage -t %s %s -f \"%s\" \"%s\" >\"%s\" 2>&1", htmldoc, statsname, format, options, outname, docname, logname);
+
+  if ((status = system(command)) == -1)
+  {
+    fprintf(stderr, "benchmark: Unable to run \"%s\": %s\n", htmldoc, strerror(errno));
+    return (0);
+  }
+  else if (!WIFEXITED(status))
+  {
+    fprintf(stderr, "benchmark: %s conversion crashed, see \"%s\".\n", r->name, logname);
+    return (0);
+  }
+  else if (WEXITSTATUS(status))
+  {
+    fprintf(stderr, "benchmark: %s conversion failed with exit status %d, see \"%s\".\n", r->name, WEXITSTATUS(status), logname);
+    return (0);
+  }
+
+  if ((stats = read_file(statsname)) == NULL)
+  {
+    fprintf(stderr, "benchmark: Unable to read \"%s\": %s\n", statsname, strerror(errno));
+    return (0);
+  }
+
+  r->parse  = json_number(stats, "fetch", "wall") + json_number(stats, "parse", "wall");
+  r->format = json_number(stats, "toc", "wall") + json_number(stats, "layout", "wall") + json_number(stats, "table", "wall") + json_number(stats, "image", "wall");
+  r->write  = json_number(stats, "compress", "wall") + json_number(stats, "write", "wall");
+  r->wall   = json_number(stats, NULL, "wall");
+  r->pages  = (long)json_number(stats, "counts", "pages");
+
+  r->input_bytes = input_bytes;
+
+  if (!stat(outname, &info))
+    r->output_bytes = (size_t)info.st_size;
+
+  free(stats);
+
+  return (1);
+}
+
+
+/*
+ * 'usage()' - Show program usage.
+ */
+
+static void
+usage(void)
+{
+  puts("Usage: ./benchmark [options] [document ...]");
+  puts("Options:");
+  puts("  -b baseline.json   Compare against a saved baseline");
+  puts("  -d directory       Directory for the corpus and output files");
+  puts("  -f format[,...]    Output formats (default \"pdf,ps,epub,html\")");
+  puts("  -h htmldoc         HTMLDOC program (default \"./htmldoc\")");
+  puts("  -o results.json    Save the results");
+  puts("  -s percent         Scale the corpus (default 100)");
+  puts("  -t percent         Slowdown that counts as a regression (default 10)");
+  puts("  -x \"options\"       Extra HTMLDOC options");
+  puts("Documents: table, nested, images, anchors, pre, markdown");
+
+  exit(1);
+}
@@ -12,32 +12,21 @@
  */
 
 #include "htmldoc.h"
+#include "links.h"
 #include "markdown.h"
+#include "thread.h"
 #include "zipc.h"
 #include <ctype.h>
 #include <time.h>
 #include <sys/stat.h>
 
 
-/*
- * Named link structure...
- */
-
-typedef struct
-{
-  uchar		*filename;	/* File for link */
-  uchar		name[124];	/* Reference name */
-} link_t;
-
-
 /*
  * Local globals...
  */
 
 
-static size_t	num_links = 0,
-		alloc_links = 0;
-static link_t	*links;
+static hd_links_t *links = NULL;
 static size_t   num_images = 0,
                 alloc_images = 0;
 static char     **images = NULL;
@@ -61,8 +50,7 @@ static char     *get_iso_date(time_t t);
 static uchar	*get_title(tree_t *doc);
 
 static void	add_link(uchar *name, uchar *filename);
-static link_t	*find_link(uchar *name);
-static int	compare_links(link_t *n1, link_t *n2);
+static hd_link_t *find_link(uchar *name);
 static int      compare_images(char **a, char **b);
 static int      copy_image(zipc_t *zipc, const char *filename);
 static int      copy_images(zipc_t *zipc, tree_t *t);
@@ -89,6 +77,7 @@ epub_export(tree_t *document,           /* I - Document to export */
               *subject;			/* Subject/category */
   zipc_t      *epub;                    /* EPUB output file */
   zipc_file_t *epubf;                   /* File in container */
+  hd_pool_t   *pool;                    /* Compression threads */
   struct stat epubinfo;                 /* EPUB file information */
   const char  *title_ext;               /* Extension of title image */
   tree_t      *title_tree = NULL;	/* Title file document tree */
@@ -184,7 +173,7 @@ epub_export(tree_t *document,           /* I - Document to export */
       }
 
       // Read a HTML title page...
-      if ((fp = fopen(title_file, "rb")) == NULL)
+      if ((fp = file_open(title_file, "rb")) == NULL)
       {
 	progress_error(HD_ERROR_FILE_NOT_FOUND,
 		       "Unable to open title file \"%s\" - %s!",
@@ -245,14 +234,19 @@ epub_export(tree_t *document,           /* I - Document to export */
   * Scan for all links in the document, and then update them...
   */
 
-  num_links   = 0;
-  alloc_links = 0;
-  links       = NULL;
+  links = hd_links_new();
 
   scan_links(document, NULL);
   update_links(document, NULL);
   update_links(toc, NULL);
 
+ /*
+  * Deflate the content in chunks, using multiple threads when available...
+  */
+
+  if ((pool = hd_pool_new(Threads)) != NULL)
+    zipcSetJobs(epub, hd_pool_threads(pool) > 1 ? hd_pool_threads(pool) : 1, (zipc_job_add_cb_t)hd_job_add, (zipc_job_wait_cb_t)hd_job_wait, pool);
+
  /*
   * Write the document content...
   */
@@ -365,8 +359,20 @@ epub_export(tree_t *document,           /* I - Document to export */
   else
     status = -1;
 
+  if (hd_stats_enabled)
+  {
+    size_t	deflate_in,		/* Bytes passed to deflate */
+		deflate_out;		/* Bytes from deflate */
+
+    zipcGetStats(epub, &deflate_in, &deflate_out);
+    hd_stats_add(HD_COUNT_DEFLATE_IN, deflate_in);
+    hd_stats_add(HD_COUNT_DEFLATE_OUT, deflate_out);
+  }
+
   status |= zipcClose(epub);
 
+  hd_pool_delete(pool);
+
   if (!stat(OutputPath, &epubinfo))
     progress_error(HD_ERROR_NONE, "BYTES: %ld", (long)epubinfo.st_size);
 
@@ -376,14 +382,8 @@ epub_export(tree_t *document,           /* I - Document to export */
   if (title_tree)
     htmlDeleteTree(title_tree);
 
-  if (alloc_links)
-  {
-    free(links);
-
-    num_links   = 0;
-    alloc_links = 0;
-    links       = NULL;
-  }
+  hd_links_delete(links);
+  links = NULL;
 
   return (status);
 }
@@ -988,46 +988,18 @@ static void
 add_link(uchar *name,		/* I - Name of link */
          uchar *filename)	/* I - File for link */
 {
-  link_t	*temp;		/* New name */
+  hd_link_t	*temp;		/* New name */
 
 
-  if ((temp = find_link(name)) != NULL)
-    temp->filename = filename;
-  else
+  if ((temp = hd_links_add(links, (char *)name)) == NULL)
   {
-    // See if we need to allocate memory for links...
-    if (num_links >= alloc_links)
-    {
-      // Allocate more links...
-      alloc_links += ALLOC_LINKS;
-
-      if (num_links == 0)
-        temp = (link_t *)malloc(sizeof(link_t) * alloc_links);
-      else
-        temp = (link_t *)realloc(links, sizeof(link_t) * alloc_links);
-
-      if (temp == NULL)
-      {
-	progress_error(HD_ERROR_OUT_OF_MEMORY,
-	               "Unable to allocate memory for %d links - %s",
-	               (int)alloc_links, strerror(errno));
-        alloc_links -= ALLOC_LINKS;
-	return;
-      }
-
-      links = temp;
-    }
-
-    // Add a new link...
-    temp = links + num_links;
-    num_links ++;
-
-    strlcpy((char *)temp->name, (char *)name, sizeof(temp->name));
-    temp->filename = filename;
-
-    if (num_links > 1)
-      qsort(links, num_links, sizeof(link_t), (compare_func_t)compare_links);
+    progress_error(HD_ERROR_OUT_OF_MEMORY,
+                   "Unable to allocate memory for %d links - %s",
+                   (int)hd_links_count(links) + 1, strerror(errno));
+    return;
   }
+
+  temp->filename = filename;
 }
 
 
@@ -1035,37 +1007,16 @@ add_link(uchar *name,		/* I - Name of link */
  * 'find_link()' - Find a named link...
  */
 
-static link_t *
+static hd_link_t *
 find_link(uchar *name)		/* I - Name to find */
 {
   uchar		*target;	/* Pointer to target name portion */
-  link_t	key,		/* Search key */
-		*match;		/* Matching name entry */
 
 
-  if (name == NULL || num_links == 0)
-    return (NULL);
-
   if ((target = (uchar *)file_target((char *)name)) == NULL)
     return (NULL);
 
-  strlcpy((char *)key.name, (char *)target, sizeof(key.name));
-  match = (link_t *)bsearch(&key, links, num_links, sizeof(link_t),
-                            (compare_func_t)compare_links);
-
-  return (match);
-}
-
-
-/*
- * 'compare_links()' - Compare two named links.
- */
-
-static int			/* O - 0 = equal, -1 or 1 = not equal */
-compare_links(link_t *n1,	/* I - First name */
-              link_t *n2)	/* I - Second name */
-{
-  return (strcasecmp((char *)n1->name, (char *)n2->name));
+  return (hd_links_find(links, (char *)target));
 }
 
 
@@ -1107,7 +1058,7 @@ static void
 update_links(tree_t *t,		/* I - Document tree */
              uchar  *filename)	/* I - Current filename */
 {
-  link_t	*link;		/* Link */
+  hd_link_t	*link;		/* Link */
   uchar		*href;		/* Reference name */
   uchar		newhref[1024];	/* New reference name */
 
@@ -1230,7 +1181,7 @@ copy_image(zipc_t     *zipc,            /* I - ZIP container */
 
   snprintf(epubname, sizeof(epubname), "OEBPS/%s", base);
 
-  if (zipcCopyFile(zipc, epubname, filename, 0, 0))
+  if (zipcCopyFile(zipc, epubname, filename, 0, ZIPC_AUTO))
   {
     progress_error(HD_ERROR_WRITE_ERROR, "Unable to copy \"%s\": %s", base, zipcError(zipc));
     return (-1);
@@ -15,12 +15,19 @@
 #include "file.h"
 #include <cups/http.h>
 #include "progress.h"
+#include "md5-private.h"
+#include "stats.h"
+#include "thread.h"
 #include "debug.h"
 
 #if defined(WIN32)
 #  include <io.h>
+#  include <direct.h>
+#  include <sys/utime.h>
 #else
 #  include <unistd.h>
+#  include <dirent.h>
+#  include <utime.h>
 #endif /* WIN32 */
 
 #include <errno.h>
@@ -53,10 +60,46 @@
 
 typedef struct		/* Cache for all temporary files */
 {
-  char	*name;				/* Temporary filename */
-  char	*url;				/* URL */
+  char		*name;			/* Temporary filename */
+  char		*url;			/* URL */
+  unsigned char	*data;			/* Decoded data URI, if any */
+  size_t	length;			/* Length of decoded data */
 } cache_t;
 
+typedef struct		/* Remote file being prefetched */
+{
+  const char	*url;			/* URL */
+  const char	*name;			/* Temporary filename */
+  size_t	index;			/* Index in URLs, then in cache array */
+  int		host;			/* Host number for connection */
+  int		done;			/* Non-zero if downloaded */
+  size_t	cached;			/* Bytes added to HTTP cache */
+} fetch_t;
+
+typedef struct		/* HTTP cache file */
+{
+  char		*name;			/* Filename */
+  off_t		size;			/* Size of file */
+  time_t	mtime;			/* Last time the file was used */
+} cachefile_t;
+
+typedef struct		/* Persistent connection for prefetching */
+{
+  fetch_t	*fetches;		/* Files to download */
+  int		first,			/* First file */
+		last,			/* Last file + 1 */
+		step;			/* Number of connections to host */
+  hd_job_t	*job;			/* Job for connection */
+} fetchconn_t;
+
+
+/*
+ * Limits for prefetching...
+ */
+
+#define FETCH_MAX_CONNECTIONS	16	/* Maximum concurrent connections */
+#define FETCH_MAX_HOST		6	/* Maximum connections per host */
+
 
 /*
  * Local globals...
@@ -73,6 +116,29 @@ int	no_local = 0;			/* Non-zero to disable local files */
 char	cookies[1024] = "";		/* HTTP cookies, if any */
 char	referer_url[HTTP_MAX_VALUE] = "";
 					/* HTTP referer, if any */
+char	cache_dir[1024] = "";		/* Persistent HTTP cache directory */
+size_t	cache_max = 0,			/* Maximum size of HTTP cache */
+	cache_added = 0;		/* Bytes added to HTTP cache */
+
+
+/*
+ * Local functions...
+ */
+
+static int	file_cache_copy(FILE *cfp, const char *url, FILE *fp);
+static void	file_cache_name(const char *url, char *name, size_t namesize);
+static FILE	*file_cache_open(const char *url, char *etag, size_t etagsize,
+		                 char *modified, size_t modsize);
+static void	file_cache_prune(void);
+static int	file_compare_cachefiles(cachefile_t *a, cachefile_t *b);
+static int	file_compare_fetches(fetch_t *a, fetch_t *b);
+static cache_t	*file_entry(char *name, int len);
+static void	file_fetch(fetchconn_t *conn);
+static ssize_t	file_receive(http_t *http, const char *url, FILE *fp,
+		             size_t *cached, int verbose);
+static http_status_t file_request(http_t **http, const char *url,
+		                  const char *etag, const char *modified,
+				  int verbose);
 
 
 /*
@@ -109,6 +175,237 @@ file_basename(const char *s)	/* I - Filename or URL */
 }
 
 
+/*
+ * 'file_cache_copy()' - Copy the body of an HTTP cache file.
+ *
+ * The cache file is marked as used so that file_cache_prune() keeps the
+ * most recently used files.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+file_cache_copy(FILE       *cfp,	/* I - HTTP cache file */
+                const char *url,	/* I - URL */
+                FILE       *fp)		/* I - Destination file */
+{
+  size_t	bytes;			/* Bytes read */
+  char		buffer[8192];		/* Copy buffer */
+
+
+  while ((bytes = fread(buffer, 1, sizeof(buffer), cfp)) > 0)
+    fwrite(buffer, 1, bytes, fp);
+
+  if (ferror(cfp) || ferror(fp))
+    return (0);
+
+  file_cache_name(url, buffer, sizeof(buffer));
+  utime(buffer, NULL);
+
+  return (1);
+}
+
+
+/*
+ * 'file_cache_name()' - Get the HTTP cache filename for a URL.
+ */
+
+static void
+file_cache_name(const char *url,	/* I - URL */
+                char       *name,	/* O - Filename */
+		size_t     namesize)	/* I - Size of filename buffer */
+{
+  int			i;		/* Looping var */
+  _cups_md5_state_t	md5;		/* MD5 state */
+  unsigned char		sum[16];	/* MD5 sum of URL */
+  char			hex[33];	/* Hex version of sum */
+  static const char	*hexdigits = "0123456789abcdef";
+					/* Hex digits */
+
+
+  _cupsMD5Init(&md5);
+  _cupsMD5Append(&md5, (const unsigned char *)url, (int)strlen(url));
+  _cupsMD5Finish(&md5, sum);
+
+  for (i = 0; i < 16; i ++)
+  {
+    hex[2 * i]     = hexdigits[sum[i] >> 4];
+    hex[2 * i + 1] = hexdigits[sum[i] & 15];
+  }
+
+  hex[32] = '\0';
+
+  snprintf(name, namesize, "%s/%s.cache", cache_dir, hex);
+}
+
+
+/*
+ * 'file_cache_open()' - Open the HTTP cache file for a URL.
+ *
+ * Cache files start with three lines containing the URL, the ETag, and the
+ * Last-Modified date of the response, followed by the response body.  The
+ * returned file is positioned at the start of the body.
+ */
+
+static FILE *				/* O - Cache file or NULL */
+file_cache_open(const char *url,	/* I - URL */
+                char       *etag,	/* O - ETag */
+                size_t     etagsize,	/* I - Size of ETag buffer */
+		char       *modified,	/* O - Last-Modified date */
+		size_t     modsize)	/* I - Size of date buffer */
+{
+  FILE		*cfp;			/* Cache file */
+  char		name[1024],		/* Cache filename */
+		line[HTTP_MAX_URI + 2],	/* Line from file */
+		*ptr;			/* Pointer into line */
+  int		i;			/* Looping var */
+
+
+  *etag     = '\0';
+  *modified = '\0';
+
+  if (!cache_dir[0])
+    return (NULL);
+
+  file_cache_name(url, name, sizeof(name));
+
+  if ((cfp = fopen(name, "rb")) == NULL)
+    return (NULL);
+
+  for (i = 0; i < 3; i ++)
+  {
+    if (!fgets(line, sizeof(line), cfp) || (ptr = strchr(line, '\n')) == NULL)
+      break;
+
+    *ptr = '\0';
+
+    if (i == 0 && strcmp(line, url))
+      break;
+    else if (i == 1)
+      strlcpy(etag, line, etagsize);
+    else if (i == 2)
+      strlcpy(modified, line, modsize);
+  }
+
+  if (i < 3 || (!*etag && !*modified))
+  {
+    fclose(cfp);
+    return (NULL);
+  }
+
+  return (cfp);
+}
+
+
+/*
+ * 'file_cache_prune()' - Remove the least recently used HTTP cache files.
+ */
+
+static void
+file_cache_prune(void)
+{
+  cachefile_t	*files = NULL,		/* Cache files */
+		*temp;			/* New cache file array */
+  size_t	i,			/* Looping var */
+		num_files = 0,		/* Number of cache files */
+		alloc_files = 0;	/* Number of allocated files */
+  off_t		total = 0;		/* Total size of files */
+  char		name[1024];		/* Filename */
+  const char	*ext;			/* Extension */
+#ifdef WIN32
+  intptr_t	dir;			/* Directory handle */
+  struct _finddata_t entry;		/* Directory entry */
+
+
+  snprintf(name, sizeof(name), "%s/*.cache", cache_dir);
+
+  if ((dir = _findfirst(name, &entry)) == -1)
+    return;
+
+  do
+  {
+    if ((ext = strrchr(entry.name, '.')) == NULL || strcmp(ext, ".cache"))
+      continue;
+
+    if (num_files >= alloc_files)
+    {
+      if ((temp = (cachefile_t *)realloc(files, (alloc_files + 64) * sizeof(cachefile_t))) == NULL)
+        break;
+
+      files       = temp;
+      alloc_files += 64;
+    }
+
+    snprintf(name, sizeof(name), "%s/%s", cache_dir, entry.name);
+
+    files[num_files].name  = strdup(name);
+    files[num_files].size  = (off_t)entry.size;
+    files[num_files].mtime = entry.time_write;
+    total += files[num_files].size;
+    num_files ++;
+  }
+  while (!_findnext(dir, &entry));
+
+  _findclose(dir);
+
+#else
+  DIR		*dir;			/* Directory */
+  struct dirent	*entry;			/* Directory entry */
+  struct stat	fileinfo;		/* File information */
+
+
+  if ((dir = opendir(cache_dir)) == NULL)
+    return;
+
+  while ((entry = readdir(dir)) != NULL)
+  {
+    if ((ext = strrchr(entry->d_name, '.')) == NULL || strcmp(ext, ".cache"))
+      continue;
+
+    snprintf(name, sizeof(name), "%s/%s", cache_dir, entry->d_name);
+
+    if (stat(name, &fileinfo) || !S_ISREG(fileinfo.st_mode))
+      continue;
+
+    if (num_files >= alloc_files)
+    {
+      if ((temp = (cachefile_t *)realloc(files, (alloc_files + 64) * sizeof(cachefile_t))) == NULL)
+        break;
+
+      files       = temp;
+      alloc_files += 64;
+    }
+
+    files[num_files].name  = strdup(name);
+    files[num_files].size  = fileinfo.st_size;
+    files[num_files].mtime = fileinfo.st_mtime;
+    total += files[num_files].size;
+    num_files ++;
+  }
+
+  closedir(dir);
+#endif /* WIN32 */
+
+ /*
+  * Remove the oldest files until the cache fits...
+  */
+
+  if (total > (off_t)cache_max)
+  {
+    qsort(files, num_files, sizeof(cachefile_t), (int (*)(const void *, const void *))file_compare_cachefiles);
+
+    for (i = 0; i < num_files && total > (off_t)cache_max; i ++)
+    {
+      if (files[i].name && !unlink(files[i].name))
+        total -= files[i].size;
+    }
+  }
+
+  for (i = 0; i < num_files; i ++)
+    free(files[i].name);
+
+  free(files);
+}
+
+
 /*
  * 'file_cleanup()' - Close an open HTTP connection and remove temporary files...
  */
@@ -133,6 +430,12 @@ file_cleanup(void)
     http = NULL;
   }
 
+  if (cache_dir[0] && cache_max > 0 && cache_added > 0)
+  {
+    file_cache_prune();
+    cache_added = 0;
+  }
+
 #ifdef WIN32
   if ((tmpdir = getenv("TEMP")) == NULL)
   {
@@ -196,17 +499,23 @@ file_cleanup(void)
   {
     snprintf(filename, sizeof(filename), TEMPLATE, tmpdir, (long)getpid(), (int)web_files);
 
-    if (unlink(filename))
+    web_files --;
+
+#ifdef HAVE_FMEMOPEN
+    if (!web_cache[web_files].data && unlink(filename) && errno != ENOENT)
+#else
+    if (unlink(filename) && errno != ENOENT)
+#endif /* HAVE_FMEMOPEN */
       progress_error(HD_ERROR_DELETE_ERROR,
                      "Unable to delete temporary file \"%s\": %s",
                      filename, strerror(errno));
 
-    web_files --;
-
     if (web_cache[web_files].name)
       free(web_cache[web_files].name);
     if (web_cache[web_files].url)
       free(web_cache[web_files].url);
+    if (web_cache[web_files].data)
+      free(web_cache[web_files].data);
   }
 
   if (web_alloc)
@@ -219,6 +528,38 @@ file_cleanup(void)
 }
 
 
+/*
+ * 'file_compare_cachefiles()' - Compare two HTTP cache files by last use.
+ */
+
+static int				/* O - Result of comparison */
+file_compare_cachefiles(cachefile_t *a,	/* I - First file */
+                        cachefile_t *b)	/* I - Second file */
+{
+  if (a->mtime < b->mtime)
+    return (-1);
+  else
+    return (a->mtime > b->mtime);
+}
+
+
+/*
+ * 'file_compare_fetches()' - Compare two prefetched files by host.
+ */
+
+static int				/* O - Result of comparison */
+file_compare_fetches(fetch_t *a,	/* I - First file */
+                     fetch_t *b)	/* I - Second file */
+{
+  if (a->host != b->host)
+    return (a->host - b->host);
+  else if (a->index < b->index)
+    return (-1);
+  else
+    return (a->index > b->index);
+}
+
+
 /*
  * 'file_cookies()' - Set the HTTP cookies for remote accesses.
  */
@@ -233,6 +574,42 @@ file_cookies(const char *s)		/* I - Cookie string or NULL */
 }
 
 
+/*
+ * 'file_data()' - Return the decoded data for a data URI.
+ *
+ * "filename" is the name returned by file_find().  NULL is returned for
+ * regular files.
+ */
+
+const unsigned char *			/* O - Data or NULL */
+file_data(const char *filename,		/* I - Filename */
+          size_t     *length)		/* O - Length of data */
+{
+  size_t	i;			/* Looping var */
+  cache_t	*wc;			/* Current cache entry */
+
+
+  if (length)
+    *length = 0;
+
+  if (!filename)
+    return (NULL);
+
+  for (i = web_files, wc = web_cache; i > 0; i --, wc ++)
+  {
+    if (wc->data && !strcmp(wc->name, filename))
+    {
+      if (length)
+        *length = wc->length;
+
+      return (wc->data);
+    }
+  }
+
+  return (NULL);
+}
+
+
 /*
  * 'file_directory()' - Return the directory without filename or target.
  */
@@ -296,6 +673,75 @@ file_directory(const char *s)	/* I - Filename or URL */
 }
 
 
+/*
+ * 'file_entry()' - Add a file to the web cache and get its temporary filename.
+ */
+
+static cache_t *			/* O - Cache entry or NULL */
+file_entry(char *name,			/* O - Filename */
+           int  len)			/* I - Length of filename buffer */
+{
+  cache_t	*temp;			/* Pointer to cache entry */
+  const char	*tmpdir;		/* Temporary directory */
+#ifdef WIN32
+  char		tmppath[1024];		/* Buffer for temp dir */
+#endif /* WIN32 */
+
+
+ /*
+  * Allocate memory for the file cache as needed...
+  */
+
+  if (web_files >= web_alloc)
+  {
+    web_alloc += ALLOC_FILES;
+    if (web_files == 0)
+      temp = (cache_t *)malloc(sizeof(cache_t) * web_alloc);
+    else
+      temp = (cache_t *)realloc(web_cache, sizeof(cache_t) * web_alloc);
+
+    if (temp == NULL)
+    {
+      progress_error(HD_ERROR_OUT_OF_MEMORY,
+                     "Unable to allocate memory for %d file entries - %s",
+                     (int)web_alloc, strerror(errno));
+      web_alloc -= ALLOC_FILES;
+      return (NULL);
+    }
+
+    web_cache = temp;
+  }
+
+ /*
+  * Clear a new file cache entry...
+  */
+
+  temp = web_cache + web_files;
+
+  temp->url    = NULL;
+  temp->data   = NULL;
+  temp->length = 0;
+  web_files ++;
+
+#ifdef WIN32
+  if ((tmpdir = getenv("TEMP")) == NULL)
+  {
+    GetTempPath(sizeof(tmppath), tmppath);
+    tmpdir = tmppath;
+  }
+#else
+  if ((tmpdir = getenv("TMPDIR")) == NULL)
+    tmpdir = "/var/tmp";
+#endif /* WIN32 */
+
+  snprintf(name, (size_t)len, TEMPLATE, tmpdir, (long)getpid(), (int)web_files);
+
+  temp->name = strdup(name);
+
+  return (temp);
+}
+
+
 /*
  * 'file_extension()' - Return the extension of a file without the target.
  */
@@ -343,38 +789,91 @@ file_extension(const char *s)	/* I - Filename or URL */
 
 
 /*
- * 'file_find_check()' - Check to see if the specified file or URL exists...
+ * 'file_fetch()' - Download files over a persistent connection.
  */
 
-static const char *			/* O - Pathname or NULL */
-file_find_check(const char *filename)	/* I - File or URL */
+static void
+file_fetch(fetchconn_t *conn)		/* I - Connection */
 {
   int		i;			/* Looping var */
-  int		retry;			/* Current retry */
-  char		scheme[HTTP_MAX_URI],	/* Method/scheme */
-		username[HTTP_MAX_URI],	/* Username:password */
-		hostname[HTTP_MAX_URI],	/* Hostname */
-		resource[HTTP_MAX_URI];	/* Resource */
-  int		port;			/* Port number */
-  const char	*connscheme;		/* Scheme for connection */
-  const char	*connhost;		/* Host to connect to */
-  int		connport;		/* Port to connect to */
-  char		connpath[HTTP_MAX_URI],	/* Path for GET */
-		connauth[HTTP_MAX_VALUE];/* Auth string */
-  http_status_t	status;			/* Status of request... */
-  FILE		*fp;			/* Web file */
-  ssize_t	bytes,			/* Bytes read */
-		count;			/* Number of bytes so far */
-  off_t		total;			/* Total bytes in file */
-  char		tempname[HTTP_MAX_URI];	/* Temporary filename */
+  fetch_t	*f;			/* Current file */
+  http_t	*http = NULL;		/* Connection to remote server */
+  http_status_t	status;			/* Status of request */
+  FILE		*fp,			/* Temporary file */
+		*cfp;			/* HTTP cache file */
+  char		etag[HTTP_MAX_VALUE],	/* ETag of cached copy */
+		modified[HTTP_MAX_VALUE];
+					/* Last-Modified of cached copy */
 
 
-  DEBUG_printf(("file_find_check(filename=\"%s\")\n", filename));
+  for (i = conn->first; i < conn->last; i += conn->step)
+  {
+    f   = conn->fetches + i;
+    cfp = file_cache_open(f->url, etag, sizeof(etag), modified, sizeof(modified));
 
-  if (strncmp(filename, "http:", 5) == 0 || strncmp(filename, "//", 2) == 0)
-    strlcpy(scheme, "http", sizeof(scheme));
-  else if (strncmp(filename, "https:", 6) == 0)
-    strlcpy(scheme, "https", sizeof(scheme));
+    status = file_request(&http, f->url, cfp ? etag : NULL, cfp ? modified : NULL, 0);
+
+    if (status == HTTP_STATUS_NOT_MODIFIED && cfp)
+    {
+      if ((fp = fopen(f->name, "wb")) != NULL)
+      {
+        f->done = file_cache_copy(cfp, f->url, fp);
+        fclose(fp);
+      }
+
+      fclose(cfp);
+      continue;
+    }
+
+    if (cfp)
+      fclose(cfp);
+
+    if (status != HTTP_STATUS_OK)
+    {
+      if (http)
+        httpFlush(http);
+      continue;
+    }
+
+    if ((fp = fopen(f->name, "wb")) == NULL)
+    {
+      httpFlush(http);
+      continue;
+    }
+
+    f->done = file_receive(http, f->url, fp, &f->cached, 0) >= 0 && !ferror(fp);
+
+    fclose(fp);
+  }
+
+  httpClose(http);
+}
+
+
+/*
+ * 'file_find_check()' - Check to see if the specified file or URL exists...
+ */
+
+static const char *			/* O - Pathname or NULL */
+file_find_check(const char *filename)	/* I - File or URL */
+{
+  int		i;			/* Looping var */
+  char		scheme[HTTP_MAX_URI];	/* Method/scheme */
+  http_status_t	status;			/* Status of request... */
+  FILE		*fp,			/* Web file */
+		*cfp;			/* HTTP cache file */
+  char		tempname[HTTP_MAX_URI],	/* Temporary filename */
+		etag[HTTP_MAX_VALUE],	/* ETag of cached copy */
+		modified[HTTP_MAX_VALUE];
+					/* Last-Modified of cached copy */
+
+
+  DEBUG_printf(("file_find_check(filename=\"%s\")\n", filename));
+
+  if (strncmp(filename, "http:", 5) == 0 || strncmp(filename, "//", 2) == 0)
+    strlcpy(scheme, "http", sizeof(scheme));
+  else if (strncmp(filename, "https:", 6) == 0)
+    strlcpy(scheme, "https", sizeof(scheme));
   else if (strncmp(filename, "data:", 5) == 0)
     strlcpy(scheme, "data", sizeof(scheme));
   else
@@ -402,12 +901,13 @@ file_find_check(const char *filename)	/* I - File or URL */
   else if (!strcmp(scheme, "data"))
   {
    /*
-    * Data URI; look it up in the web cache, then save to a temporary file...
+    * Data URI; look it up in the web cache, then decode it into memory...
     */
 
     const char	*data;			/* Pointer to data */
     int		len;			/* Number of bytes */
-    char	buffer[8192];		/* Data buffer */
+    unsigned char *buffer;		/* Data buffer */
+    cache_t	*wc;			/* Cache entry */
 
     for (i = 0; i < (int)web_files; i ++)
     {
@@ -420,26 +920,51 @@ file_find_check(const char *filename)	/* I - File or URL */
 
     if ((data = strstr(filename, ";base64,")) != NULL)
     {
-      len = sizeof(buffer);
-      httpDecode64_2(buffer, &len, data + 8);
+      data += 8;
+      len  = (int)(3 * (strlen(data) / 4) + 4);
+
+      if ((buffer = (unsigned char *)malloc((size_t)len)) == NULL)
+      {
+	progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for data URL.");
+	return (NULL);
+      }
 
+      httpDecode64_2((char *)buffer, &len, data);
+
+#ifdef HAVE_FMEMOPEN
+     /*
+      * The data is read with file_open() using a memory stream, so only
+      * reserve a name for it...
+      */
+
+      if ((wc = file_entry(tempname, sizeof(tempname))) == NULL)
+      {
+        free(buffer);
+	return (NULL);
+      }
+
+#else
       if ((fp = file_temp(tempname, sizeof(tempname))) == NULL)
       {
 	progress_hide();
 	progress_error(HD_ERROR_WRITE_ERROR, "Unable to create temporary file \"%s\": %s", tempname, strerror(errno));
+	free(buffer);
 	return (NULL);
       }
 
       fwrite(buffer, 1, (size_t)len, fp);
       fclose(fp);
 
-      progress_hide();
+      wc = web_cache + web_files - 1;
+#endif /* HAVE_FMEMOPEN */
 
-      web_cache[web_files - 1].url = strdup(filename);
+      wc->url    = strdup(filename);
+      wc->data   = buffer;
+      wc->length = (size_t)len;
 
       DEBUG_printf(("file_find_check: Returning \"%s\" for \"%s\".\n", tempname, filename));
 
-      return (web_cache[web_files - 1].name);
+      return (wc->name);
     }
   }
   else
@@ -458,102 +983,61 @@ file_find_check(const char *filename)	/* I - File or URL */
       }
     }
 
-    httpSeparateURI(HTTP_URI_CODING_ALL, filename, scheme, sizeof(scheme),
-                    username, sizeof(username), hostname, sizeof(hostname),
-		    &port, resource, sizeof(resource));
-
-    for (status = HTTP_STATUS_ERROR, retry = 0; status != HTTP_STATUS_OK && retry < 5; retry ++)
-    {
-      if (proxy_port)
-      {
-        // Send request to proxy host...
-        connscheme = proxy_scheme;
-        connhost   = proxy_host;
-        connport   = proxy_port;
-        httpAssembleURI(HTTP_URI_CODING_ALL, connpath, sizeof(connpath), scheme, NULL, hostname, port, resource);
-      }
-      else
-      {
-        // Send request to host directly...
-        connscheme = scheme;
-        connhost   = hostname;
-        connport   = port;
-        strlcpy(connpath, resource, sizeof(connpath));
-      }
+    hd_stats_begin(HD_PHASE_FETCH);
 
-      if (connport != httpAddrPort(httpGetAddress(http)) ||
-#ifdef HAVE_SSL
-	  (!strcmp(connscheme, "https") && !httpIsEncrypted(http)) ||
-          (!strcmp(connscheme, "http") && httpIsEncrypted(http)) ||
-#endif // HAVE_SSL
-          strcasecmp(httpGetHostname(http, tempname, sizeof(tempname)), hostname))
-      {
-        httpClose(http);
-        http = NULL;
-      }
+    cfp    = file_cache_open(filename, etag, sizeof(etag), modified, sizeof(modified));
+    status = file_request(&http, filename, cfp ? etag : NULL, cfp ? modified : NULL, 1);
 
-      if (http == NULL)
-      {
-        progress_show("Connecting to %s...", connhost);
+    hd_stats_end();
 
-        http_encryption_t encryption = !strcmp(connscheme, "http") ? HTTP_ENCRYPTION_IF_REQUESTED : HTTP_ENCRYPTION_ALWAYS;
+    if (status == HTTP_STATUS_NOT_MODIFIED && cfp)
+    {
+     /*
+      * Use the copy in the HTTP cache...
+      */
 
-        if ((http = httpConnect2(connhost, connport, NULL, AF_UNSPEC, encryption, 1, 30000, NULL)) == NULL)
-	{
-          progress_hide();
-          progress_error(HD_ERROR_NETWORK_ERROR, "Unable to connect to %s:%d", connhost, connport);
-          return (NULL);
-        }
+      if ((fp = file_temp(tempname, sizeof(tempname))) == NULL)
+      {
+	progress_hide();
+	progress_error(HD_ERROR_WRITE_ERROR,
+		       "Unable to create temporary file \"%s\": %s", tempname,
+		       strerror(errno));
+	fclose(cfp);
+	return (NULL);
       }
 
-      progress_show("Getting %s...", connpath);
-
-      httpClearFields(http);
-      httpSetField(http, HTTP_FIELD_HOST, hostname);
-      httpSetField(http, HTTP_FIELD_CONNECTION, "Keep-Alive");
-      httpSetField(http, HTTP_FIELD_REFERER, referer_url);
+      i = file_cache_copy(cfp, filename, fp);
 
-      if (username[0])
-      {
-        strlcpy(connauth, "Basic ", sizeof(connauth));
-        httpEncode64_2(connauth + 6, sizeof(connauth) - 6, username, strlen(username));
-        httpSetField(http, HTTP_FIELD_AUTHORIZATION, connauth);
-      }
+      fclose(cfp);
+      fclose(fp);
 
-      if (cookies[0])
-        httpSetCookie(http, cookies);
+      progress_hide();
 
-      if (!httpGet(http, connpath))
+      if (!i)
       {
-	while ((status = httpUpdate(http)) == HTTP_CONTINUE);
+        progress_error(HD_ERROR_READ_ERROR, "Unable to read cached copy of \"%s\".", filename);
+        return (NULL);
       }
-      else
-	status = HTTP_ERROR;
 
-      if (status >= HTTP_STATUS_MULTIPLE_CHOICES && status < HTTP_STATUS_BAD_REQUEST)
-      {
-        // Redirect status code, grab the new location...
-        const char *newurl = httpGetField(http, HTTP_FIELD_LOCATION);
-					// New URL
-        char	newresource[256];	// New resource
-
-        progress_show("Redirecting to %s...", newurl);
-	httpSeparateURI(HTTP_URI_CODING_ALL, newurl, scheme, sizeof(scheme), username, sizeof(username), hostname, sizeof(hostname), &port, newresource, sizeof(newresource));
+      web_cache[web_files - 1].url = strdup(filename);
 
-        // Don't use new resource path if it is empty...
-        if (strchr(newurl + strlen(scheme) + 3, '/'))
-          strlcpy(resource, newresource, sizeof(resource));
+      DEBUG_printf(("file_find_check: Returning cached \"%s\" for \"%s\".\n", tempname, filename));
 
-        // ... then flush any text in the response...
-	httpFlush(http);
-      }
+      return (web_cache[web_files - 1].name);
     }
 
+    if (cfp)
+      fclose(cfp);
+
     if (status != HTTP_OK)
     {
-      progress_hide();
-      progress_error((HDerror)status, "%s (%s)", httpStatus(status), filename);
-      httpFlush(http);
+      if (http)
+      {
+        progress_hide();
+        progress_error((HDerror)status, "%s (%s)", httpStatus(status), filename);
+        httpFlush(http);
+      }
+
       return (NULL);
     }
 
@@ -567,16 +1051,9 @@ file_find_check(const char *filename)	/* I - File or URL */
       return (NULL);
     }
 
-    if ((total = httpGetLength2(http)) == 0)
-      total = 8192;
-
-    count = 0;
-    while ((bytes = httpRead2(http, resource, sizeof(resource))) > 0)
-    {
-      count += bytes;
-      progress_update((100 * count / total) % 101);
-      fwrite(resource, 1, (size_t)bytes, fp);
-    }
+    hd_stats_begin(HD_PHASE_FETCH);
+    file_receive(http, filename, fp, &cache_added, 1);
+    hd_stats_end();
 
     progress_hide();
 
@@ -686,6 +1163,7 @@ file_find(const char *path,		/* I - Path "dir;dir;dir" */
 
   if (strncmp(s, "http:", 5) == 0 ||
       strncmp(s, "https:", 6) == 0 ||
+      strncmp(s, "data:", 5) == 0 ||
       strncmp(s, "//", 2) == 0)
   {
     DEBUG_puts("file_find: Resetting path to NULL since filename is a URL...");
@@ -825,6 +1303,59 @@ file_gets(char  *buf,		/* I - Line buffer */
 }
 
 
+/*
+ * 'file_httpcache()' - Set the directory and size of the HTTP cache.
+ *
+ * Remote files are saved in the directory along with their ETag and
+ * Last-Modified date, and are revalidated with a conditional GET when they
+ * are needed again.  A NULL or empty directory disables the cache.
+ */
+
+void
+file_httpcache(const char *directory,	/* I - Cache directory or NULL */
+               size_t     maxsize)	/* I - Maximum size in bytes or 0 for no limit */
+{
+  cache_dir[0] = '\0';
+  cache_max    = maxsize;
+
+  if (!directory || !*directory)
+    return;
+
+#ifdef WIN32
+  if (access(directory, 0) && _mkdir(directory))
+#else
+  if (access(directory, 0) && mkdir(directory, 0700))
+#endif /* WIN32 */
+  {
+    progress_error(HD_ERROR_WRITE_ERROR,
+                   "Unable to create HTTP cache directory \"%s\": %s",
+		   directory, strerror(errno));
+    return;
+  }
+
+  strlcpy(cache_dir, directory, sizeof(cache_dir));
+}
+
+
+/*
+ * 'file_httpcache_purge()' - Remove all files from the HTTP cache.
+ */
+
+void
+file_httpcache_purge(void)
+{
+  size_t	maxsize = cache_max;	/* Maximum size of cache */
+
+
+  if (!cache_dir[0])
+    return;
+
+  cache_max = 0;
+  file_cache_prune();
+  cache_max = maxsize;
+}
+
+
 /*
  * 'file_localize()' - Localize a filename for the new working directory.
  */
@@ -950,6 +1481,239 @@ file_nolocal(void)
 }
 
 
+/*
+ * 'file_open()' - Open a file found with file_find() for reading.
+ *
+ * Decoded data URIs are read from memory when possible.
+ */
+
+FILE *					/* O - File or NULL */
+file_open(const char *filename,		/* I - Filename */
+          const char *mode)		/* I - Open mode */
+{
+#ifdef HAVE_FMEMOPEN
+  const unsigned char	*data;		/* Decoded data URI */
+  size_t		length;		/* Length of data */
+
+
+  if ((data = file_data(filename, &length)) != NULL)
+  {
+    if (length == 0)
+    {
+      errno = EINVAL;
+      return (NULL);
+    }
+
+    return (fmemopen((void *)data, length, mode));
+  }
+#endif /* HAVE_FMEMOPEN */
+
+  return (fopen(filename, mode));
+}
+
+
+/*
+ * 'file_prefetch()' - Download remote files concurrently.
+ *
+ * The files are downloaded using a few persistent connections to each host
+ * and added to the web cache, so that later calls to file_find() do not need
+ * to download them again.  Files that cannot be downloaded are ignored here
+ * and reported when file_find() tries them again.
+ */
+
+int					/* O - Number of files downloaded */
+file_prefetch(const char **urls,	/* I - URLs */
+              int        num_urls)	/* I - Number of URLs */
+{
+  int		i, j;			/* Looping vars */
+  fetch_t	*fetches,		/* Files to download */
+		*f;			/* Current file */
+  int		num_fetches;		/* Number of files to download */
+  char		(*hosts)[HTTP_MAX_URI];	/* Hosts */
+  int		num_hosts;		/* Number of hosts */
+  fetchconn_t	*conns,			/* Connections */
+		*conn;			/* Current connection */
+  int		num_conns;		/* Number of connections */
+  int		first,			/* First file for host */
+		last;			/* Last file for host + 1 */
+  int		count;			/* Number of files downloaded */
+  hd_pool_t	*pool;			/* Threads for connections */
+  FILE		*fp;			/* Temporary file */
+  char		scheme[HTTP_MAX_URI],	/* Method/scheme */
+		username[HTTP_MAX_URI],	/* Username:password */
+		hostname[HTTP_MAX_URI],	/* Hostname */
+		resource[HTTP_MAX_URI],	/* Resource */
+		key[HTTP_MAX_URI],	/* Scheme, host, and port */
+		tempname[HTTP_MAX_URI];	/* Temporary filename */
+  int		port;			/* Port number */
+
+
+  if (!urls || num_urls < 2)
+    return (0);
+
+  if ((fetches = (fetch_t *)calloc((size_t)num_urls, sizeof(fetch_t))) == NULL)
+    return (0);
+
+  if ((hosts = (char (*)[HTTP_MAX_URI])calloc((size_t)num_urls, HTTP_MAX_URI)) == NULL)
+  {
+    free(fetches);
+    return (0);
+  }
+
+ /*
+  * Figure out which URLs need to be downloaded and the host for each...
+  */
+
+  for (i = 0, num_fetches = 0, num_hosts = 0; i < num_urls; i ++)
+  {
+    if (strncmp(urls[i], "http://", 7) && strncmp(urls[i], "https://", 8))
+      continue;
+
+    for (j = 0; j < (int)web_files; j ++)
+      if (web_cache[j].url && !strcmp(web_cache[j].url, urls[i]))
+        break;
+
+    if (j < (int)web_files)
+      continue;
+
+    for (j = 0; j < num_fetches; j ++)
+      if (!strcmp(fetches[j].url, urls[i]))
+        break;
+
+    if (j < num_fetches)
+      continue;
+
+    if (proxy_port)
+    {
+      snprintf(key, sizeof(key), "%s://%s:%d", proxy_scheme, proxy_host, proxy_port);
+    }
+    else
+    {
+      httpSeparateURI(HTTP_URI_CODING_ALL, urls[i], scheme, sizeof(scheme),
+                      username, sizeof(username), hostname, sizeof(hostname),
+		      &port, resource, sizeof(resource));
+      snprintf(key, sizeof(key), "%s://%s:%d", scheme, hostname, port);
+    }
+
+    for (j = 0; j < num_hosts; j ++)
+      if (!strcasecmp(hosts[j], key))
+        break;
+
+    if (j == num_hosts)
+      strlcpy(hosts[num_hosts ++], key, sizeof(hosts[0]));
+
+    f = fetches + num_fetches;
+    num_fetches ++;
+
+    f->url   = urls[i];
+    f->index = (size_t)i;
+    f->host  = j;
+  }
+
+  free(hosts);
+
+  if (num_fetches < 2)
+  {
+    free(fetches);
+    return (0);
+  }
+
+ /*
+  * Create the temporary files now since the web cache cannot change while
+  * the connections are running...
+  */
+
+  qsort(fetches, (size_t)num_fetches, sizeof(fetch_t), (int (*)(const void *, const void *))file_compare_fetches);
+
+  for (i = 0; i < num_fetches; i ++)
+  {
+    if ((fp = file_temp(tempname, sizeof(tempname))) == NULL)
+      break;
+
+    fclose(fp);
+
+    fetches[i].index = web_files - 1;
+    fetches[i].name  = web_cache[web_files - 1].name;
+  }
+
+  if ((num_fetches = i) < 2)
+  {
+    free(fetches);
+    return (0);
+  }
+
+ /*
+  * Start a few connections to each host; the connections share a bounded
+  * number of threads, with each connection getting every Nth file for its
+  * host...
+  */
+
+  if ((conns = (fetchconn_t *)calloc((size_t)num_fetches, sizeof(fetchconn_t))) == NULL)
+  {
+    free(fetches);
+    return (0);
+  }
+
+  if ((pool = hd_pool_new(FETCH_MAX_CONNECTIONS)) == NULL)
+  {
+    free(conns);
+    free(fetches);
+    return (0);
+  }
+
+  progress_show("Getting %d files...", num_fetches);
+  hd_stats_begin(HD_PHASE_FETCH);
+
+  for (first = 0, num_conns = 0; first < num_fetches; first = last)
+  {
+    for (last = first + 1; last < num_fetches && fetches[last].host == fetches[first].host; last ++);
+
+    for (j = 0; j < FETCH_MAX_HOST && j < (last - first); j ++)
+    {
+      conn = conns + num_conns;
+      num_conns ++;
+
+      conn->fetches = fetches;
+      conn->first   = first + j;
+      conn->last    = last;
+      conn->step    = (last - first) < FETCH_MAX_HOST ? (last - first) : FETCH_MAX_HOST;
+    }
+  }
+
+  for (i = 0, conn = conns; i < num_conns; i ++, conn ++)
+    if ((conn->job = hd_job_add(pool, (hd_job_func_t)file_fetch, conn)) == NULL)
+      file_fetch(conn);
+
+  for (i = 0, conn = conns; i < num_conns; i ++, conn ++)
+    hd_job_wait(conn->job);
+
+  hd_pool_delete(pool);
+
+  hd_stats_end();
+  progress_hide();
+
+ /*
+  * Add the downloaded files to the web cache...
+  */
+
+  for (i = 0, f = fetches, count = 0; i < num_fetches; i ++, f ++)
+  {
+    if (f->done)
+    {
+      web_cache[f->index].url = strdup(f->url);
+      count ++;
+    }
+
+    cache_added += f->cached;
+  }
+
+  free(conns);
+  free(fetches);
+
+  return (count);
+}
+
+
 /*
  * 'file_proxy()' - Set the proxy host for all HTTP requests.
  */
@@ -984,6 +1748,97 @@ file_proxy(const char *url)	/* I - URL of proxy server */
 }
 
 
+/*
+ * 'file_receive()' - Receive the body of a response.
+ *
+ * Responses with an ETag or Last-Modified date are also saved to the HTTP
+ * cache, if enabled.  A partial response is never added to the cache.
+ */
+
+static ssize_t				/* O  - Number of bytes or -1 on error */
+file_receive(http_t     *http,		/* I  - Connection to remote server */
+             const char *url,		/* I  - URL */
+             FILE       *fp,		/* I  - Destination file */
+	     size_t     *cached,	/* IO - Bytes added to HTTP cache */
+	     int        verbose)	/* I  - Show progress? */
+{
+  ssize_t	bytes,			/* Bytes read */
+		count;			/* Number of bytes so far */
+  off_t		total;			/* Total bytes in file */
+  FILE		*cfp = NULL;		/* HTTP cache file */
+  const char	*etag,			/* ETag of response */
+		*modified;		/* Last-Modified of response */
+  char		name[1024],		/* HTTP cache filename */
+		tempname[1024],		/* Temporary cache filename */
+		buffer[8192];		/* Read buffer */
+
+
+  if (cache_dir[0])
+  {
+#ifdef HAVE_HTTP_FIELD_ETAG
+    etag     = httpGetField(http, HTTP_FIELD_ETAG);
+#else
+    etag     = "";
+#endif // HAVE_HTTP_FIELD_ETAG
+    modified = httpGetField(http, HTTP_FIELD_LAST_MODIFIED);
+
+    if (!etag)
+      etag = "";
+    if (!modified)
+      modified = "";
+
+    if ((*etag || *modified) && !strchr(etag, '\n') && !strchr(modified, '\n'))
+    {
+      file_cache_name(url, name, sizeof(name));
+      snprintf(tempname, sizeof(tempname), "%s.%ld.tmp", name, (long)getpid());
+
+      if ((cfp = fopen(tempname, "wb")) != NULL)
+        fprintf(cfp, "%s\n%s\n%s\n", url, etag, modified);
+    }
+  }
+
+  if ((total = httpGetLength2(http)) == 0)
+    total = 8192;
+
+  count = 0;
+  while ((bytes = httpRead2(http, buffer, sizeof(buffer))) > 0)
+  {
+    count += bytes;
+
+    if (verbose)
+      progress_update((int)((100 * count / total) % 101));
+
+    fwrite(buffer, 1, (size_t)bytes, fp);
+
+    if (cfp)
+      fwrite(buffer, 1, (size_t)bytes, cfp);
+  }
+
+  if (cfp)
+  {
+    int complete = bytes == 0 && !ferror(cfp);
+					/* Is the cache file complete? */
+
+    if (fclose(cfp))
+      complete = 0;
+
+#ifdef WIN32
+    if (complete)
+      unlink(name);
+#endif /* WIN32 */
+
+    if (complete && !rename(tempname, name))
+      *cached += (size_t)count;
+    else
+      unlink(tempname);
+  }
+
+  hd_stats_add(HD_COUNT_FETCH_BYTES, (size_t)count);
+
+  return (bytes < 0 ? -1 : count);
+}
+
+
 /*
  * 'file_referer()' - Set the HTTP referer for remote accesses.
  */
@@ -998,6 +1853,150 @@ file_referer(const char *referer)	/* I - Referer URL */
 }
 
 
+/*
+ * 'file_request()' - Send a GET request, following any redirects.
+ *
+ * The connection is reused when it goes to the same host.  On success the
+ * response data is ready to be read with httpRead2().  If the connection
+ * cannot be made, "http" is set to NULL.  When the validators of a cached
+ * copy are supplied, HTTP_STATUS_NOT_MODIFIED means the copy can be used.
+ */
+
+static http_status_t			/* O  - Status of request */
+file_request(http_t     **http,		/* IO - Connection to remote server */
+             const char *url,		/* I  - URL */
+	     const char *etag,		/* I  - ETag of cached copy or NULL */
+	     const char *modified,	/* I  - Last-Modified of cached copy or NULL */
+	     int        verbose)	/* I  - Show progress and errors? */
+{
+  int		retry;			/* Current retry */
+  char		scheme[HTTP_MAX_URI],	/* Method/scheme */
+		username[HTTP_MAX_URI],	/* Username:password */
+		hostname[HTTP_MAX_URI],	/* Hostname */
+		resource[HTTP_MAX_URI];	/* Resource */
+  int		port;			/* Port number */
+  const char	*connscheme;		/* Scheme for connection */
+  const char	*connhost;		/* Host to connect to */
+  int		connport;		/* Port to connect to */
+  char		connpath[HTTP_MAX_URI],	/* Path for GET */
+		connauth[HTTP_MAX_VALUE],/* Auth string */
+		temp[HTTP_MAX_URI];	/* Temporary string */
+  http_status_t	status;			/* Status of request... */
+
+
+  httpSeparateURI(HTTP_URI_CODING_ALL, url, scheme, sizeof(scheme),
+                  username, sizeof(username), hostname, sizeof(hostname),
+		  &port, resource, sizeof(resource));
+
+  for (status = HTTP_STATUS_ERROR, retry = 0; status != HTTP_STATUS_OK && status != HTTP_STATUS_NOT_MODIFIED && retry < 5; retry ++)
+  {
+    if (proxy_port)
+    {
+      // Send request to proxy host...
+      connscheme = proxy_scheme;
+      connhost   = proxy_host;
+      connport   = proxy_port;
+      httpAssembleURI(HTTP_URI_CODING_ALL, connpath, sizeof(connpath), scheme, NULL, hostname, port, resource);
+    }
+    else
+    {
+      // Send request to host directly...
+      connscheme = scheme;
+      connhost   = hostname;
+      connport   = port;
+      strlcpy(connpath, resource, sizeof(connpath));
+    }
+
+    if (connport != httpAddrPort(httpGetAddress(*http)) ||
+#ifdef HAVE_SSL
+	(!strcmp(connscheme, "https") && !httpIsEncrypted(*http)) ||
+        (!strcmp(connscheme, "http") && httpIsEncrypted(*http)) ||
+#endif // HAVE_SSL
+        strcasecmp(httpGetHostname(*http, temp, sizeof(temp)), hostname))
+    {
+      httpClose(*http);
+      *http = NULL;
+    }
+
+    if (*http == NULL)
+    {
+      if (verbose)
+        progress_show("Connecting to %s...", connhost);
+
+      http_encryption_t encryption = !strcmp(connscheme, "http") ? HTTP_ENCRYPTION_IF_REQUESTED : HTTP_ENCRYPTION_ALWAYS;
+
+      if ((*http = httpConnect2(connhost, connport, NULL, AF_UNSPEC, encryption, 1, 30000, NULL)) == NULL)
+      {
+        if (verbose)
+        {
+          progress_hide();
+          progress_error(HD_ERROR_NETWORK_ERROR, "Unable to connect to %s:%d", connhost, connport);
+        }
+
+        return (HTTP_STATUS_ERROR);
+      }
+    }
+
+    if (verbose)
+      progress_show("Getting %s...", connpath);
+
+    httpClearFields(*http);
+    httpSetField(*http, HTTP_FIELD_HOST, hostname);
+    httpSetField(*http, HTTP_FIELD_CONNECTION, "Keep-Alive");
+    httpSetField(*http, HTTP_FIELD_REFERER, referer_url);
+
+    if (username[0])
+    {
+      strlcpy(connauth, "Basic ", sizeof(connauth));
+      httpEncode64_2(connauth + 6, sizeof(connauth) - 6, username, strlen(username));
+      httpSetField(*http, HTTP_FIELD_AUTHORIZATION, connauth);
+    }
+
+    if (cookies[0])
+      httpSetCookie(*http, cookies);
+
+    if (modified && *modified)
+      httpSetField(*http, HTTP_FIELD_IF_MODIFIED_SINCE, modified);
+
+#ifdef HAVE_HTTP_FIELD_ETAG
+    if (etag && *etag)
+      httpSetField(*http, HTTP_FIELD_IF_NONE_MATCH, etag);
+#else
+    (void)etag;
+#endif // HAVE_HTTP_FIELD_ETAG
+
+    if (!httpGet(*http, connpath))
+    {
+      while ((status = httpUpdate(*http)) == HTTP_CONTINUE);
+    }
+    else
+      status = HTTP_ERROR;
+
+    if (status >= HTTP_STATUS_MULTIPLE_CHOICES && status < HTTP_STATUS_BAD_REQUEST && status != HTTP_STATUS_NOT_MODIFIED)
+    {
+      // Redirect status code, grab the new location...
+      const char *newurl = httpGetField(*http, HTTP_FIELD_LOCATION);
+					// New URL
+      char	newresource[256];	// New resource
+
+      if (verbose)
+        progress_show("Redirecting to %s...", newurl);
+
+      httpSeparateURI(HTTP_URI_CODING_ALL, newurl, scheme, sizeof(scheme), username, sizeof(username), hostname, sizeof(hostname), &port, newresource, sizeof(newresource));
+
+      // Don't use new resource path if it is empty...
+      if (strchr(newurl + strlen(scheme) + 3, '/'))
+        strlcpy(resource, newresource, sizeof(resource));
+
+      // ... then flush any text in the response...
+      httpFlush(*http);
+    }
+  }
+
+  return (status);
+}
+
+
 /*
  * 'file_rlookup()' - Lookup a filename to find the original URL, if applicable.
  */
@@ -1060,61 +2059,12 @@ FILE *					/* O - Temporary file */
 file_temp(char *name,			/* O - Filename */
           int  len)			/* I - Length of filename buffer */
 {
-  cache_t	*temp;			/* Pointer to cache entry */
   FILE		*fp;			/* File pointer */
   int		fd;			/* File descriptor */
-  const char	*tmpdir;		/* Temporary directory */
-#ifdef WIN32
-  char		tmppath[1024];		/* Buffer for temp dir */
-#endif /* WIN32 */
-
-
- /*
-  * Allocate memory for the file cache as needed...
-  */
-
-  if (web_files >= web_alloc)
-  {
-    web_alloc += ALLOC_FILES;
-    if (web_files == 0)
-      temp = (cache_t *)malloc(sizeof(cache_t) * web_alloc);
-    else
-      temp = (cache_t *)realloc(web_cache, sizeof(cache_t) * web_alloc);
 
-    if (temp == NULL)
-    {
-      progress_error(HD_ERROR_OUT_OF_MEMORY,
-                     "Unable to allocate memory for %d file entries - %s",
-                     (int)web_alloc, strerror(errno));
-      web_alloc -= ALLOC_FILES;
-      return (NULL);
-    }
-
-    web_cache = temp;
-  }
 
- /*
-  * Clear a new file cache entry...
-  */
-
-  temp = web_cache + web_files;
-
-  temp->name = NULL;
-  temp->url  = NULL;
-  web_files ++;
-
-#ifdef WIN32
-  if ((tmpdir = getenv("TEMP")) == NULL)
-  {
-    GetTempPath(sizeof(tmppath), tmppath);
-    tmpdir = tmppath;
-  }
-#else
-  if ((tmpdir = getenv("TMPDIR")) == NULL)
-    tmpdir = "/var/tmp";
-#endif /* WIN32 */
-
-  snprintf(name, (size_t)len, TEMPLATE, tmpdir, (long)getpid(), (int)web_files);
+  if (!file_entry(name, len))
+    return (NULL);
 
   if ((fd = open(name, OPENMODE, OPENPERM)) >= 0)
     fp = fdopen(fd, "w+b");
@@ -1122,9 +2072,10 @@ file_temp(char *name,			/* O - Filename */
     fp = NULL;
 
   if (!fp)
+  {
     web_files --;
-
-  temp->name = strdup(name);
+    free(web_cache[web_files].name);
+  }
 
   return (fp);
 }
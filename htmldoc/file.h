@@ -29,13 +29,18 @@ extern "C" {
 extern const char	*file_basename(const char *s);
 extern void		file_cleanup(void);
 extern void		file_cookies(const char *s);
+extern const unsigned char *file_data(const char *filename, size_t *length);
 extern const char	*file_directory(const char *s);
 extern const char	*file_extension(const char *s);
 extern const char	*file_find(const char *path, const char *s);
 extern char		*file_gets(char *buf, int buflen, FILE *fp);
+extern void		file_httpcache(const char *directory, size_t maxsize);
+extern void		file_httpcache_purge(void);
 extern const char	*file_localize(const char *filename, const char *newcwd);
 extern const char	*file_method(const char *s);
 extern void		file_nolocal(void);
+extern FILE		*file_open(const char *filename, const char *mode);
+extern int		file_prefetch(const char **urls, int num_urls);
 extern void		file_proxy(const char *url);
 extern void		file_referer(const char *referer);
 extern const char	*file_rlookup(const char *filename);
@@ -0,0 +1,338 @@
+/*
+ * Deflate compression functions for HTMLDOC, a HTML document processing
+ * program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "flate.h"
+#include "stats.h"
+#include "config.h"
+#include <string.h>
+
+#ifdef HAVE_ZLIB_NG
+#  include <zlib-ng.h>
+#  define z_stream	zng_stream
+#  define deflate	zng_deflate
+#  define deflateBound	zng_deflateBound
+#  define deflateEnd	zng_deflateEnd
+#  define deflateInit2	zng_deflateInit2
+#else
+#  include <zlib.h>
+#endif /* HAVE_ZLIB_NG */
+
+#ifdef HAVE_LIBDEFLATE
+#  include <libdeflate.h>
+#endif /* HAVE_LIBDEFLATE */
+
+
+/*
+ * Local globals...
+ */
+
+#define HD_FLATE_BUFFER	65536		/* Size of output buffer */
+
+static int		flate_levels[HD_FLATE_MAX] =
+			{		/* Compression level for each kind of stream */
+			  1,		/* HD_FLATE_CONTENT */
+			  9,		/* HD_FLATE_FONT */
+			  1,		/* HD_FLATE_IMAGE */
+			  9		/* HD_FLATE_OBJECT */
+			};
+
+
+/*
+ * Local types...
+ */
+
+struct hd_flate_s			/* Compressed stream */
+{
+  z_stream		stream;		/* Compressor */
+  hd_flate_cb_t		cb;		/* Output callback */
+  void			*cb_data;	/* Callback data */
+  int			error;		/* Non-zero on error */
+  unsigned char		buffer[HD_FLATE_BUFFER];
+					/* Output buffer */
+};
+
+
+/*
+ * Local functions...
+ */
+
+static void	flate_output(hd_flate_t *f);
+
+
+/*
+ * 'hd_flate_buffer()' - Compress a buffer in one call.
+ *
+ * When HTMLDOC is built with libdeflate it is used instead of zlib, so the
+ * compressed data may not match hd_flate_write() for the same input.  The
+ * compressed data must be freed by the caller.
+ */
+
+int					/* O - 1 on success, 0 on error */
+hd_flate_buffer(
+    hd_flate_type_t     type,		/* I - Kind of stream */
+    const unsigned char *data,		/* I - Data to compress */
+    size_t              length,		/* I - Length of data */
+    unsigned char       **comp,		/* O - Compressed data */
+    size_t              *comp_length)	/* O - Length of compressed data */
+{
+  int		level;			/* Compression level */
+#ifdef HAVE_LIBDEFLATE
+  struct libdeflate_compressor *c;	/* Compressor */
+  size_t	alloc;			/* Allocated size */
+#else
+  z_stream	stream;			/* Compressor */
+  size_t	alloc;			/* Allocated size */
+#endif /* HAVE_LIBDEFLATE */
+
+
+  *comp        = NULL;
+  *comp_length = 0;
+
+  if (type < HD_FLATE_CONTENT || type >= HD_FLATE_MAX)
+    return (0);
+
+  if ((level = flate_levels[type]) < 1)
+    level = 1;
+
+#ifdef HAVE_LIBDEFLATE
+  if ((c = libdeflate_alloc_compressor(level)) == NULL)
+    return (0);
+
+  alloc = libdeflate_zlib_compress_bound(c, length);
+
+  if ((*comp = (unsigned char *)malloc(alloc)) == NULL ||
+      (*comp_length = libdeflate_zlib_compress(c, data, length, *comp, alloc)) == 0)
+  {
+    free(*comp);
+    *comp = NULL;
+  }
+
+  libdeflate_free_compressor(c);
+
+#else
+  memset(&stream, 0, sizeof(stream));
+
+  if (deflateInit2(&stream, level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) < Z_OK)
+    return (0);
+
+  alloc = (size_t)deflateBound(&stream, (unsigned long)length);
+
+  if ((*comp = (unsigned char *)malloc(alloc)) != NULL)
+  {
+    stream.next_in   = (unsigned char *)data;
+    stream.avail_in  = (unsigned)length;
+    stream.next_out  = *comp;
+    stream.avail_out = (unsigned)alloc;
+
+    if (deflate(&stream, Z_FINISH) == Z_STREAM_END)
+    {
+      *comp_length = alloc - stream.avail_out;
+    }
+    else
+    {
+      free(*comp);
+      *comp = NULL;
+    }
+  }
+
+  deflateEnd(&stream);
+#endif /* HAVE_LIBDEFLATE */
+
+  hd_stats_add(HD_COUNT_DEFLATE_IN, length);
+  hd_stats_add(HD_COUNT_DEFLATE_OUT, *comp_length);
+
+  return (*comp != NULL);
+}
+
+
+/*
+ * 'hd_flate_close()' - Finish and free a compressed stream.
+ */
+
+int					/* O - 1 on success, 0 on error */
+hd_flate_close(hd_flate_t *f)		/* I - Compressed stream */
+{
+  int	status;				/* Deflate status */
+  int	ret;				/* Return value */
+
+
+  if (!f)
+    return (0);
+
+  while (!f->error && (status = deflate(&f->stream, Z_FINISH)) != Z_STREAM_END)
+  {
+    if (status < Z_OK && status != Z_BUF_ERROR)
+    {
+      f->error = 1;
+      break;
+    }
+
+    flate_output(f);
+  }
+
+  if (!f->error)
+    flate_output(f);
+
+  ret = !f->error;
+
+  deflateEnd(&f->stream);
+  free(f);
+
+  return (ret);
+}
+
+
+/*
+ * 'hd_flate_new()' - Start a compressed stream.
+ */
+
+hd_flate_t *				/* O - Compressed stream or NULL */
+hd_flate_new(hd_flate_type_t type,	/* I - Kind of stream */
+             hd_flate_cb_t   cb,	/* I - Output callback */
+	     void            *cb_data)	/* I - Callback data */
+{
+  hd_flate_t	*f;			/* Compressed stream */
+  int		level;			/* Compression level */
+
+
+  if (type < HD_FLATE_CONTENT || type >= HD_FLATE_MAX || !cb)
+    return (NULL);
+
+  if ((f = (hd_flate_t *)calloc(1, sizeof(hd_flate_t))) == NULL)
+    return (NULL);
+
+  if ((level = flate_levels[type]) < 1)
+    level = 1;
+
+  if (deflateInit2(&f->stream, level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) < Z_OK)
+  {
+    free(f);
+    return (NULL);
+  }
+
+  f->cb               = cb;
+  f->cb_data          = cb_data;
+  f->stream.next_out  = f->buffer;
+  f->stream.avail_out = sizeof(f->buffer);
+
+  return (f);
+}
+
+
+/*
+ * 'hd_flate_set()' - Set the compression level for a kind of stream.
+ */
+
+void
+hd_flate_set(hd_flate_type_t type,	/* I - Kind of stream */
+             int             level)	/* I - Compression level, 1-9 */
+{
+  if (type < HD_FLATE_CONTENT || type >= HD_FLATE_MAX)
+    return;
+
+  if (level < 1)
+    level = 1;
+  else if (level > 9)
+    level = 9;
+
+  flate_levels[type] = level;
+}
+
+
+/*
+ * 'hd_flate_setup()' - Set the compression for each kind of stream from the
+ *                      overall compression level.
+ *
+ * Page content uses the level as given since every page has to be
+ * compressed.  Fonts and object streams are small and compressed once, so
+ * they always use the best compression.
+ */
+
+void
+hd_flate_setup(int level)		/* I - Compression level, 1-9 */
+{
+  hd_flate_set(HD_FLATE_CONTENT, level);
+  hd_flate_set(HD_FLATE_FONT, 9);
+  hd_flate_set(HD_FLATE_IMAGE, level);
+  hd_flate_set(HD_FLATE_OBJECT, 9);
+}
+
+
+/*
+ * 'hd_flate_write()' - Compress data.
+ *
+ * A full flush is done after the data when "flush" is non-zero.
+ */
+
+int					/* O - 1 on success, 0 on error */
+hd_flate_write(hd_flate_t          *f,	/* I - Compressed stream */
+               const unsigned char *data,
+					/* I - Data to compress */
+               size_t              length,
+					/* I - Length of data */
+	       int                 flush)
+					/* I - Flush after the data? */
+{
+  int		status;			/* Deflate status */
+
+
+  if (!f || f->error)
+    return (0);
+
+  hd_stats_add(HD_COUNT_DEFLATE_IN, length);
+
+  f->stream.next_in  = (unsigned char *)data;
+  f->stream.avail_in = (unsigned)length;
+
+  while (f->stream.avail_in > 0)
+  {
+    if (f->stream.avail_out < (sizeof(f->buffer) / 8))
+      flate_output(f);
+
+    status = deflate(&f->stream, flush ? Z_FULL_FLUSH : Z_NO_FLUSH);
+
+    if (status < Z_OK && status != Z_BUF_ERROR)
+    {
+      f->error = 1;
+      return (0);
+    }
+
+    flush = 0;
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'flate_output()' - Pass compressed data to the output callback.
+ */
+
+static void
+flate_output(hd_flate_t *f)		/* I - Compressed stream */
+{
+  size_t	bytes = (size_t)(f->stream.next_out - f->buffer);
+					/* Bytes in buffer */
+
+
+  if (bytes > 0)
+  {
+    hd_stats_add(HD_COUNT_DEFLATE_OUT, bytes);
+
+    (f->cb)(f->cb_data, f->buffer, bytes);
+  }
+
+  f->stream.next_out  = f->buffer;
+  f->stream.avail_out = sizeof(f->buffer);
+}
@@ -0,0 +1,69 @@
+/*
+ * Deflate compression definitions for HTMLDOC, a HTML document processing
+ * program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+#ifndef _FLATE_H_
+#  define _FLATE_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include <stdlib.h>
+
+#  ifdef __cplusplus
+extern "C" {
+#  endif /* __cplusplus */
+
+
+/*
+ * Each kind of stream has its own compression level...
+ */
+
+typedef enum hd_flate_type_e		/**** Kinds of streams ****/
+{
+  HD_FLATE_CONTENT,			/* Page content streams */
+  HD_FLATE_FONT,			/* Embedded font programs */
+  HD_FLATE_IMAGE,			/* Image and mask data */
+  HD_FLATE_OBJECT,			/* Object and cross-reference streams */
+  HD_FLATE_MAX
+} hd_flate_type_t;
+
+
+/*
+ * Compressed stream - compressed data is passed to the callback in large
+ * blocks as the output buffer fills...
+ */
+
+typedef struct hd_flate_s hd_flate_t;
+
+typedef void (*hd_flate_cb_t)(void *data, unsigned char *buffer,
+                              size_t length);
+
+
+/*
+ * Prototypes...
+ */
+
+extern int	hd_flate_buffer(hd_flate_type_t type, const unsigned char *data,
+		                size_t length, unsigned char **comp,
+				size_t *comp_length);
+extern int	hd_flate_close(hd_flate_t *f);
+extern hd_flate_t *hd_flate_new(hd_flate_type_t type, hd_flate_cb_t cb,
+		                void *cb_data);
+extern void	hd_flate_set(hd_flate_type_t type, int level);
+extern void	hd_flate_setup(int level);
+extern int	hd_flate_write(hd_flate_t *f, const unsigned char *data,
+		               size_t length, int flush);
+
+#  ifdef __cplusplus
+}
+#  endif /* __cplusplus */
+
+#endif /* !_FLATE_H_ */
@@ -10,6 +10,7 @@
 
 #include "htmldoc.h"
 #include "markdown.h"
+#include "thread.h"
 
 #ifdef HAVE_LIBFLTK
 
@@ -810,6 +811,11 @@ GUI::GUI(const char *filename)		// Book file to load initially
     pdf14->callback((Fl_Callback *)pdfCB, this);
     pdf14->tooltip("Produce PDF files for Acrobat 5.0.");
 
+    pdf15 = new Fl_Round_Button(460, 45, 130, 20, "1.5 (Acrobat 6.0)");
+    pdf15->type(FL_RADIO_BUTTON);
+    pdf15->callback((Fl_Callback *)pdfCB, this);
+    pdf15->tooltip("Produce smaller PDF files for Acrobat 6.0.");
+
   pdfVersion->end();
 
   pageMode = new Fl_Choice(180, 90, 120, 25, "Page Mode: ");
@@ -1092,6 +1098,8 @@ GUI::GUI(const char *filename)		// Book file to load initially
 
   book_changed     = 0;
   book_filename[0] = '\0';
+  generating       = 0;
+  generated        = 0;
 
 #ifdef __APPLE__
   if (apple_filename)
@@ -1157,8 +1165,13 @@ void
 GUI::progress(int        percent,	// I - Percent complete
               const char *text)		// I - Text prompt
 {
+  // The generate thread has to hold the lock and wake up the main thread to
+  // redraw...
+  if (generating == 2)
+    Fl::lock();
+
   if (text != NULL)
-    progressBar->label(text);
+    progressBar->copy_label(text);
   else if (percent == 0)
     progressBar->label("HTMLDOC " SVERSION " Ready.");
 
@@ -1166,11 +1179,33 @@ GUI::progress(int        percent,	// I - Percent complete
       percent < (int)progressBar->value())
     progressBar->value(percent);
 
-  if (progressBar->damage())
+  if (generating == 2)
+  {
+    Fl::unlock();
+    Fl::awake();
+  }
+  else if (progressBar->damage())
     Fl::check();
 }
 
 
+//
+// 'GUI::add_error()' - Add a message to the error list.
+//
+
+void
+GUI::add_error(const char *s)		// I - Error message
+{
+  if (generating == 2)
+    Fl::lock();
+
+  error_list->add(s);
+
+  if (generating == 2)
+    Fl::unlock();
+}
+
+
 //
 // 'GUI::title()' - Set the title bar of the window.
 //
@@ -1286,8 +1321,10 @@ GUI::loadSettings()
     PDFVersion = 12;
   else if (pdf13->value())
     PDFVersion = 13;
-  else
+  else if (pdf14->value())
     PDFVersion = 14;
+  else
+    PDFVersion = 15;
 
   PDFPageMode       = pageMode->value();
   PDFPageLayout     = pageLayout->value();
@@ -1530,11 +1567,16 @@ GUI::newBook(void)
     pdf13->setonly();
     pdfCB(pdf13, this);
   }
-  else
+  else if (PDFVersion < 15)
   {
     pdf14->setonly();
     pdfCB(pdf14, this);
   }
+  else
+  {
+    pdf15->setonly();
+    pdfCB(pdf15, this);
+  }
 
   pageMode->value(PDFPageMode);
 
@@ -2058,6 +2100,13 @@ GUI::parseOptions(const char *line)	// I - Line from file
 	outputFormatCB(typePDF, this);
 	pdfCB(pdf14, this);
       }
+      else if (strcmp(temp2, "pdf15") == 0)
+      {
+        typePDF->setonly();
+	pdf15->setonly();
+	outputFormatCB(typePDF, this);
+	pdfCB(pdf15, this);
+      }
     }
     else if (strcmp(temp, "--letterhead") == 0)
       lhImage->value(temp2);
@@ -2398,8 +2447,10 @@ GUI::saveBook(const char *filename)	// I - Name of book file
     fputs("-t pdf12", fp);
   else if (pdf13->value())
     fputs("-t pdf13", fp);
-  else
+  else if (pdf14->value())
     fputs("-t pdf14", fp);
+  else
+    fputs("-t pdf15", fp);
 
   if (outputFile->value())
     fprintf(fp, " -f \"%s\"", outputPath->value());
@@ -4019,21 +4070,23 @@ void
 GUI::generateBookCB(Fl_Widget *w,	// I - Widget
                     GUI       *gui)	// I - GUI
 {
-  int		i,		// Looping var
-	        count;		// Number of files
-  char	  	temp[1024];	// Temporary string
-  FILE		*docfile;	// Document file
-  tree_t	*document,	// Master HTML document
-		*file,		// HTML document file
-		*toc;		// Table of contents
-  const char	*filename,	// HTML filename
-		*ext;		// Extension of filename
-  char		base[1024],	// Base directory of HTML file
-		bookbase[1024];	// Base directory of book file
+  int		i;		// Looping var
+  hd_thread_t	*thread;	// Generate thread
+  gui_job_t	job;		// Generate job
 
 
   REF(w);
 
+  // Cancel the current conversion if we are already generating...
+  if (gui->generating)
+  {
+    progress_cancel(1);
+
+    gui->bookGenerate->label("Cancelling...");
+    gui->bookGenerate->deactivate();
+    return;
+  }
+
   // Do we have an output filename?
   if (gui->outputPath->size() == 0)
   {
@@ -4046,13 +4099,37 @@ GUI::generateBookCB(Fl_Widget *w,	// I - Widget
     return;
   }
 
-  // Disable the GUI while we generate...
-  gui->controls->deactivate();
+  // Copy the input files and output format for the generate thread...
+  job.gui       = gui;
+  job.num_files = gui->inputFiles->size();
+
+  if ((job.files = (char **)calloc((size_t)(job.num_files ? job.num_files : 1), sizeof(char *))) == NULL)
+  {
+    fl_alert("Unable to allocate memory for %d input files.", job.num_files);
+    return;
+  }
+
+  for (i = 0; i < job.num_files; i ++)
+    job.files[i] = strdup(gui->inputFiles->text(i + 1));
+
+  if (gui->typeEPUB->value())
+    job.exportfunc = epub_export;
+  else if (gui->typeHTML->value())
+    job.exportfunc = html_export;
+  else if (gui->typeHTMLSep->value())
+    job.exportfunc = htmlsep_export;
+  else
+    job.exportfunc = pspdf_export;
+
+  // Disable the GUI while we generate, except for the cancel button...
+  for (i = 0; i < gui->controls->children(); i ++)
+    if (gui->controls->child(i) != gui->bookGenerate)
+      gui->controls->child(i)->deactivate();
+
+  gui->bookGenerate->label("Cancel");
   gui->window->cursor(FL_CURSOR_WAIT);
 
   // Set global vars used for converting the HTML files to XYZ format...
-  strlcpy(bookbase, file_directory(gui->book_filename), sizeof(bookbase));
-
   Verbosity = 1;
 
   gui->loadSettings();
@@ -4090,19 +4167,93 @@ GUI::generateBookCB(Fl_Widget *w,	// I - Widget
   Errors = 0;
   gui->error_list->clear();
 
+  progress_cancel(0);
+
+  // Convert the files in the background, running the event loop until the
+  // thread is done.  Without threads the files are converted here and only
+  // the progress bar is updated...
+  gui->generated  = 0;
+  gui->generating = 2;
+
+  if ((thread = hd_thread_new((hd_job_func_t)generateBookThread, &job)) != NULL)
+  {
+    while (!gui->generated)
+      Fl::wait();
+
+    hd_thread_wait(thread);
+  }
+  else
+  {
+    gui->generating = 1;
+    gui->bookGenerate->deactivate();
+
+    generateBookThread(&job);
+  }
+
+  gui->generating = 0;
+
+  for (i = 0; i < job.num_files; i ++)
+    free(job.files[i]);
+
+  free(job.files);
+
+  if (progress_cancelled())
+    fl_message("Document generation cancelled.");
+  else if (Errors == 0)
+    fl_message("Document generated successfully!");
+  else if (fl_choice("%d error%s occurred while generating document.\n"
+                     "Would you like to see the list?", "Continue",
+		     "View Error List", NULL, Errors, Errors == 1 ? "" : "s"))
+    gui->error_window->show();
+
+  progress_cancel(0);
+
+  for (i = 0; i < gui->controls->children(); i ++)
+    gui->controls->child(i)->activate();
+
+  gui->bookGenerate->label("Generate");
+  gui->window->cursor(FL_CURSOR_DEFAULT);
+  gui->progress(0);
+}
+
+
+//
+// 'GUI::generateBookThread()' - Load the input files and generate the book.
+//
+// This runs in the generate thread.  Everything it needs from the controls is
+// copied into the job first, and the progress bar and error list are only
+// updated while holding the FLTK lock.
+//
+
+void
+GUI::generateBookThread(gui_job_t *job)	// I - Generate job
+{
+  GUI		*gui = job->gui;// GUI
+  int		i,		// Looping var
+	        count;		// Number of files
+  char	  	temp[1024];	// Temporary string
+  FILE		*docfile;	// Document file
+  tree_t	*document,	// Master HTML document
+		*file,		// HTML document file
+		*toc;		// Table of contents
+  const char	*filename,	// HTML filename
+		*ext;		// Extension of filename
+  char		base[1024];	// Base directory of HTML file
+
+
  /*
   * Load the input files...
   */
 
-  count    = gui->inputFiles->size();
+  count    = job->num_files;
   document = NULL;
 
-  for (i = 1; i <= count; i ++)
+  for (i = 1; i <= count && !progress_cancelled(); i ++)
   {
-    filename = file_find(Path, gui->inputFiles->text(i));
+    filename = file_find(Path, job->files[i - 1]);
 
     if (filename != NULL &&
-        (docfile = fopen(filename, "rb")) != NULL)
+        (docfile = file_open(filename, "rb")) != NULL)
     {
      /*
       * Read from a file...
@@ -4111,7 +4262,7 @@ GUI::generateBookCB(Fl_Widget *w,	// I - Widget
       snprintf(temp, sizeof(temp), "Loading \"%s\"...", filename);
       gui->progress(100 * i / count, temp);
 
-      strlcpy(base, file_directory(gui->inputFiles->text(i)), sizeof(base));
+      strlcpy(base, file_directory(job->files[i - 1]), sizeof(base));
       ext = file_extension(filename);
 
       file = htmlAddTree(NULL, MARKUP_FILE, NULL);
@@ -4127,7 +4278,7 @@ GUI::generateBookCB(Fl_Widget *w,	// I - Widget
       else
       {
         // Read HTML from a file...
-        _htmlCurrentFile = gui->inputFiles->text(i);
+        _htmlCurrentFile = job->files[i - 1];
         htmlReadFile(file, docfile, base);
       }
 
@@ -4152,7 +4303,7 @@ GUI::generateBookCB(Fl_Widget *w,	// I - Widget
     else
       progress_error(HD_ERROR_FILE_NOT_FOUND,
                      "Unable to open \"%s\" for reading!",
-                     gui->inputFiles->text(i));
+                     job->files[i - 1]);
   }
 
  /*
@@ -4160,8 +4311,11 @@ GUI::generateBookCB(Fl_Widget *w,	// I - Widget
   */
 
   if (document == NULL)
-    progress_error(HD_ERROR_NO_FILES,
-                   "No input files to format, cannot generate document.");
+  {
+    if (!progress_cancelled())
+      progress_error(HD_ERROR_NO_FILES,
+                     "No input files to format, cannot generate document.");
+  }
   else
   {
    /*
@@ -4171,45 +4325,40 @@ GUI::generateBookCB(Fl_Widget *w,	// I - Widget
     while (document->prev != NULL)
       document = document->prev;
 
-    // Fix links...
-    htmlFixLinks(document, document);
+    if (!progress_cancelled())
+    {
+      // Fix links...
+      htmlFixLinks(document, document);
 
-    // Show debug info...
-    htmlDebugStats("Document Tree", document);
+      // Show debug info...
+      htmlDebugStats("Document Tree", document);
 
-    // Build a table of contents for the documents...
-    if (OutputType == OUTPUT_BOOK && TocLevels > 0)
-      toc = toc_build(document);
-    else
-      toc = NULL;
-
-    // Generate the output file(s).
-    if (gui->typeEPUB->value())
-      epub_export(document, toc);
-    else if (gui->typeHTML->value())
-      html_export(document, toc);
-    else if (gui->typeHTMLSep->value())
-      htmlsep_export(document, toc);
-    else
-      pspdf_export(document, toc);
+      // Build a table of contents for the documents...
+      if (OutputType == OUTPUT_BOOK && TocLevels > 0)
+	toc = toc_build(document);
+      else
+	toc = NULL;
+
+      // Generate the output file(s).
+      (*job->exportfunc)(document, toc);
+
+      htmlDeleteTree(toc);
+    }
 
     htmlDeleteTree(document);
-    htmlDeleteTree(toc);
 
     file_cleanup();
     image_flush_cache();
   }
 
-  if (Errors == 0)
-    fl_message("Document generated successfully!");
-  else if (fl_choice("%d error%s occurred while generating document.\n"
-                     "Would you like to see the list?", "Continue",
-		     "View Error List", NULL, Errors, Errors == 1 ? "" : "s"))
-    gui->error_window->show();
-
-  gui->controls->activate();
-  gui->window->cursor(FL_CURSOR_DEFAULT);
-  gui->progress(0);
+  // Let the main thread know we are done...
+  if (gui->generating == 2)
+  {
+    Fl::lock();
+    gui->generated = 1;
+    Fl::unlock();
+    Fl::awake();
+  }
 }
 
 
@@ -4223,6 +4372,15 @@ GUI::closeBookCB(Fl_Widget *w,		// I - Widget
 {
   REF(w);
 
+  // Cancel the current conversion first...
+  if (gui->generating)
+  {
+    if (gui->generating == 2)
+      generateBookCB(gui->bookGenerate, gui);
+
+    return;
+  }
+
   if (gui->checkSave())
     gui->hide();
 }
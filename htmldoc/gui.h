@@ -34,6 +34,23 @@
 #include <FL/Fl_Tooltip.H>
 
 
+/*
+ * Document generation job - the input files and output format are copied
+ * from the controls so that the generate thread doesn't read any widgets...
+ */
+
+class GUI;
+
+typedef struct
+{
+  GUI		*gui;			// GUI that started the job
+  int		num_files;		// Number of input files
+  char		**files;		// Input files
+  int		(*exportfunc)(tree_t *, tree_t *);
+					// Export function
+} gui_job_t;
+
+
 /*
  * Class definition for HTMLDOC dialog...
  */
@@ -151,7 +168,8 @@ class GUI
   Fl_Round_Button	*pdf11,
 			*pdf12,
 			*pdf13,
-			*pdf14;
+			*pdf14,
+			*pdf15;
   Fl_Choice		*pageMode,
 			*pageLayout,
 			*firstPage,
@@ -199,6 +217,9 @@ class GUI
   char			book_filename[1024];
   int			book_changed;
 
+  int			generating;	// 1 = generating, 2 = in a thread
+  volatile int		generated;	// Has the generate thread finished?
+
   char			title_string[1024];
 
   Fl_File_Chooser	*fc;
@@ -256,6 +277,7 @@ class GUI
   static void	saveBookCB(Fl_Widget *w, GUI *gui);
   static void	saveAsBookCB(Fl_Widget *w, GUI *gui);
   static void	generateBookCB(Fl_Widget *w, GUI *gui);
+  static void	generateBookThread(gui_job_t *job);
   static void	closeBookCB(Fl_Widget *w, GUI *gui);
 
   static void	errorCB(Fl_Widget *w, GUI *gui);
@@ -274,7 +296,7 @@ class GUI
   GUI(const char *filename = NULL);
   ~GUI(void);
 
-  void	add_error(const char *s) { error_list->add(s); }
+  void	add_error(const char *s);
   int	checkSave();
   void	hide() { window->hide(); help->hide(); fc->hide(); };
   int	loadBook(const char *bookfile);
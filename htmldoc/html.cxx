@@ -13,39 +13,23 @@
  */
 
 #include "htmldoc.h"
+#include "links.h"
 #include "markdown.h"
 #include <ctype.h>
 
 
-/*
- * Named link structure...
- */
-
-typedef struct
-{
-  uchar		*filename;	/* File for link */
-  uchar		name[124];	/* Reference name */
-} link_t;
-
-
 /*
  * Local globals...
  */
 
 
-static size_t	num_links = 0,
-		alloc_links = 0;
-static link_t	*links;
+static hd_links_t *links = NULL;
 
 
 /*
  * Local functions...
  */
 
-extern "C" {
-typedef int	(*compare_func_t)(const void *, const void *);
-}
-
 static void	write_header(FILE **out, uchar *filename, uchar *title,
 		             uchar *author, uchar *copyright, uchar *docnumber,
 			     tree_t *t);
@@ -59,8 +43,7 @@ static int	write_toc(FILE *out, tree_t *t, int col);
 static uchar	*get_title(tree_t *doc);
 
 static void	add_link(uchar *name, uchar *filename);
-static link_t	*find_link(uchar *name);
-static int	compare_links(link_t *n1, link_t *n2);
+static hd_link_t *find_link(uchar *name);
 static void	scan_links(tree_t *t, uchar *filename);
 static void	update_links(tree_t *t, uchar *filename);
 
@@ -123,9 +106,7 @@ html_export(tree_t *document,	/* I - Document to export */
   * Scan for all links in the document, and then update them...
   */
 
-  num_links   = 0;
-  alloc_links = 0;
-  links       = NULL;
+  links = hd_links_new();
 
   scan_links(document, NULL);
   update_links(document, NULL);
@@ -183,14 +164,8 @@ html_export(tree_t *document,	/* I - Document to export */
   if (title != NULL)
     free(title);
 
-  if (alloc_links)
-  {
-    free(links);
-
-    num_links   = 0;
-    alloc_links = 0;
-    links       = NULL;
-  }
+  hd_links_delete(links);
+  links = NULL;
 
   return (out == NULL);
 }
@@ -460,7 +435,7 @@ write_title(FILE  *out,		/* I - Output file */
     }
 
     // Write a title page from HTML source...
-    if ((fp = fopen(title_file, "rb")) == NULL)
+    if ((fp = file_open(title_file, "rb")) == NULL)
     {
       progress_error(HD_ERROR_FILE_NOT_FOUND,
                      "Unable to open title file \"%s\" - %s!",
@@ -901,46 +876,18 @@ static void
 add_link(uchar *name,		/* I - Name of link */
          uchar *filename)	/* I - File for link */
 {
-  link_t	*temp;		/* New name */
+  hd_link_t	*temp;		/* New name */
 
 
-  if ((temp = find_link(name)) != NULL)
-    temp->filename = filename;
-  else
+  if ((temp = hd_links_add(links, (char *)name)) == NULL)
   {
-    // See if we need to allocate memory for links...
-    if (num_links >= alloc_links)
-    {
-      // Allocate more links...
-      alloc_links += ALLOC_LINKS;
-
-      if (num_links == 0)
-        temp = (link_t *)malloc(sizeof(link_t) * alloc_links);
-      else
-        temp = (link_t *)realloc(links, sizeof(link_t) * alloc_links);
-
-      if (temp == NULL)
-      {
-	progress_error(HD_ERROR_OUT_OF_MEMORY,
-	               "Unable to allocate memory for %d links - %s",
-	               (int)alloc_links, strerror(errno));
-        alloc_links -= ALLOC_LINKS;
-	return;
-      }
-
-      links = temp;
-    }
-
-    // Add a new link...
-    temp = links + num_links;
-    num_links ++;
-
-    strlcpy((char *)temp->name, (char *)name, sizeof(temp->name));
-    temp->filename = filename;
-
-    if (num_links > 1)
-      qsort(links, num_links, sizeof(link_t), (compare_func_t)compare_links);
+    progress_error(HD_ERROR_OUT_OF_MEMORY,
+                   "Unable to allocate memory for %d links - %s",
+                   (int)hd_links_count(links) + 1, strerror(errno));
+    return;
   }
+
+  temp->filename = filename;
 }
 
 
@@ -948,37 +895,16 @@ add_link(uchar *name,		/* I - Name of link */
  * 'find_link()' - Find a named link...
  */
 
-static link_t *
+static hd_link_t *
 find_link(uchar *name)		/* I - Name to find */
 {
   uchar		*target;	/* Pointer to target name portion */
-  link_t	key,		/* Search key */
-		*match;		/* Matching name entry */
 
 
-  if (name == NULL || num_links == 0)
-    return (NULL);
-
   if ((target = (uchar *)file_target((char *)name)) == NULL)
     return (NULL);
 
-  strlcpy((char *)key.name, (char *)target, sizeof(key.name));
-  match = (link_t *)bsearch(&key, links, num_links, sizeof(link_t),
-                            (compare_func_t)compare_links);
-
-  return (match);
-}
-
-
-/*
- * 'compare_links()' - Compare two named links.
- */
-
-static int			/* O - 0 = equal, -1 or 1 = not equal */
-compare_links(link_t *n1,	/* I - First name */
-              link_t *n2)	/* I - Second name */
-{
-  return (strcasecmp((char *)n1->name, (char *)n2->name));
+  return (hd_links_find(links, (char *)target));
 }
 
 
@@ -1020,7 +946,7 @@ static void
 update_links(tree_t *t,		/* I - Document tree */
              uchar  *filename)	/* I - Current filename */
 {
-  link_t	*link;		/* Link */
+  hd_link_t	*link;		/* Link */
   uchar		*href;		/* Reference name */
   uchar		newhref[1024];	/* New reference name */
 
@@ -18,6 +18,7 @@
 #  include <stdio.h>
 #  include <stdlib.h>
 
+#  include "arena.h"
 #  include "file.h"
 #  include "hdstring.h"
 #  include "iso8859.h"
@@ -231,6 +232,8 @@ typedef struct
  * Parsing tree...
  */
 
+#  define HD_INLINE_VARS	3	/* Variables stored in the node itself */
+
 typedef struct tree_str
 {
   struct tree_str	*parent,	/* Parent tree entry */
@@ -251,14 +254,19 @@ typedef struct tree_str
 			subscript:1,	/* Text is subscripted? */
 			superscript:1,	/* Text is superscripted? */
 			preformatted:1,	/* Preformatted text? */
-			indent:4;	/* Indentation level 0-15 */
+			indent:4,	/* Indentation level 0-15 */
+			arena_owner:1;	/* Node owns the arena? */
   uchar			red,		/* Color of this fragment */
 			green,
 			blue;
   float			width,		/* Width of this fragment in points */
 			height;		/* Height of this fragment in points */
-  int			nvars;		/* Number of variables... */
+  int			nvars,		/* Number of variables... */
+			avars;		/* Allocated variables, if not inline */
   var_t			*vars;		/* Variables... */
+  hd_arena_t		*arena;		/* Arena holding this node, if any */
+  var_t			ivars[HD_INLINE_VARS];
+					/* Inline storage for variables */
 } tree_t;
 
 
@@ -281,7 +289,6 @@ extern int		_htmlInitialized;
 extern char		_htmlCharSet[];
 extern int		_htmlWidthsLoaded[TYPE_MAX][STYLE_MAX];
 extern short		_htmlWidths[TYPE_MAX][STYLE_MAX][256];
-extern short		_htmlWidthsAll[TYPE_MAX][STYLE_MAX][65536];
 extern int		_htmlUnicode[];
 extern uchar            _htmlCharacters[];
 extern int              _htmlUTF8;
@@ -297,8 +304,12 @@ extern int		_htmlStandardFonts[TYPE_MAX];
 
 extern tree_t	*htmlReadFile(tree_t *parent, FILE *fp, const char *base);
 extern int	htmlWriteFile(tree_t *parent, FILE *fp);
+extern int	htmlLoadTree(tree_t *parent, FILE *fp);
+extern int	htmlSaveTree(tree_t *parent, FILE *fp);
 
 extern tree_t	*htmlAddTree(tree_t *parent, markup_t markup, uchar *data);
+extern tree_t	*htmlCopyTree(tree_t *parent, tree_t *t);
+extern tree_t	*htmlCopyTrees(tree_t *t);
 extern int	htmlDeleteTree(tree_t *parent);
 extern tree_t	*htmlInsertTree(tree_t *parent, markup_t markup, uchar *data);
 extern tree_t	*htmlNewTree(tree_t *parent, markup_t markup, uchar *data);
@@ -319,6 +330,8 @@ extern void	htmlSetBaseSize(double p, double s);
 extern void	htmlSetCharSet(const char *cs);
 extern void	htmlSetTextColor(uchar *color);
 
+extern int	htmlGetTextWidth(const uchar *s, int typeface, int style);
+extern short	htmlGetUnicodeWidth(int typeface, int style, int unicode);
 extern void	htmlLoadFontWidths(int typeface, int style);
 
 extern uchar	htmlMapUnicode(int ch);
@@ -15,6 +15,7 @@
 #define _HTMLDOC_CXX_
 #include "htmldoc.h"
 #include "markdown.h"
+#include "treecache.h"
 #include <cups/http.h>
 #include <ctype.h>
 #include <fcntl.h>
@@ -30,6 +31,10 @@
 #  include <signal.h>
 #  include <unistd.h>
 #  include <sys/time.h>
+#  include <sys/wait.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <netdb.h>
 #endif // WIN32
 
 #ifdef __APPLE__
@@ -49,19 +54,73 @@ const char *__XOS2RedirRoot(const char *);
 
 typedef int (*exportfunc_t)(tree_t *, tree_t *);
 
+#define MAX_OUTPUTS	16		// Maximum number of --output options
+
+typedef struct output_s			// Additional output from --output
+{
+  char		format[16];		// Output format
+  int		files;			// Write to a directory?
+  char		path[1024];		// Output file or directory
+} output_t;
+
+typedef struct settings_s		// Settings changed by the exporters
+{
+  char		path[1024];		// Output file or directory
+  int		files,			// Write to a directory?
+		pslevel,		// PostScript level
+		pdfversion,		// PDF version
+		compression,		// Compression level
+		width,			// Page width
+		length,			// Page length
+		left,			// Left margin
+		right,			// Right margin
+		bottom,			// Bottom margin
+		top,			// Top margin
+		landscape,		// Landscape orientation?
+		duplex,			// Duplex pages?
+		nup,			// Number-up pages
+		chapters;		// Number of chapters
+  char		*formats[5][3];		// Header and footer strings
+} settings_t;
+
+typedef struct batch_job_s		// Running batch job
+{
+  int		pid;			// Process ID or 0 if unused
+  int		number;			// Job number
+  char		name[1024];		// Book filename
+  double	start;			// Start time
+} batch_job_t;
+
 
 /*
  * Local functions...
  */
 
 static int	compare_strings(const char *s, const char *t, int tmin);
+static void	convert_document(tree_t *document, exportfunc_t exportfunc);
+static void	export_outputs(tree_t *document, tree_t *toc,
+		               output_t *outputs, int num_outputs);
+static void	free_settings(settings_t *settings);
+static exportfunc_t get_export(const char *format, int *pslevel,
+		               int *pdfversion, int *compression);
+static int	get_output(const char *arg, output_t *output);
 static double	get_seconds(void);
 static int	load_book(const char *filename, tree_t **document,
 		          exportfunc_t *exportfunc, int set_nolocal = 0);
 static void	parse_options(const char *line, exportfunc_t *exportfunc);
 static const char *prefs_getrc(void);
+static int	read_book(FILE *fp, const char *filename, const char *dir,
+		          tree_t **document, exportfunc_t *exportfunc);
 static int	read_file(const char *filename, tree_t **document,
-		          const char *path);
+		          const char *path, const char *basedir = NULL);
+static void	restore_settings(settings_t *settings);
+static int	run_batch(const char *manifest, int jobs,
+		          const char *httpcache, exportfunc_t exportfunc);
+static int	run_server(const char *address, exportfunc_t exportfunc);
+static void	save_settings(settings_t *settings);
+#ifndef WIN32
+static int	serve_job(int fd, exportfunc_t exportfunc);
+#endif // !WIN32
 static void	set_permissions(const char *p);
 #ifndef WIN32
 extern "C" {
@@ -92,6 +151,14 @@ main(int  argc,				/* I - Number of command-line arguments */
 		load_time,		/* Load time */
 		end_time;		/* End time */
   const char	*debug;			/* HTMLDOC_DEBUG environment variable */
+  const char	*httpcache = NULL;	/* HTTP cache directory */
+  int		httpcachesize = 100;	/* HTTP cache size in megabytes */
+  const char	*server = NULL;		/* Server address */
+  const char	*manifest = NULL;	/* Manifest of book files */
+  int		jobs = 0;		/* Number of simultaneous jobs */
+  const char	*stats = NULL;		/* Statistics file */
+  output_t	outputs[MAX_OUTPUTS];	/* Additional outputs */
+  int		num_outputs = 0;	/* Number of additional outputs */
 
 
   start_time = get_seconds();
@@ -237,6 +304,15 @@ main(int  argc,				/* I - Number of command-line arguments */
   num_files   = 0;
   Errors      = 0;
 
+  for (i = 1; i < (argc - 1); i ++)
+    if (compare_strings(argv[i], "--stats", 5) == 0)
+    {
+      // Start collecting statistics before any files are loaded...
+      stats = argv[i + 1];
+      hd_stats_start();
+      break;
+    }
+
   for (i = 1; i < argc; i ++)
   {
 #ifdef DEBUG
@@ -461,60 +537,9 @@ main(int  argc,				/* I - Number of command-line arguments */
              strcmp(argv[i], "-t") == 0)
     {
       i ++;
-      if (i < argc)
-      {
-        if (strcasecmp(argv[i], "epub") == 0)
-	  exportfunc = (exportfunc_t)epub_export;
-        else if (strcasecmp(argv[i], "html") == 0)
-          exportfunc = (exportfunc_t)html_export;
-        else if (strcasecmp(argv[i], "htmlsep") == 0)
-          exportfunc = (exportfunc_t)htmlsep_export;
-        else if (strcasecmp(argv[i], "pdf14") == 0 ||
-	         strcasecmp(argv[i], "pdf") == 0)
-	{
-          exportfunc = (exportfunc_t)pspdf_export;
-	  PSLevel    = 0;
-	  PDFVersion = 14;
-	}
-        else if (strcasecmp(argv[i], "pdf13") == 0)
-	{
-          exportfunc = (exportfunc_t)pspdf_export;
-	  PSLevel    = 0;
-	  PDFVersion = 13;
-	}
-        else if (strcasecmp(argv[i], "pdf12") == 0)
-	{
-          exportfunc = (exportfunc_t)pspdf_export;
-	  PSLevel    = 0;
-	  PDFVersion = 12;
-	}
-        else if (strcasecmp(argv[i], "pdf11") == 0)
-	{
-          exportfunc  = (exportfunc_t)pspdf_export;
-	  PSLevel     = 0;
-	  PDFVersion  = 11;
-	  Compression = 0;
-	}
-        else if (strcasecmp(argv[i], "ps1") == 0)
-        {
-	  exportfunc = (exportfunc_t)pspdf_export;
-	  PSLevel    = 1;
-	}
-        else if (strcasecmp(argv[i], "ps2") == 0 ||
-                 strcasecmp(argv[i], "ps") == 0)
-        {
-	  exportfunc = (exportfunc_t)pspdf_export;
-	  PSLevel    = 2;
-	}
-        else if (strcasecmp(argv[i], "ps3") == 0)
-        {
-	  exportfunc = (exportfunc_t)pspdf_export;
-	  PSLevel    = 3;
-	}
-	else
-	  usage(argv[i - 1]);
-      }
-      else
+      if (i >= argc ||
+          (exportfunc = get_export(argv[i], &PSLevel, &PDFVersion,
+	                           &Compression)) == NULL)
         usage(argv[i - 1]);
     }
     else if (compare_strings(argv[i], "--grayscale", 3) == 0)
@@ -746,6 +771,44 @@ main(int  argc,				/* I - Number of command-line arguments */
 
       strlcpy(HFImage[hfimgnum], argv[i], sizeof(HFImage[0]));
     }
+    else if (compare_strings(argv[i], "--httpcache", 7) == 0)
+    {
+      i ++;
+      if (i < argc)
+      {
+        httpcache = argv[i];
+        file_httpcache(httpcache, (size_t)httpcachesize * 1024 * 1024);
+      }
+      else
+        usage(argv[i - 1]);
+    }
+    else if (compare_strings(argv[i], "--httpcachesize", 12) == 0)
+    {
+      i ++;
+      if (i < argc && atoi(argv[i]) >= 0)
+      {
+        httpcachesize = atoi(argv[i]);
+        file_httpcache(httpcache, (size_t)httpcachesize * 1024 * 1024);
+      }
+      else
+        usage(argv[i - 1]);
+    }
+    else if (compare_strings(argv[i], "--imagecache", 4) == 0)
+    {
+      i ++;
+      if (i < argc)
+        ImageCache = atoi(argv[i]);
+      else
+        usage(argv[i - 1]);
+    }
+    else if (compare_strings(argv[i], "--jobs", 4) == 0)
+    {
+      i ++;
+      if (i < argc)
+        jobs = atoi(argv[i]);
+      else
+        usage(argv[i - 1]);
+    }
     else if (compare_strings(argv[i], "--jpeg", 3) == 0 ||
              strncmp(argv[i], "--jpeg=", 7) == 0)
     {
@@ -772,6 +835,8 @@ main(int  argc,				/* I - Number of command-line arguments */
       else
         usage(argv[i - 1]);
     }
+    else if (compare_strings(argv[i], "--linearize", 6) == 0)
+      PDFLinearize = 1;
     else if (compare_strings(argv[i], "--linkcolor", 7) == 0)
     {
       i ++;
@@ -805,6 +870,14 @@ main(int  argc,				/* I - Number of command-line arguments */
       else
         usage(argv[i - 1]);
     }
+    else if (compare_strings(argv[i], "--manifest", 4) == 0)
+    {
+      i ++;
+      if (i < argc)
+        manifest = argv[i];
+      else
+        usage(argv[i - 1]);
+    }
     else if (compare_strings(argv[i], "--no-compression", 6) == 0)
       Compression = 0;
     else if (compare_strings(argv[i], "--no-duplex", 4) == 0)
@@ -815,6 +888,8 @@ main(int  argc,				/* I - Number of command-line arguments */
       Encryption = 0;
     else if (compare_strings(argv[i], "--no-jpeg", 6) == 0)
       OutputJPEG = 0;
+    else if (compare_strings(argv[i], "--no-linearize", 9) == 0)
+      PDFLinearize = 0;
     else if (compare_strings(argv[i], "--no-links", 7) == 0)
       Links = 0;
     else if (compare_strings(argv[i], "--no-localfiles", 7) == 0)
@@ -898,6 +973,15 @@ main(int  argc,				/* I - Number of command-line arguments */
     }
     else if (compare_strings(argv[i], "--overflow", 4) == 0)
       OverflowErrors = 1;
+    else if (compare_strings(argv[i], "--output", 6) == 0)
+    {
+      i ++;
+      if (i < argc && num_outputs < MAX_OUTPUTS &&
+          get_output(argv[i], outputs + num_outputs))
+        num_outputs ++;
+      else
+        usage(argv[i - 1]);
+    }
     else if (compare_strings(argv[i], "--owner-password", 4) == 0)
     {
       i ++;
@@ -1019,6 +1103,14 @@ main(int  argc,				/* I - Number of command-line arguments */
       else
         usage(argv[i - 1]);
     }
+    else if (compare_strings(argv[i], "--server", 4) == 0)
+    {
+      i ++;
+      if (i < argc)
+        server = argv[i];
+      else
+        usage(argv[i - 1]);
+    }
     else if (compare_strings(argv[i], "--size", 4) == 0)
     {
       i ++;
@@ -1027,6 +1119,12 @@ main(int  argc,				/* I - Number of command-line arguments */
       else
         usage(argv[i - 1]);
     }
+    else if (compare_strings(argv[i], "--stats", 5) == 0)
+    {
+      i ++;
+      if (i >= argc)
+        usage(argv[i - 1]);
+    }
     else if (compare_strings(argv[i], "--strict", 4) == 0)
       StrictHTML = 1;
     else if (compare_strings(argv[i], "--textcolor", 7) == 0)
@@ -1037,6 +1135,14 @@ main(int  argc,				/* I - Number of command-line arguments */
       else
         usage(argv[i - 1]);
     }
+    else if (compare_strings(argv[i], "--threads", 4) == 0)
+    {
+      i ++;
+      if (i < argc)
+        Threads = atoi(argv[i]);
+      else
+        usage(argv[i - 1]);
+    }
     else if (compare_strings(argv[i], "--title", 7) == 0)
       TitlePage = 1;
     else if (compare_strings(argv[i], "--titlefile", 8) == 0 ||
@@ -1090,6 +1196,14 @@ main(int  argc,				/* I - Number of command-line arguments */
       else
         usage(argv[i - 1]);
     }
+    else if (compare_strings(argv[i], "--treecache", 5) == 0)
+    {
+      i ++;
+      if (i < argc)
+        hd_treecache_init(argv[i]);
+      else
+        usage(argv[i - 1]);
+    }
     else if (compare_strings(argv[i], "--user-password", 4) == 0)
     {
       i ++;
@@ -1230,6 +1344,20 @@ main(int  argc,				/* I - Number of command-line arguments */
                      "PATH_INFO is not set in the environment!");
   }
 
+ /*
+  * Run as a server if requested...
+  */
+
+  if (server)
+    return (run_server(server, exportfunc));
+
+ /*
+  * Convert a list of book files if requested...
+  */
+
+  if (manifest)
+    return (run_batch(manifest, jobs, httpcache, exportfunc));
+
  /*
   * Display the GUI if necessary...
   */
@@ -1244,6 +1372,9 @@ main(int  argc,				/* I - Number of command-line arguments */
 
     BookGUI->show();
 
+    // Enable locking so documents can be generated in a separate thread...
+    Fl::lock();
+
     i = Fl::run();
 
     delete BookGUI;
@@ -1278,6 +1409,8 @@ main(int  argc,				/* I - Number of command-line arguments */
   * Build a table of contents for the documents if necessary...
   */
 
+  hd_stats_begin(HD_PHASE_TOC);
+
   if (OutputType == OUTPUT_BOOK && TocLevels > 0)
   {
     toc = toc_build(document);
@@ -1290,13 +1423,34 @@ main(int  argc,				/* I - Number of command-line arguments */
     toc = NULL;
   }
 
+  hd_stats_end();
+
   htmlDebugStats("Table of Contents Tree", toc);
 
  /*
   * Generate the output file(s).
   */
 
+  hd_stats_begin(HD_PHASE_WRITE);
+
+  if (num_outputs > 0 && !OutputPath[0])
+  {
+   /*
+    * Without --outfile or --outdir the last --output gets the document...
+    */
+
+    num_outputs --;
+
+    strlcpy(OutputPath, outputs[num_outputs].path, sizeof(OutputPath));
+    OutputFiles = outputs[num_outputs].files;
+    exportfunc  = get_export(outputs[num_outputs].format, &PSLevel,
+                             &PDFVersion, &Compression);
+  }
+
+  export_outputs(document, toc, outputs, num_outputs);
+
   (*exportfunc)(document, toc);
+  hd_stats_end();
 
   end_time = get_seconds();
 
@@ -1310,6 +1464,9 @@ main(int  argc,				/* I - Number of command-line arguments */
                    load_time - start_time, end_time - load_time,
 		   end_time - start_time);
 
+  if (stats && !hd_stats_write(stats))
+    progress_error(HD_ERROR_WRITE_ERROR, "Unable to write statistics to \"%s\": %s", stats, strerror(errno));
+
  /*
   * Cleanup...
   */
@@ -1775,6 +1932,246 @@ compare_strings(const char *s,		/* I - Command-line string */
 }
 
 
+/*
+ * 'convert_document()' - Generate the output files for a document.
+ */
+
+static void
+convert_document(
+    tree_t       *document,		/* I - Document tree */
+    exportfunc_t exportfunc)		/* I - Export function */
+{
+  tree_t	*toc;			/* Table of contents */
+
+
+  while (document && document->prev != NULL)
+    document = document->prev;
+
+  htmlFixLinks(document, document);
+
+  hd_stats_begin(HD_PHASE_TOC);
+
+  if (OutputType == OUTPUT_BOOK && TocLevels > 0)
+  {
+    toc = toc_build(document);
+  }
+  else
+  {
+    if (TocNumbers)
+      htmlDeleteTree(toc_build(document));
+
+    toc = NULL;
+  }
+
+  hd_stats_end();
+
+  hd_stats_begin(HD_PHASE_WRITE);
+  (*exportfunc)(document, toc);
+  hd_stats_end();
+
+  htmlDeleteTree(document);
+  htmlDeleteTree(toc);
+}
+
+
+/*
+ * 'export_outputs()' - Generate the additional outputs for a document.
+ *
+ * The document is only loaded and the table of contents built once.  The
+ * exporters change the links in the trees they are given, so each output is
+ * generated from a copy of the document while the original is left for the
+ * main output.  The image and HTTP caches are shared.
+ */
+
+static void
+export_outputs(tree_t   *document,	/* I - Document tree */
+               tree_t   *toc,		/* I - Table of contents */
+	       output_t *outputs,	/* I - Additional outputs */
+	       int      num_outputs)	/* I - Number of additional outputs */
+{
+  tree_t	*doccopy,		/* Copy of document */
+		*toccopy;		/* Copy of table of contents */
+  exportfunc_t	exportfunc;		/* Export function */
+  settings_t	settings;		/* Settings for the main output */
+
+
+  if (num_outputs <= 0)
+    return;
+
+  save_settings(&settings);
+
+  for (; num_outputs > 0; num_outputs --, outputs ++)
+  {
+    doccopy = htmlCopyTrees(document);
+    toccopy = htmlCopyTrees(toc);
+
+    if (!doccopy || (toc && !toccopy))
+    {
+      progress_error(HD_ERROR_OUT_OF_MEMORY,
+                     "Unable to copy document for \"%s\".", outputs->path);
+      htmlDeleteTree(doccopy);
+      htmlDeleteTree(toccopy);
+      continue;
+    }
+
+    restore_settings(&settings);
+
+    strlcpy(OutputPath, outputs->path, sizeof(OutputPath));
+    OutputFiles = outputs->files;
+    exportfunc  = get_export(outputs->format, &PSLevel, &PDFVersion,
+                             &Compression);
+
+    (*exportfunc)(doccopy, toccopy);
+
+    htmlDeleteTree(doccopy);
+    htmlDeleteTree(toccopy);
+  }
+
+  restore_settings(&settings);
+  free_settings(&settings);
+}
+
+
+/*
+ * 'free_settings()' - Free the strings in saved settings.
+ */
+
+static void
+free_settings(settings_t *settings)	/* I - Saved settings */
+{
+  int	i, j;				/* Looping vars */
+
+
+  for (i = 0; i < 5; i ++)
+    for (j = 0; j < 3; j ++)
+      free(settings->formats[i][j]);
+}
+
+
+/*
+ * 'get_export()' - Get the export function for an output format.
+ */
+
+static exportfunc_t			/* O - Export function or NULL */
+get_export(const char *format,		/* I - Output format */
+           int        *pslevel,		/* O - PostScript level */
+	   int        *pdfversion,	/* O - PDF version */
+	   int        *compression)	/* O - Compression level */
+{
+  if (strcasecmp(format, "epub") == 0)
+    return ((exportfunc_t)epub_export);
+  else if (strcasecmp(format, "html") == 0)
+    return ((exportfunc_t)html_export);
+  else if (strcasecmp(format, "htmlsep") == 0)
+    return ((exportfunc_t)htmlsep_export);
+  else if (strcasecmp(format, "pdf15") == 0)
+  {
+    *pslevel    = 0;
+    *pdfversion = 15;
+  }
+  else if (strcasecmp(format, "pdf14") == 0 ||
+	   strcasecmp(format, "pdf") == 0)
+  {
+    *pslevel    = 0;
+    *pdfversion = 14;
+  }
+  else if (strcasecmp(format, "pdf13") == 0)
+  {
+    *pslevel    = 0;
+    *pdfversion = 13;
+  }
+  else if (strcasecmp(format, "pdf12") == 0)
+  {
+    *pslevel    = 0;
+    *pdfversion = 12;
+  }
+  else if (strcasecmp(format, "pdf11") == 0)
+  {
+    *pslevel     = 0;
+    *pdfversion  = 11;
+    *compression = 0;
+  }
+  else if (strcasecmp(format, "ps1") == 0)
+    *pslevel = 1;
+  else if (strcasecmp(format, "ps2") == 0 ||
+	   strcasecmp(format, "ps") == 0)
+    *pslevel = 2;
+  else if (strcasecmp(format, "ps3") == 0)
+    *pslevel = 3;
+  else
+    return (NULL);
+
+  return ((exportfunc_t)pspdf_export);
+}
+
+
+/*
+ * 'get_output()' - Get an additional output from a --output argument.
+ *
+ * The argument is "format:path" or just a filename with an epub, html, pdf,
+ * or ps extension.  Paths ending in a slash and the htmlsep format write to
+ * a directory.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+get_output(const char *arg,		/* I - Argument string */
+           output_t   *output)		/* O - Output */
+{
+  const char	*path;			/* Output path */
+  const char	*extension;		/* Extension of output filename */
+  int		pslevel,		/* PostScript level */
+		pdfversion,		/* PDF version */
+		compression;		/* Compression level */
+  size_t	pathlen;		/* Length of output path */
+
+
+  memset(output, 0, sizeof(output_t));
+
+  if ((path = strchr(arg, ':')) != NULL && (size_t)(path - arg) < sizeof(output->format))
+  {
+    strlcpy(output->format, arg, (size_t)(path - arg + 1));
+
+    if (get_export(output->format, &pslevel, &pdfversion, &compression))
+      path ++;
+    else
+      path = NULL;
+  }
+  else
+    path = NULL;
+
+  if (!path)
+  {
+   /*
+    * No format, use the filename extension...
+    */
+
+    path = arg;
+
+    if ((extension = file_extension(path)) == NULL ||
+        (strcasecmp(extension, "epub") && strcasecmp(extension, "html") &&
+	 strcasecmp(extension, "pdf") && strcasecmp(extension, "ps")))
+      return (0);
+
+    strlcpy(output->format, extension, sizeof(output->format));
+  }
+
+  if (!*path)
+    return (0);
+
+  strlcpy(output->path, path, sizeof(output->path));
+
+  if ((pathlen = strlen(output->path)) > 1 && output->path[pathlen - 1] == '/')
+  {
+    output->path[pathlen - 1] = '\0';
+    output->files             = 1;
+  }
+  else
+    output->files = !strcasecmp(output->format, "htmlsep");
+
+  return (1);
+}
+
+
 /*
  * 'get_seconds()' - Get the current fractional time in seconds.
  */
@@ -1805,20 +2202,14 @@ load_book(const char   *filename,	// I  - Book file
           int          set_nolocal)	// I  - Set file_nolocal() after lookup?
 {
   FILE		*fp;			// File to read from
-  char		line[10240];		// Line from file
   const char 	*dir;			// Directory
   const char	*local;			// Local filename
-  char		path[2048];		// Current path
+  int		status;			// Status of load
 
 
   // See if the filename contains a path...
   dir = file_directory(filename);
 
-  if (dir != NULL)
-    snprintf(path, sizeof(path), "%s;%s", dir, Path);
-  else
-    strlcpy(path, Path, sizeof(path));
-
   // Open the file...
   local = file_find(Path, filename);
 
@@ -1828,65 +2219,19 @@ load_book(const char   *filename,	// I  - Book file
   if (!local)
     return (0);
 
-  if ((fp = fopen(local, "rb")) == NULL)
+  if ((fp = file_open(local, "rb")) == NULL)
   {
     progress_error(HD_ERROR_READ_ERROR, "Unable to open book file \"%s\": %s",
                    local, strerror(errno));
     return (0);
   }
 
-  // Get the header...
-  file_gets(line, sizeof(line), fp);
-  if (strncmp(line, "#HTMLDOC", 8) != 0)
-  {
-    fclose(fp);
-    progress_error(HD_ERROR_BAD_FORMAT,
-                   "Bad or missing #HTMLDOC header in \"%s\".", filename);
-    return (0);
-  }
-
-  // Read the second line from the book file; for older book files, this will
-  // be the file count; for new files this will be the options...
-  do
-  {
-    file_gets(line, sizeof(line), fp);
-
-    if (line[0] == '-')
-    {
-      parse_options(line, exportfunc);
-
-      if (dir != NULL)
-	snprintf(path, sizeof(path), "%s;%s", dir, Path);
-      else
-	strlcpy(path, Path, sizeof(path));
-    }
-  }
-  while (!line[0]);			// Skip blank lines
-
-  // Get input files/options...
-  while (file_gets(line, sizeof(line), fp) != NULL)
-  {
-    if (!line[0])
-      continue;				// Skip blank lines
-    else if (line[0] == '-')
-    {
-      parse_options(line, exportfunc);
-
-      if (dir != NULL)
-	snprintf(path, sizeof(path), "%s;%s", dir, Path);
-      else
-	strlcpy(path, Path, sizeof(path));
-    }
-    else if (line[0] == '\\')
-      read_file(line + 1, document, path);
-    else
-      read_file(line, document, path);
-  }
+  status = read_book(fp, filename, dir, document, exportfunc);
 
   // Close the book file and return...
   fclose(fp);
 
-  return (1);
+  return (status);
 }
 
 
@@ -1955,6 +2300,16 @@ parse_options(const char   *line,	// I - Options from book file
       OutputColor = 1;
       continue;
     }
+    else if (strcmp(temp, "--linearize") == 0)
+    {
+      PDFLinearize = 1;
+      continue;
+    }
+    else if (strcmp(temp, "--no-linearize") == 0)
+    {
+      PDFLinearize = 0;
+      continue;
+    }
     else if (strcmp(temp, "--links") == 0)
     {
       Links = 1;
@@ -2127,6 +2482,12 @@ parse_options(const char   *line,	// I - Options from book file
 	PSLevel     = 0;
 	PDFVersion  = 14;
       }
+      else if (strcmp(temp2, "pdf15") == 0)
+      {
+        *exportfunc = (exportfunc_t)pspdf_export;
+	PSLevel     = 0;
+	PDFVersion  = 15;
+      }
       else if (strcmp(temp2, "ps1") == 0)
       {
         *exportfunc = (exportfunc_t)pspdf_export;
@@ -2454,6 +2815,77 @@ parse_options(const char   *line,	// I - Options from book file
 }
 
 
+//
+// 'read_book()' - Read the options and files from a book file.
+//
+
+static int				// O  - 1 = success, 0 = failure
+read_book(FILE         *fp,		// I  - Book file
+          const char   *filename,	// I  - Name of book file
+          const char   *dir,		// I  - Directory for files or NULL
+          tree_t       **document,	// IO - Document tree
+          exportfunc_t *exportfunc)	// O  - Export function
+{
+  char		line[10240];		// Line from file
+  char		path[2048];		// Current path
+
+
+  if (dir != NULL)
+    snprintf(path, sizeof(path), "%s;%s", dir, Path);
+  else
+    strlcpy(path, Path, sizeof(path));
+
+  // Get the header...
+  file_gets(line, sizeof(line), fp);
+  if (strncmp(line, "#HTMLDOC", 8) != 0)
+  {
+    progress_error(HD_ERROR_BAD_FORMAT,
+                   "Bad or missing #HTMLDOC header in \"%s\".", filename);
+    return (0);
+  }
+
+  // Read the second line from the book file; for older book files, this will
+  // be the file count; for new files this will be the options...
+  do
+  {
+    file_gets(line, sizeof(line), fp);
+
+    if (line[0] == '-')
+    {
+      parse_options(line, exportfunc);
+
+      if (dir != NULL)
+	snprintf(path, sizeof(path), "%s;%s", dir, Path);
+      else
+	strlcpy(path, Path, sizeof(path));
+    }
+  }
+  while (!line[0]);			// Skip blank lines
+
+  // Get input files/options...
+  while (file_gets(line, sizeof(line), fp) != NULL)
+  {
+    if (!line[0])
+      continue;				// Skip blank lines
+    else if (line[0] == '-')
+    {
+      parse_options(line, exportfunc);
+
+      if (dir != NULL)
+	snprintf(path, sizeof(path), "%s;%s", dir, Path);
+      else
+	strlcpy(path, Path, sizeof(path));
+    }
+    else if (line[0] == '\\')
+      read_file(line + 1, document, path);
+    else
+      read_file(line, document, path);
+  }
+
+  return (1);
+}
+
+
 //
 // 'read_file()' - Read a file into the current document.
 //
@@ -2461,7 +2893,8 @@ parse_options(const char   *line,	// I - Options from book file
 static int				// O  - 1 on success, 0 on failure
 read_file(const char *filename,		// I  - File/URL to read
           tree_t     **document,	// IO - Current document
-	  const char *path)		// I  - Search path
+	  const char *path,		// I  - Search path
+	  const char *basedir)		// I  - Base directory or NULL for the file's directory
 {
   FILE		*docfile;		// Document file
   tree_t	*file;			// HTML document file
@@ -2474,7 +2907,7 @@ read_file(const char *filename,		// I  - File/URL to read
 
   if ((realname = file_find(path, filename)) != NULL)
   {
-    if ((docfile = fopen(realname, "rb")) != NULL)
+    if ((docfile = file_open(realname, "rb")) != NULL)
     {
       // Prepare to read the file...
       if (Verbosity > 0)
@@ -2482,7 +2915,10 @@ read_file(const char *filename,		// I  - File/URL to read
 
       _htmlPPI = 72.0f * _htmlBrowserWidth / (PageWidth - PageLeft - PageRight);
 
-      strlcpy(base, file_directory(filename), sizeof(base));
+      if (!basedir && (basedir = file_directory(filename)) == NULL)
+        basedir = ".";
+
+      strlcpy(base, basedir, sizeof(base));
       ext = file_extension(filename);
 
       file = htmlAddTree(NULL, MARKUP_FILE, NULL);
@@ -2490,18 +2926,33 @@ read_file(const char *filename,		// I  - File/URL to read
       htmlSetVariable(file, (uchar *)"_HD_FILENAME", (uchar *)file_basename(filename));
       htmlSetVariable(file, (uchar *)"_HD_BASE", (uchar *)base);
 
-      if (ext && !strcmp(ext, "md"))
-      {
-        // Read markdown from a file...
-        mdReadFile(file, docfile, base);
-      }
-      else
+      hd_stats_begin(HD_PHASE_PARSE);
+
+      if (!hd_treecache_load(file, filename, realname, base))
       {
-        // Read HTML from a file...
-        _htmlCurrentFile = filename;
-        htmlReadFile(file, docfile, base);
+        // Not in the tree cache, so parse the file...
+        int errors = Errors;		// Errors before reading
+
+        if (ext && !strcmp(ext, "md"))
+        {
+          // Read markdown from a file...
+          mdReadFile(file, docfile, base);
+        }
+        else
+        {
+          // Read HTML from a file...
+          _htmlCurrentFile = filename;
+          htmlReadFile(file, docfile, base);
+        }
+
+        // Cache the tree unless there were errors that need to be reported
+        // again on the next run...
+        if (Errors == errors)
+          hd_treecache_save(file, filename, realname, base);
       }
 
+      hd_stats_end();
+
       fclose(docfile);
 
       if (*document == NULL)
@@ -2531,6 +2982,664 @@ read_file(const char *filename,		// I  - File/URL to read
 }
 
 
+//
+// 'restore_settings()' - Restore the settings saved by save_settings().
+//
+
+static void
+restore_settings(settings_t *settings)	// I - Saved settings
+{
+  int		i, j;			// Looping vars
+  char		**formats[5] =		// Header and footer strings
+		{ Header, Header1, Footer, TocHeader, TocFooter };
+
+
+  strlcpy(OutputPath, settings->path, sizeof(OutputPath));
+
+  OutputFiles = settings->files;
+  PSLevel     = settings->pslevel;
+  PDFVersion  = settings->pdfversion;
+  Compression = settings->compression;
+  PageWidth   = settings->width;
+  PageLength  = settings->length;
+  PageLeft    = settings->left;
+  PageRight   = settings->right;
+  PageBottom  = settings->bottom;
+  PageTop     = settings->top;
+  Landscape   = settings->landscape;
+  PageDuplex  = settings->duplex;
+  NumberUp    = settings->nup;
+  TocDocCount = settings->chapters;
+
+  // pspdf_export() frees and clears the strings, the other exporters leave
+  // them alone...
+  for (i = 0; i < 5; i ++)
+    for (j = 0; j < 3; j ++)
+    {
+      free(formats[i][j]);
+      formats[i][j] = settings->formats[i][j] ? strdup(settings->formats[i][j]) : NULL;
+    }
+}
+
+
+//
+// 'run_batch()' - Convert the book files listed in a manifest.
+//
+// Each book file is converted by a child process, up to "jobs" at a time,
+// after the charset and fonts have been loaded once.  Remote files are
+// shared between jobs through the HTTP cache, using a temporary cache when
+// none has been configured.
+//
+
+static int				// O - Number of failed jobs, at most 254
+run_batch(const char   *manifest,	// I - Manifest file
+          int          jobs,		// I - Number of jobs or 0 for one per CPU
+          const char   *httpcache,	// I - HTTP cache directory or NULL
+          exportfunc_t exportfunc)	// I - Default export function
+{
+#ifdef WIN32
+  REF(jobs);
+  REF(httpcache);
+  REF(exportfunc);
+
+  progress_error(HD_ERROR_INTERNAL_ERROR,
+                 "Unable to convert \"%s\": Batch mode is not supported on Windows.",
+		 manifest);
+  return (1);
+
+#else
+  FILE		*fp;			// Manifest file
+  char		line[1024],		// Line from manifest
+		cachedir[1024];		// Temporary HTTP cache directory
+  const char	*tmpdir;		// Temporary directory
+  int		i,			// Looping var
+		num_jobs = 0,		// Number of jobs started
+		num_active = 0,		// Number of running jobs
+		num_failed = 0,		// Number of failed jobs
+		status,			// Exit status of job
+		done = 0;		// Done reading the manifest?
+  char		*start,			// Start of filename
+		*end;			// End of filename
+  pid_t		pid;			// Job process
+  batch_job_t	*active;		// Running jobs
+  double	start_time;		// Start time
+
+
+  if ((fp = fopen(manifest, "r")) == NULL)
+  {
+    progress_error(HD_ERROR_FILE_NOT_FOUND, "Unable to open manifest \"%s\": %s",
+                   manifest, strerror(errno));
+    return (1);
+  }
+
+#  ifdef _SC_NPROCESSORS_ONLN
+  if (jobs <= 0)
+    jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#  endif // _SC_NPROCESSORS_ONLN
+
+  if (jobs < 1)
+    jobs = 1;
+
+  if ((active = (batch_job_t *)calloc((size_t)jobs, sizeof(*active))) == NULL)
+  {
+    progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for %d jobs.", jobs);
+    fclose(fp);
+    return (1);
+  }
+
+ /*
+  * Share remote files between the jobs...
+  */
+
+  cachedir[0] = '\0';
+
+  if (!httpcache)
+  {
+    if ((tmpdir = getenv("TMPDIR")) == NULL)
+      tmpdir = "/var/tmp";
+
+    snprintf(cachedir, sizeof(cachedir), "%s/htmldoc-cache.%d", tmpdir, (int)getpid());
+    file_httpcache(cachedir, 0);
+  }
+
+ /*
+  * Load the charset and fonts once for all of the jobs...
+  */
+
+  htmlSetCharSet(_htmlCharSet);
+  pspdf_preload();
+  progress_hide();
+
+  start_time = get_seconds();
+
+  while (!done || num_active > 0)
+  {
+   /*
+    * Start jobs until all of the workers are busy...
+    */
+
+    while (!done && num_active < jobs)
+    {
+      if (!fgets(line, sizeof(line), fp))
+      {
+        done = 1;
+	break;
+      }
+
+      // Strip leading/trailing whitespace and skip blank and comment lines...
+      for (start = line; isspace(*start & 255); start ++);
+      for (end = start + strlen(start); end > start && isspace(end[-1] & 255); *--end = '\0');
+
+      if (!*start || *start == '#')
+        continue;
+
+      num_jobs ++;
+
+      fflush(stdout);
+      fflush(stderr);
+
+      if ((pid = fork()) == 0)
+      {
+       /*
+        * Convert the book file in the child...
+	*/
+
+        tree_t	*document = NULL;	// Document tree
+
+
+        fclose(fp);
+
+        Errors = 0;
+
+        if (!load_book(start, &document, &exportfunc))
+	{
+	  if (!Errors)
+	    progress_error(HD_ERROR_FILE_NOT_FOUND, "Unable to find book file \"%s\".", start);
+	}
+	else
+	{
+	  if (!document)
+	    progress_error(HD_ERROR_FILE_NOT_FOUND, "No HTML files!");
+	  else if (!OutputPath[0])
+	  {
+	    progress_error(HD_ERROR_BAD_FORMAT, "No output file or directory specified.");
+	    htmlDeleteTree(document);
+	  }
+	  else
+	    convert_document(document, exportfunc);
+	}
+
+        file_cleanup();
+	image_flush_cache();
+
+        exit(Errors > 254 ? 254 : Errors);
+      }
+      else if (pid < 0)
+      {
+	progress_error(HD_ERROR_INTERNAL_ERROR, "Unable to start job for \"%s\": %s",
+		       start, strerror(errno));
+	num_failed ++;
+	continue;
+      }
+
+      for (i = 0; i < jobs; i ++)
+        if (!active[i].pid)
+	  break;
+
+      active[i].pid    = (int)pid;
+      active[i].number = num_jobs;
+      active[i].start  = get_seconds();
+      strlcpy(active[i].name, start, sizeof(active[i].name));
+
+      num_active ++;
+    }
+
+   /*
+    * Wait for a job to finish and report on it...
+    */
+
+    if (num_active == 0)
+      continue;
+
+    if ((pid = waitpid(-1, &status, 0)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      break;
+    }
+
+    for (i = 0; i < jobs; i ++)
+      if (active[i].pid == pid)
+        break;
+
+    if (i >= jobs)
+      continue;
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    {
+      progress_error(HD_ERROR_NONE, "INFO: Job %d \"%s\" succeeded in %.3f seconds.",
+		     active[i].number, active[i].name, get_seconds() - active[i].start);
+    }
+    else
+    {
+      if (WIFEXITED(status))
+	progress_error(HD_ERROR_NONE, "INFO: Job %d \"%s\" failed with %d error(s) in %.3f seconds.",
+		       active[i].number, active[i].name, WEXITSTATUS(status),
+		       get_seconds() - active[i].start);
+      else
+	progress_error(HD_ERROR_NONE, "INFO: Job %d \"%s\" stopped by signal %d after %.3f seconds.",
+		       active[i].number, active[i].name,
+		       WIFSIGNALED(status) ? WTERMSIG(status) : 0,
+		       get_seconds() - active[i].start);
+
+      num_failed ++;
+    }
+
+    active[i].pid = 0;
+    num_active --;
+  }
+
+  fclose(fp);
+  free(active);
+
+  progress_error(HD_ERROR_NONE, "INFO: %d of %d jobs succeeded in %.3f seconds.",
+		 num_jobs - num_failed, num_jobs, get_seconds() - start_time);
+
+ /*
+  * Remove the temporary HTTP cache...
+  */
+
+  if (cachedir[0])
+  {
+    file_httpcache_purge();
+    rmdir(cachedir);
+  }
+
+  return (num_failed > 254 ? 254 : num_failed);
+#endif // WIN32
+}
+
+
+//
+// 'run_server()' - Convert documents sent to a socket.
+//
+// Each connection is converted by a child process so that the options and
+// files of one job cannot affect the next, while the charset and fonts that
+// are loaded here are shared by every job.
+//
+
+static int				// O - Exit status
+run_server(const char   *address,	// I - "/path", "host:port", or "port"
+           exportfunc_t exportfunc)	// I - Default export function
+{
+#ifdef WIN32
+  REF(exportfunc);
+
+  progress_error(HD_ERROR_INTERNAL_ERROR,
+                 "Unable to listen on \"%s\": Server mode is not supported on Windows.",
+		 address);
+  return (1);
+
+#else
+  int		lfd = -1,		// Listening socket
+		fd,			// Client connection
+		val;			// Socket option value
+  pid_t		pid;			// Job process
+  const char	*port;			// Port number
+  char		host[256];		// Hostname or address
+  struct addrinfo hints,		// Address hints
+		*addrs,			// Addresses
+		*addr;			// Current address
+
+
+  if (strchr(address, '/'))
+  {
+    // Listen on a UNIX domain socket...
+    struct sockaddr_un	sun;		// Socket address
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+
+    if (strlcpy(sun.sun_path, address, sizeof(sun.sun_path)) >= sizeof(sun.sun_path))
+    {
+      progress_error(HD_ERROR_INTERNAL_ERROR, "Socket path \"%s\" is too long.", address);
+      return (1);
+    }
+
+    unlink(address);
+
+    if ((lfd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0 &&
+        bind(lfd, (struct sockaddr *)&sun, sizeof(sun)))
+    {
+      val = errno;
+      close(lfd);
+      lfd   = -1;
+      errno = val;
+    }
+  }
+  else
+  {
+    // Listen on a TCP/IP socket, using "host:port" or just "port"...
+    if ((port = strrchr(address, ':')) != NULL)
+    {
+      if (*address == '[' && port > address && port[-1] == ']')
+        strlcpy(host, address + 1, sizeof(host) < (size_t)(port - address - 1) ? sizeof(host) : (size_t)(port - address - 1));
+      else
+        strlcpy(host, address, sizeof(host) < (size_t)(port - address + 1) ? sizeof(host) : (size_t)(port - address + 1));
+
+      port ++;
+    }
+    else
+    {
+      host[0] = '\0';
+      port    = address;
+    }
+
+    // Only listen on the loopback address unless a host is given, with "*"
+    // meaning all interfaces...
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (!strcmp(host, "*"))
+    {
+      hints.ai_flags = AI_PASSIVE;
+      host[0]        = '\0';
+    }
+    else if (!host[0])
+      strlcpy(host, "127.0.0.1", sizeof(host));
+
+    if ((val = getaddrinfo(host[0] ? host : NULL, port, &hints, &addrs)) != 0)
+    {
+      progress_error(HD_ERROR_INTERNAL_ERROR, "Unable to listen on \"%s\": %s",
+                     address, gai_strerror(val));
+      return (1);
+    }
+
+    for (addr = addrs; addr; addr = addr->ai_next)
+    {
+      if ((lfd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) < 0)
+        continue;
+
+      val = 1;
+      setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+
+      if (!bind(lfd, addr->ai_addr, addr->ai_addrlen))
+        break;
+
+      val = errno;
+      close(lfd);
+      lfd   = -1;
+      errno = val;
+    }
+
+    freeaddrinfo(addrs);
+  }
+
+  if (lfd < 0 || listen(lfd, 128))
+  {
+    progress_error(HD_ERROR_INTERNAL_ERROR, "Unable to listen on \"%s\": %s",
+                   address, strerror(errno));
+    return (1);
+  }
+
+  // Load the charset and fonts once for all of the jobs...
+  htmlSetCharSet(_htmlCharSet);
+  pspdf_preload();
+  progress_hide();
+
+  // Let the system reap finished jobs...
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+  progress_error(HD_ERROR_NONE, "INFO: HTMLDOC " SVERSION " listening on \"%s\".", address);
+
+  for (;;)
+  {
+    if ((fd = accept(lfd, NULL, NULL)) < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+
+      progress_error(HD_ERROR_INTERNAL_ERROR, "Unable to accept connection: %s",
+                     strerror(errno));
+      break;
+    }
+
+    if ((pid = fork()) == 0)
+    {
+      // Convert the document in the child...
+      close(lfd);
+      signal(SIGCHLD, SIG_DFL);
+
+      exit(serve_job(fd, exportfunc));
+    }
+    else if (pid < 0)
+      progress_error(HD_ERROR_INTERNAL_ERROR, "Unable to start job: %s",
+                     strerror(errno));
+
+    close(fd);
+  }
+
+  close(lfd);
+
+  return (1);
+#endif // WIN32
+}
+
+
+#ifndef WIN32
+//
+// 'serve_job()' - Convert a document sent to the server.
+//
+// The client sends a book file, optionally followed by a line containing
+// "#BODY" and a HTML document, and then shuts down its side of the
+// connection.  The output file is sent back and the connection is closed;
+// nothing is sent if the document could not be converted.
+//
+
+static int				// O - Exit status
+serve_job(int          fd,		// I - Client connection
+          exportfunc_t exportfunc)	// I - Default export function
+{
+  FILE		*fp,			// Connection
+		*book,			// Book file
+		*body = NULL,		// Body of request
+		*out;			// Output file
+  tree_t	*document = NULL;	// Document tree
+  char		line[10240],		// Line from request
+		bookname[1024],		// Book filename
+		bodyname[1024];		// Body filename
+  size_t	bytes;			// Bytes read
+  ssize_t	written;		// Bytes written
+  int		status = 1;		// Exit status
+
+
+  Errors = 0;
+
+  if ((fp = fdopen(fd, "rb")) == NULL)
+  {
+    close(fd);
+    return (1);
+  }
+
+ /*
+  * Copy the request to temporary files...
+  */
+
+  if ((book = file_temp(bookname, sizeof(bookname))) == NULL)
+  {
+    progress_error(HD_ERROR_WRITE_ERROR, "Unable to create temporary file \"%s\": %s",
+                   bookname, strerror(errno));
+    goto done;
+  }
+
+  while (fgets(line, sizeof(line), fp))
+  {
+    if (!strcmp(line, "#BODY\n") || !strcmp(line, "#BODY\r\n"))
+    {
+      if ((body = file_temp(bodyname, sizeof(bodyname))) == NULL)
+      {
+	progress_error(HD_ERROR_WRITE_ERROR, "Unable to create temporary file \"%s\": %s",
+		       bodyname, strerror(errno));
+        fclose(book);
+	goto done;
+      }
+
+      while ((bytes = fread(line, 1, sizeof(line), fp)) > 0)
+        fwrite(line, 1, bytes, body);
+
+      fclose(body);
+      break;
+    }
+
+    fputs(line, book);
+  }
+
+  rewind(book);
+
+ /*
+  * Load the document, sending the output to a temporary file...
+  */
+
+  // Jobs come from the network, so they can only use remote files and the
+  // body that was sent with the request...
+  file_nolocal();
+
+  if (read_book(book, "server request", NULL, &document, &exportfunc) && body &&
+      (body = fopen(bodyname, "rb")) != NULL)
+  {
+    tree_t	*file;			// Body document
+
+    _htmlPPI = 72.0f * _htmlBrowserWidth / (PageWidth - PageLeft - PageRight);
+
+    file = htmlAddTree(NULL, MARKUP_FILE, NULL);
+    htmlSetVariable(file, (uchar *)"_HD_FILENAME", (uchar *)file_basename(bodyname));
+    htmlSetVariable(file, (uchar *)"_HD_BASE", (uchar *)".");
+
+    _htmlCurrentFile = "server request";
+    htmlReadFile(file, body, ".");
+
+    fclose(body);
+
+    if (document == NULL)
+      document = file;
+    else
+    {
+      while (document->next != NULL)
+        document = document->next;
+
+      document->next = file;
+      file->prev     = document;
+    }
+  }
+
+  fclose(book);
+
+  if (!document)
+  {
+    progress_error(HD_ERROR_FILE_NOT_FOUND, "No HTML files!");
+    goto done;
+  }
+
+  if (OutputFiles || exportfunc == (exportfunc_t)htmlsep_export)
+  {
+    progress_error(HD_ERROR_BAD_FORMAT, "Server jobs cannot produce multiple files.");
+    htmlDeleteTree(document);
+    goto done;
+  }
+
+  if ((out = file_temp(OutputPath, sizeof(OutputPath))) == NULL)
+  {
+    progress_error(HD_ERROR_WRITE_ERROR, "Unable to create temporary file \"%s\": %s",
+                   OutputPath, strerror(errno));
+    htmlDeleteTree(document);
+    goto done;
+  }
+
+  fclose(out);
+
+  convert_document(document, exportfunc);
+
+ /*
+  * Send the output file...
+  */
+
+  if ((out = fopen(OutputPath, "rb")) != NULL)
+  {
+    status = 0;
+
+    while (!status && (bytes = fread(line, 1, sizeof(line), out)) > 0)
+    {
+      char *ptr;			// Pointer into buffer
+
+      for (ptr = line; bytes > 0; ptr += written, bytes -= (size_t)written)
+      {
+        if ((written = write(fd, ptr, bytes)) < 0)
+	{
+	  if (errno == EINTR)
+	  {
+	    written = 0;
+	    continue;
+	  }
+
+	  status = 1;
+	  break;
+	}
+      }
+    }
+
+    fclose(out);
+  }
+
+  done:
+
+  fclose(fp);
+
+  file_cleanup();
+  image_flush_cache();
+
+  return (status);
+}
+#endif // !WIN32
+
+
+//
+// 'save_settings()' - Save the settings that are changed by the exporters.
+//
+
+static void
+save_settings(settings_t *settings)	// O - Saved settings
+{
+  int		i, j;			// Looping vars
+  char		**formats[5] =		// Header and footer strings
+		{ Header, Header1, Footer, TocHeader, TocFooter };
+
+
+  strlcpy(settings->path, OutputPath, sizeof(settings->path));
+
+  settings->files       = OutputFiles;
+  settings->pslevel     = PSLevel;
+  settings->pdfversion  = PDFVersion;
+  settings->compression = Compression;
+  settings->width       = PageWidth;
+  settings->length      = PageLength;
+  settings->left        = PageLeft;
+  settings->right       = PageRight;
+  settings->bottom      = PageBottom;
+  settings->top         = PageTop;
+  settings->landscape   = Landscape;
+  settings->duplex      = PageDuplex;
+  settings->nup         = NumberUp;
+  settings->chapters    = TocDocCount;
+
+  for (i = 0; i < 5; i ++)
+    for (j = 0; j < 3; j ++)
+      settings->formats[i][j] = formats[i][j] ? strdup(formats[i][j]) : NULL;
+}
+
+
 //
 // 'set_permissions()' - Set the PDF permission bits.
 //
@@ -2678,7 +3787,7 @@ usage(const char *arg)			// I - Bad argument string
     puts("  --fontsize {4.0..24.0}");
     puts("  --fontspacing {1.0..3.0}");
     puts("  --footer fff");
-    puts("  {--format, -t} {epub,html,htmlsep,pdf11,pdf12,pdf13,pdf14,ps1,ps2,ps3}");
+    puts("  {--format, -t} {epub,html,htmlsep,pdf11,pdf12,pdf13,pdf14,pdf15,ps1,ps2,ps3}");
     puts("  --gray");
     puts("  --header fff");
     puts("  --header1 fff");
@@ -2696,18 +3805,25 @@ usage(const char *arg)			// I - Bad argument string
 #endif // HAVE_LIBFLTK
     for (int i = 0; i < MAX_HF_IMAGES; i ++)
       printf("  --hfimage%d filename.{bmp,gif,jpg,png}\n", i);
+    puts("  --httpcache directory");
+    puts("  --httpcachesize megabytes");
+    puts("  --imagecache megabytes");
+    puts("  --jobs {0..N}");
     puts("  --jpeg[=quality]");
     puts("  --landscape");
     puts("  --left margin{in,cm,mm}");
     puts("  --letterhead filename.{bmp,gif,jpg,png}");
+    puts("  --linearize");
     puts("  --linkcolor color");
     puts("  --links");
     puts("  --linkstyle {plain,underline}");
     puts("  --logoimage filename.{bmp,gif,jpg,png}");
+    puts("  --manifest filename");
     puts("  --no-compression");
     puts("  --no-duplex");
     puts("  --no-embedfonts");
     puts("  --no-encryption");
+    puts("  --no-linearize");
     puts("  --no-links");
     puts("  --no-localfiles");
     puts("  --no-numbered");
@@ -2720,6 +3836,7 @@ usage(const char *arg)			// I - Bad argument string
     puts("  --nup {1,2,4,6,9,16}");
     puts("  {--outdir, -d} dirname");
     puts("  {--outfile, -f} filename.{epub,html,pdf,ps}");
+    puts("  --output [format:]{filename,dirname/}");
     puts("  --overflow");
     puts("  --owner-password password");
     puts("  --pageduration {1.0..60.0}");
@@ -2734,10 +3851,13 @@ usage(const char *arg)			// I - Bad argument string
     puts("  --quiet");
     puts("  --referer url");
     puts("  --right margin{in,cm,mm}");
+    puts("  --server {/path,host:port,port}");
     puts("  --size {letter,a4,WxH{in,cm,mm},etc}");
+    puts("  --stats {filename.json,-}");
     puts("  --strict");
     puts("  --textcolor color");
     puts("  --textfont {courier,times,helvetica}");
+    puts("  --threads {0..64}");
     puts("  --title");
     puts("  --titlefile filename.{htm,html,shtml}");
     puts("  --titleimage filename.{bmp,gif,jpg,png}");
@@ -2746,6 +3866,7 @@ usage(const char *arg)			// I - Bad argument string
     puts("  --toclevels levels");
     puts("  --toctitle string");
     puts("  --top margin{in,cm,mm}");
+    puts("  --treecache directory");
     puts("  --user-password password");
     puts("  {--verbose, -v}");
     puts("  --version");
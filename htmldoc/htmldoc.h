@@ -20,6 +20,7 @@
 #include "image.h"
 #include "debug.h"
 #include "progress.h"
+#include "stats.h"
 
 #ifdef HAVE_LIBFLTK
 #  include "gui.h"
@@ -124,11 +125,14 @@ enum	/* PDF document permissions */
 #endif /* _HTML_DOC_CXX_ */
 
 VAR int		Verbosity	VALUE(0);	/* Verbosity */
+VAR int		StatusMessages	VALUE(1);	/* Show status (non-error) messages? */
 VAR int		OverflowErrors	VALUE(0);	/* Show errors on overflow */
 VAR int		StrictHTML	VALUE(0);	/* Do strict HTML checking */
 VAR int		CGIMode		VALUE(0);	/* Running as CGI? */
 VAR int		Errors		VALUE(0);	/* Number of errors */
 VAR int		Compression	VALUE(1);	/* Non-zero means compress PDFs */
+VAR int		Threads		VALUE(0);	/* Worker threads, 0 = one per CPU */
+VAR int		ImageCache	VALUE(0);	/* Image pixel memory in MB, 0 = no limit */
 VAR int		TitlePage	VALUE(1),	/* Need a title page */
 		TocLevels	VALUE(3),	/* Number of table-of-contents levels */
 		TocLinks	VALUE(1),	/* Generate links */
@@ -137,6 +141,7 @@ VAR int		TitlePage	VALUE(1),	/* Need a title page */
 VAR int		OutputType	VALUE(OUTPUT_BOOK);
 						/* Output a "book", etc. */
 VAR char	OutputPath[1024] VALUE("");	/* Output directory/name */
+VAR FILE	*OutputFile	VALUE(NULL);	/* Output stream instead of OutputPath */
 VAR int		OutputFiles	VALUE(0),	/* Generate multiple files? */
 		OutputColor	VALUE(1);	/* Output color images */
 VAR int		OutputJPEG	VALUE(0);	/* JPEG compress images? */
@@ -150,6 +155,7 @@ VAR int		PDFPageMode	VALUE(PDF_OUTLINE),
 		PDFEffect	VALUE(PDF_NONE);/* Page transition effect */
 VAR double	PDFEffectDuration VALUE(1.0),	/* Page effect duration */
 		PDFPageDuration	VALUE(10.0);	/* Page duration */
+VAR int		PDFLinearize	VALUE(0);	/* Linearize PDF files? */
 VAR int		Encryption	VALUE(0),	/* Encrypt the PDF file? */
 		Permissions	VALUE(-4);	/* File permissions? */
 VAR char	OwnerPassword[33] VALUE(""),	/* Owner password */
@@ -246,6 +252,7 @@ VAR int		Tooltips	VALUE(0);	/* Show tooltips? */
  */
 
 extern int	pspdf_export(tree_t *document, tree_t *toc);
+extern void	pspdf_preload(void);
 
 extern int	epub_export(tree_t *document, tree_t *toc);
 
@@ -15,6 +15,19 @@
 #include "htmldoc.h"
 #include <cups/http.h>
 #include <ctype.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#  include <sys/mman.h>
+#endif // HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#ifdef WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif // WIN32
+#ifndef O_BINARY
+#  define O_BINARY 0
+#endif // !O_BINARY
 
 
 /*
@@ -154,8 +167,6 @@ int		_htmlWidthsLoaded[TYPE_MAX][STYLE_MAX] =
 		};
 short		_htmlWidths[TYPE_MAX][STYLE_MAX][256];
 					/* Character widths of fonts */
-short		_htmlWidthsAll[TYPE_MAX][STYLE_MAX][65536];
-                                        /* Unicode widths of fonts */
 int		_htmlUnicode[256];	/* Character to Unicode mapping */
 uchar           _htmlCharacters[65536]; /* Unicode to character mapping */
 int             _htmlUTF8 = 0;          /* Doing UTF-8? */
@@ -228,6 +239,89 @@ int		_htmlStandardFonts[TYPE_MAX] =
 		};
 
 
+/*
+ * Local types...
+ */
+
+typedef struct				// Buffered HTML input
+{
+  FILE		*fp;			// Underlying file
+  uchar		*buffer,		// Start of buffer
+		*ptr,			// Current position in buffer
+		*end,			// End of data in buffer
+		*map;			// Start of memory-mapped file or NULL
+  size_t	mapsize;		// Size of memory-mapped file
+} hdinput_t;
+
+#define HD_INPUT_SIZE	65536		// Size of read buffer
+
+typedef struct				// Font metrics file header
+{
+  char		magic[4];		// "HDFM"
+  unsigned	byteorder,		// HD_METRICS_BYTEORDER
+		num_glyphs,		// Number of glyphs
+		names_size;		// Bytes of glyph names
+  long long	afm_size,		// Size of AFM file
+		afm_mtime;		// Modification time of AFM file
+} hdmetrics_header_t;
+
+typedef struct				// Glyph in a font metrics file
+{
+  short		code,			// Character code or -1 if unencoded
+		width;			// Advance width
+  unsigned	name;			// Offset of name in name strings
+} hdmetrics_glyph_t;
+
+typedef struct				// Font metrics
+{
+  hdmetrics_header_t *header;		// Start of metrics data
+  hdmetrics_glyph_t *glyphs;		// Glyphs, sorted by name
+  const char	*names;			// Glyph name strings
+  size_t	size;			// Size of metrics data
+  int		mapped;			// Is the data memory-mapped?
+  char		*datadir;		// Data directory for font
+} hdmetrics_t;
+
+#define HD_METRICS_BYTEORDER 0x01020304	// Native byte order check value
+
+typedef struct				// Saved tree header
+{
+  char		magic[4];		// "HDTR"
+  unsigned	byteorder,		// HD_METRICS_BYTEORDER
+		node_size,		// Size of hdtree_node_t
+		num_children,		// Number of top-level nodes
+		length;			// Length of node data that follows
+} hdtree_header_t;
+
+typedef struct				// Saved tree node, followed by the
+{					// text and variable strings
+  short		markup;			// Markup code
+  unsigned short num_vars;		// Number of variables
+  unsigned	flags;			// Alignment, font, and style bits
+  uchar		red,			// Color of this fragment
+		green,
+		blue,
+		link;			// Levels up to linked-to node or 255
+  float		width,			// Width of this fragment in points
+		height;			// Height of this fragment in points
+  unsigned	data_length,		// Length of text + 1 or 0 for none
+		num_children;		// Number of child nodes
+} hdtree_node_t;
+
+#define HD_TREE_NO_LINK	255		// No linked-to node
+
+typedef struct				// Glyph read from an AFM file
+{
+  int		code,			// Character code or -1 if unencoded
+		width;			// Advance width
+  char		*name;			// Glyph name
+} hdafm_glyph_t;
+
+#define html_getc(in)	((in)->ptr < (in)->end ? *((in)->ptr)++ : fill_input(in))
+#define html_ungetc(ch,in) \
+			(void)((ch) != EOF && (in)->ptr > (in)->buffer && (in)->ptr --)
+
+
 /*
  * Local functions.
  */
@@ -238,16 +332,45 @@ typedef int	(*compare_func_t)(const void *, const void *);
 
 static int	write_file(tree_t *t, FILE *fp, int col);
 static int	compare_variables(var_t *v0, var_t *v1);
-static int	compare_markups(uchar **m0, uchar **m1);
+static int	compare_glyphs(hdafm_glyph_t *g0, hdafm_glyph_t *g1);
+static tree_t	*copy_children(tree_t *parent, tree_t *t);
+static uchar	*copy_string(tree_t *t, const uchar *s);
 static void	delete_node(tree_t *t);
+static const uchar *load_string(const uchar **ptr, const uchar *end,
+		                unsigned length);
+static int	load_tree(tree_t *parent, unsigned num_children,
+		          const uchar **ptr, const uchar *end);
+static int	save_tree(tree_t *parent, FILE *fp);
+static var_t	*find_variable(tree_t *t, const uchar *name);
+static unsigned	hash_name(const uchar *s, int shift);
+static uchar	*intern_name(const uchar *name);
+static markup_t	lookup_markup(const uchar *name);
+#ifdef DEBUG
+static void	check_names(void);
+#endif /* DEBUG */
+static tree_t	*new_node(tree_t *parent);
 static void	insert_space(tree_t *parent, tree_t *t);
-static int	parse_markup(tree_t *t, FILE *fp, int *linenum);
-static int	parse_variable(tree_t *t, FILE *fp, int *linenum);
+static void	close_input(hdinput_t *in);
+static int	fill_input(hdinput_t *in);
+static int	open_input(hdinput_t *in, FILE *fp);
+static int	parse_markup(tree_t *t, hdinput_t *in, int *linenum);
+static int	parse_variable(tree_t *t, hdinput_t *in, int *linenum);
+static tree_t	*read_html(tree_t *parent, hdinput_t *in, const char *base);
 static int	compute_size(tree_t *t);
+static short	*fill_width_page(int typeface, int style, int page);
+static int	find_glyph_width(hdmetrics_t *m, const char *name);
+static void	free_metrics(hdmetrics_t *m);
+static hdmetrics_t *load_metrics(int typeface, int style);
+static hdmetrics_t *read_afm(const char *filename, struct stat *afminfo);
+static hdmetrics_t *read_metrics(const char *filename, struct stat *afminfo);
+static void	write_metrics(const char *filename, hdmetrics_t *m);
 static int	compute_color(tree_t *t, uchar *color);
 static int	get_alignment(tree_t *t);
 static const char *fix_filename(char *path, char *base);
-static int      utf8_getc(int ch, FILE *fp);
+static void	prefetch_html(const uchar *ptr, const uchar *end,
+		              const char *base);
+static const char *resolve_filename(char *path, char *base);
+static int      utf8_getc(int ch, hdinput_t *in);
 
 #define issuper(x)	((x) == MARKUP_CENTER || (x) == MARKUP_DIV ||\
 			 (x) == MARKUP_BLOCKQUOTE)
@@ -268,6 +391,140 @@ static int      utf8_getc(int ch, FILE *fp);
 static uchar	indent[255] = "";
 #endif /* DEBUG */
 
+static short	*width_pages[TYPE_MAX][STYLE_MAX][256];
+					/* Unicode widths of fonts, by page */
+
+
+/*
+ * Perfect hash tables for element and attribute names, indexed by
+ * hash_name().  These are generated by mkhash.py and must be regenerated
+ * whenever _htmlMarkups[] or html_attrs[] change...
+ */
+
+static const unsigned char html_markup_hash[512] =
+{					/* Element name to markup_t */
+   0,  0,  0,  0,  0,  0,  0,  0, 78,  0,  0,  0,  0,  0,  0,  0,
+  31,  0, 65,  0, 94,  0,  0,  0,  0, 95,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0, 51,  0,  0,  0,  0,  0, 62,  0,  0,  0, 57,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 25, 73,  0,  0, 26,
+   0,  0,  0,  0,  0,  0,  0,  0, 55,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0, 32,  0,  0, 90,  0,  0,  0,  0,  0,  0,  0,  0,
+  75,  3,  8, 59,  0,  0,  0,  0,  0, 53,  0,  0,  0,  0,  0,  0,
+  69,  0,  0, 71,  0, 93,  0,  0, 47, 48, 45, 46,  0, 44,  0,  0,
+   0,  0,  0,  0,  0, 50, 49,  0,  0,  0,  0, 63,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 81,  0,  0,  0,  0,  0,
+   0, 21,  0,  0,  0,  0,  0,  0,  0, 18,  0,  0,  0,  0,  0,  0,
+  96,  0,  0,  0,  0,  0,  0,  0,  0, 16,  0,  0, 54,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0, 76,  0,  0, 19,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0, 86,  0,  0,  0,  0,  0,  0,  0,
+   5, 29,  0,  0,  0,  0,  0,  0, 84,  0,  0,  0, 82,  0,  0,  0,
+  68,  0,  0,  0,  0,  0,  0,  0,  0, 13,  0,  0, 70, 89,  0,  0,
+   0, 91,  0,  0,  0,  9,  0,  0, 17,  0,  0, 88,  0,  0,  0, 85,
+   0,  0, 20,  0,  0,  0,  4, 10,  0,  0,  0,  0,  0,  0,  0, 92,
+   0,  0,  0,  0, 77, 87,  0,  0,  0,  0,  0,  0,  0,  0,  0, 33,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 79, 72, 12,  0, 66,
+   0,  0,  0,  0,  0,  0,  0,  0,  2, 14,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0, 11,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0, 64,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+  60,  0,  0,  0,  0,  0,  6,  0,  0,  0,  0,  0,  0,  0, 24,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 83,
+   0, 34,  0,  0,  0, 23,  0,  0,  0,  0, 56,  0,  0,  0, 61,  0,
+   0,  0,  7,  0,  0,  0,  0, 67,  0,  0, 52,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0, 74,  0,  0,  0,
+   0,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0, 27,  0,  0,  0,  0,  0,  0,  0, 22,  0,  0,
+  39, 38, 41, 40, 35, 80, 37, 36,  0,  0,  0,  0,  0, 28,  0,  0,
+   0, 58,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 43, 42, 30,  0
+};
+
+static const char * const html_attrs[][2] =
+{					/* Interned attribute names */
+  { "ALIGN", "align" },
+  { "ALINK", "alink" },
+  { "ALT", "alt" },
+  { "BACKGROUND", "background" },
+  { "BGCOLOR", "bgcolor" },
+  { "BORDER", "border" },
+  { "BORDERCOLOR", "bordercolor" },
+  { "BREAK", "break" },
+  { "CELLPADDING", "cellpadding" },
+  { "CELLSPACING", "cellspacing" },
+  { "CHARSET", "charset" },
+  { "CLASS", "class" },
+  { "CLEAR", "clear" },
+  { "COLOR", "color" },
+  { "COLSPAN", "colspan" },
+  { "CONTENT", "content" },
+  { "DIR", "dir" },
+  { "FACE", "face" },
+  { "HEIGHT", "height" },
+  { "HREF", "href" },
+  { "HSPACE", "hspace" },
+  { "HTTP-EQUIV", "http-equiv" },
+  { "ID", "id" },
+  { "LANG", "lang" },
+  { "LINK", "link" },
+  { "NAME", "name" },
+  { "NOWRAP", "nowrap" },
+  { "REALSRC", "realsrc" },
+  { "REL", "rel" },
+  { "ROWSPAN", "rowspan" },
+  { "SIZE", "size" },
+  { "SRC", "src" },
+  { "START", "start" },
+  { "STYLE", "style" },
+  { "SUMMARY", "summary" },
+  { "TEXT", "text" },
+  { "TITLE", "title" },
+  { "TYPE", "type" },
+  { "VALIGN", "valign" },
+  { "VALUE", "value" },
+  { "VLINK", "vlink" },
+  { "VSPACE", "vspace" },
+  { "WIDTH", "width" },
+  { "_HD_BASE", "_hd_base" },
+  { "_HD_FILENAME", "_hd_filename" },
+  { "_HD_FULL_HREF", "_hd_full_href" },
+  { "_HD_OMIT_TOC", "_hd_omit_toc" },
+  { "_HD_URL", "_hd_url" }
+};
+
+static const unsigned char html_attr_hash[512] =
+{					/* Attribute name to html_attrs[] index + 1 */
+   0,  0, 44,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 47,  0,  0,
+   0,  9,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 36,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   8,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0, 21,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0, 13,  0,  0,  0, 30, 29,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 10,  0,  0,  0,  0,  0,
+   6,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0, 42,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  0,  0,
+   0,  0,  0,  0,  0,  0,  0, 48,  0,  0,  0,  0,  0,  0,  0,  0,
+  38,  0,  4,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0, 39,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 14,  0,  0,  0,  0, 45,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0, 16,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0, 22,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  5,  0,  0,  0,  0,  0, 12,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 11,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 33,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 40,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0, 46,  0,  0,  0,  0,  0,  0,  0, 32,  0,  0,  0,  0,  0,
+  43,  0,  0,  0,  0,  0, 34,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  2, 18,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0, 27,  0,  0,  3,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0, 35,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+  41,  0,  0,  0,  0,  0, 28,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0, 20,  0,  0,  0,  0,  0,  0, 19,  0,
+   0,  0,  0, 37,  0,  0,  0,  0,  7,  0,  0,  0,  0, 23,  0,  0,
+   0,  0,  0, 24,  0,  0,  0,  0,  0,  0, 31,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 17, 25,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 26,  0,  0
+};
+
 
 /*
  * 'htmlReadFile()' - Read a file for HTML markup codes.
@@ -277,6 +534,42 @@ tree_t *				// O - Pointer to top of file tree
 htmlReadFile(tree_t     *parent,	// I - Parent tree entry
              FILE       *fp,		// I - File pointer
 	     const char *base)		// I - Base directory for file
+{
+  hdinput_t	in;			// Buffered input
+  tree_t	*tree;			// "top" of this tree
+
+
+  DEBUG_printf(("htmlReadFile(parent=%p, fp=%p, base=\"%s\")\n",
+                (void *)parent, (void *)fp, base ? base : "(null)"));
+
+  if (!open_input(&in, fp))
+  {
+#ifndef DEBUG
+    progress_error(HD_ERROR_OUT_OF_MEMORY,
+                   "Unable to allocate memory for HTML input buffer!");
+#endif /* !DEBUG */
+    return (NULL);
+  }
+
+  if (in.map && Threads != 1)
+    prefetch_html(in.ptr, in.end, base);
+
+  tree = read_html(parent, &in, base);
+
+  close_input(&in);
+
+  return (tree);
+}
+
+
+/*
+ * 'read_html()' - Read HTML markup codes from a buffered file.
+ */
+
+static tree_t *				// O - Pointer to top of file tree
+read_html(tree_t     *parent,		// I - Parent tree entry
+          hdinput_t  *in,		// I - Input file
+	  const char *base)		// I - Base directory for file
 {
   int		ch;			// Character from file
   uchar		*ptr,			// Pointer in string
@@ -297,23 +590,24 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 		*span;			// Value for SPAN tag
   int		sizeval;		// Size value from FONT tag
   int		linenum;		// Line number in file
+  tree_t	*spare;			// Node left over from a closing element
   static uchar	s[10240];		// String from file
   static int	have_whitespace = 0;	// Non-zero if there was leading whitespace
 
 
-  DEBUG_printf(("htmlReadFile(parent=%p, fp=%p, base=\"%s\")\n",
-                (void *)parent, (void *)fp, base ? base : "(null)"));
-
 #ifdef DEBUG
   indent[0] = '\0';
+
+  check_names();
 #endif // DEBUG
 
  /*
   * Start off with no previous tree entry...
   */
 
-  prev = NULL;
-  tree = NULL;
+  prev  = NULL;
+  tree  = NULL;
+  spare = NULL;
 
  /*
   * Parse data until we hit end-of-file...
@@ -321,7 +615,7 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 
   linenum = 1;
 
-  while ((ch = getc(fp)) != EOF)
+  while ((ch = html_getc(in)) != EOF)
   {
    /*
     * Ignore leading whitespace...
@@ -335,7 +629,7 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 	  linenum ++;
 
         have_whitespace = 1;
-        ch              = getc(fp);
+        ch              = html_getc(in);
       }
 
       if (ch == EOF)
@@ -343,11 +637,17 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
     }
 
    /*
-    * Allocate a new tree entry - use calloc() to get zeroed data...
+    * Allocate a new tree entry, reusing the node from the last closing
+    * element if there is one since arena memory is not reclaimed until the
+    * whole document is freed...
     */
 
-    t = (tree_t *)calloc(sizeof(tree_t), 1);
-    if (t == NULL)
+    if (spare)
+    {
+      t     = spare;
+      spare = NULL;
+    }
+    else if ((t = new_node(parent)) == NULL)
     {
 #ifndef DEBUG
       progress_error(HD_ERROR_OUT_OF_MEMORY,
@@ -398,7 +698,7 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
       * Markup char; grab the next char to see if this is a /...
       */
 
-      ch = getc(fp);
+      ch = html_getc(in);
 
       if (isspace(ch) || ch == '=' || ch == '<')
       {
@@ -425,14 +725,14 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 	if (ch == '=')
 	  *ptr++ = '=';
 	else if (ch == '<')
-	  ungetc(ch, fp);
+	  html_ungetc(ch, in);
 	else
 	  have_whitespace = 1;
 
 	*ptr++ = '\0';
 
 	t->markup = MARKUP_NONE;
-	t->data   = (uchar *)strdup((char *)s);
+	t->data   = copy_string(t, s);
       }
       else
       {
@@ -441,9 +741,9 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 	*/
 
 	if (ch != '/')
-          ungetc(ch, fp);
+          html_ungetc(ch, in);
 
-	if (parse_markup(t, fp, &linenum) == MARKUP_ERROR)
+	if (parse_markup(t, in, &linenum) == MARKUP_ERROR)
 	{
 #ifndef DEBUG
           progress_error(HD_ERROR_READ_ERROR,
@@ -658,7 +958,16 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
           if (ch == '/')
 	  {
 	    // Closing element, so delete this node...
-            delete_node(t);
+	    if (t->arena)
+	    {
+	      hd_arena_t *arena = t->arena;
+
+	      memset(t, 0, sizeof(tree_t));
+	      t->arena = arena;
+	      spare    = t;
+	    }
+	    else
+              delete_node(t);
 	    continue;
 	  }
 	  else
@@ -707,7 +1016,16 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 			  indent, _htmlMarkups[t->markup], linenum));
           }
 
-	  delete_node(t);
+	  if (t->arena)
+	  {
+	    hd_arena_t *arena = t->arena;
+
+	    memset(t, 0, sizeof(tree_t));
+	    t->arena = arena;
+	    spare    = t;
+	  }
+	  else
+	    delete_node(t);
 	  continue;
 	}
       }
@@ -726,7 +1044,7 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 	  // Possibly a character entity...
 	  eptr = entity;
 	  while (eptr < (entity + sizeof(entity) - 1) &&
-	         (ch = getc(fp)) != EOF)
+	         (ch = html_getc(in)) != EOF)
 	    if (!isalnum(ch) && ch != '#')
 	      break;
 	    else
@@ -734,7 +1052,7 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 
           if (ch != ';')
 	  {
-	    ungetc(ch, fp);
+	    html_ungetc(ch, in);
 	    ch = 0;
 	  }
 
@@ -768,7 +1086,7 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
         else if ((ch & 0x80) && _htmlUTF8)
         {
           // Collect UTF-8 value...
-          ch = utf8_getc(ch, fp);
+          ch = utf8_getc(ch, in);
 
           if (ch)
             *ptr++ = (uchar)ch;
@@ -782,18 +1100,27 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 	    linenum ++;
             break;
 	  }
+
+          // Copy any following run of plain text directly from the buffer...
+	  if (ch >= ' ' && ch < 0x7f)
+	  {
+	    while (in->ptr < in->end && ptr < (s + sizeof(s) - 1) &&
+	           *(in->ptr) >= ' ' && *(in->ptr) < 0x7f &&
+		   *(in->ptr) != '<' && *(in->ptr) != '&')
+	      *ptr++ = *(in->ptr)++;
+	  }
 	}
 
-        ch = getc(fp);
+        ch = html_getc(in);
       }
 
       *ptr = '\0';
 
       if (ch == '<')
-        ungetc(ch, fp);
+        html_ungetc(ch, in);
 
       t->markup = MARKUP_NONE;
-      t->data   = (uchar *)strdup((char *)s);
+      t->data   = copy_string(t, s);
 
       DEBUG_printf(("%sfragment \"%s\", line %d\n", indent, s, linenum));
     }
@@ -817,7 +1144,7 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 	  // Possibly a character entity...
 	  eptr = entity;
 	  while (eptr < (entity + sizeof(entity) - 1) &&
-	         (ch = getc(fp)) != EOF)
+	         (ch = html_getc(in)) != EOF)
 	    if (!isalnum(ch) && ch != '#')
 	      break;
 	    else
@@ -827,7 +1154,7 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 
           if (ch != ';')
 	  {
-	    ungetc(ch, fp);
+	    html_ungetc(ch, in);
 	    ch = 0;
 	  }
 
@@ -862,17 +1189,26 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
           if ((ch & 0x80) && _htmlUTF8)
           {
             // Collect UTF-8 value...
-            ch = utf8_getc(ch, fp);
+            ch = utf8_getc(ch, in);
           }
 
           if (ch)
             *ptr++ = (uchar)ch;
+
+          // Copy any following run of plain text directly from the buffer...
+	  if (ch > ' ' && ch < 0x7f)
+	  {
+	    while (in->ptr < in->end && ptr < (s + sizeof(s) - 1) &&
+	           *(in->ptr) > ' ' && *(in->ptr) < 0x7f &&
+		   *(in->ptr) != '<' && *(in->ptr) != '&')
+	      *ptr++ = *(in->ptr)++;
+	  }
         }
 
 	if ((_htmlUTF8 && ch == _htmlCharacters[173]) || (!_htmlUTF8 && ch == 173))
 	  break;
 
-        ch = getc(fp);
+        ch = html_getc(in);
       }
 
       if (ch == '\n')
@@ -884,10 +1220,10 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
       *ptr = '\0';
 
       if (ch == '<')
-        ungetc(ch, fp);
+        html_ungetc(ch, in);
 
       t->markup = MARKUP_NONE;
-      t->data   = (uchar *)strdup((char *)s);
+      t->data   = copy_string(t, s);
 
       DEBUG_printf(("%sfragment \"%s\" (len=%d), line %d\n", indent, s,
                     (int)(ptr - s), linenum));
@@ -1090,7 +1426,7 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
 	    filename = (uchar *)fix_filename((char *)filename,
 	                                     (char *)base);
 
-            if ((embed = fopen((char *)filename, "r")) != NULL)
+            if ((embed = file_open((char *)filename, "r")) != NULL)
             {
 	      strlcpy(newbase, file_directory((char *)filename), sizeof(newbase));
 
@@ -1456,10 +1792,10 @@ htmlReadFile(tree_t     *parent,	// I - Parent tree entry
       case MARKUP_TT :
       case MARKUP_CODE :
       case MARKUP_SAMP :
-          if (isspace(ch = getc(fp)))
+          if (isspace(ch = html_getc(in)))
 	    have_whitespace = 1;
 	  else
-	    ungetc(ch, fp);
+	    html_ungetc(ch, in);
 
           if (have_whitespace)
 	  {
@@ -1769,6 +2105,123 @@ htmlWriteFile(tree_t *parent,	/* I - Parent tree entry */
 }
 
 
+/*
+ * 'htmlLoadTree()' - Load the children of a node saved by htmlSaveTree().
+ *
+ * The loaded nodes are added to the end of the parent's children, with the
+ * font characteristics and sizes they had when they were saved.  On error
+ * any partially loaded nodes are removed again.
+ */
+
+int				/* O - 0 on success, -1 on error */
+htmlLoadTree(tree_t *parent,	/* I - Parent tree entry */
+             FILE   *fp)	/* I - File to read from */
+{
+  hdtree_header_t	header;	/* Saved tree header */
+  tree_t		*last;	/* Last child before loading */
+  uchar			*buffer;/* Node data */
+  const uchar		*ptr;	/* Pointer into node data */
+  int			status;	/* Load status */
+
+
+  if (parent == NULL)
+    return (-1);
+
+  if (fread(&header, sizeof(header), 1, fp) != 1 ||
+      memcmp(header.magic, "HDTR", 4) ||
+      header.byteorder != HD_METRICS_BYTEORDER ||
+      header.node_size != sizeof(hdtree_node_t))
+    return (-1);
+
+ /*
+  * Read all of the node data at once and then build the tree from it...
+  */
+
+  if ((buffer = (uchar *)malloc(header.length ? header.length : 1)) == NULL)
+    return (-1);
+
+  if (fread(buffer, 1, header.length, fp) != header.length)
+  {
+    free(buffer);
+    return (-1);
+  }
+
+  last   = parent->last_child;
+  ptr    = buffer;
+  status = load_tree(parent, header.num_children, &ptr, buffer + header.length);
+
+  free(buffer);
+
+  if (status)
+  {
+   /*
+    * Remove the nodes we added...
+    */
+
+    tree_t *first = last ? last->next : parent->child;
+
+    if (first)
+      htmlDeleteTree(first);
+
+    if (last)
+      last->next = NULL;
+    else
+      parent->child = NULL;
+
+    parent->last_child = last;
+  }
+
+  return (status);
+}
+
+
+/*
+ * 'htmlSaveTree()' - Save the children of a node in binary form.
+ *
+ * The saved tree uses the native byte order and is meant for caching on
+ * the same system - see htmlLoadTree().
+ */
+
+int				/* O - 0 on success, -1 on error */
+htmlSaveTree(tree_t *parent,	/* I - Parent tree entry */
+             FILE   *fp)	/* I - File to write to */
+{
+  hdtree_header_t	header;	/* Saved tree header */
+  tree_t		*t;	/* Current child */
+  long			start,	/* Start of header */
+			end;	/* End of node data */
+
+
+  if (parent == NULL || (start = ftell(fp)) < 0)
+    return (-1);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "HDTR", 4);
+  header.byteorder = HD_METRICS_BYTEORDER;
+  header.node_size = sizeof(hdtree_node_t);
+
+  for (t = parent->child; t; t = t->next)
+    header.num_children ++;
+
+ /*
+  * Write the header again once the length of the node data is known...
+  */
+
+  if (fwrite(&header, sizeof(header), 1, fp) != 1 || save_tree(parent, fp) ||
+      (end = ftell(fp)) < 0)
+    return (-1);
+
+  header.length = (unsigned)(end - start - (long)sizeof(header));
+
+  if (fseek(fp, start, SEEK_SET) ||
+      fwrite(&header, sizeof(header), 1, fp) != 1 ||
+      fseek(fp, end, SEEK_SET))
+    return (-1);
+
+  return (ferror(fp) ? -1 : 0);
+}
+
+
 /*
  * 'htmlAddTree()' - Add a tree node to the parent.
  */
@@ -1805,6 +2258,119 @@ htmlAddTree(tree_t   *parent,	/* I - Parent entry */
 }
 
 
+/*
+ * 'htmlCopyTree()' - Add a copy of a tree node to the parent.
+ *
+ * The copy keeps the formatting and size of the original node, so text is
+ * not measured again and images are not loaded again.  Child nodes are not
+ * copied.  Copies of top-level file nodes get their own arena as for
+ * htmlNewTree().
+ */
+
+tree_t *			/* O - New entry */
+htmlCopyTree(tree_t *parent,	/* I - Parent entry */
+             tree_t *t)		/* I - Node to copy */
+{
+  tree_t	*temp;		/* New tree entry */
+  int		i;		/* Looping var */
+  var_t		*var;		/* Current variable */
+
+
+  if (t == NULL)
+    return (NULL);
+
+  if (parent == NULL && t->markup == MARKUP_FILE)
+    temp = htmlNewTree(NULL, MARKUP_FILE, NULL);
+  else
+    temp = new_node(parent);
+
+  if (temp == NULL)
+    return (NULL);
+
+  temp->parent        = parent;
+  temp->markup        = t->markup;
+  temp->data          = copy_string(temp, t->data);
+  temp->link          = t->link;
+  temp->halignment    = t->halignment;
+  temp->valignment    = t->valignment;
+  temp->typeface      = t->typeface;
+  temp->size          = t->size;
+  temp->style         = t->style;
+  temp->underline     = t->underline;
+  temp->strikethrough = t->strikethrough;
+  temp->subscript     = t->subscript;
+  temp->superscript   = t->superscript;
+  temp->preformatted  = t->preformatted;
+  temp->indent        = t->indent;
+  temp->red           = t->red;
+  temp->green         = t->green;
+  temp->blue          = t->blue;
+  temp->width         = t->width;
+  temp->height        = t->height;
+
+  for (i = 0, var = t->vars; i < t->nvars; i ++, var ++)
+    htmlSetVariable(temp, var->name, var->value);
+
+ /*
+  * Add the tree entry to the end of the chain of children...
+  */
+
+  if (parent != NULL)
+  {
+    if (parent->last_child != NULL)
+    {
+      parent->last_child->next = temp;
+      temp->prev               = parent->last_child;
+    }
+    else
+      parent->child = temp;
+
+    parent->last_child = temp;
+  }
+
+  return (temp);
+}
+
+
+/*
+ * 'htmlCopyTrees()' - Copy a list of trees and all of their children.
+ *
+ * The exporters change links and image sources as they write, so each one
+ * needs its own copy of the document when several formats are generated
+ * from the same tree.
+ */
+
+tree_t *			/* O - First copied tree or NULL on error */
+htmlCopyTrees(tree_t *t)	/* I - First tree to copy */
+{
+  tree_t	*first,		/* First copied tree */
+		*last,		/* Last copied tree */
+		*temp;		/* Copy of current tree */
+
+
+  for (first = last = NULL; t != NULL; t = t->next)
+  {
+    if ((temp = copy_children(NULL, t)) == NULL)
+    {
+      htmlDeleteTree(first);
+      return (NULL);
+    }
+
+    if (last)
+    {
+      last->next = temp;
+      temp->prev = last;
+    }
+    else
+      first = temp;
+
+    last = temp;
+  }
+
+  return (first);
+}
+
+
 /*
  * 'htmlDeleteTree()' - Free all memory associated with a tree...
  */
@@ -1899,7 +2465,8 @@ htmlMapUnicode(int ch)		/* I - Unicode character */
 
   for (int i = 0; i < TYPE_MAX; i ++)
     for (int j = 0; j < STYLE_MAX; j ++)
-      _htmlWidths[i][j][newch] = _htmlWidthsAll[i][j][ch];
+      if (_htmlWidthsLoaded[i][j])
+        _htmlWidths[i][j][newch] = htmlGetUnicodeWidth(i, j, ch);
 
   return (newch);
 }
@@ -1918,11 +2485,27 @@ htmlNewTree(tree_t   *parent,	/* I - Parent entry */
 
 
  /*
-  * Allocate a new tree entry - use calloc() to get zeroed data...
+  * Allocate a new tree entry - top-level file nodes get an arena of their
+  * own that holds the nodes and strings of the whole file...
   */
 
-  t = (tree_t *)calloc(sizeof(tree_t), 1);
-  if (t == NULL)
+  if (parent == NULL && markup == MARKUP_FILE)
+  {
+    hd_arena_t	*arena;		/* New arena */
+
+    if ((arena = hd_arena_new(0)) == NULL)
+      return (NULL);
+
+    if ((t = (tree_t *)hd_arena_alloc(arena, sizeof(tree_t))) == NULL)
+    {
+      hd_arena_delete(arena);
+      return (NULL);
+    }
+
+    t->arena       = arena;
+    t->arena_owner = 1;
+  }
+  else if ((t = new_node(parent)) == NULL)
     return (NULL);
 
  /*
@@ -1931,7 +2514,7 @@ htmlNewTree(tree_t   *parent,	/* I - Parent entry */
 
   t->markup = markup;
   if (data != NULL)
-    t->data = (uchar *)strdup((char *)data);
+    t->data = copy_string(t, data);
 
  /*
   * Set/copy font characteristics...
@@ -2242,6 +2825,72 @@ htmlGetStyle(tree_t *t,		// I - Node
 }
 
 
+/*
+ * 'htmlGetTextWidth()' - Get the width of a string in a font.
+ *
+ * The widths are summed into four separate totals so that the table
+ * lookups for several characters can be done at the same time.
+ */
+
+int					/* O - Width in 1/1000ths of the font size */
+htmlGetTextWidth(const uchar *s,	/* I - String */
+                 int         typeface,	/* I - Typeface */
+                 int         style)	/* I - Style */
+{
+  const short	*widths;		/* Character widths */
+  size_t	len;			/* Characters left */
+  int		w0, w1, w2, w3;		/* Partial widths */
+
+
+  if (s == NULL)
+    return (0);
+
+  if (!_htmlWidthsLoaded[typeface][style])
+    htmlLoadFontWidths(typeface, style);
+
+  widths = _htmlWidths[typeface][style];
+
+  for (len = strlen((const char *)s), w0 = w1 = w2 = w3 = 0; len >= 4; len -= 4, s += 4)
+  {
+    w0 += widths[s[0]];
+    w1 += widths[s[1]];
+    w2 += widths[s[2]];
+    w3 += widths[s[3]];
+  }
+
+  for (; len > 0; len --, s ++)
+    w0 += widths[*s];
+
+  return (w0 + w1 + w2 + w3);
+}
+
+
+/*
+ * 'htmlGetUnicodeWidth()' - Get the width of a Unicode character in a font.
+ *
+ * Widths are kept in pages of 256 characters that are filled the first time
+ * a character in the page is used.
+ */
+
+short					/* O - Width in 1/1000ths of the font size */
+htmlGetUnicodeWidth(int typeface,	/* I - Typeface */
+                    int style,		/* I - Style */
+		    int unicode)	/* I - Unicode character */
+{
+  short	*page;				/* Page of widths */
+
+
+  if (unicode < 0 || unicode > 0xffff)
+    return (600);
+
+  if ((page = width_pages[typeface][style][unicode >> 8]) == NULL &&
+      (page = fill_width_page(typeface, style, unicode >> 8)) == NULL)
+    return (600);
+
+  return (page[unicode & 255]);
+}
+
+
 /*
  * 'htmlGetVariable()' - Get a variable value from a markup entry.
  */
@@ -2250,17 +2899,13 @@ uchar *				/* O - Value or NULL if variable does not exist */
 htmlGetVariable(tree_t *t,	/* I - Tree entry */
                 uchar  *name)	/* I - Variable name */
 {
-  var_t	*v,			/* Matching variable */
-	key;			/* Search key */
+  var_t	*v;			/* Matching variable */
 
 
   if (t == NULL || name == NULL || t->nvars == 0)
     return (NULL);
 
-  key.name = name;
-
-  v = (var_t *)bsearch(&key, t->vars, (size_t)t->nvars, sizeof(var_t), (compare_func_t)compare_variables);
-  if (v == NULL)
+  if ((v = find_variable(t, name)) == NULL)
     return (NULL);
   else if (v->value == NULL)
     return ((uchar *)"");
@@ -2276,93 +2921,60 @@ htmlGetVariable(tree_t *t,	/* I - Tree entry */
 void
 htmlLoadFontWidths(int typeface, int style)
 {
-  char		filename[1024];		/* Filenames */
-  FILE		*fp;			/* Files */
   int		ch;			/* Character */
-  float		width;			/* Width value */
-  char		glyph[64];		/* Glyph name */
-  char		line[1024];		/* Line from AFM file */
+  int		width;			/* Width value */
+  unsigned	i;			/* Looping var */
+  hdmetrics_t	*m;			/* Font metrics */
 
 
  /*
-  * Now read all of the font widths...
+  * Unicode widths are looked up again as they are needed, since the glyph
+  * names may have changed with the character set...
   */
 
   for (ch = 0; ch < 256; ch ++)
-    _htmlWidths[typeface][style][ch] = 600;
-
-  if (_htmlUTF8)
   {
-    for (ch = 0; ch < 65536; ch ++)
-      _htmlWidthsAll[typeface][style][ch] = 600;
+    free(width_pages[typeface][style][ch]);
+    width_pages[typeface][style][ch] = NULL;
   }
 
-  snprintf(filename, sizeof(filename), "%s/fonts/%s.afm", _htmlData, _htmlFonts[typeface][style]);
-  if ((fp = fopen(filename, "r")) == NULL)
-  {
-#ifndef DEBUG
-    progress_error(HD_ERROR_FILE_NOT_FOUND, "Unable to open font width file %s!", filename);
-#endif /* !DEBUG */
+ /*
+  * Now set all of the font widths...
+  */
+
+  for (ch = 0; ch < 256; ch ++)
+    _htmlWidths[typeface][style][ch] = 600;
+
+  if ((m = load_metrics(typeface, style)) == NULL)
     return;
-  }
 
-  while (fgets(line, sizeof(line), fp) != NULL)
+  if (typeface < TYPE_SYMBOL)
   {
-    if (strncmp(line, "C ", 2) != 0)
-      continue;
+   /*
+    * Handle encoding of regular fonts using assigned charset.  Every code
+    * gets the width of its glyph, including codes that share a glyph name
+    * with another code...
+    */
 
-    if (typeface < TYPE_SYMBOL)
+    for (ch = 0; ch < 256; ch ++)
+      if (_htmlGlyphs[ch] && (width = find_glyph_width(m, _htmlGlyphs[ch])) >= 0)
+        _htmlWidths[typeface][style][ch] = (short)width;
+  }
+  else
+  {
+   /*
+    * Symbol and Dingbats fonts uses their own encoding...
+    */
+
+    for (i = 0; i < m->header->num_glyphs; i ++)
     {
-     /*
-      * Handle encoding of regular fonts using assigned charset...
-      */
-
-      if (sscanf(line, "%*s%*s%*s%*s%f%*s%*s%63s", &width, glyph) != 2)
-	continue;
-
-      for (ch = 0; ch < 256; ch ++)
-      {
-	if (_htmlGlyphs[ch] && !strcmp(_htmlGlyphs[ch], glyph))
-	{
-	  _htmlWidths[typeface][style][ch] = (short)width;
-	  break;
-	}
-      }
-
-      if (_htmlUTF8)
-      {
-	for (ch = 0; ch < 65536; ch ++)
-	{
-	  if (_htmlGlyphsAll[ch] && !strcmp(_htmlGlyphsAll[ch], glyph))
-	  {
-	    _htmlWidthsAll[typeface][style][ch] = (short)width;
-	    break;
-	  }
-	}
-      }
-    }
-    else
-    {
-     /*
-      * Symbol and Dingbats fonts uses their own encoding...
-      */
-
-      if (sscanf(line, "%*s%d%*s%*s%f", &ch, &width) != 2)
-	continue;
-
-      if (ch < 256 && ch >= 0)
-      {
-	_htmlWidths[typeface][style][ch]    = (short)width;
-	_htmlWidthsAll[typeface][style][ch] = (short)width;
-      }
-    }
-  }
-
-  fclose(fp);
+      if ((ch = m->glyphs[i].code) < 256 && ch >= 0)
+	_htmlWidths[typeface][style][ch] = m->glyphs[i].width;
+    }
+  }
 
   // Make sure that non-breaking space has the same width as a breaking space...
-  _htmlWidths[typeface][style][160]    = _htmlWidths[typeface][style][32];
-  _htmlWidthsAll[typeface][style][160] = _htmlWidthsAll[typeface][style][32];
+  _htmlWidths[typeface][style][160] = _htmlWidths[typeface][style][32];
 
   _htmlWidthsLoaded[typeface][style] = 1;
 }
@@ -2377,8 +2989,8 @@ htmlSetVariable(tree_t *t,	/* I - Tree entry */
                 uchar  *name,	/* I - Variable name */
                 uchar  *value)	/* I - Variable value */
 {
-  var_t	*v,			/* Matching variable */
-	key;			/* Search key */
+  var_t	*v;			/* Matching variable */
+  int	i;			/* Insertion point */
 
 
   DEBUG_printf(("%shtmlSetVariable(%p, \"%s\", \"%s\")\n", indent, (void *)t, name,
@@ -2387,52 +2999,72 @@ htmlSetVariable(tree_t *t,	/* I - Tree entry */
   if (t->nvars == 0)
     v = NULL;
   else
-  {
-    key.name = name;
-
-    v = (var_t *)bsearch(&key, t->vars, (size_t)t->nvars, sizeof(var_t), (compare_func_t)compare_variables);
-  }
+    v = find_variable(t, name);
 
   if (v == NULL)
   {
-    if (t->nvars == 0)
-      v = (var_t *)malloc(sizeof(var_t));
-    else
-      v = (var_t *)realloc(t->vars, sizeof(var_t) * (size_t)(t->nvars + 1));
-
-    if (v == NULL)
+    if (t->vars == NULL)
     {
-      DEBUG_printf(("%s==== MALLOC/REALLOC FAILED! ====\n", indent));
+      // The first few variables are stored in the node itself...
+      t->vars = t->ivars;
+    }
+    else if (t->nvars >= (t->vars == t->ivars ? HD_INLINE_VARS : t->avars))
+    {
+      // Out of room, so grow the array by doubling it...
+      int avars = 2 * t->nvars;		// New size of array
 
-      return (-1);
+      if (t->arena || t->vars == t->ivars)
+      {
+        // Arena memory cannot be resized, so copy to a larger array...
+        if (t->arena)
+          v = (var_t *)hd_arena_alloc(t->arena, sizeof(var_t) * (size_t)avars);
+	else
+          v = (var_t *)malloc(sizeof(var_t) * (size_t)avars);
+
+        if (v != NULL)
+          memcpy(v, t->vars, sizeof(var_t) * (size_t)t->nvars);
+      }
+      else
+        v = (var_t *)realloc(t->vars, sizeof(var_t) * (size_t)avars);
+
+      if (v == NULL)
+      {
+        DEBUG_printf(("%s==== MALLOC/REALLOC FAILED! ====\n", indent));
+
+        return (-1);
+      }
+
+      t->vars  = v;
+      t->avars = avars;
     }
 
-    t->vars  = v;
-    v        += t->nvars;
+    // Keep the variables sorted by name...
+    for (i = 0; i < t->nvars; i ++)
+      if (strcasecmp((char *)t->vars[i].name, (char *)name) > 0)
+        break;
+
+    v = t->vars + i;
+
+    if (i < t->nvars)
+      memmove(v + 1, v, sizeof(var_t) * (size_t)(t->nvars - i));
+
     t->nvars ++;
-    v->name  = (uchar *)strdup((char *)name);
-    if (value != NULL)
-      v->value = (uchar *)strdup((char *)value);
-    else
-      v->value = NULL;
+    if ((v->name = intern_name(name)) == NULL)
+      v->name = copy_string(t, name);
+    v->value = copy_string(t, value);
 
     if (strcasecmp((char *)name, "HREF") == 0)
     {
       DEBUG_printf(("%s---- Set link to %s ----\n", indent, value));
       t->link = t;
     }
-
-    if (t->nvars > 1)
-      qsort(t->vars, (size_t)t->nvars, sizeof(var_t), (compare_func_t)compare_variables);
   }
   else if (v->value != value)
   {
-    if (v->value != NULL)
+    if (v->value != NULL && !t->arena)
       free(v->value);
-    if (value != NULL)
-      v->value = (uchar *)strdup((char *)value);
-    else
-      v->value = NULL;
+
+    v->value = copy_string(t, value);
   }
 
   return (0);
@@ -2596,6 +3228,18 @@ htmlSetTextColor(uchar *color)	/* I - Text color */
 }
 
 
+/*
+ * 'compare_glyphs()' - Compare two glyphs from an AFM file by name.
+ */
+
+static int			/* O - -1 if g0 < g1, 0 if g0 == g1, 1 if g0 > g1 */
+compare_glyphs(hdafm_glyph_t *g0,	/* I - First glyph */
+               hdafm_glyph_t *g1)	/* I - Second glyph */
+{
+  return (strcmp(g0->name, g1->name));
+}
+
+
 /*
  * 'compare_variables()' - Compare two markup variables.
  */
@@ -2609,18 +3253,456 @@ compare_variables(var_t *v0,	/* I - First variable */
 
 
 /*
- * 'compare_markups()' - Compare two markup strings...
+ * 'find_variable()' - Find a variable in a markup entry.
+ *
+ * Most elements have only a handful of variables, so a linear search is used
+ * for short arrays and a binary search for longer ones.
+ */
+
+static var_t *				/* O - Matching variable or NULL */
+find_variable(tree_t      *t,		/* I - Tree entry */
+              const uchar *name)	/* I - Variable name */
+{
+  var_t	*v,				/* Current variable */
+	key;				/* Search key */
+  int	i;				/* Looping var */
+
+
+  if (t->nvars <= 8)
+  {
+    for (i = t->nvars, v = t->vars; i > 0; i --, v ++)
+      if (!strcasecmp((char *)v->name, (const char *)name))
+        return (v);
+
+    return (NULL);
+  }
+
+  key.name = (uchar *)name;
+
+  return ((var_t *)bsearch(&key, t->vars, (size_t)t->nvars, sizeof(var_t), (compare_func_t)compare_variables));
+}
+
+
+#ifdef DEBUG
+/*
+ * 'check_names()' - Verify that every element and interned attribute name is
+ *                   found through the hash tables.
+ *
+ * Failures mean that html_markup_hash[] or html_attr_hash[] are out of date
+ * and mkhash.py needs to be run.
  */
 
-static int			/* O - -1 if m0 < m1, 0 if m0 == m1, 1 if m0 > m1 */
-compare_markups(uchar **m0,	/* I - First markup */
-                uchar **m1)	/* I - Second markup */
+static void
+check_names(void)
 {
-  if (tolower((*m0)[0]) == 'h' && isdigit((*m0)[1]) &&
-      tolower((*m1)[0]) == 'h' && isdigit((*m1)[1]))
-    return (atoi((char *)*m0 + 1) - atoi((char *)*m1 + 1));
+  int		i, j;			/* Looping vars */
+  uchar		name[255];		/* Name with mixed case */
+  static int	checked = 0;		/* Already checked? */
+
+
+  if (checked)
+    return;
+
+  checked = 1;
+
+  for (i = 1; i < (int)(sizeof(_htmlMarkups) / sizeof(_htmlMarkups[0])); i ++)
+  {
+    strlcpy((char *)name, _htmlMarkups[i], sizeof(name));
+    if (name[0])
+      name[0] = (uchar)toupper(name[0]);
+
+    if (lookup_markup((const uchar *)_htmlMarkups[i]) != (markup_t)i ||
+        lookup_markup(name) != (markup_t)i)
+    {
+      fprintf(stderr, "check_names: Element \"%s\" not found, run mkhash.py.\n",
+              _htmlMarkups[i]);
+      abort();
+    }
+  }
+
+  for (i = 0; i < (int)(sizeof(html_attrs) / sizeof(html_attrs[0])); i ++)
+    for (j = 0; j < 2; j ++)
+      if (intern_name((const uchar *)html_attrs[i][j]) != (const uchar *)html_attrs[i][j])
+      {
+	fprintf(stderr, "check_names: Attribute \"%s\" not interned, run mkhash.py.\n",
+		html_attrs[i][j]);
+	abort();
+      }
+
+  DEBUG_printf(("check_names: %d elements and %d attributes OK\n",
+                (int)(sizeof(_htmlMarkups) / sizeof(_htmlMarkups[0])) - 1,
+                (int)(sizeof(html_attrs) / sizeof(html_attrs[0]))));
+}
+#endif /* DEBUG */
+
+
+/*
+ * 'hash_name()' - Compute the case-insensitive hash of an element or
+ *                 attribute name.
+ *
+ * The multiplier and shifts were chosen so that every element name and every
+ * interned attribute name lands in its own slot of the 512-entry tables.
+ */
+
+static unsigned				/* O - Hash value from 0 to 511 */
+hash_name(const uchar *s,		/* I - Name */
+          int         shift)		/* I - Shift for final mixing */
+{
+  unsigned	h;			/* Hash value */
+
+
+  for (h = 0; *s; s ++)
+    h = h * 275 + (unsigned)tolower(*s);
+
+  return ((h ^ (h >> shift)) & 511);
+}
+
+
+/*
+ * 'intern_name()' - Find the shared copy of a common attribute name.
+ *
+ * Only the all-uppercase and all-lowercase spellings are interned so that the
+ * original case is preserved when the markup is written back out.
+ */
+
+static uchar *				/* O - Shared name or NULL */
+intern_name(const uchar *name)		/* I - Attribute name */
+{
+  int		i;			/* Index into html_attrs[] */
+
+
+  if ((i = html_attr_hash[hash_name(name, 7)]) == 0)
+    return (NULL);
+
+  if (!strcmp((const char *)name, html_attrs[i - 1][0]))
+    return ((uchar *)html_attrs[i - 1][0]);
+  else if (!strcmp((const char *)name, html_attrs[i - 1][1]))
+    return ((uchar *)html_attrs[i - 1][1]);
+  else
+    return (NULL);
+}
+
+
+/*
+ * 'lookup_markup()' - Find the markup_t value for an element name.
+ */
+
+static markup_t				/* O - Markup or MARKUP_UNKNOWN */
+lookup_markup(const uchar *name)	/* I - Element name */
+{
+  int		i;			/* Index into _htmlMarkups[] */
+
+
+  if (!*name)
+    return (MARKUP_NONE);
+
+  if ((i = html_markup_hash[hash_name(name, 11)]) != 0 &&
+      !strcasecmp((const char *)name, _htmlMarkups[i]))
+    return ((markup_t)i);
+  else
+    return (MARKUP_UNKNOWN);
+}
+
+
+/*
+ * 'copy_children()' - Add a copy of a node and all of its children to the
+ *                     parent.
+ */
+
+static tree_t *			/* O - New entry or NULL on error */
+copy_children(tree_t *parent,	/* I - Parent entry */
+              tree_t *t)	/* I - Node to copy */
+{
+  tree_t	*temp,		/* New tree entry */
+		*child,		/* Current child */
+		*orig,		/* Ancestor of the original node */
+		*copy;		/* Ancestor of the new node */
+
+
+  if ((temp = htmlCopyTree(parent, t)) == NULL)
+    return (NULL);
+
+ /*
+  * Links point to the node itself or one of its parents, so point the copy
+  * at the matching parent of the new tree...
+  */
+
+  if (t->link)
+  {
+    for (orig = t, copy = temp; orig && copy && orig != t->link; orig = orig->parent, copy = copy->parent);
+
+    if (orig && copy)
+      temp->link = copy;
+  }
+
+ /*
+  * Copy the children, freeing a partial top-level copy on error...
+  */
+
+  for (child = t->child; child != NULL; child = child->next)
+    if (copy_children(temp, child) == NULL)
+    {
+      if (parent == NULL)
+        htmlDeleteTree(temp);
+
+      return (NULL);
+    }
+
+  return (temp);
+}
+
+
+/*
+ * 'copy_string()' - Copy a string for a node.
+ */
+
+static uchar *			/* O - New string or NULL */
+copy_string(tree_t      *t,	/* I - Node that will own the string */
+            const uchar *s)	/* I - String to copy */
+{
+  if (s == NULL)
+    return (NULL);
+  else if (t->arena)
+    return ((uchar *)hd_arena_strdup(t->arena, (const char *)s));
   else
-    return (strcasecmp((char *)*m0, (char *)*m1));
+    return ((uchar *)strdup((const char *)s));
+}
+
+
+/*
+ * 'load_string()' - Load a string saved by save_tree().
+ */
+
+static const uchar *			/* O  - String or NULL on error */
+load_string(const uchar **ptr,		/* IO - Pointer into node data */
+            const uchar *end,		/* I  - End of node data */
+            unsigned    length)		/* I  - Length of string + 1 */
+{
+  const uchar	*s = *ptr;		/* String */
+
+
+  if (length == 0 || length > (size_t)(end - s) || s[length - 1])
+    return (NULL);
+
+  *ptr += length;
+
+  return (s);
+}
+
+
+/*
+ * 'load_tree()' - Load saved nodes under a parent.
+ */
+
+static int				/* O  - 0 on success, -1 on error */
+load_tree(tree_t      *parent,		/* I  - Parent node */
+          unsigned    num_children,	/* I  - Number of nodes to load */
+          const uchar **ptr,		/* IO - Pointer into node data */
+	  const uchar *end)		/* I  - End of node data */
+{
+  unsigned	i, j;			/* Looping vars */
+  hdtree_node_t	node;			/* Saved node */
+  tree_t	*t,			/* New node */
+		*link;			/* Linked-to node */
+  var_t		*v;			/* Current variable */
+  const uchar	*name,			/* Variable name */
+		*value;			/* Text or variable value */
+  unsigned	lengths[2];		/* Name and value lengths */
+
+
+  for (i = 0; i < num_children; i ++)
+  {
+    if ((size_t)(end - *ptr) < sizeof(node))
+      return (-1);
+
+    memcpy(&node, *ptr, sizeof(node));
+    *ptr += sizeof(node);
+
+    if (node.markup < MARKUP_FILE || node.markup > MARKUP_WBR)
+      return (-1);
+
+    if ((t = new_node(parent)) == NULL)
+      return (-1);
+
+    t->markup        = (markup_t)node.markup;
+    t->halignment    = node.flags & 3;
+    t->valignment    = (node.flags >> 2) & 3;
+    t->typeface      = (node.flags >> 4) & 7;
+    t->size          = (node.flags >> 7) & 7;
+    t->style         = (node.flags >> 10) & 3;
+    t->underline     = (node.flags >> 12) & 1;
+    t->strikethrough = (node.flags >> 13) & 1;
+    t->subscript     = (node.flags >> 14) & 1;
+    t->superscript   = (node.flags >> 15) & 1;
+    t->preformatted  = (node.flags >> 16) & 1;
+    t->indent        = (node.flags >> 17) & 15;
+    t->red           = node.red;
+    t->green         = node.green;
+    t->blue          = node.blue;
+    t->width         = node.width;
+    t->height        = node.height;
+    t->parent        = parent;
+
+    if (parent->last_child)
+    {
+      parent->last_child->next = t;
+      t->prev                  = parent->last_child;
+    }
+    else
+      parent->child = t;
+
+    parent->last_child = t;
+
+    if (node.data_length)
+    {
+      if ((value = load_string(ptr, end, node.data_length)) == NULL)
+        return (-1);
+
+      t->data = copy_string(t, value);
+    }
+
+    if (node.num_vars)
+    {
+     /*
+      * The variables were saved in sorted order, so just copy them...
+      */
+
+      if (node.num_vars <= HD_INLINE_VARS)
+        t->vars = t->ivars;
+      else
+      {
+        if (t->arena)
+	  t->vars = (var_t *)hd_arena_alloc(t->arena, node.num_vars * sizeof(var_t));
+	else
+	  t->vars = (var_t *)calloc(node.num_vars, sizeof(var_t));
+
+        if (!t->vars)
+	  return (-1);
+
+        t->avars = node.num_vars;
+      }
+
+      for (j = 0, v = t->vars; j < node.num_vars; j ++, v ++)
+      {
+	if ((size_t)(end - *ptr) < sizeof(lengths))
+	  return (-1);
+
+	memcpy(lengths, *ptr, sizeof(lengths));
+	*ptr += sizeof(lengths);
+
+	if ((name = load_string(ptr, end, lengths[0])) == NULL)
+	  return (-1);
+
+	if (!lengths[1])
+	  value = NULL;
+	else if ((value = load_string(ptr, end, lengths[1])) == NULL)
+	  return (-1);
+
+	if ((v->name = intern_name(name)) == NULL)
+	  v->name = copy_string(t, name);
+
+	v->value = copy_string(t, value);
+	t->nvars ++;
+      }
+    }
+
+    if (node.link != HD_TREE_NO_LINK)
+    {
+      for (link = t, j = 0; link && j < node.link; j ++)
+        link = link->parent;
+
+      if (!link)
+        return (-1);
+
+      t->link = link;
+    }
+
+    if (load_tree(t, node.num_children, ptr, end))
+      return (-1);
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'save_tree()' - Save the children of a node.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+save_tree(tree_t *parent,		/* I - Parent node */
+          FILE   *fp)			/* I - File to write to */
+{
+  tree_t	*t,			/* Current node */
+		*temp;			/* Linked-to or child node */
+  hdtree_node_t	node;			/* Saved node */
+  int		i;			/* Looping var */
+  unsigned	lengths[2];		/* Name and value lengths */
+
+
+  for (t = parent->child; t; t = t->next)
+  {
+    memset(&node, 0, sizeof(node));
+
+    node.markup   = (short)t->markup;
+    node.num_vars = (unsigned short)t->nvars;
+    node.flags    = t->halignment | (t->valignment << 2) | (t->typeface << 4) |
+                    (t->size << 7) | (t->style << 10) | (t->underline << 12) |
+		    (t->strikethrough << 13) | (t->subscript << 14) |
+		    (t->superscript << 15) | (t->preformatted << 16) |
+		    (t->indent << 17);
+    node.red      = t->red;
+    node.green    = t->green;
+    node.blue     = t->blue;
+    node.link     = HD_TREE_NO_LINK;
+    node.width    = t->width;
+    node.height   = t->height;
+
+    if (t->link)
+    {
+     /*
+      * Links point at the node itself or one of its parents...
+      */
+
+      for (temp = t, i = 0; temp && temp != t->link && i < HD_TREE_NO_LINK; temp = temp->parent, i ++);
+
+      if (temp != t->link)
+        return (-1);
+
+      node.link = (uchar)i;
+    }
+
+    if (t->nvars > 65535)
+      return (-1);
+
+    if (t->data)
+      node.data_length = (unsigned)strlen((char *)t->data) + 1;
+
+    for (temp = t->child; temp; temp = temp->next)
+      node.num_children ++;
+
+    if (fwrite(&node, sizeof(node), 1, fp) != 1)
+      return (-1);
+
+    if (t->data && fwrite(t->data, 1, node.data_length, fp) != node.data_length)
+      return (-1);
+
+    for (i = 0; i < t->nvars; i ++)
+    {
+      lengths[0] = (unsigned)strlen((char *)t->vars[i].name) + 1;
+      lengths[1] = t->vars[i].value ? (unsigned)strlen((char *)t->vars[i].value) + 1 : 0;
+
+      if (fwrite(lengths, sizeof(lengths), 1, fp) != 1 ||
+          fwrite(t->vars[i].name, 1, lengths[0], fp) != lengths[0] ||
+	  (lengths[1] && fwrite(t->vars[i].value, 1, lengths[1], fp) != lengths[1]))
+        return (-1);
+    }
+
+    if (save_tree(t, fp))
+      return (-1);
+  }
+
+  return (0);
 }
 
 
@@ -2638,17 +3720,31 @@ delete_node(tree_t *t)		/* I - Node to delete */
   if (t == NULL)
     return;
 
+  if (t->arena)
+  {
+   /*
+    * Arena nodes are freed all at once with the node that owns the arena,
+    * which htmlDeleteTree() always deletes after its children...
+    */
+
+    if (t->arena_owner)
+      hd_arena_delete(t->arena);
+
+    return;
+  }
+
   if (t->data != NULL)
     free(t->data);
 
   for (i = t->nvars, var = t->vars; i > 0; i --, var ++)
   {
-    free(var->name);
+    if (var->name != intern_name(var->name))
+      free(var->name);
     if (var->value != NULL)
       free(var->value);
   }
 
-  if (t->vars != NULL)
+  if (t->vars != NULL && t->vars != t->ivars)
     free(t->vars);
 
   free(t);
@@ -2668,7 +3764,7 @@ insert_space(tree_t *parent,	// I - Parent node
 
 
   // Allocate memory for the whitespace...
-  space = (tree_t *)calloc(sizeof(tree_t), 1);
+  space = new_node(parent);
   if (space == NULL)
   {
 #ifndef DEBUG
@@ -2693,7 +3789,7 @@ insert_space(tree_t *parent,	// I - Parent node
 
   // Initialize element data...
   space->markup = MARKUP_NONE;
-  space->data   = (uchar *)strdup(" ");
+  space->data   = copy_string(space, (uchar *)" ");
 
   // Set tree pointers...
   space->parent = parent;
@@ -2711,32 +3807,53 @@ insert_space(tree_t *parent,	// I - Parent node
 }
 
 
+/*
+ * 'new_node()' - Allocate a zeroed node from the parent's arena or the heap.
+ */
+
+static tree_t *			/* O - New node or NULL */
+new_node(tree_t *parent)	/* I - Parent node or NULL */
+{
+  tree_t	*t;		/* New node */
+
+
+  if (parent && parent->arena)
+  {
+    if ((t = (tree_t *)hd_arena_alloc(parent->arena, sizeof(tree_t))) != NULL)
+      t->arena = parent->arena;
+  }
+  else
+    t = (tree_t *)calloc(sizeof(tree_t), 1);
+
+  return (t);
+}
+
+
 /*
  * 'parse_markup()' - Parse a markup string.
  */
 
 static int			/* O - -1 on error, MARKUP_nnnn otherwise */
-parse_markup(tree_t *t,		/* I - Current tree entry */
-             FILE   *fp,	/* I - Input file */
-	     int    *linenum)	/* O - Current line number */
+parse_markup(tree_t    *t,	/* I - Current tree entry */
+             hdinput_t *in,	/* I - Input file */
+	     int       *linenum)	/* O - Current line number */
 {
   int	ch, ch2;		/* Characters from file */
   uchar	markup[255],		/* Markup string... */
 	*mptr,			/* Current character... */
 	comment[10240],		/* Comment string */
-	*cptr,			/* Current char... */
-	**temp;			/* Markup variable entry */
+	*cptr;			/* Current char... */
 
 
   mptr = markup;
 
-  while ((ch = getc(fp)) != EOF && mptr < (markup + sizeof(markup) - 1))
+  while ((ch = html_getc(in)) != EOF && mptr < (markup + sizeof(markup) - 1))
     if (ch == '>' || isspace(ch))
       break;
     else if (ch == '/' && mptr > markup)
     {
       // Look for "/>"...
-      ch = getc(fp);
+      ch = html_getc(in);
 
       if (ch != '>')
         return (MARKUP_ERROR);
@@ -2748,7 +3865,7 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
       if ((ch & 0x80) && _htmlUTF8)
       {
         // Collect UTF-8 value...
-        ch = utf8_getc(ch, fp);
+        ch = utf8_getc(ch, in);
       }
 
       if (ch)
@@ -2757,7 +3874,7 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
       // Handle comments without whitespace...
       if ((mptr - markup) == 3 && strncmp((const char *)markup, "!--", 3) == 0)
       {
-        ch = getc(fp);
+        ch = html_getc(in);
         break;
       }
     }
@@ -2767,19 +3884,12 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
   if (ch == EOF)
     return (MARKUP_ERROR);
 
-  mptr = markup;
-  temp = (uchar **)bsearch(&mptr, _htmlMarkups,
-                           sizeof(_htmlMarkups) / sizeof(_htmlMarkups[0]),
-                           sizeof(_htmlMarkups[0]),
-                           (compare_func_t)compare_markups);
-
-  if (temp == NULL)
+  if ((t->markup = lookup_markup(markup)) == MARKUP_UNKNOWN)
   {
    /*
     * Unrecognized markup stuff...
     */
 
-    t->markup = MARKUP_UNKNOWN;
     strlcpy((char *)comment, (char *)markup, sizeof(comment));
     cptr = comment + strlen((char *)comment);
 
@@ -2787,8 +3897,7 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
   }
   else
   {
-    t->markup = (markup_t)((const char **)temp - _htmlMarkups);
-    cptr      = comment;
+    cptr = comment;
 
     DEBUG_printf(("%s%s, line %d\n", indent, markup, *linenum));
   }
@@ -2799,7 +3908,7 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
 
     while (ch != EOF && cptr < (comment + sizeof(comment) - 2))
     {
-      if (ch == '>' && temp == NULL)
+      if (ch == '>' && t->markup == MARKUP_UNKNOWN)
         break;
 
       if (ch == '\n')
@@ -2809,7 +3918,7 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
       {
         *cptr++ = (uchar)ch;
 
-        if ((ch2 = getc(fp)) == '>')
+        if ((ch2 = html_getc(in)) == '>')
 	{
 	  // Erase trailing -->
 	  cptr -= 2;
@@ -2832,7 +3941,7 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
 
 	  eptr = entity;
 	  while (eptr < (entity + sizeof(entity) - 1) &&
-		 (ch = getc(fp)) != EOF)
+		 (ch = html_getc(in)) != EOF)
 	    if (!isalnum(ch) && ch != '#')
 	      break;
 	    else
@@ -2840,7 +3949,7 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
 
 	  if (ch != ';')
 	  {
-	    ungetc(ch, fp);
+	    html_ungetc(ch, in);
 	    ch = 0;
 	  }
 
@@ -2876,7 +3985,7 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
           if ((ch & 0x80) && _htmlUTF8)
           {
             // Collect UTF-8 value...
-            ch = utf8_getc(ch, fp);
+            ch = utf8_getc(ch, in);
           }
 
           if (ch)
@@ -2884,12 +3993,12 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
         }
 
         lastch = ch;
-        ch     = getc(fp);
+        ch     = html_getc(in);
       }
     }
 
     *cptr = '\0';
-    t->data = (uchar *)strdup((char *)comment);
+    t->data = copy_string(t, comment);
   }
   else
   {
@@ -2900,16 +4009,16 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
 
       if (!isspace(ch))
       {
-        ungetc(ch, fp);
-        parse_variable(t, fp, linenum);
+        html_ungetc(ch, in);
+        parse_variable(t, in, linenum);
       }
 
-      ch = getc(fp);
+      ch = html_getc(in);
 
       if (ch == '/')
       {
 	// Look for "/>"...
-	ch = getc(fp);
+	ch = html_getc(in);
 
 	if (ch != '>')
           return (MARKUP_ERROR);
@@ -2928,8 +4037,8 @@ parse_markup(tree_t *t,		/* I - Current tree entry */
  */
 
 static int				// O - -1 on error, 0 on success
-parse_variable(tree_t *t,		// I - Current tree entry
-               FILE   *fp,		// I - Input file
+parse_variable(tree_t    *t,		// I - Current tree entry
+               hdinput_t *in,		// I - Input file
 	       int    *linenum)		// I - Current line number
 {
   uchar	name[1024],			// Name of variable
@@ -2941,7 +4050,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
 
 
   ptr = name;
-  while ((ch = getc(fp)) != EOF)
+  while ((ch = html_getc(in)) != EOF)
     if (isspace(ch) || ch == '=' || ch == '>' || ch == '\r')
       break;
     else if (ch == '/' && ptr == name)
@@ -2951,7 +4060,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
       if ((ch & 0x80) && _htmlUTF8)
       {
         // Collect UTF-8 value...
-        ch = utf8_getc(ch, fp);
+        ch = utf8_getc(ch, in);
       }
 
       if (ch)
@@ -2965,7 +4074,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
 
   while (isspace(ch) || ch == '\r')
   {
-    ch = getc(fp);
+    ch = html_getc(in);
 
     if (ch == '\n')
       (*linenum) ++;
@@ -2974,23 +4083,23 @@ parse_variable(tree_t *t,		// I - Current tree entry
   switch (ch)
   {
     default :
-        ungetc(ch, fp);
+        html_ungetc(ch, in);
         return (htmlSetVariable(t, name, NULL));
     case EOF :
         return (-1);
     case '=' :
         ptr = value;
-        ch  = getc(fp);
+        ch  = html_getc(in);
 
         while (isspace(ch) || ch == '\r')
-          ch = getc(fp);
+          ch = html_getc(in);
 
         if (ch == EOF)
           return (-1);
 
         if (ch == '\'')
         {
-          while ((ch = getc(fp)) != EOF)
+          while ((ch = html_getc(in)) != EOF)
 	  {
             if (ch == '\'')
               break;
@@ -2999,7 +4108,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
 	      // Possibly a character entity...
 	      eptr = entity;
 	      while (eptr < (entity + sizeof(entity) - 1) &&
-	             (ch = getc(fp)) != EOF)
+	             (ch = html_getc(in)) != EOF)
 	        if (!isalnum(ch) && ch != '#')
 		  break;
 		else
@@ -3007,7 +4116,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
 
               if (ch != ';')
 	      {
-	        ungetc(ch, fp);
+	        html_ungetc(ch, in);
 		ch = 0;
 	      }
 
@@ -3045,7 +4154,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
               if ((ch & 0x80) && _htmlUTF8)
               {
                 // Collect UTF-8 value...
-                ch = utf8_getc(ch, fp);
+                ch = utf8_getc(ch, in);
               }
 
               if (ch)
@@ -3064,7 +4173,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
         }
         else if (ch == '\"')
         {
-          while ((ch = getc(fp)) != EOF)
+          while ((ch = html_getc(in)) != EOF)
 	  {
             if (ch == '\"')
               break;
@@ -3073,7 +4182,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
 	      // Possibly a character entity...
 	      eptr = entity;
 	      while (eptr < (entity + sizeof(entity) - 1) &&
-	             (ch = getc(fp)) != EOF)
+	             (ch = html_getc(in)) != EOF)
 	        if (!isalnum(ch) && ch != '#')
 		  break;
 		else
@@ -3081,7 +4190,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
 
               if (ch != ';')
 	      {
-	        ungetc(ch, fp);
+	        html_ungetc(ch, in);
 		ch = 0;
 	      }
 
@@ -3118,7 +4227,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
               if ((ch & 0x80) && _htmlUTF8)
               {
                 // Collect UTF-8 value...
-                ch = utf8_getc(ch, fp);
+                ch = utf8_getc(ch, in);
               }
 
               if (ch)
@@ -3138,7 +4247,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
         else
         {
           *ptr++ = (uchar)ch;
-          while ((ch = getc(fp)) != EOF)
+          while ((ch = html_getc(in)) != EOF)
 	  {
             if (isspace(ch) || ch == '>' || ch == '\r')
               break;
@@ -3147,7 +4256,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
 	      // Possibly a character entity...
 	      eptr = entity;
 	      while (eptr < (entity + sizeof(entity) - 1) &&
-	             (ch = getc(fp)) != EOF)
+	             (ch = html_getc(in)) != EOF)
 	        if (!isalnum(ch) && ch != '#')
 		  break;
 		else
@@ -3155,7 +4264,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
 
               if (ch != ';')
 	      {
-	        ungetc(ch, fp);
+	        html_ungetc(ch, in);
 		ch = 0;
 	      }
 
@@ -3191,7 +4300,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
               if ((ch & 0x80) && _htmlUTF8)
               {
                 // Collect UTF-8 value...
-                ch = utf8_getc(ch, fp);
+                ch = utf8_getc(ch, in);
               }
 
               if (ch)
@@ -3204,7 +4313,7 @@ parse_variable(tree_t *t,		// I - Current tree entry
 
           *ptr = '\0';
           if (ch == '>')
-            ungetc(ch, fp);
+            html_ungetc(ch, in);
         }
 
         return (htmlSetVariable(t, name, value));
@@ -3353,13 +4462,8 @@ compute_size(tree_t *t)		/* I - Tree entry */
   }
   else if (t->data)
   {
-    if (!_htmlWidthsLoaded[t->typeface][t->style])
-      htmlLoadFontWidths(t->typeface, t->style);
-
-    for (int_width = 0, ptr = t->data; *ptr != '\0'; ptr ++)
-      int_width += _htmlWidths[t->typeface][t->style][(int)*ptr & 255];
-
-    width = 0.001f * int_width;
+    int_width = htmlGetTextWidth(t->data, t->typeface, t->style);
+    width     = 0.001f * int_width;
   }
   else
     width = 0.0f;
@@ -3442,17 +4546,174 @@ get_alignment(tree_t *t)	/* I - Tree entry */
       t->valignment = ALIGN_BOTTOM;
   }
 
-  return (0);
+  return (0);
+}
+
+
+/*
+ * 'fix_filename()' - Fix a filename to be relative to the base directory.
+ */
+
+static const char *			/* O - Fixed filename */
+fix_filename(char *filename,		/* I - Original filename */
+             char *base)		/* I - Base directory */
+{
+  if ((filename = (char *)resolve_filename(filename, base)) == NULL)
+    return (NULL);
+
+  return (file_find(Path, filename));
+}
+
+
+/*
+ * 'prefetch_html()' - Download the remote images used by a HTML file.
+ *
+ * This does a quick scan of the markup for image SRC and BACKGROUND
+ * attributes so that the remote images can be downloaded concurrently
+ * before the file is parsed.
+ */
+
+static void
+prefetch_html(const uchar *ptr,		/* I - Start of HTML */
+              const uchar *end,		/* I - End of HTML */
+	      const char  *base)	/* I - Base directory */
+{
+  char		name[16],		/* Element or attribute name */
+		value[1024],		/* Attribute value */
+		*nameptr,		/* Pointer into name */
+		*valptr;		/* Pointer into value */
+  int		is_img,			/* Is this an IMG element? */
+		quote;			/* Quote character */
+  const char	*url;			/* Resolved URL */
+  const char	**urls = NULL,		/* Remote URLs */
+		**temp;			/* New URLs array */
+  int		num_urls = 0,		/* Number of URLs */
+		alloc_urls = 0;		/* Allocated URLs */
+
+
+  while (ptr < end)
+  {
+    if (*ptr++ != '<')
+      continue;
+
+    if ((end - ptr) > 3 && !memcmp(ptr, "!--", 3))
+    {
+     /*
+      * Skip comment...
+      */
+
+      for (ptr += 3; ptr < (end - 2) && memcmp(ptr, "-->", 3); ptr ++);
+      continue;
+    }
+
+   /*
+    * Get the element name...
+    */
+
+    for (nameptr = name; ptr < end && isalnum(*ptr); ptr ++)
+      if (nameptr < (name + sizeof(name) - 1))
+        *nameptr++ = (char)*ptr;
+
+    *nameptr = '\0';
+
+    if (!(is_img = !strcasecmp(name, "IMG")) && strcasecmp(name, "BODY") &&
+        strcasecmp(name, "TABLE") && strcasecmp(name, "TD") &&
+        strcasecmp(name, "TH") && strcasecmp(name, "TR"))
+      continue;
+
+   /*
+    * Look at the attributes...
+    */
+
+    while (ptr < end && *ptr != '>')
+    {
+      while (ptr < end && isspace(*ptr))
+        ptr ++;
+
+      for (nameptr = name; ptr < end && *ptr != '=' && *ptr != '>' && !isspace(*ptr); ptr ++)
+        if (nameptr < (name + sizeof(name) - 1))
+          *nameptr++ = (char)*ptr;
+
+      *nameptr = '\0';
+
+      while (ptr < end && isspace(*ptr))
+        ptr ++;
+
+      if (ptr >= end || *ptr != '=')
+      {
+        if (!name[0] && ptr < end && *ptr != '>')
+          ptr ++;
+        continue;
+      }
+
+      for (ptr ++; ptr < end && isspace(*ptr); ptr ++);
+
+      if (ptr < end && (*ptr == '\"' || *ptr == '\''))
+        quote = *ptr++;
+      else
+        quote = 0;
+
+      for (valptr = value; ptr < end; ptr ++)
+      {
+        if (quote ? *ptr == quote : (isspace(*ptr) || *ptr == '>'))
+          break;
+
+        if (valptr < (value + sizeof(value) - 1))
+          *valptr++ = (char)*ptr;
+
+        if (*ptr == '&' && (end - ptr) > 4 && !memcmp(ptr, "&amp;", 5))
+          ptr += 4;
+      }
+
+      *valptr = '\0';
+
+      if (quote && ptr < end)
+        ptr ++;
+
+      if ((is_img && !strcasecmp(name, "SRC")) || !strcasecmp(name, "BACKGROUND"))
+      {
+        if ((url = resolve_filename(value, (char *)base)) == NULL ||
+	    (strncmp(url, "http://", 7) && strncmp(url, "https://", 8)))
+	  continue;
+
+        if (num_urls >= alloc_urls)
+	{
+	  alloc_urls += 64;
+
+	  if ((temp = (const char **)realloc(urls, (size_t)alloc_urls * sizeof(char *))) == NULL)
+	    break;
+
+          urls = temp;
+	}
+
+        if ((urls[num_urls] = strdup(url)) != NULL)
+	  num_urls ++;
+      }
+    }
+  }
+
+  if (num_urls > 1)
+    file_prefetch(urls, num_urls);
+
+  while (num_urls > 0)
+  {
+    num_urls --;
+    free((void *)urls[num_urls]);
+  }
+
+  free(urls);
 }
 
 
 /*
- * 'fix_filename()' - Fix a filename to be relative to the base directory.
+ * 'resolve_filename()' - Make a filename or URL relative to the base directory.
+ *
+ * Unlike fix_filename(), remote files are not downloaded.
  */
 
-static const char *			/* O - Fixed filename */
-fix_filename(char *filename,		/* I - Original filename */
-             char *base)		/* I - Base directory */
+static const char *			/* O - Filename or URL */
+resolve_filename(char *filename,	/* I - Original filename */
+                 char *base)		/* I - Base directory */
 {
   char		*slash;			/* Location of slash */
   char		*tempptr;		/* Pointer into filename */
@@ -3460,11 +4721,15 @@ fix_filename(char *filename,		/* I - Original filename */
   static char	newfilename[1024];	/* New filename */
 
 
-//  printf("fix_filename(filename=\"%s\", base=\"%s\")\n", filename, base);
+//  printf("resolve_filename(filename=\"%s\", base=\"%s\")\n", filename, base);
 
   if (filename == NULL)
     return (NULL);
 
+  // Data URIs are not relative to anything...
+  if (!strncmp(filename, "data:", 5))
+    return (filename);
+
 #ifdef DEBUG // to silence Clang static analyzer, totally unnecessary
   memset(temp, 0, sizeof(temp));
 #endif // DEBUG
@@ -3505,7 +4770,7 @@ fix_filename(char *filename,		/* I - Original filename */
   }
 
   if (strcmp(base, ".") == 0 || strstr(filename, "//") != NULL)
-    return (file_find(Path, filename));
+    return (filename);
 
   if (strncmp(filename, "./", 2) == 0 ||
       strncmp(filename, ".\\", 2) == 0)
@@ -3550,7 +4815,7 @@ fix_filename(char *filename,		/* I - Original filename */
 	base[0] == '\0' || (isalpha(filename[0]) && filename[1] == ':'))
     {
       // No change needed for absolute path...
-      return (file_find(Path, filename));
+      return (filename);
     }
 
     strlcpy(newfilename, base, sizeof(newfilename));
@@ -3587,7 +4852,7 @@ fix_filename(char *filename,		/* I - Original filename */
 
 //  printf("    newfilename=\"%s\"\n", newfilename);
 
-  return (file_find(Path, newfilename));
+  return (newfilename);
 }
 
 
@@ -3610,11 +4875,13 @@ html_memory_used(tree_t *t)		// I - Tree node
   while (t != NULL)
   {
     bytes += sizeof(tree_t);
-    bytes += (size_t)t->nvars * sizeof(var_t);
+    if (t->vars != t->ivars)
+      bytes += (size_t)t->avars * sizeof(var_t);
 
     for (i = 0; i < t->nvars; i ++)
     {
-      bytes += (strlen((char *)t->vars[i].name) + 8) & (size_t)~7;
+      if (t->vars[i].name != intern_name(t->vars[i].name))
+        bytes += (strlen((char *)t->vars[i].name) + 8) & (size_t)~7;
 
       if (t->vars[i].value != NULL)
         bytes += (strlen((char *)t->vars[i].value) + 8) & (size_t)~7;
@@ -3641,6 +4908,14 @@ htmlDebugStats(const char *title,	// I - Title
                tree_t     *t)		// I - Document root node
 {
   const char	*debug;			/* HTMLDOC_DEBUG env var */
+  tree_t	*file;			// Current file node
+  size_t	used,			// Arena bytes used for a file
+		allocated,		// Arena bytes allocated for a file
+		total_used,		// Total arena bytes used
+		total_allocated;	// Total arena bytes allocated
+  int		blocks,			// Arena blocks for a file
+		total_blocks,		// Total arena blocks
+		arenas;			// Number of arenas
 
 
   if ((debug = getenv("HTMLDOC_DEBUG")) == NULL ||
@@ -3649,6 +4924,25 @@ htmlDebugStats(const char *title,	// I - Title
 
   progress_error(HD_ERROR_NONE, "DEBUG: %s = %d kbytes", title,
                  (html_memory_used(t) + 1023) / 1024);
+
+  for (file = t, total_used = 0, total_allocated = 0, total_blocks = 0, arenas = 0; file; file = file->next)
+  {
+    if (!file->arena_owner)
+      continue;
+
+    hd_arena_stats(file->arena, &used, &allocated, &blocks);
+
+    total_used      += used;
+    total_allocated += allocated;
+    total_blocks    += blocks;
+    arenas ++;
+  }
+
+  if (arenas > 0)
+    progress_error(HD_ERROR_NONE, "DEBUG: %s Arenas = %d kbytes used, %d kbytes allocated in %d blocks (%d arenas)", title,
+                   (int)((total_used + 1023) / 1024),
+                   (int)((total_allocated + 1023) / 1024), total_blocks,
+                   arenas);
 }
 
 
@@ -3767,13 +5061,523 @@ htmlFixLinks(tree_t *doc,		// I - Top node
 }
 
 
+//
+// 'find_glyph_width()' - Find the width of a named glyph.
+//
+
+static int				// O - Width or -1 if not found
+find_glyph_width(hdmetrics_t *m,	// I - Font metrics
+                 const char  *name)	// I - Glyph name
+{
+  int	left,				// Left side of search
+	right,				// Right side of search
+	current,			// Current glyph
+	diff;				// Comparison result
+
+
+  for (left = 0, right = (int)m->header->num_glyphs - 1; left <= right;)
+  {
+    current = (left + right) / 2;
+
+    if ((diff = strcmp(name, m->names + m->glyphs[current].name)) == 0)
+      return (m->glyphs[current].width);
+    else if (diff < 0)
+      right = current - 1;
+    else
+      left = current + 1;
+  }
+
+  return (-1);
+}
+
+
+//
+// 'fill_width_page()' - Fill a page of Unicode widths for a font.
+//
+
+static short *				// O - Page of widths or NULL
+fill_width_page(int typeface,		// I - Typeface
+                int style,		// I - Style
+		int page)		// I - Page number (Unicode / 256)
+{
+  short		*widths;		// Widths
+  hdmetrics_t	*m;			// Font metrics
+  int		ch,			// Character in page
+		width;			// Width of character
+  unsigned	i;			// Looping var
+
+
+  if ((widths = (short *)malloc(256 * sizeof(short))) == NULL)
+    return (NULL);
+
+  for (ch = 0; ch < 256; ch ++)
+    widths[ch] = 600;
+
+  if ((m = load_metrics(typeface, style)) != NULL)
+  {
+    if (typeface < TYPE_SYMBOL)
+    {
+      for (ch = 0; ch < 256; ch ++)
+      {
+        const char *glyph = _htmlGlyphsAll[(page << 8) + ch];
+					// Glyph name
+
+	if (glyph && (width = find_glyph_width(m, glyph)) >= 0)
+	  widths[ch] = (short)width;
+      }
+    }
+    else if (page == 0)
+    {
+      // Symbol and Dingbats fonts uses their own encoding...
+      for (i = 0; i < m->header->num_glyphs; i ++)
+        if ((ch = m->glyphs[i].code) < 256 && ch >= 0)
+	  widths[ch] = m->glyphs[i].width;
+    }
+  }
+
+  // Make sure that non-breaking space has the same width as a breaking space...
+  if (page == 0)
+    widths[160] = widths[32];
+
+  width_pages[typeface][style][page] = widths;
+
+  return (widths);
+}
+
+
+//
+// 'free_metrics()' - Free font metrics.
+//
+
+static void
+free_metrics(hdmetrics_t *m)		// I - Font metrics
+{
+#ifdef HAVE_SYS_MMAN_H
+  if (m->mapped)
+    munmap(m->header, m->size);
+  else
+#endif // HAVE_SYS_MMAN_H
+  free(m->header);
+
+  free(m->datadir);
+  free(m);
+}
+
+
+//
+// 'load_metrics()' - Load the metrics for a font.
+//
+// The AFM file is only parsed when its binary metrics file is missing or
+// older than the AFM file; a new metrics file is then written if the fonts
+// directory is writable.  Metrics are kept until the data directory changes.
+//
+
+static hdmetrics_t *			// O - Font metrics or NULL
+load_metrics(int typeface,		// I - Typeface
+             int style)			// I - Style
+{
+  char		afmfile[1024],		// AFM filename
+		metfile[1024];		// Metrics filename
+  struct stat	afminfo;		// AFM file information
+  hdmetrics_t	*m;			// Font metrics
+  static hdmetrics_t *metrics[TYPE_MAX][STYLE_MAX] = { { NULL } };
+					// Loaded metrics
+
+
+  if ((m = metrics[typeface][style]) != NULL)
+  {
+    if (!strcmp(m->datadir, _htmlData))
+      return (m);
+
+    // The data directory has changed, so flush the cached metrics...
+    free_metrics(m);
+    metrics[typeface][style] = NULL;
+  }
+
+  snprintf(afmfile, sizeof(afmfile), "%s/fonts/%s.afm", _htmlData, _htmlFonts[typeface][style]);
+  snprintf(metfile, sizeof(metfile), "%s/fonts/%s.metrics", _htmlData, _htmlFonts[typeface][style]);
+
+  if (stat(afmfile, &afminfo))
+  {
+#ifndef DEBUG
+    progress_error(HD_ERROR_FILE_NOT_FOUND, "Unable to open font width file %s!", afmfile);
+#endif /* !DEBUG */
+    return (NULL);
+  }
+
+  if ((m = read_metrics(metfile, &afminfo)) == NULL)
+  {
+    if ((m = read_afm(afmfile, &afminfo)) != NULL)
+      write_metrics(metfile, m);
+  }
+
+  if (m && (m->datadir = strdup(_htmlData)) == NULL)
+  {
+    free_metrics(m);
+    m = NULL;
+  }
+
+  return (metrics[typeface][style] = m);
+}
+
+
+//
+// 'read_afm()' - Read font metrics from an AFM file.
+//
+
+static hdmetrics_t *			// O - Font metrics or NULL
+read_afm(const char  *filename,		// I - AFM filename
+         struct stat *afminfo)		// I - AFM file information
+{
+  FILE		*fp;			// AFM file
+  char		line[1024],		// Line from AFM file
+		glyph[64];		// Glyph name
+  int		code;			// Character code
+  float		width;			// Width value
+  hdafm_glyph_t	*glyphs = NULL,		// Glyphs
+		*g;			// Current glyph
+  unsigned	i,			// Looping var
+		num_glyphs = 0,		// Number of glyphs
+		alloc_glyphs = 0,	// Allocated glyphs
+		names_size = 0;		// Bytes of glyph names
+  size_t	size;			// Size of metrics data
+  hdmetrics_t	*m;			// Font metrics
+  char		*names;			// Glyph name strings
+
+
+  if ((fp = fopen(filename, "r")) == NULL)
+  {
+#ifndef DEBUG
+    progress_error(HD_ERROR_FILE_NOT_FOUND, "Unable to open font width file %s!", filename);
+#endif /* !DEBUG */
+    return (NULL);
+  }
+
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    if (strncmp(line, "C ", 2) != 0)
+      continue;
+
+    glyph[0] = '\0';
+
+    if (sscanf(line, "%*s%d%*s%*s%f%*s%*s%63s", &code, &width, glyph) < 2)
+      continue;
+
+    if (num_glyphs >= alloc_glyphs)
+    {
+      alloc_glyphs += 256;
+
+      if ((g = (hdafm_glyph_t *)realloc(glyphs, alloc_glyphs * sizeof(hdafm_glyph_t))) == NULL)
+        break;
+
+      glyphs = g;
+    }
+
+    g = glyphs + num_glyphs;
+
+    if ((g->name = strdup(glyph)) == NULL)
+      break;
+
+    g->code    = code;
+    g->width   = (int)width;
+    names_size += (unsigned)strlen(glyph) + 1;
+    num_glyphs ++;
+  }
+
+  fclose(fp);
+
+  qsort(glyphs, num_glyphs, sizeof(hdafm_glyph_t), (compare_func_t)compare_glyphs);
+
+ /*
+  * Build the metrics in the same layout as the metrics file...
+  */
+
+  size = sizeof(hdmetrics_header_t) + num_glyphs * sizeof(hdmetrics_glyph_t) + names_size;
+
+  if ((m = (hdmetrics_t *)calloc(1, sizeof(hdmetrics_t))) != NULL &&
+      (m->header = (hdmetrics_header_t *)calloc(1, size)) != NULL)
+  {
+    memcpy(m->header->magic, "HDFM", 4);
+    m->header->byteorder  = HD_METRICS_BYTEORDER;
+    m->header->num_glyphs = num_glyphs;
+    m->header->names_size = names_size;
+    m->header->afm_size   = (long long)afminfo->st_size;
+    m->header->afm_mtime  = (long long)afminfo->st_mtime;
+
+    m->glyphs = (hdmetrics_glyph_t *)(m->header + 1);
+    m->names  = names = (char *)(m->glyphs + num_glyphs);
+    m->size   = size;
+
+    for (i = 0, g = glyphs; i < num_glyphs; i ++, g ++)
+    {
+      m->glyphs[i].code  = (short)g->code;
+      m->glyphs[i].width = (short)g->width;
+      m->glyphs[i].name  = (unsigned)(names - m->names);
+
+      strcpy(names, g->name);
+      names += strlen(g->name) + 1;
+    }
+  }
+  else if (m)
+  {
+    free(m);
+    m = NULL;
+  }
+
+  for (i = 0; i < num_glyphs; i ++)
+    free(glyphs[i].name);
+  free(glyphs);
+
+  return (m);
+}
+
+
+//
+// 'read_metrics()' - Read a binary font metrics file.
+//
+// The file is only used if it matches the current AFM file and is
+// internally consistent.
+//
+
+static hdmetrics_t *			// O - Font metrics or NULL
+read_metrics(const char  *filename,	// I - Metrics filename
+             struct stat *afminfo)	// I - AFM file information
+{
+  int			fd;		// File descriptor
+  struct stat		metinfo;	// Metrics file information
+  hdmetrics_header_t	*header;	// Metrics data
+  hdmetrics_t		*m;		// Font metrics
+  unsigned		i;		// Looping var
+  size_t		size;		// Size of metrics data
+
+
+  if ((fd = open(filename, O_RDONLY | O_BINARY)) < 0)
+    return (NULL);
+
+  if (fstat(fd, &metinfo) || (size_t)metinfo.st_size < sizeof(hdmetrics_header_t))
+  {
+    close(fd);
+    return (NULL);
+  }
+
+  size = (size_t)metinfo.st_size;
+
+#ifdef HAVE_SYS_MMAN_H
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  header = map == MAP_FAILED ? NULL : (hdmetrics_header_t *)map;
+#else
+  if ((header = (hdmetrics_header_t *)malloc(size)) != NULL &&
+      (size_t)read(fd, header, size) != size)
+  {
+    free(header);
+    header = NULL;
+  }
+#endif // HAVE_SYS_MMAN_H
+
+  close(fd);
+
+  if (!header)
+    return (NULL);
+
+  if (memcmp(header->magic, "HDFM", 4) ||
+      header->byteorder != HD_METRICS_BYTEORDER ||
+      header->afm_size != (long long)afminfo->st_size ||
+      header->afm_mtime != (long long)afminfo->st_mtime ||
+      header->names_size == 0 ||
+      header->num_glyphs > (size / sizeof(hdmetrics_glyph_t)) ||
+      size != (sizeof(hdmetrics_header_t) + header->num_glyphs * sizeof(hdmetrics_glyph_t) + header->names_size) ||
+      ((char *)header)[size - 1] != '\0' ||
+      (m = (hdmetrics_t *)calloc(1, sizeof(hdmetrics_t))) == NULL)
+    goto bad_metrics;
+
+  m->header = header;
+  m->glyphs = (hdmetrics_glyph_t *)(header + 1);
+  m->names  = (const char *)(m->glyphs + header->num_glyphs);
+  m->size   = size;
+#ifdef HAVE_SYS_MMAN_H
+  m->mapped = 1;
+#endif // HAVE_SYS_MMAN_H
+
+  for (i = 0; i < header->num_glyphs; i ++)
+  {
+    if (m->glyphs[i].name >= header->names_size)
+    {
+      free(m);
+      goto bad_metrics;
+    }
+  }
+
+  return (m);
+
+  bad_metrics:
+
+#ifdef HAVE_SYS_MMAN_H
+  munmap(header, size);
+#else
+  free(header);
+#endif // HAVE_SYS_MMAN_H
+
+  return (NULL);
+}
+
+
+//
+// 'write_metrics()' - Write a binary font metrics file.
+//
+// The file is written under a temporary name and then renamed so that other
+// processes never see a partial file.  Errors are ignored since the metrics
+// file is only an optimization.
+//
+
+static void
+write_metrics(const char  *filename,	// I - Metrics filename
+              hdmetrics_t *m)		// I - Font metrics
+{
+#ifndef WIN32
+  int	fd;				// File descriptor
+  char	tempfile[1024];			// Temporary filename
+
+
+  snprintf(tempfile, sizeof(tempfile), "%s.XXXXXX", filename);
+
+  if ((fd = mkstemp(tempfile)) < 0)
+    return;
+
+  fchmod(fd, 0644);
+
+  if ((size_t)write(fd, m->header, m->size) != m->size)
+  {
+    close(fd);
+    unlink(tempfile);
+    return;
+  }
+
+  close(fd);
+
+  if (rename(tempfile, filename))
+    unlink(tempfile);
+#else
+  (void)filename;
+  (void)m;
+#endif // !WIN32
+}
+
+
+//
+// 'close_input()' - Release a buffered input file.
+//
+// Data that was read from a memory-mapped file is consumed all at once, so
+// the file position is updated to point just past the last byte used.
+//
+
+static void
+close_input(hdinput_t *in)		// I - Input file
+{
+#ifdef HAVE_SYS_MMAN_H
+  if (in->map)
+  {
+    fseek(in->fp, (long)(in->ptr - in->map), SEEK_SET);
+    munmap(in->map, in->mapsize);
+  }
+  else
+#endif // HAVE_SYS_MMAN_H
+  free(in->buffer);
+
+  memset(in, 0, sizeof(hdinput_t));
+}
+
+
+//
+// 'fill_input()' - Refill the input buffer and return the next character.
+//
+// The last character in the buffer is kept so that it can be pushed back
+// with html_ungetc() after a refill.
+//
+
+static int				// O - Next character or EOF
+fill_input(hdinput_t *in)		// I - Input file
+{
+  size_t	keep,			// Bytes kept from the old buffer
+		bytes;			// Bytes read
+
+
+  if (in->map || !in->buffer)
+    return (EOF);
+
+  if (in->end > in->buffer)
+  {
+    in->buffer[0] = in->end[-1];
+    keep          = 1;
+  }
+  else
+    keep = 0;
+
+  bytes    = fread(in->buffer + keep, 1, HD_INPUT_SIZE - keep, in->fp);
+  in->ptr  = in->buffer + keep;
+  in->end  = in->ptr + bytes;
+
+  if (bytes == 0)
+    return (EOF);
+
+  return (*(in->ptr)++);
+}
+
+
+//
+// 'open_input()' - Start buffered reading of a file.
+//
+// Regular files are memory-mapped when possible, otherwise the file is read
+// in large blocks.
+//
+
+static int				// O - 1 on success, 0 on error
+open_input(hdinput_t *in,		// I - Input file
+           FILE      *fp)		// I - File pointer
+{
+  memset(in, 0, sizeof(hdinput_t));
+
+  in->fp = fp;
+
+#ifdef HAVE_SYS_MMAN_H
+  struct stat	fileinfo;		// File information
+  long		offset;			// Current offset in file
+
+  if (!fstat(fileno(fp), &fileinfo) && S_ISREG(fileinfo.st_mode) &&
+      (offset = ftell(fp)) >= 0 && offset < fileinfo.st_size)
+  {
+    void *map = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE,
+                     fileno(fp), 0);
+
+    if (map != MAP_FAILED)
+    {
+      in->map     = (uchar *)map;
+      in->mapsize = (size_t)fileinfo.st_size;
+      in->buffer  = in->map;
+      in->ptr     = in->map + offset;
+      in->end     = in->map + in->mapsize;
+
+      return (1);
+    }
+  }
+#endif // HAVE_SYS_MMAN_H
+
+  if ((in->buffer = (uchar *)malloc(HD_INPUT_SIZE)) == NULL)
+    return (0);
+
+  in->ptr = in->end = in->buffer;
+
+  return (1);
+}
+
+
 //
 // 'utf8_getc()' - Get a UTF-8 encoded character.
 //
 
 static int                              // O - Unicode equivalent
-utf8_getc(int  ch,                      // I - Initial character
-          FILE *fp)                     // I - File to read from
+utf8_getc(int       ch,                 // I - Initial character
+          hdinput_t *in)                // I - File to read from
 {
   int  ch2 = -1, ch3 = -1;              // Temporary characters
 
@@ -3785,7 +5589,7 @@ utf8_getc(int  ch,                      // I - Initial character
     */
 
     ch  = (ch & 0x1f) << 6;
-    ch2 = getc(fp);
+    ch2 = html_getc(in);
 
     if ((ch2 & 0xc0) == 0x80)
       ch |= ch2 & 0x3f;
@@ -3799,14 +5603,14 @@ utf8_getc(int  ch,                      // I - Initial character
     */
 
     ch  = (ch & 0x0f) << 12;
-    ch2 = getc(fp);
+    ch2 = html_getc(in);
 
     if ((ch2 & 0xc0) == 0x80)
       ch |= (ch2 & 0x3f) << 6;
     else
       goto bad_sequence;
 
-    ch3 = getc(fp);
+    ch3 = html_getc(in);
 
     if ((ch3 & 0xc0) == 0x80)
       ch |= ch3 & 0x3f;
@@ -3822,7 +5626,7 @@ utf8_getc(int  ch,                      // I - Initial character
     // them...  Try reading another character...
     //
     // TODO: Emit a warning about this...
-    return (utf8_getc(getc(fp), fp));
+    return (utf8_getc(html_getc(in), in));
   }
 
   return (htmlMapUnicode(ch));
@@ -14,19 +14,31 @@
  */
 
 #include "htmldoc.h"
+#include "links.h"
 #include "markdown.h"
+#include "thread.h"
 #include <ctype.h>
 
 
 //
-// Named link structure...
+// Local types...
 //
 
-typedef struct
+typedef struct hdsepfile_s		// Output file written by a worker thread
 {
-  uchar		*filename;	/* File for link */
-  uchar		name[124];	/* Reference name */
-} link_t;
+  hd_job_t	*job;			// Job writing the file
+  int		heading;		// Heading number
+  tree_t	*start,			// First node in file
+		*end;			// First node in next file or NULL
+  uchar		*title,			// Title
+		*author,		// Author
+		*copyright,		// Copyright
+		*docnumber;		// Document number
+  char		*data;			// File contents
+  size_t	length,			// Length of file contents
+		body;			// Offset of body in file contents
+  int		col;			// Column at end of body
+} hdsepfile_t;
 
 
 //
@@ -39,38 +51,45 @@ static size_t	num_headings = 0,	// Number of headings
 static uchar	**headings;		// Heading strings
 
 // Links in document - used to add the correct filename to the link
-static size_t	num_links = 0,		// Number of links
-		alloc_links = 0;	// Allocated links
-static link_t	*links;			// Links
+static hd_links_t *links = NULL;	// Links
+
+// Images are copied before the files are written by worker threads
+static int	images_copied = 0;	// Have images been copied already?
 
 
 //
 // Local functions...
 //
 
-extern "C" {
-typedef int	(*compare_func_t)(const void *, const void *);
-}
-
 static void	write_header(FILE **out, uchar *filename, uchar *title,
 		             uchar *author, uchar *copyright, uchar *docnumber,
 			     int heading);
+static void	write_head(FILE *out, uchar *title, uchar *author,
+		           uchar *copyright, uchar *docnumber, int heading);
 static void	write_footer(FILE **out, int heading);
+static void	write_foot(FILE *out, int heading);
 static void	write_title(FILE *out, uchar *title, uchar *author,
 		            uchar *copyright, uchar *docnumber);
 static int	write_all(FILE *out, tree_t *t, int col);
 static int	write_doc(FILE **out, tree_t *t, int col, int *heading,
 		          uchar *title, uchar *author, uchar *copyright,
 			  uchar *docnumber);
+static int	write_files(tree_t *document, uchar *title, uchar *author,
+		            uchar *copyright, uchar *docnumber);
+static void	write_file(hdsepfile_t *file);
+static int	write_range(FILE *out, tree_t *t, tree_t *end, int col);
 static int	write_node(FILE *out, tree_t *t, int col);
 static int	write_nodeclose(FILE *out, tree_t *t, int col);
 static int	write_toc(FILE *out, tree_t *t, int col);
 static uchar	*get_title(tree_t *doc);
+static tree_t	*next_node(tree_t *t);
+static int	is_split(tree_t *t);
+static uchar	*local_image(tree_t *t);
+static void	update_image(tree_t *t, int copy = 1);
 
 static void	add_heading(tree_t *t);
 static void	add_link(uchar *name);
-static link_t	*find_link(uchar *name);
-static int	compare_links(link_t *n1, link_t *n2);
+static hd_link_t *find_link(uchar *name);
 static void	scan_links(tree_t *t);
 static void	update_links(tree_t *t, int *heading);
 
@@ -130,9 +149,7 @@ htmlsep_export(tree_t *document,	// I - Document to export
     docnumber = htmlGetMeta(document, (uchar *)"version");
 
   // Scan for all links in the document, and then update them...
-  num_links   = 0;
-  alloc_links = 0;
-  links       = NULL;
+  links = hd_links_new();
 
   scan_links(document);
 
@@ -168,24 +185,21 @@ htmlsep_export(tree_t *document,	// I - Document to export
   write_footer(&out, -1);
 
   // Then write each output file...
-  heading = -1;
-  write_doc(&out, document, 0, &heading, title, author, copyright, docnumber);
+  if (!write_files(document, title, author, copyright, docnumber))
+  {
+    heading = -1;
+    write_doc(&out, document, 0, &heading, title, author, copyright, docnumber);
 
-  if (out != NULL)
-    write_footer(&out, heading);
+    if (out != NULL)
+      write_footer(&out, heading);
+  }
 
   // Free memory...
   if (title != NULL)
     free(title);
 
-  if (alloc_links)
-  {
-    free(links);
-
-    num_links   = 0;
-    alloc_links = 0;
-    links       = NULL;
-  }
+  hd_links_delete(links);
+  links = NULL;
 
   if (alloc_headings)
   {
@@ -218,17 +232,6 @@ write_header(FILE   **out,	/* IO - Output file */
 {
   char		realname[1024];	/* Real filename */
   const char	*basename;	/* Filename without directory */
-  static const char *families[] =/* Typeface names */
-		{
-		  "monospace",
-		  "serif",
-		  "sans-serif",
-		  "monospace",
-		  "serif",
-		  "sans-serif",
-		  "symbol",
-		  "dingbats"
-		};
 
 
   basename = file_basename((char *)filename);
@@ -245,91 +248,120 @@ write_header(FILE   **out,	/* IO - Output file */
     return;
   }
 
-  fputs("<!DOCTYPE html>\n", *out);
-  fputs("<HTML>\n", *out);
-  fputs("<HEAD>\n", *out);
+  write_head(*out, title, author, copyright, docnumber, heading);
+}
+
+
+/*
+ * 'write_head()' - Write the standard "header" for a HTML file.
+ */
+
+static void
+write_head(FILE   *out,		/* I - Output file */
+	   uchar  *title,	/* I - Title for document */
+           uchar  *author,	/* I - Author for document */
+           uchar  *copyright,	/* I - Copyright for document */
+           uchar  *docnumber,	/* I - ID number for document */
+	   int    heading)	/* I - Current heading */
+{
+  static const char *families[] =/* Typeface names */
+		{
+		  "monospace",
+		  "serif",
+		  "sans-serif",
+		  "monospace",
+		  "serif",
+		  "sans-serif",
+		  "symbol",
+		  "dingbats"
+		};
+
+
+  fputs("<!DOCTYPE html>\n", out);
+  fputs("<HTML>\n", out);
+  fputs("<HEAD>\n", out);
   if (title != NULL)
-    fprintf(*out, "<TITLE>%s</TITLE>\n", title);
+    fprintf(out, "<TITLE>%s</TITLE>\n", title);
   if (author != NULL)
-    fprintf(*out, "<META NAME=\"author\" CONTENT=\"%s\">\n", author);
+    fprintf(out, "<META NAME=\"author\" CONTENT=\"%s\">\n", author);
   if (copyright != NULL)
-    fprintf(*out, "<META NAME=\"copyright\" CONTENT=\"%s\">\n", copyright);
+    fprintf(out, "<META NAME=\"copyright\" CONTENT=\"%s\">\n", copyright);
   if (docnumber != NULL)
-    fprintf(*out, "<META NAME=\"docnumber\" CONTENT=\"%s\">\n", docnumber);
-  fprintf(*out, "<META HTTP-EQUIV=\"Content-Type\" CONTENT=\"text/html; CHARSET=%s\">\n",
+    fprintf(out, "<META NAME=\"docnumber\" CONTENT=\"%s\">\n", docnumber);
+  fprintf(out, "<META HTTP-EQUIV=\"Content-Type\" CONTENT=\"text/html; CHARSET=%s\">\n",
           _htmlCharSet);
 
-  fputs("<LINK REL=\"Start\" HREF=\"index.html\">\n", *out);
+  fputs("<LINK REL=\"Start\" HREF=\"index.html\">\n", out);
 
   if (TitlePage)
-    fputs("<LINK REL=\"Contents\" HREF=\"toc.html\">\n", *out);
+    fputs("<LINK REL=\"Contents\" HREF=\"toc.html\">\n", out);
   else
-    fputs("<LINK REL=\"Contents\" HREF=\"index.html\">\n", *out);
+    fputs("<LINK REL=\"Contents\" HREF=\"index.html\">\n", out);
 
   if (heading >= 0)
   {
     if (heading > 0)
-      fprintf(*out, "<LINK REL=\"Prev\" HREF=\"%s.html\">\n", headings[heading - 1]);
+      fprintf(out, "<LINK REL=\"Prev\" HREF=\"%s.html\">\n", headings[heading - 1]);
 
     if ((size_t)heading < (num_headings - 1))
-      fprintf(*out, "<LINK REL=\"Next\" HREF=\"%s.html\">\n", headings[heading + 1]);
+      fprintf(out, "<LINK REL=\"Next\" HREF=\"%s.html\">\n", headings[heading + 1]);
   }
 
-  fputs("<STYLE TYPE=\"text/css\"><!--\n", *out);
-  fprintf(*out, "BODY { font-family: %s; }\n", families[_htmlBodyFont]);
-  fprintf(*out, "H1 { font-family: %s; }\n", families[_htmlHeadingFont]);
-  fprintf(*out, "H2 { font-family: %s; }\n", families[_htmlHeadingFont]);
-  fprintf(*out, "H3 { font-family: %s; }\n", families[_htmlHeadingFont]);
-  fprintf(*out, "H4 { font-family: %s; }\n", families[_htmlHeadingFont]);
-  fprintf(*out, "H5 { font-family: %s; }\n", families[_htmlHeadingFont]);
-  fprintf(*out, "H6 { font-family: %s; }\n", families[_htmlHeadingFont]);
-  fputs("SUB { font-size: smaller; }\n", *out);
-  fputs("SUP { font-size: smaller; }\n", *out);
-  fprintf(*out, "PRE { font-family: monospace; margin-left: %dpt; }\n", PreIndent);
+  fputs("<STYLE TYPE=\"text/css\"><!--\n", out);
+  fprintf(out, "BODY { font-family: %s; }\n", families[_htmlBodyFont]);
+  fprintf(out, "H1 { font-family: %s; }\n", families[_htmlHeadingFont]);
+  fprintf(out, "H2 { font-family: %s; }\n", families[_htmlHeadingFont]);
+  fprintf(out, "H3 { font-family: %s; }\n", families[_htmlHeadingFont]);
+  fprintf(out, "H4 { font-family: %s; }\n", families[_htmlHeadingFont]);
+  fprintf(out, "H5 { font-family: %s; }\n", families[_htmlHeadingFont]);
+  fprintf(out, "H6 { font-family: %s; }\n", families[_htmlHeadingFont]);
+  fputs("SUB { font-size: smaller; }\n", out);
+  fputs("SUP { font-size: smaller; }\n", out);
+  fprintf(out, "PRE { font-family: monospace; margin-left: %dpt; }\n", PreIndent);
 
   if (!LinkStyle)
-    fputs("A { text-decoration: none; }\n", *out);
+    fputs("A { text-decoration: none; }\n", out);
 
-  fputs("--></STYLE>\n", *out);
-  fputs("</HEAD>\n", *out);
+  fputs("--></STYLE>\n", out);
+  fputs("</HEAD>\n", out);
 
   if (BodyImage[0])
-    fprintf(*out, "<BODY BACKGROUND=\"%s\"", file_basename(BodyImage));
+    fprintf(out, "<BODY BACKGROUND=\"%s\"", file_basename(BodyImage));
   else if (BodyColor[0])
-    fprintf(*out, "<BODY BGCOLOR=\"%s\"", BodyColor);
+    fprintf(out, "<BODY BGCOLOR=\"%s\"", BodyColor);
   else
-    fputs("<BODY", *out);
+    fputs("<BODY", out);
 
   if (_htmlTextColor[0])
-    fprintf(*out, " TEXT=\"%s\"", _htmlTextColor);
+    fprintf(out, " TEXT=\"%s\"", _htmlTextColor);
 
   if (LinkColor[0])
-    fprintf(*out, " LINK=\"%s\" VLINK=\"%s\" ALINK=\"%s\"", LinkColor,
+    fprintf(out, " LINK=\"%s\" VLINK=\"%s\" ALINK=\"%s\"", LinkColor,
             LinkColor, LinkColor);
 
-  fputs(">\n", *out);
+  fputs(">\n", out);
 
   if (heading >= 0)
   {
     if (LogoImage[0])
-      fprintf(*out, "<IMG SRC=\"%s\">\n", file_basename(LogoImage));
+      fprintf(out, "<IMG SRC=\"%s\">\n", file_basename(LogoImage));
 
     for (int hfi = 0; hfi < MAX_HF_IMAGES; ++hfi)
       if (HFImage[hfi][0])
-        fprintf(*out, "<IMG SRC=\"%s\">\n", file_basename(HFImage[hfi]));
+        fprintf(out, "<IMG SRC=\"%s\">\n", file_basename(HFImage[hfi]));
 
     if (TitlePage)
-      fputs("<A HREF=\"toc.html\">Contents</A>\n", *out);
+      fputs("<A HREF=\"toc.html\">Contents</A>\n", out);
     else
-      fputs("<A HREF=\"index.html\">Contents</A>\n", *out);
+      fputs("<A HREF=\"index.html\">Contents</A>\n", out);
 
     if (heading > 0)
-      fprintf(*out, "<A HREF=\"%s.html\">Previous</A>\n", headings[heading - 1]);
+      fprintf(out, "<A HREF=\"%s.html\">Previous</A>\n", headings[heading - 1]);
 
     if ((size_t)heading < (num_headings - 1))
-      fprintf(*out, "<A HREF=\"%s.html\">Next</A>\n", headings[heading + 1]);
+      fprintf(out, "<A HREF=\"%s.html\">Next</A>\n", headings[heading + 1]);
 
-    fputs("<HR NOSHADE>\n", *out);
+    fputs("<HR NOSHADE>\n", out);
   }
 }
 
@@ -345,36 +377,48 @@ write_footer(FILE **out,	/* IO - Output file pointer */
   if (*out == NULL)
     return;
 
-  fputs("<HR NOSHADE>\n", *out);
+  write_foot(*out, heading);
+
+  progress_error(HD_ERROR_NONE, "BYTES: %ld", ftell(*out));
+
+  fclose(*out);
+  *out = NULL;
+}
+
+
+/*
+ * 'write_foot()' - Write the standard "footer" for a HTML file.
+ */
+
+static void
+write_foot(FILE *out,		/* I - Output file */
+	   int  heading)	/* I - Current heading */
+{
+  fputs("<HR NOSHADE>\n", out);
 
   if (heading >= 0)
   {
     if (LogoImage[0])
-      fprintf(*out, "<IMG SRC=\"%s\">\n", file_basename(LogoImage));
+      fprintf(out, "<IMG SRC=\"%s\">\n", file_basename(LogoImage));
 
     for (int hfi = 0; hfi < MAX_HF_IMAGES; ++hfi)
       if (HFImage[hfi][0])
-        fprintf(*out, "<IMG SRC=\"%s\">\n", file_basename(HFImage[hfi]));
+        fprintf(out, "<IMG SRC=\"%s\">\n", file_basename(HFImage[hfi]));
 
     if (TitlePage)
-      fputs("<A HREF=\"toc.html\">Contents</A>\n", *out);
+      fputs("<A HREF=\"toc.html\">Contents</A>\n", out);
     else
-      fputs("<A HREF=\"index.html\">Contents</A>\n", *out);
+      fputs("<A HREF=\"index.html\">Contents</A>\n", out);
 
     if (heading > 0)
-      fprintf(*out, "<A HREF=\"%s.html\">Previous</A>\n", headings[heading - 1]);
+      fprintf(out, "<A HREF=\"%s.html\">Previous</A>\n", headings[heading - 1]);
 
     if ((size_t)heading < (num_headings - 1))
-      fprintf(*out, "<A HREF=\"%s.html\">Next</A>\n", headings[heading + 1]);
+      fprintf(out, "<A HREF=\"%s.html\">Next</A>\n", headings[heading + 1]);
   }
 
-  fputs("</BODY>\n", *out);
-  fputs("</HTML>\n", *out);
-
-  progress_error(HD_ERROR_NONE, "BYTES: %ld", ftell(*out));
-
-  fclose(*out);
-  *out = NULL;
+  fputs("</BODY>\n", out);
+  fputs("</HTML>\n", out);
 }
 
 
@@ -423,7 +467,7 @@ write_title(FILE  *out,		/* I - Output file */
     }
 
     // Write a title page from HTML source...
-    if ((fp = fopen(title_file, "rb")) == NULL)
+    if ((fp = file_open(title_file, "rb")) == NULL)
     {
       progress_error(HD_ERROR_FILE_NOT_FOUND,
                      "Unable to open title file \"%s\" - %s!",
@@ -529,8 +573,7 @@ write_doc(FILE   **out,			// I - Output file
 
   while (t != NULL)
   {
-    if (t->markup >= MARKUP_H1 && t->markup < (MARKUP_H1 + TocLevels) &&
-        htmlGetVariable(t, (uchar *)"_HD_OMIT_TOC") == NULL)
+    if (is_split(t))
     {
       if (*heading >= 0)
         write_footer(out, *heading);
@@ -561,6 +604,226 @@ write_doc(FILE   **out,			// I - Output file
 }
 
 
+//
+// 'write_files()' - Write the output files using worker threads.
+//
+// Each file is written to memory by a worker thread, starting at its
+// heading and stopping at the next one, and the files are then saved in
+// order, each after copying its images.  Since each heading starts a new
+// line, the only state carried from one file to the next is whether the
+// previous file ended in the middle of a line, so the output and messages
+// are the same as write_doc().
+//
+
+static int				// O - 1 if written, 0 to use write_doc()
+write_files(tree_t *document,		// I - Document tree
+	    uchar  *title,		// I - Title
+            uchar  *author,		// I - Author
+	    uchar  *copyright,		// I - Copyright
+	    uchar  *docnumber)		// I - Document number
+{
+#ifdef HAVE_OPEN_MEMSTREAM
+  size_t	i,			// Looping var
+		num_files,		// Number of files
+		next,			// Next file to start
+		window;			// Number of files to write ahead
+  tree_t	*t;			// Current node
+  hd_pool_t	*pool;			// Worker threads
+  hdsepfile_t	*files;			// Output files
+  FILE		*out;			// Output file
+  char		realname[1024];		// Output filename
+
+
+  // file_basename() uses a static buffer for names with a target...
+  if (num_headings == 0 || Threads == 1 || strchr(LogoImage, '#') || strchr(BodyImage, '#'))
+    return (0);
+
+  for (i = 0; i < MAX_HF_IMAGES; i ++)
+    if (strchr(HFImage[i], '#'))
+      return (0);
+
+  if ((pool = hd_pool_new(Threads)) == NULL)
+    return (0);
+  else if (hd_pool_threads(pool) < 2 || (files = (hdsepfile_t *)calloc(num_headings, sizeof(hdsepfile_t))) == NULL)
+  {
+    hd_pool_delete(pool);
+    return (0);
+  }
+
+  // Find the start of each file...
+  for (t = document, num_files = 0; t; t = next_node(t))
+  {
+    if (!is_split(t))
+      continue;
+
+    if (num_files >= num_headings)
+      break;
+
+    files[num_files].heading   = (int)num_files;
+    files[num_files].start     = t;
+    files[num_files].title     = title;
+    files[num_files].author    = author;
+    files[num_files].copyright = copyright;
+    files[num_files].docnumber = docnumber;
+
+    if (num_files > 0)
+      files[num_files - 1].end = t;
+
+    num_files ++;
+  }
+
+  if (t || num_files != num_headings)
+  {
+    hd_pool_delete(pool);
+    free(files);
+    return (0);
+  }
+
+  // Update image sources and build the entity strings before starting the
+  // threads, the images are copied as each file is saved...
+  for (t = files[0].start; t; t = next_node(t))
+    if (t->markup == MARKUP_IMG)
+      update_image(t, 0);
+
+  images_copied = 1;
+
+  iso8859((uchar)' ');
+
+  // Write the files in order as the threads finish them...
+  window = 4 * (size_t)hd_pool_threads(pool);
+
+  for (i = 0, next = 0; i < num_files; i ++)
+  {
+    for (; next < num_files && next < (i + window); next ++)
+      files[next].job = hd_job_add(pool, (hd_job_func_t)write_file, files + next);
+
+    hd_job_wait(files[i].job);
+
+    for (t = files[i].start; t != files[i].end; t = next_node(t))
+      if (t->markup == MARKUP_IMG && local_image(t))
+        image_copy((char *)htmlGetVariable(t, (uchar *)"SRC"), (char *)htmlGetVariable(t, (uchar *)"REALSRC"), OutputPath);
+
+    if (!files[i].data)
+    {
+      progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to write \"%s.html\".", headings[i]);
+      continue;
+    }
+
+    snprintf(realname, sizeof(realname), "%s/%s.html", OutputPath, file_basename((char *)headings[i]));
+
+    if ((out = fopen(realname, "wb")) == NULL)
+    {
+      progress_error(HD_ERROR_WRITE_ERROR, "Unable to create output file \"%s\" - %s.\n", realname, strerror(errno));
+    }
+    else
+    {
+      fwrite(files[i].data, 1, files[i].body, out);
+      if (i > 0 && files[i - 1].col > 0)
+        putc('\n', out);
+      fwrite(files[i].data + files[i].body, 1, files[i].length - files[i].body, out);
+
+      progress_error(HD_ERROR_NONE, "BYTES: %ld", ftell(out));
+
+      fclose(out);
+    }
+
+    free(files[i].data);
+  }
+
+  images_copied = 0;
+
+  hd_pool_delete(pool);
+  free(files);
+
+  return (1);
+
+#else
+  (void)document;
+  (void)title;
+  (void)author;
+  (void)copyright;
+  (void)docnumber;
+
+  return (0);
+#endif // HAVE_OPEN_MEMSTREAM
+}
+
+
+//
+// 'write_file()' - Write an output file to memory.
+//
+// This function runs in a worker thread.
+//
+
+static void
+write_file(hdsepfile_t *file)		// I - Output file
+{
+#ifdef HAVE_OPEN_MEMSTREAM
+  FILE	*out;				// Memory stream
+
+
+  if ((out = open_memstream(&file->data, &file->length)) == NULL)
+    return;
+
+  write_head(out, file->title, file->author, file->copyright, file->docnumber, file->heading);
+
+  fflush(out);
+  file->body = file->length;
+
+  file->col = write_range(out, file->start, file->end, 0);
+
+  write_foot(out, file->heading);
+
+  fclose(out);
+#else
+  (void)file;
+#endif // HAVE_OPEN_MEMSTREAM
+}
+
+
+//
+// 'write_range()' - Write the nodes from "t" up to "end".
+//
+// The nodes are visited in the same order as write_doc(), closing parent
+// nodes on the way back up the tree.
+//
+
+static int				// O - Current column
+write_range(FILE   *out,		// I - Output file
+            tree_t *t,			// I - First node
+	    tree_t *end,		// I - First node not to write or NULL
+	    int    col)			// I - Current column
+{
+  while (t && t != end)
+  {
+    col = write_node(out, t, col);
+
+    if (t->child && t->markup != MARKUP_HEAD && t->markup != MARKUP_TITLE)
+    {
+      t = t->child;
+      continue;
+    }
+
+    // Close this node and any parents that have no more children...
+    for (;;)
+    {
+      col = write_nodeclose(out, t, col);
+
+      if (t->next)
+      {
+        t = t->next;
+	break;
+      }
+
+      if ((t = t->parent) == NULL)
+        break;
+    }
+  }
+
+  return (col);
+}
+
+
 /*
  * 'write_node()' - Write a single tree node.
  */
@@ -572,10 +835,7 @@ write_node(FILE   *out,		/* I - Output file */
 {
   int		i;		/* Looping var */
   uchar		*ptr,		/* Pointer to output string */
-		*entity,	/* Entity string */
-		*src,		/* Source image */
-		*realsrc,	/* Real source image */
-		newsrc[1024];	/* New source image filename */
+		*entity;	/* Entity string */
 
 
   if (out == NULL)
@@ -674,23 +934,8 @@ write_node(FILE   *out,		/* I - Output file */
         }
 
     default :
-	if (t->markup == MARKUP_IMG &&
-            (src = htmlGetVariable(t, (uchar *)"SRC")) != NULL &&
-            (realsrc = htmlGetVariable(t, (uchar *)"REALSRC")) != NULL)
-	{
-	 /*
-          * Update local images...
-          */
-
-          if (file_method((char *)src) == NULL &&
-              src[0] != '/' && src[0] != '\\' &&
-	      (!isalpha(src[0]) || src[1] != ':'))
-          {
-            image_copy((char *)src, (char *)realsrc, OutputPath);
-            strlcpy((char *)newsrc, file_basename((char *)src), sizeof(newsrc));
-            htmlSetVariable(t, (uchar *)"SRC", newsrc);
-          }
-	}
+	if (t->markup == MARKUP_IMG && !images_copied)
+	  update_image(t);
 
         if (t->markup != MARKUP_EMBED)
 	{
@@ -897,6 +1142,79 @@ get_title(tree_t *doc)	/* I - Document tree */
 }
 
 
+//
+// 'next_node()' - Return the next node in the order used by write_doc().
+//
+
+static tree_t *				// O - Next node or NULL
+next_node(tree_t *t)			// I - Current node
+{
+  if (t->child && t->markup != MARKUP_HEAD && t->markup != MARKUP_TITLE)
+    return (t->child);
+
+  while (t && !t->next)
+    t = t->parent;
+
+  return (t ? t->next : NULL);
+}
+
+
+//
+// 'is_split()' - Determine whether a node starts a new output file.
+//
+
+static int				// O - 1 if the node starts a file
+is_split(tree_t *t)			// I - Node
+{
+  return (t->markup >= MARKUP_H1 && t->markup < (MARKUP_H1 + TocLevels) &&
+          htmlGetVariable(t, (uchar *)"_HD_OMIT_TOC") == NULL);
+}
+
+
+//
+// 'local_image()' - Get the source of a local image.
+//
+
+static uchar *				// O - Image source or NULL if not local
+local_image(tree_t *t)			// I - Image node
+{
+  uchar	*src;				// Source image
+
+
+  if ((src = htmlGetVariable(t, (uchar *)"SRC")) != NULL &&
+      htmlGetVariable(t, (uchar *)"REALSRC") != NULL &&
+      file_method((char *)src) == NULL &&
+      src[0] != '/' && src[0] != '\\' &&
+      (!isalpha(src[0]) || src[1] != ':'))
+    return (src);
+  else
+    return (NULL);
+}
+
+
+//
+// 'update_image()' - Copy a local image and update its source.
+//
+
+static void
+update_image(tree_t *t,			// I - Image node
+             int    copy)		// I - Copy the image file?
+{
+  uchar	*src,				// Source image
+	newsrc[1024];			// New source image filename
+
+
+  if ((src = local_image(t)) != NULL)
+  {
+    if (copy)
+      image_copy((char *)src, (char *)htmlGetVariable(t, (uchar *)"REALSRC"), OutputPath);
+
+    strlcpy((char *)newsrc, file_basename((char *)src), sizeof(newsrc));
+    htmlSetVariable(t, (uchar *)"SRC", newsrc);
+  }
+}
+
+
 //
 // 'add_heading()' - Add a heading to the list of headings...
 //
@@ -991,7 +1309,7 @@ static void
 add_link(uchar *name)		/* I - Name of link */
 {
   uchar		*filename;	/* File for link */
-  link_t	*temp;		/* New name */
+  hd_link_t	*temp;		/* New name */
 
 
   if (num_headings)
@@ -999,43 +1317,15 @@ add_link(uchar *name)		/* I - Name of link */
   else
     filename = (uchar *)"noheading";
 
-  if ((temp = find_link(name)) != NULL)
-    temp->filename = filename;
-  else
+  if ((temp = hd_links_add(links, (char *)name)) == NULL)
   {
-    // See if we need to allocate memory for links...
-    if (num_links >= alloc_links)
-    {
-      // Allocate more links...
-      alloc_links += ALLOC_LINKS;
-
-      if (num_links == 0)
-        temp = (link_t *)malloc(sizeof(link_t) * alloc_links);
-      else
-        temp = (link_t *)realloc(links, sizeof(link_t) * alloc_links);
-
-      if (temp == NULL)
-      {
-	progress_error(HD_ERROR_OUT_OF_MEMORY,
-	               "Unable to allocate memory for %d links - %s",
-	               (int)alloc_links, strerror(errno));
-        alloc_links -= ALLOC_LINKS;
-	return;
-      }
-
-      links = temp;
-    }
-
-    // Add a new link...
-    temp = links + num_links;
-    num_links ++;
-
-    strlcpy((char *)temp->name, (char *)name, sizeof(temp->name));
-    temp->filename = filename;
-
-    if (num_links > 1)
-      qsort(links, num_links, sizeof(link_t), (compare_func_t)compare_links);
+    progress_error(HD_ERROR_OUT_OF_MEMORY,
+                   "Unable to allocate memory for %d links - %s",
+                   (int)hd_links_count(links) + 1, strerror(errno));
+    return;
   }
+
+  temp->filename = filename;
 }
 
 
@@ -1043,38 +1333,16 @@ add_link(uchar *name)		/* I - Name of link */
  * 'find_link()' - Find a named link...
  */
 
-static link_t *
+static hd_link_t *
 find_link(uchar *name)		/* I - Name to find */
 {
   uchar		*target;	/* Pointer to target name portion */
-  link_t	key,		/* Search key */
-		*match;		/* Matching name entry */
 
 
-  if (name == NULL || num_links == 0)
-    return (NULL);
-
   if ((target = (uchar *)file_target((char *)name)) == NULL)
     return (NULL);
 
-  strlcpy((char *)key.name, (char *)target, sizeof(key.name));
-  key.name[sizeof(key.name) - 1] = '\0';
-  match = (link_t *)bsearch(&key, links, num_links, sizeof(link_t),
-                            (compare_func_t)compare_links);
-
-  return (match);
-}
-
-
-/*
- * 'compare_links()' - Compare two named links.
- */
-
-static int			/* O - 0 = equal, -1 or 1 = not equal */
-compare_links(link_t *n1,	/* I - First name */
-              link_t *n2)	/* I - Second name */
-{
-  return (strcasecmp((char *)n1->name, (char *)n2->name));
+  return (hd_links_find(links, (char *)target));
 }
 
 
@@ -1115,7 +1383,7 @@ static void
 update_links(tree_t *t,		/* I - Document tree */
              int    *heading)	/* I - Current heading */
 {
-  link_t	*link;		/* Link */
+  hd_link_t	*link;		/* Link */
   uchar		*href;		/* Reference name */
   uchar		newhref[1024];	/* New reference name */
   uchar		*filename;	/* Current filename */
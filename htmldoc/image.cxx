@@ -13,6 +13,8 @@
  */
 
 #include "htmldoc.h"
+#include "md5-private.h"
+#include "thread.h"
 #include <setjmp.h>
 
 #ifdef HAVE_LIBJPEG
@@ -31,6 +33,49 @@ extern "C" {		/* Workaround for JPEG header problems... */
  */
 
 #define IMAGE_MAX_DIM	37837		// Maximum dimension - sqrt(4GiB / 3)
+#define IMAGE_PREFETCH_MAX (256 * 1024 * 1024)
+					// Maximum bytes decoded ahead of use
+#define IMAGE_LOAD_QUIET 2		// Load image data without error messages
+#define IMAGE_HASH_BUCKETS 256		// Initial number of hash buckets
+#define IMAGE_PALETTE_SIZE 512		// Slots in palette hash, must be > 2 * 256
+
+
+/*
+ * Cache index definitions...
+ */
+
+typedef struct image_key_s		// Image cache key
+{
+  struct image_key_s *next;		// Next key in hash bucket
+  unsigned	hash;			// Hash of key
+  char		*key;			// Filename or MD5 digest of file
+  image_t	*img;			// Image
+} image_key_t;
+
+typedef struct image_hash_s		// Image cache index
+{
+  image_key_t	**buckets;		// Hash buckets
+  size_t	num_buckets,		// Number of hash buckets
+		num_keys;		// Number of keys
+} image_hash_t;
+
+
+/*
+ * Prefetch definitions...
+ */
+
+typedef struct image_prefetch_s		// Background image decode
+{
+  struct image_prefetch_s *next;	// Next decode waiting to be queued
+  image_t	*img,			// Cached image
+		decoded;		// Decoded copy of image
+  char		realname[1024];		// File to decode
+  FILE		*fp;			// Memory stream for data URI, if any
+  int		gray,			// Decode as grayscale?
+		status;			// Status of decode
+  size_t	bytes;			// Expected size of pixels
+  hd_job_t	*job;			// Decode job, if queued
+} image_prefetch_t;
 
 
 /*
@@ -62,7 +107,23 @@ typedef uchar	gif_cmap_t[256][3];
 static size_t	num_images = 0,		/* Number of images in cache */
 		alloc_images = 0;	/* Allocated images */
 static image_t	**images = NULL;	/* Images in cache */
+static int	images_sorted = 1;	/* Are images sorted by filename? */
+static hd_arena_t *image_keys = NULL;	/* Memory for cache keys */
+static image_hash_t image_names = { NULL, 0, 0 },
+					/* Images by filename */
+		image_digests = { NULL, 0, 0 };
+					/* Images by MD5 digest of file */
 static int	gif_eof = 0;		/* Did we hit EOF? */
+static hd_pool_t *prefetch_pool = NULL;	/* Threads for decoding images */
+static int	prefetch_disabled = 0;	/* Don't decode in the background? */
+static image_prefetch_t *prefetch_first = NULL,
+					/* First decode waiting to be queued */
+		*prefetch_last = NULL;	/* Last decode waiting to be queued */
+static size_t	prefetch_bytes = 0;	/* Bytes queued or decoded ahead */
+static size_t	pixel_bytes = 0,	/* Bytes of decoded pixels and masks */
+		pixel_peak = 0,		/* Most bytes of pixels and masks */
+		pixel_clock = 0;	/* Counter for least recently used */
+static int	pixel_evicted = 0;	/* Number of pixel buffers evicted */
 
 
 /*
@@ -78,6 +139,12 @@ static int	gif_read_image(FILE *fp, image_t *img, gif_cmap_t cmap,
 static int	gif_read_lzw(FILE *fp, int first_time, int input_code_size);
 
 static int	image_compare(image_t **img1, image_t **img2);
+static int	image_compare_colors(unsigned *a, unsigned *b);
+static void	image_digest(FILE *fp, char *digest, size_t digestsize);
+static int	image_hash_add(image_hash_t *h, const char *key, image_t *img);
+static void	image_hash_clear(image_hash_t *h);
+static image_t	*image_hash_find(image_hash_t *h, const char *key);
+static unsigned	image_hash_key(const char *key);
 static int	image_load_bmp(image_t *img, FILE *fp, int gray, int load_data);
 static int	image_load_gif(image_t *img, FILE *fp, int gray, int load_data);
 
@@ -90,6 +157,13 @@ static void	jpeg_error_handler(j_common_ptr);
 static int	image_load_png(image_t *img, FILE *fp, int gray, int load_data);
 #endif // HAVE_LIBPNG
 
+static size_t	image_mask_bytes(image_t *img);
+static void	image_pixels_free(image_t *img);
+static void	image_pixels_used(image_t *img);
+static int	image_prefetch_finish(image_t *img, int gray);
+static void	image_prefetch_image(image_prefetch_t *p);
+static void	image_prefetch_queue(void);
+
 static void	image_need_mask(image_t *img, int scaling = 1);
 static void	image_set_mask(image_t *img, int x, int y, uchar alpha = 0);
 
@@ -543,6 +617,18 @@ image_compare(image_t **img1,	/* I - First image */
 }
 
 
+/*
+ * 'image_compare_colors()' - Compare two 0xRRGGBB colors...
+ */
+
+static int			/* O - Result of comparison */
+image_compare_colors(unsigned *a,	/* I - First color */
+                     unsigned *b)	/* I - Second color */
+{
+  return (*a < *b ? -1 : *a > *b);
+}
+
+
 /*
  * 'image_copy()' - Copy image files to the destination directory...
  */
@@ -577,7 +663,7 @@ image_copy(const char *src,		/* I - Source file */
   * Open files and copy...
   */
 
-  if ((in = fopen(realsrc, "rb")) == NULL)
+  if ((in = file_open(realsrc, "rb")) == NULL)
   {
     progress_error(HD_ERROR_READ_ERROR, "Unable to open \"%s\" - %s",
                    realsrc, strerror(errno));
@@ -602,6 +688,38 @@ image_copy(const char *src,		/* I - Source file */
 }
 
 
+/*
+ * 'image_digest()' - Compute the MD5 digest of an image file.
+ *
+ * The file is rewound afterwards.
+ */
+
+static void
+image_digest(FILE   *fp,		/* I - File to read from */
+             char   *digest,		/* O - Hex digest string */
+	     size_t digestsize)		/* I - Size of digest string */
+{
+  _cups_md5_state_t	md5;		/* MD5 state */
+  uchar			buffer[8192],	/* Read buffer */
+			sum[16];	/* MD5 sum */
+  size_t		bytes;		/* Bytes read */
+  int			i;		/* Looping var */
+
+
+  _cupsMD5Init(&md5);
+
+  while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    _cupsMD5Append(&md5, buffer, (int)bytes);
+
+  _cupsMD5Finish(&md5, sum);
+
+  for (i = 0; i < 16 && (size_t)(2 * i + 2) < digestsize; i ++)
+    snprintf(digest + 2 * i, 3, "%02x", sum[i]);
+
+  rewind(fp);
+}
+
+
 /*
  * 'image_find()' - Find an image file in memory...
  */
@@ -610,9 +728,7 @@ image_t *			/* O - Pointer to image */
 image_find(const char *filename,/* I - Name of image file */
            int        load_data)/* I - 1 = load image data */
 {
-  image_t	key,		/* Search key... */
-		*keyptr,	/* Pointer to search key... */
-		**match;	/* Matching image */
+  image_t	*match;		/* Matching image */
 
 
  /*
@@ -629,20 +745,12 @@ image_find(const char *filename,/* I - Name of image file */
   * See if we've already loaded it...
   */
 
-  if (num_images > 0)
+  if ((match = image_hash_find(&image_names, filename)) != NULL)
   {
-    strlcpy(key.filename, filename, sizeof(key.filename));
-    keyptr = &key;
-
-    match = (image_t **)bsearch(&keyptr, images, (size_t)num_images, sizeof(image_t *),
-                                (int (*)(const void *, const void *))image_compare);
-    if (match != NULL)
-    {
-      if (load_data && !(*match)->pixels)
-        return (image_load((*match)->filename, (*match)->depth == 1, 1));
-      else
-        return (*match);
-    }
+    if (load_data && !match->pixels)
+      return (image_load(match->filename, match->depth == 1, 1));
+    else
+      return (match);
   }
 
   return (NULL);
@@ -659,6 +767,22 @@ image_flush_cache(void)
   size_t	i;			/* Looping var */
 
 
+ /*
+  * Stop any background decoding...
+  */
+
+  prefetch_first = prefetch_last = NULL;
+
+  for (i = 0; i < num_images; i ++)
+    if (images[i]->prefetch)
+      image_prefetch_finish(images[i], -1);
+
+  hd_pool_delete(prefetch_pool);
+
+  prefetch_pool     = NULL;
+  prefetch_disabled = 0;
+  prefetch_bytes    = 0;
+
  /*
   * Free the memory used by each image...
   */
@@ -671,6 +795,9 @@ image_flush_cache(void)
     if (images[i]->pixels)
       free(images[i]->pixels);
 
+    if (images[i]->colors)
+      free(images[i]->colors);
+
     free(images[i]);
   }
 
@@ -681,7 +808,17 @@ image_flush_cache(void)
     alloc_images = 0;
   }
 
-  num_images = 0;
+  num_images    = 0;
+  images_sorted = 1;
+  pixel_bytes   = 0;
+  pixel_peak    = 0;
+  pixel_evicted = 0;
+
+  image_hash_clear(&image_names);
+  image_hash_clear(&image_digests);
+
+  hd_arena_delete(image_keys);
+  image_keys = NULL;
 }
 
 
@@ -692,11 +829,151 @@ image_flush_cache(void)
 int				/* O - Number of images in array */
 image_getlist(image_t ***ptrs)	/* O - Pointer to images array */
 {
+  if (!images_sorted)
+  {
+    qsort(images, num_images, sizeof(image_t *),
+          (int (*)(const void *, const void *))image_compare);
+
+    images_sorted = 1;
+  }
+
   *ptrs = images;
   return (num_images);
 }
 
 
+/*
+ * 'image_hash_add()' - Add a key to a cache index.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+image_hash_add(image_hash_t *h,		/* I - Cache index */
+               const char   *key,	/* I - Filename or digest */
+	       image_t      *img)	/* I - Image */
+{
+  image_key_t	*k,			/* New key */
+		**buckets,		/* New hash buckets */
+		*next;			/* Next key in old bucket */
+  size_t	i,			/* Looping var */
+		num_buckets;		/* New number of hash buckets */
+
+
+ /*
+  * Grow the hash table as needed to keep the chains short...
+  */
+
+  if (h->num_keys >= h->num_buckets)
+  {
+    num_buckets = h->num_buckets ? 2 * h->num_buckets : IMAGE_HASH_BUCKETS;
+
+    if ((buckets = (image_key_t **)calloc(num_buckets, sizeof(image_key_t *))) == NULL)
+      return (0);
+
+    for (i = 0; i < h->num_buckets; i ++)
+      for (k = h->buckets[i]; k; k = next)
+      {
+        next = k->next;
+	k->next = buckets[k->hash & (num_buckets - 1)];
+	buckets[k->hash & (num_buckets - 1)] = k;
+      }
+
+    free(h->buckets);
+
+    h->buckets     = buckets;
+    h->num_buckets = num_buckets;
+  }
+
+ /*
+  * Add the new key...
+  */
+
+  if (!image_keys && (image_keys = hd_arena_new(0)) == NULL)
+    return (0);
+
+  if ((k = (image_key_t *)hd_arena_alloc(image_keys, sizeof(image_key_t))) == NULL)
+    return (0);
+
+  if ((k->key = hd_arena_strdup(image_keys, key)) == NULL)
+    return (0);
+
+  k->img  = img;
+  k->hash = image_hash_key(key);
+  k->next = h->buckets[k->hash & (h->num_buckets - 1)];
+
+  h->buckets[k->hash & (h->num_buckets - 1)] = k;
+  h->num_keys ++;
+
+  return (1);
+}
+
+
+/*
+ * 'image_hash_clear()' - Remove all keys from a cache index.
+ *
+ * The keys themselves are freed with the image_keys arena.
+ */
+
+static void
+image_hash_clear(image_hash_t *h)	/* I - Cache index */
+{
+  free(h->buckets);
+
+  h->buckets     = NULL;
+  h->num_buckets = 0;
+  h->num_keys    = 0;
+}
+
+
+/*
+ * 'image_hash_find()' - Find an image in a cache index.
+ */
+
+static image_t *			/* O - Image or NULL */
+image_hash_find(image_hash_t *h,	/* I - Cache index */
+                const char   *key)	/* I - Filename or digest */
+{
+  image_key_t	*k;			/* Current key */
+  unsigned	hash;			/* Hash of key */
+
+
+  if (h->num_keys == 0)
+    return (NULL);
+
+  hash = image_hash_key(key);
+
+  for (k = h->buckets[hash & (h->num_buckets - 1)]; k; k = k->next)
+#ifdef WIN32
+    if (k->hash == hash && !strcasecmp(k->key, key))
+#else
+    if (k->hash == hash && !strcmp(k->key, key))
+#endif /* WIN32 */
+      return (k->img);
+
+  return (NULL);
+}
+
+
+/*
+ * 'image_hash_key()' - Compute the hash of a cache key.
+ */
+
+static unsigned				/* O - Hash value */
+image_hash_key(const char *key)		/* I - Filename or digest */
+{
+  unsigned	hash;			/* Hash value */
+
+
+  for (hash = 2166136261U; *key; key ++)
+#ifdef WIN32
+    hash = (hash ^ (unsigned)tolower(*key & 255)) * 16777619U;
+#else
+    hash = (hash ^ (unsigned)(*key & 255)) * 16777619U;
+#endif /* WIN32 */
+
+  return (hash);
+}
+
+
 /*
  * 'image_load()' - Load an image file from disk...
  */
@@ -712,12 +989,12 @@ image_load(const char *filename,/* I - Name of image file */
   FILE		*fp;		/* File pointer */
   uchar		header[16];	/* First 16 bytes of file */
   image_t	*img,		/* New image buffer */
-		key,		/* Search key... */
-		*keyptr,	/* Pointer to search key... */
-		**match,	/* Matching image */
+		*match,		/* Matching image */
 		**temp;		/* Temporary array pointer */
   int		status;		/* Status of load... */
   const char	*realname;	/* Real filename */
+  char		digest[33];	/* MD5 digest of file */
+  uchar		*mask;		/* Mask before loading */
 
 
  /*
@@ -738,21 +1015,25 @@ image_load(const char *filename,/* I - Name of image file */
   * See if we've already loaded it...
   */
 
-  if (num_images > 0)
+  if ((match = image_hash_find(&image_names, filename)) != NULL)
   {
-    strlcpy(key.filename, filename, sizeof(key.filename));
-    keyptr = &key;
-
-    match = (image_t **)bsearch(&keyptr, images, (size_t)num_images, sizeof(image_t *),
-                                (int (*)(const void *, const void *))image_compare);
-    if (match != NULL && (!load_data || (*match)->pixels))
+    if (!load_data || match->pixels)
     {
-      (*match)->use ++;
-      return (*match);
+      match->use ++;
+      return (match);
     }
+
+    if (match->prefetch && image_prefetch_finish(match, gray))
+      return (match);
+  }
+  else if (progress_cancelled())
+  {
+   /*
+    * Don't start on new images once the conversion has been cancelled...
+    */
+
+    return (NULL);
   }
-  else
-    match = NULL;
 
  /*
   * Figure out the file type...
@@ -765,7 +1046,7 @@ image_load(const char *filename,/* I - Name of image file */
     return (NULL);
   }
 
-  if ((fp = fopen(realname, "rb")) == NULL)
+  if ((fp = file_open(realname, "rb")) == NULL)
   {
     progress_error(HD_ERROR_FILE_NOT_FOUND,
                    "Unable to open image file \"%s\" (%s) for reading!",
@@ -797,6 +1078,31 @@ image_load(const char *filename,/* I - Name of image file */
 
   rewind(fp);
 
+  if (!match)
+  {
+    // See if the same file is already cached under another name...
+    image_digest(fp, digest, sizeof(digest));
+
+    if ((img = image_hash_find(&image_digests, digest)) != NULL)
+    {
+      fclose(fp);
+
+      if (!image_hash_add(&image_names, filename, img))
+      {
+	progress_error(HD_ERROR_OUT_OF_MEMORY,
+	               "Unable to allocate memory for \"%s\"", filename);
+        return (NULL);
+      }
+
+      img->use ++;
+
+      if (load_data && !img->pixels)
+        return (image_load(img->filename, gray, 1));
+      else
+        return (img);
+    }
+  }
+
   // See if the images array needs to be resized...
   if (!match)
   {
@@ -839,9 +1145,13 @@ image_load(const char *filename,/* I - Name of image file */
     img->use = 1;
   }
   else
-    img = *match;
+    img = match;
 
   // Load the image as appropriate...
+  hd_stats_begin(HD_PHASE_IMAGE);
+
+  mask = img->mask;
+
   if (memcmp(header, "GIF87a", 6) == 0 ||
       memcmp(header, "GIF89a", 6) == 0)
     status = image_load_gif(img,  fp, gray, load_data);
@@ -859,11 +1169,14 @@ image_load(const char *filename,/* I - Name of image file */
   {
     progress_error(HD_ERROR_BAD_FORMAT, "Unknown image file format for \"%s\".",
                    file_rlookup(filename));
+    hd_stats_end();
     fclose(fp);
     free(img);
     return (NULL);
   }
 
+  hd_stats_end();
+
   fclose(fp);
 
   if (status)
@@ -875,12 +1188,26 @@ image_load(const char *filename,/* I - Name of image file */
     return (NULL);
   }
 
+  // Masks are kept until the cache is flushed, so count each one once...
+  if (img->mask && img->mask != mask)
+    pixel_bytes += image_mask_bytes(img);
+
+  if (img->pixels)
+    image_pixels_used(img);
+  else if (pixel_bytes > pixel_peak)
+    pixel_peak = pixel_bytes;
+
   if (!match)
   {
+    if (!image_hash_add(&image_names, filename, img) ||
+        !image_hash_add(&image_digests, digest, img))
+      progress_error(HD_ERROR_OUT_OF_MEMORY,
+                     "Unable to allocate memory for \"%s\"", filename);
+
     num_images ++;
-    if (num_images > 1)
-      qsort(images, num_images, sizeof(image_t *),
-            (int (*)(const void *, const void *))image_compare);
+    images_sorted = 0;
+
+    hd_stats_add(HD_COUNT_IMAGES, 1);
   }
 
   return (img);
@@ -1398,7 +1725,7 @@ static int			/* O - 0 = success, -1 = fail */
 image_load_jpeg(image_t *img,	/* I - Image pointer */
                 FILE    *fp,	/* I - File to load from */
                 int     gray,	/* I - 0 = color, 1 = grayscale */
-                int     load_data)/* I - 1 = load image data, 0 = just info */
+                int     load_data)/* I - 1 = load image data, 0 = just info, 2 = quietly */
 {
   struct jpeg_decompress_struct	cinfo;		/* Decompressor info */
   hd_jpeg_err_t			jerr;		// JPEG error handler
@@ -1410,7 +1737,8 @@ JSAMPROW			row;		/* Sample row pointer */
 
   if (setjmp(jerr.retbuf))
   {
-    progress_error(HD_ERROR_BAD_FORMAT, "%s (%s)", jerr.message,  file_rlookup(img->filename));
+    if (load_data != IMAGE_LOAD_QUIET)
+      progress_error(HD_ERROR_BAD_FORMAT, "%s (%s)", jerr.message,  file_rlookup(img->filename));
     jpeg_destroy_decompress(&cinfo);
     return (-1);
   }
@@ -1432,9 +1760,10 @@ JSAMPROW			row;		/* Sample row pointer */
   {
     jpeg_destroy_decompress(&cinfo);
 
-    progress_error(HD_ERROR_BAD_FORMAT,
-                   "CMYK JPEG files are not supported! (%s)",
-		   file_rlookup(img->filename));
+    if (load_data != IMAGE_LOAD_QUIET)
+      progress_error(HD_ERROR_BAD_FORMAT,
+                     "CMYK JPEG files are not supported! (%s)",
+		     file_rlookup(img->filename));
     return (-1);
   }
   else
@@ -1444,6 +1773,14 @@ JSAMPROW			row;		/* Sample row pointer */
     cinfo.output_components    = 3;
   }
 
+  // See if the compressed data can be copied to the output file as-is...
+  if (cinfo.data_precision != 8 || cinfo.arith_code || (gray && cinfo.num_components != 1))
+    img->jpeg = 0;
+  else if (cinfo.jpeg_color_space == JCS_GRAYSCALE || cinfo.jpeg_color_space == JCS_YCbCr)
+    img->jpeg = cinfo.progressive_mode ? 2 : 1;
+  else
+    img->jpeg = 0;
+
   jpeg_calc_output_dimensions(&cinfo);
 
   img->width  = (int)cinfo.output_width;
@@ -1495,7 +1832,7 @@ static int			/* O - 0 = success, -1 = fail */
 image_load_png(image_t *img,	/* I - Image pointer */
                FILE    *fp,	/* I - File to read from */
                int     gray,	/* I - 0 = color, 1 = grayscale */
-               int     load_data)/* I - 1 = load image data, 0 = just info */
+               int     load_data)/* I - 1 = load image data, 0 = just info, 2 = quietly */
 {
   int		i, j;		/* Looping vars */
   png_structp	pp;		/* PNG read pointer */
@@ -1515,16 +1852,18 @@ image_load_png(image_t *img,	/* I - Image pointer */
   pp = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
   if (!pp)
   {
-    progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for PNG file: %s",
-                   strerror(errno));
+    if (load_data != IMAGE_LOAD_QUIET)
+      progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for PNG file: %s",
+                     strerror(errno));
     return (-1);
   }
 
   info = png_create_info_struct(pp);
   if (!info)
   {
-    progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for PNG info: %s",
-                   strerror(errno));
+    if (load_data != IMAGE_LOAD_QUIET)
+      progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for PNG info: %s",
+                     strerror(errno));
 
     png_destroy_read_struct(&pp, NULL, NULL);
 
@@ -1533,7 +1872,8 @@ image_load_png(image_t *img,	/* I - Image pointer */
 
   if (setjmp(png_jmpbuf(pp)))
   {
-    progress_error(HD_ERROR_BAD_FORMAT, "PNG file contains errors!");
+    if (load_data != IMAGE_LOAD_QUIET)
+      progress_error(HD_ERROR_BAD_FORMAT, "PNG file contains errors!");
 
     png_destroy_read_struct(&pp, &info, NULL);
 
@@ -1774,19 +2114,437 @@ image_need_mask(image_t *img,		/* I - Image to add mask to */
   {
     // Alpha image
     img->maskwidth = img->width;
-    size           = (size_t)(img->width * img->height);
   }
   else
   {
     // Alpha mask
     img->maskwidth = (img->width * scaling + 7) / 8;
-    size           = (size_t)(img->maskwidth * img->height * scaling + 1);
   }
 
+  size      = image_mask_bytes(img);
   img->mask = (uchar *)calloc(size, 1);
 }
 
 
+/*
+ * 'image_palette()' - Get the distinct colors used by an image.
+ *
+ * Up to 256 colors are copied to "colors" in ascending 0xRRGGBB order; gray
+ * levels are returned as 0xLLLLLL.  The result is kept with the image, so
+ * the pixels are only examined the first time.  Returns 0 when the image has
+ * more than 256 colors or no pixels are loaded.
+ */
+
+int					/* O - Number of colors or 0 */
+image_palette(image_t  *img,		/* I - Image */
+              unsigned *colors)		/* O - Colors (256 entries) */
+{
+  int		i,			/* Looping var */
+		ncolors;		/* Number of colors */
+  size_t	count;			/* Number of pixels left */
+  const uchar	*pixel;			/* Current pixel */
+  unsigned	key,			/* Current color */
+		last,			/* Previous color */
+		slot,			/* Hash slot */
+		table[IMAGE_PALETTE_SIZE];
+					/* Open-addressed color hash */
+  uchar		grays[256];		/* Gray levels found */
+
+
+  if (!img)
+    return (0);
+
+  if (img->ncolors == 0 && img->pixels)
+  {
+    count   = (size_t)img->width * (size_t)img->height;
+    ncolors = 0;
+
+    if (img->depth == 1)
+    {
+     /*
+      * Grayscale images have at most 256 levels, so just mark them...
+      */
+
+      memset(grays, 0, sizeof(grays));
+
+      for (pixel = img->pixels; count > 0 && ncolors < 256; count --, pixel ++)
+        if (!grays[*pixel])
+        {
+          grays[*pixel] = 1;
+          ncolors ++;
+        }
+
+      for (i = 0, ncolors = 0; i < 256; i ++)
+        if (grays[i])
+          table[ncolors ++] = (unsigned)i * 0x010101;
+    }
+    else
+    {
+     /*
+      * Color images use a small hash that is never more than half full, and
+      * runs of the same color skip the hash entirely.  Stop as soon as a
+      * 257th color is seen...
+      */
+
+      memset(table, 255, sizeof(table));
+
+      for (pixel = img->pixels, last = 0xffffffff; count > 0; count --, pixel += 3)
+      {
+        key = ((unsigned)pixel[0] << 16) | ((unsigned)pixel[1] << 8) | pixel[2];
+
+        if (key == last)
+          continue;
+
+        last = key;
+
+        for (slot = (key * 2654435761U) >> 23;
+             table[slot] != key && table[slot] != 0xffffffff;
+             slot = (slot + 1) & (IMAGE_PALETTE_SIZE - 1));
+
+        if (table[slot] == key)
+          continue;
+
+        if (ncolors >= 256)
+        {
+          ncolors = -1;
+          break;
+        }
+
+        table[slot] = key;
+        ncolors ++;
+      }
+
+      if (ncolors > 0)
+      {
+        for (slot = 0, i = 0; slot < IMAGE_PALETTE_SIZE; slot ++)
+          if (table[slot] != 0xffffffff)
+            table[i ++] = table[slot];
+
+        qsort(table, (size_t)ncolors, sizeof(unsigned),
+              (int (*)(const void *, const void *))image_compare_colors);
+      }
+    }
+
+    if (ncolors > 0)
+    {
+      if ((img->colors = (unsigned *)malloc((size_t)ncolors * sizeof(unsigned))) == NULL)
+        return (0);
+
+      memcpy(img->colors, table, (size_t)ncolors * sizeof(unsigned));
+    }
+
+    img->ncolors = ncolors;
+  }
+
+  if (img->ncolors <= 0)
+    return (0);
+
+  memcpy(colors, img->colors, (size_t)img->ncolors * sizeof(unsigned));
+
+  return (img->ncolors);
+}
+
+
+/*
+ * 'image_mask_bytes()' - Get the byte size of an image mask.
+ */
+
+static size_t				/* O - Bytes of mask data */
+image_mask_bytes(image_t *img)		/* I - Image */
+{
+  if (img->maskscale == 8)
+    return ((size_t)(img->width * img->height));
+  else
+    return ((size_t)(img->maskwidth * img->height * img->maskscale + 1));
+}
+
+
+/*
+ * 'image_pixels_free()' - Free the decoded pixels of an image.
+ */
+
+static void
+image_pixels_free(image_t *img)		/* I - Image */
+{
+  pixel_bytes -= (size_t)img->width * (size_t)img->height * (size_t)img->depth;
+
+  free(img->pixels);
+  img->pixels = NULL;
+}
+
+
+/*
+ * 'image_pixels_used()' - Account for newly decoded pixels.
+ *
+ * When the pixels of all images exceed the ImageCache limit, the pixels of the
+ * least recently used images are freed; image_load() decodes them again if
+ * they are needed.  The peak is recorded after any pixels are freed.
+ */
+
+static void
+image_pixels_used(image_t *img)		/* I - Image with new pixels */
+{
+  size_t	i;			/* Looping var */
+  image_t	*oldest;		/* Least recently used image */
+
+
+  pixel_bytes += (size_t)img->width * (size_t)img->height * (size_t)img->depth;
+  img->lru    = ++ pixel_clock;
+
+  while (ImageCache > 0 && pixel_bytes > (size_t)ImageCache * 1024 * 1024)
+  {
+    for (i = 0, oldest = NULL; i < num_images; i ++)
+      if (images[i] != img && images[i]->pixels &&
+          (!oldest || images[i]->lru < oldest->lru))
+        oldest = images[i];
+
+    if (!oldest)
+      break;
+
+    image_pixels_free(oldest);
+    pixel_evicted ++;
+  }
+
+  if (pixel_bytes > pixel_peak)
+    pixel_peak = pixel_bytes;
+}
+
+
+/*
+ * 'image_prefetch()' - Start decoding the pixels of an image in the background.
+ *
+ * Images are decoded in the order they are added, with at most
+ * IMAGE_PREFETCH_MAX bytes of pixels (or half of the ImageCache limit) decoded
+ * ahead of image_load().  Nothing is done unless there are at least two worker
+ * threads.
+ */
+
+void
+image_prefetch(image_t *img,		/* I - Image from image_load() */
+               int     gray)		/* I - 0 = color, 1 = grayscale */
+{
+  image_prefetch_t	*p;		/* New decode */
+  const char		*realname;	/* Real filename */
+
+
+  if (!img || img->pixels || img->prefetch || img->obj || prefetch_disabled)
+    return;
+
+  if (!prefetch_pool)
+  {
+    if (Threads == 1 || (prefetch_pool = hd_pool_new(Threads)) == NULL)
+    {
+      prefetch_disabled = 1;
+      return;
+    }
+    else if (hd_pool_threads(prefetch_pool) < 2)
+    {
+      hd_pool_delete(prefetch_pool);
+
+      prefetch_pool     = NULL;
+      prefetch_disabled = 1;
+      return;
+    }
+  }
+
+  if ((realname = file_find(Path, img->filename)) == NULL)
+    return;
+
+  if ((p = (image_prefetch_t *)calloc(1, sizeof(image_prefetch_t))) == NULL)
+    return;
+
+  p->img    = img;
+  p->gray   = gray;
+  p->status = -1;
+  p->bytes  = (size_t)img->width * (size_t)img->height * (size_t)img->depth;
+
+  strlcpy(p->realname, realname, sizeof(p->realname));
+  strlcpy(p->decoded.filename, img->filename, sizeof(p->decoded.filename));
+
+  img->prefetch = p;
+
+  if (prefetch_last)
+    prefetch_last->next = p;
+  else
+    prefetch_first = p;
+
+  prefetch_last = p;
+
+  image_prefetch_queue();
+}
+
+
+/*
+ * 'image_prefetch_finish()' - Wait for a background decode and use its pixels.
+ *
+ * Passing -1 for "gray" discards the decoded pixels.
+ */
+
+static int				/* O - 1 if the image has pixels, 0 otherwise */
+image_prefetch_finish(image_t *img,	/* I - Image */
+                      int     gray)	/* I - 0 = color, 1 = grayscale */
+{
+  image_prefetch_t	*p = img->prefetch,
+					/* Background decode */
+			*prev;		/* Previous waiting decode */
+
+
+  if (p->job)
+  {
+    hd_job_wait(p->job);
+
+    prefetch_bytes -= p->bytes;
+  }
+  else if (prefetch_first == p)
+  {
+    if ((prefetch_first = p->next) == NULL)
+      prefetch_last = NULL;
+  }
+  else
+  {
+   /*
+    * Not queued yet, remove it from the waiting list...
+    */
+
+    for (prev = prefetch_first; prev && prev->next != p; prev = prev->next);
+
+    if (prev && (prev->next = p->next) == NULL)
+      prefetch_last = prev;
+  }
+
+  if (!p->status && p->gray == gray && !img->pixels)
+  {
+    img->width  = p->decoded.width;
+    img->height = p->decoded.height;
+    img->depth  = p->decoded.depth;
+    img->use    += p->decoded.use;
+    img->pixels = p->decoded.pixels;
+
+    if (p->decoded.mask)
+    {
+      if (img->mask)
+      {
+        pixel_bytes -= image_mask_bytes(img);
+        free(img->mask);
+      }
+
+      img->mask      = p->decoded.mask;
+      img->maskwidth = p->decoded.maskwidth;
+      img->maskscale = p->decoded.maskscale;
+      pixel_bytes    += image_mask_bytes(img);
+    }
+
+    image_pixels_used(img);
+  }
+  else
+  {
+    free(p->decoded.pixels);
+    free(p->decoded.mask);
+  }
+
+  free(p);
+  img->prefetch = NULL;
+
+  image_prefetch_queue();
+
+  return (img->pixels != NULL);
+}
+
+
+/*
+ * 'image_prefetch_image()' - Decode an image on a worker thread.
+ *
+ * Only the BMP, JPEG, and PNG loaders are safe to run on more than one thread
+ * at a time - GIF images are left for image_load().
+ */
+
+static void
+image_prefetch_image(
+    image_prefetch_t *p)		/* I - Background decode */
+{
+  FILE		*fp;			/* File pointer */
+  uchar		header[16];		/* First 16 bytes of file */
+
+
+  if ((fp = p->fp) == NULL && (fp = fopen(p->realname, "rb")) == NULL)
+    return;
+
+  p->fp = NULL;
+
+  if (fread(header, 1, sizeof(header), fp) == 0)
+  {
+    fclose(fp);
+    return;
+  }
+
+  rewind(fp);
+
+  if (memcmp(header, "BM", 2) == 0)
+    p->status = image_load_bmp(&p->decoded, fp, p->gray, 1);
+#ifdef HAVE_LIBPNG
+  else if (memcmp(header, "\211PNG", 4) == 0)
+    p->status = image_load_png(&p->decoded, fp, p->gray, IMAGE_LOAD_QUIET);
+#endif // HAVE_LIBPNG
+#ifdef HAVE_LIBJPEG
+  else if (memcmp(header, "\377\330\377", 3) == 0)
+    p->status = image_load_jpeg(&p->decoded, fp, p->gray, IMAGE_LOAD_QUIET);
+#endif // HAVE_LIBJPEG
+
+  fclose(fp);
+
+  if (p->status)
+  {
+    free(p->decoded.pixels);
+    free(p->decoded.mask);
+
+    p->decoded.pixels = NULL;
+    p->decoded.mask   = NULL;
+  }
+}
+
+
+/*
+ * 'image_prefetch_queue()' - Queue waiting decodes that fit in the budget.
+ */
+
+static void
+image_prefetch_queue(void)
+{
+  image_prefetch_t	*p;		/* Current decode */
+  size_t		limit;		/* Maximum bytes to decode ahead */
+
+
+  limit = IMAGE_PREFETCH_MAX;
+
+  if (ImageCache > 0 && (size_t)ImageCache * 512 * 1024 < limit)
+    limit = (size_t)ImageCache * 512 * 1024;
+
+  while ((p = prefetch_first) != NULL && prefetch_pool)
+  {
+    if (prefetch_bytes > 0 && prefetch_bytes + p->bytes > limit)
+      break;
+
+    if ((prefetch_first = p->next) == NULL)
+      prefetch_last = NULL;
+
+#ifdef HAVE_FMEMOPEN
+    // Data URIs are read from memory, so open them here where it is safe
+    // to look in the web cache...
+    if (file_data(p->realname, NULL))
+      p->fp = file_open(p->realname, "rb");
+#endif // HAVE_FMEMOPEN
+
+    if ((p->job = hd_job_add(prefetch_pool, (hd_job_func_t)image_prefetch_image, p)) != NULL)
+      prefetch_bytes += p->bytes;
+    else if (p->fp)
+    {
+      fclose(p->fp);
+      p->fp = NULL;
+    }
+  }
+}
+
+
 /*
  * 'image_set_mask()' - Set a bit in the image mask.
  */
@@ -1843,6 +2601,26 @@ image_set_mask(image_t *img,	/* I - Image to operate on */
 }
 
 
+/*
+ * 'image_stats()' - Report the memory used for decoded pixels.
+ */
+
+void
+image_stats(size_t *current,		/* O - Bytes of pixels now */
+            size_t *peak,		/* O - Most bytes of pixels */
+	    int    *evicted)		/* O - Number of pixel buffers evicted */
+{
+  if (current)
+    *current = pixel_bytes;
+
+  if (peak)
+    *peak = pixel_peak;
+
+  if (evicted)
+    *evicted = pixel_evicted;
+}
+
+
 /*
  * 'image_unload()' - Unload an image from memory.
  */
@@ -1862,10 +2640,12 @@ image_unload(image_t *img)	// I - Image
     img->use --;
 
   if (img->use)
+  {
+    img->lru = ++ pixel_clock;
     return;
+  }
 
-  free(img->pixels);
-  img->pixels = NULL;
+  image_pixels_free(img);
 }
 
 
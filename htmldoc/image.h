@@ -43,6 +43,14 @@ typedef struct			/**** Image structure ****/
   uchar		*mask;		/* 1-bit mask data, if any */
   int		maskwidth,	/* Byte width of mask data */
 		maskscale;	/* Scaling of mask data */
+  int		jpeg;		/* 1 = baseline and 2 = progressive JPEG data
+				 * that can be copied as-is, 0 = decode */
+  size_t	lru;		/* Last use of pixels, for cache eviction */
+  int		ncolors;	/* Number of colors, 0 = not yet counted and
+				 * -1 = more than 256 colors */
+  unsigned	*colors;	/* Sorted 0xRRGGBB colors, if ncolors > 0 */
+  struct image_prefetch_s *prefetch;
+				/* Pending background decode, if any */
 } image_t;
 
 
@@ -56,6 +64,9 @@ extern image_t	*image_find(const char *filename, int load_data = 0);
 extern void	image_flush_cache(void);
 extern int	image_getlist(image_t ***ptrs);
 extern image_t	*image_load(const char *filename, int gray, int load_data = 0);
+extern int	image_palette(image_t *img, unsigned *colors);
+extern void	image_prefetch(image_t *img, int gray);
+extern void	image_stats(size_t *current, size_t *peak, int *evicted);
 extern void	image_unload(image_t *img);
 
 #  ifdef __cplusplus
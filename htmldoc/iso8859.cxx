@@ -376,7 +376,7 @@ iso8859(uchar *name)			/* I - Glyph name */
 	    {
 	      if (_htmlWidthsLoaded[typeface][style])
 	      {
-	        _htmlWidths[typeface][style][newch] = _htmlWidthsAll[typeface][style][ch];
+	        _htmlWidths[typeface][style][newch] = htmlGetUnicodeWidth(typeface, style, ch);
 	      }
 	    }
 	  }
@@ -398,6 +398,9 @@ iso8859(uchar *name)			/* I - Glyph name */
 
 /*
  * 'iso8859()' - Return the glyph name of an 8-bit character value.
+ *
+ * The strings for all 256 values are built on the first call, after which
+ * this function may be called from multiple threads.
  */
 
 uchar *			/* O - Glyph name */
@@ -406,7 +409,7 @@ iso8859(uchar value)	/* I - ISO-8859-1 equivalent */
   int		i;		/* Looping var */
   int		ch;		/* Current character */
   static int	first_time = 1;	/* First time called? */
-  static uchar	buf[255];	/* Character buffer */
+  static uchar	strings[256][16];/* Character or entity for each value */
 
 
   if (first_time)
@@ -436,18 +439,21 @@ iso8859(uchar value)	/* I - ISO-8859-1 equivalent */
 	  }
       }
 
-    first_time = 0;
-  }
+    for (ch = 0; ch < 256; ch ++)
+    {
+      if (iso8859_names[ch] == NULL)
+      {
+	strings[ch][0] = (uchar)ch;
+	strings[ch][1] = '\0';
+      }
+      else
+	snprintf((char *)strings[ch], sizeof(strings[ch]), "&%s;", iso8859_names[ch]->name);
+    }
 
-  if (iso8859_names[value] == NULL)
-  {
-    buf[0] = value;
-    buf[1] = '\0';
+    first_time = 0;
   }
-  else
-    snprintf((char *)buf, sizeof(buf), "&%s;", iso8859_names[value]->name);
 
-  return (buf);
+  return (strings[value]);
 }
 
 
@@ -0,0 +1,282 @@
+/*
+ * Named link registry functions for HTMLDOC, a HTML document processing
+ * program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "links.h"
+#include "arena.h"
+#include "hdstring.h"
+
+
+/*
+ * Local types...
+ */
+
+struct hd_links_s			/* Link registry */
+{
+  hd_arena_t		*arena;		/* Memory for links and names */
+  hd_link_t		**buckets;	/* Hash buckets */
+  size_t		num_buckets,	/* Number of hash buckets */
+			num_links;	/* Number of links */
+  hd_link_t		**sorted;	/* Links sorted by name */
+  int			sorted_valid;	/* Is the sorted array up to date? */
+};
+
+
+/*
+ * Local globals...
+ */
+
+#define HD_LINKS_BUCKETS 256		/* Initial number of hash buckets */
+
+
+/*
+ * Local functions...
+ */
+
+static int	compare_links(hd_link_t **a, hd_link_t **b);
+static unsigned	hash_link(const char *name);
+
+
+/*
+ * 'hd_links_add()' - Add a named link, or return the existing one.
+ *
+ * The name is copied into the registry the first time it is seen; later
+ * additions that differ only in case return the same link.
+ */
+
+hd_link_t *				/* O - Link or NULL on error */
+hd_links_add(hd_links_t *l,		/* I - Link registry */
+             const char *name)		/* I - Name of link */
+{
+  hd_link_t	*link,			/* New link */
+		**buckets,		/* New hash buckets */
+		*next;			/* Next link in old bucket */
+  size_t	i,			/* Looping var */
+		num_buckets;		/* New number of hash buckets */
+
+
+  if (!l || !name)
+    return (NULL);
+
+  if ((link = hd_links_find(l, name)) != NULL)
+    return (link);
+
+ /*
+  * Grow the hash table as needed to keep the chains short...
+  */
+
+  if (l->num_links >= l->num_buckets)
+  {
+    num_buckets = l->num_buckets ? 2 * l->num_buckets : HD_LINKS_BUCKETS;
+
+    if ((buckets = (hd_link_t **)calloc(num_buckets, sizeof(hd_link_t *))) == NULL)
+      return (NULL);
+
+    for (i = 0; i < l->num_buckets; i ++)
+      for (link = l->buckets[i]; link; link = next)
+      {
+        next = link->next;
+	link->next = buckets[link->hash & (num_buckets - 1)];
+	buckets[link->hash & (num_buckets - 1)] = link;
+      }
+
+    free(l->buckets);
+
+    l->buckets     = buckets;
+    l->num_buckets = num_buckets;
+  }
+
+ /*
+  * Add the new link...
+  */
+
+  if ((link = (hd_link_t *)hd_arena_alloc(l->arena, sizeof(hd_link_t))) == NULL)
+    return (NULL);
+
+  if ((link->name = hd_arena_strdup(l->arena, name)) == NULL)
+    return (NULL);
+
+  link->hash = hash_link(name);
+  link->next = l->buckets[link->hash & (l->num_buckets - 1)];
+
+  l->buckets[link->hash & (l->num_buckets - 1)] = link;
+  l->num_links ++;
+  l->sorted_valid = 0;
+
+  return (link);
+}
+
+
+/*
+ * 'hd_links_count()' - Return the number of links in a registry.
+ */
+
+size_t					/* O - Number of links */
+hd_links_count(hd_links_t *l)		/* I - Link registry */
+{
+  return (l ? l->num_links : 0);
+}
+
+
+/*
+ * 'hd_links_delete()' - Free a link registry and all of its links.
+ */
+
+void
+hd_links_delete(hd_links_t *l)		/* I - Link registry */
+{
+  if (!l)
+    return;
+
+  hd_arena_delete(l->arena);
+  free(l->buckets);
+  free(l->sorted);
+  free(l);
+}
+
+
+/*
+ * 'hd_links_find()' - Find a named link.
+ */
+
+hd_link_t *				/* O - Matching link or NULL */
+hd_links_find(hd_links_t *l,		/* I - Link registry */
+              const char *name)		/* I - Name to find */
+{
+  hd_link_t	*link;			/* Current link */
+  unsigned	hash;			/* Hash of name */
+
+
+  if (!l || !name || l->num_links == 0)
+    return (NULL);
+
+  hash = hash_link(name);
+
+  for (link = l->buckets[hash & (l->num_buckets - 1)]; link; link = link->next)
+    if (link->hash == hash && !strcasecmp(link->name, name))
+      return (link);
+
+  return (NULL);
+}
+
+
+/*
+ * 'hd_links_memory()' - Return the memory used by a link registry.
+ */
+
+size_t					/* O - Bytes allocated */
+hd_links_memory(hd_links_t *l)		/* I - Link registry */
+{
+  size_t	allocated;		/* Bytes allocated from the arena */
+
+
+  if (!l)
+    return (0);
+
+  hd_arena_stats(l->arena, NULL, &allocated, NULL);
+
+  return (sizeof(hd_links_t) + allocated +
+          l->num_buckets * sizeof(hd_link_t *) +
+          (l->sorted ? l->num_links * sizeof(hd_link_t *) : 0));
+}
+
+
+/*
+ * 'hd_links_new()' - Create a new link registry.
+ */
+
+hd_links_t *				/* O - New link registry or NULL */
+hd_links_new(void)
+{
+  hd_links_t	*l;			/* New link registry */
+
+
+  if ((l = (hd_links_t *)calloc(1, sizeof(hd_links_t))) == NULL)
+    return (NULL);
+
+  if ((l->arena = hd_arena_new(0)) == NULL)
+  {
+    free(l);
+    return (NULL);
+  }
+
+  return (l);
+}
+
+
+/*
+ * 'hd_links_sorted()' - Return the links sorted by name.
+ *
+ * The array is owned by the registry and stays valid until the next call to
+ * hd_links_add() or hd_links_delete().
+ */
+
+hd_link_t **				/* O - Array of links or NULL */
+hd_links_sorted(hd_links_t *l)		/* I - Link registry */
+{
+  hd_link_t	*link,			/* Current link */
+		**sorted;		/* Sorted array */
+  size_t	i,			/* Looping var */
+		count;			/* Number of links copied */
+
+
+  if (!l || l->num_links == 0)
+    return (NULL);
+
+  if (l->sorted_valid)
+    return (l->sorted);
+
+  if ((sorted = (hd_link_t **)realloc(l->sorted, l->num_links * sizeof(hd_link_t *))) == NULL)
+    return (NULL);
+
+  l->sorted = sorted;
+
+  for (i = 0, count = 0; i < l->num_buckets; i ++)
+    for (link = l->buckets[i]; link; link = link->next)
+      sorted[count ++] = link;
+
+  qsort(sorted, count, sizeof(hd_link_t *), (int (*)(const void *, const void *))compare_links);
+
+  l->sorted_valid = 1;
+
+  return (sorted);
+}
+
+
+/*
+ * 'compare_links()' - Compare two named links.
+ */
+
+static int				/* O - Result of comparison */
+compare_links(hd_link_t **a,		/* I - First link */
+              hd_link_t **b)		/* I - Second link */
+{
+  return (strcasecmp((*a)->name, (*b)->name));
+}
+
+
+/*
+ * 'hash_link()' - Compute the case-insensitive hash of a link name.
+ */
+
+static unsigned				/* O - Hash value */
+hash_link(const char *name)		/* I - Name of link */
+{
+  unsigned	hash;			/* Hash value */
+
+
+  for (hash = 2166136261U; *name; name ++)
+    hash = (hash ^ (unsigned)tolower(*name & 255)) * 16777619U;
+
+  return (hash);
+}
@@ -0,0 +1,63 @@
+/*
+ * Named link registry definitions for HTMLDOC, a HTML document processing
+ * program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+#ifndef _LINKS_H_
+#  define _LINKS_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include <stdlib.h>
+
+#  ifdef __cplusplus
+extern "C" {
+#  endif /* __cplusplus */
+
+
+/*
+ * Named link - the target of an <A NAME="..."> reference...
+ */
+
+typedef struct hd_link_s
+{
+  struct hd_link_s	*next;		/* Next link in hash bucket */
+  unsigned		hash;		/* Hash of name */
+  char			*name;		/* Reference name */
+  unsigned char		*filename;	/* File for link */
+  int			page,		/* Page # */
+			top;		/* Top position */
+} hd_link_t;
+
+
+/*
+ * Link registry - named links hashed by case-insensitive name...
+ */
+
+typedef struct hd_links_s hd_links_t;
+
+
+/*
+ * Prototypes...
+ */
+
+extern hd_link_t *hd_links_add(hd_links_t *l, const char *name);
+extern size_t	hd_links_count(hd_links_t *l);
+extern void	hd_links_delete(hd_links_t *l);
+extern hd_link_t *hd_links_find(hd_links_t *l, const char *name);
+extern size_t	hd_links_memory(hd_links_t *l);
+extern hd_links_t *hd_links_new(void);
+extern hd_link_t **hd_links_sorted(hd_links_t *l);
+
+#  ifdef __cplusplus
+}
+#  endif /* __cplusplus */
+
+#endif /* !_LINKS_H_ */
@@ -14,6 +14,11 @@
 #  include "markdown.h"
 #  include "mmd.h"
 #  include "progress.h"
+#  include <sys/stat.h>
+#  ifdef HAVE_SYS_MMAN_H
+#    include <sys/mman.h>
+#    include <unistd.h>
+#  endif // HAVE_SYS_MMAN_H
 
 
 /*
@@ -29,6 +34,10 @@ static uchar      *make_anchor(const uchar *text);
 
 /*
  * 'mdReadFile()' - Read a Markdown file.
+ *
+ * Regular files are memory-mapped and parsed in place when possible, and
+ * each top-level block is freed as soon as it has been added to the HTML
+ * tree so that only one copy of the document is held at a time.
  */
 
 tree_t *				/* O - HTML document tree */
@@ -36,7 +45,9 @@ mdReadFile(tree_t     *parent,		/* I - Parent node */
            FILE       *fp,		/* I - File to read from */
            const char *base)		/* I - Base path/URL */
 {
-  mmd_t       *doc;			/* Markdown document */
+  mmd_t       *doc,			/* Markdown document */
+              *node,                    /* Current block */
+              *next;                    /* Next block */
   tree_t      *html,                    /* HTML element */
               *head,                    /* HEAD element */
               *temp,                    /* META/TITLE element */
@@ -44,7 +55,37 @@ mdReadFile(tree_t     *parent,		/* I - Parent node */
   const char  *meta;                    /* Title, author, etc. */
 
 
+  doc = NULL;
+
+#ifdef HAVE_SYS_MMAN_H
+  struct stat fileinfo;                 /* File information */
+  long        offset;                   /* Current offset in file */
+
+  // mmdLoadBuffer() needs a nul after the text, which the zero fill at the
+  // end of the last page provides unless the file fills the page...
+  if (!fstat(fileno(fp), &fileinfo) && S_ISREG(fileinfo.st_mode) &&
+      (offset = ftell(fp)) >= 0 && offset < fileinfo.st_size &&
+      (fileinfo.st_size % sysconf(_SC_PAGESIZE)) != 0)
+  {
+    void *map = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE,
+                     fileno(fp), 0);
+
+    if (map != MAP_FAILED)
+    {
+      doc = mmdLoadBuffer(NULL, (char *)map + offset, (size_t)(fileinfo.st_size - offset));
+
+      munmap(map, (size_t)fileinfo.st_size);
+      fseek(fp, 0, SEEK_END);
+    }
+  }
+
+  if (!doc)
+#endif // HAVE_SYS_MMAN_H
   doc = mmdLoadFile(NULL, fp);
+
+  if (!doc)
+    return (NULL);
+
   html = htmlAddTree(parent, MARKUP_HTML, NULL);
   if ((meta = mmdGetMetadata(doc, "lang")) != NULL)
     htmlSetVariable(html, (uchar *)"lang", get_text((uchar *)meta));
@@ -85,7 +126,18 @@ mdReadFile(tree_t     *parent,		/* I - Parent node */
   }
 
   body = htmlAddTree(html, MARKUP_BODY, NULL);
-  add_block(body, doc);
+
+  for (node = mmdGetFirstChild(doc); node; node = next)
+  {
+    next = mmdGetNextSibling(node);
+
+    if (mmdIsBlock(node))
+      add_block(body, node);
+    else
+      add_leaf(body, node);
+
+    mmdFree(node);
+  }
 
   mmdFree(doc);
 
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+#
+# Perfect hash table generator for HTMLDOC, a HTML document processing
+# program.
+#
+# This program regenerates the html_markup_hash[] and html_attr_hash[] tables
+# in htmllib.cxx from the _htmlMarkups[] and html_attrs[] arrays, using the
+# same hash as hash_name() in htmllib.cxx.  Run it whenever an element or
+# interned attribute name is added or removed:
+#
+#     python3 mkhash.py [--check] [htmllib.cxx]
+#
+# With --check the tables are verified but the file is not changed, and the
+# exit status is 1 if they are out of date.
+#
+# This program is free software.  Distribution and use rights are outlined in
+# the file "COPYING".
+#
+
+import re
+import sys
+
+HASH_SIZE = 512				# Size of each table
+HASH_MULTIPLIER = 275			# Multiplier in hash_name()
+MARKUP_SHIFT = 11			# Shift used by lookup_markup()
+ATTR_SHIFT = 7				# Shift used by intern_name()
+
+
+def hash_name(name, shift):
+    """Compute the same value as hash_name() in htmllib.cxx."""
+
+    h = 0
+    for ch in name.encode('ascii').lower():
+        h = (h * HASH_MULTIPLIER + ch) & 0xffffffff
+
+    return (h ^ (h >> shift)) & (HASH_SIZE - 1)
+
+
+def get_array(source, start):
+    """Return the text between the start marker and the closing "};"."""
+
+    pos = source.index(start)
+    end = source.index('};', pos)
+    return source[pos + len(start):end]
+
+
+def make_table(names, shift, offset, what):
+    """Build a hash table mapping each name to its index plus the offset."""
+
+    table = [0] * HASH_SIZE
+    owners = {}
+
+    for i, name in enumerate(names):
+        h = hash_name(name, shift)
+        if table[h]:
+            sys.exit('mkhash: %s "%s" collides with "%s" in slot %d - '
+                     'choose a new multiplier or shift.' %
+                     (what, name, owners[h], h))
+        table[h] = i + offset
+        owners[h] = name
+
+    return table
+
+
+def format_table(table):
+    """Format a table the way htmllib.cxx lays it out, 16 values per line."""
+
+    rows = []
+    for i in range(0, HASH_SIZE, 16):
+        rows.append('  ' + ', '.join('%2d' % v for v in table[i:i + 16]))
+
+    return ',\n'.join(rows) + '\n'
+
+
+def replace_table(source, name, table):
+    """Replace the body of the named table in the source."""
+
+    pattern = re.compile(r'(static const unsigned char ' + name +
+                         r'\[%d\] =\n\{[^\n]*\n)(.*?)(\};)' % HASH_SIZE,
+                         re.S)
+    match = pattern.search(source)
+    if not match:
+        sys.exit('mkhash: Unable to find %s[] table.' % name)
+
+    return (source[:match.start(2)] + format_table(table) +
+            source[match.end(2):])
+
+
+def main(args):
+    check = False
+    filename = 'htmllib.cxx'
+
+    for arg in args:
+        if arg == '--check':
+            check = True
+        elif arg.startswith('-'):
+            sys.exit('Usage: mkhash.py [--check] [htmllib.cxx]')
+        else:
+            filename = arg
+
+    with open(filename) as f:
+        source = f.read()
+
+    # Element names, skipping MARKUP_NONE which is never looked up...
+    markups = re.findall(r'"([^"]*)"',
+                         get_array(source, 'const char\t*_htmlMarkups[] ='))
+    markup_table = make_table(markups[1:], MARKUP_SHIFT, 1, 'element')
+
+    # Interned attribute names, hashed by their lowercase spelling...
+    attrs = re.findall(r'\{ "[^"]*", "([^"]*)" \}',
+                       get_array(source,
+                                 'static const char * const html_attrs[][2] ='))
+    attr_table = make_table(attrs, ATTR_SHIFT, 1, 'attribute')
+
+    if max(len(markups), len(attrs) + 1) > 255:
+        sys.exit('mkhash: Too many names for unsigned char tables.')
+
+    updated = replace_table(source, 'html_markup_hash', markup_table)
+    updated = replace_table(updated, 'html_attr_hash', attr_table)
+
+    if updated == source:
+        print('%s: hash tables are up to date (%d elements, %d attributes).' %
+              (filename, len(markups) - 1, len(attrs)))
+    elif check:
+        print('%s: hash tables are out of date, run mkhash.py.' % filename)
+        return 1
+    else:
+        with open(filename, 'w') as f:
+            f.write(updated)
+        print('%s: hash tables updated (%d elements, %d attributes).' %
+              (filename, len(markups) - 1, len(attrs)))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
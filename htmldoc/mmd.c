@@ -94,7 +94,7 @@ struct _mmd_s
 
 typedef struct _mmd_filebuf_s		/**** Buffered file ****/
 {
-  FILE		*fp;			/* File pointer */
+  FILE		*fp;			/* File pointer or `NULL` for a memory buffer */
   char		buffer[65536],		/* Buffer */
 		*bufptr,		/* Pointer into buffer */
 		*bufend;		/* End of buffer */
@@ -139,10 +139,12 @@ static mmd_option_t	mmd_options = MMD_OPTION_ALL;
 
 static mmd_t	*mmd_add(mmd_t *parent, mmd_type_t type, int whitespace, char *text, char *url);
 static void	mmd_free(mmd_t *node);
+static void	mmd_free_text(mmd_t *node);
 static int	mmd_has_continuation(const char *line, _mmd_filebuf_t *file, int indent);
 static size_t	mmd_is_chars(const char *lineptr, const char *chars, size_t minchars);
 static size_t	mmd_is_codefence(char *lineptr, char fence, size_t fencelen, char **language);
 static int	mmd_is_table(_mmd_filebuf_t *file, int indent);
+static mmd_t	*mmd_load(mmd_t *root, _mmd_filebuf_t *file);
 static void	mmd_parse_inline(_mmd_doc_t *doc, mmd_t *parent, char *lineptr);
 static char	*mmd_parse_link(_mmd_doc_t *doc, char *lineptr, char **text, char **url, char **title, char **refname);
 static void	mmd_read_buffer(_mmd_filebuf_t *file);
@@ -482,6 +484,30 @@ mmdLoad(mmd_t      *root,		/* I - Root node for document or `NULL` for a new doc
 }
 
 
+/*
+ * 'mmdLoadBuffer()' - Load a markdown document from memory into nodes.
+ *
+ * The buffer is parsed in place, without copying it, and must be followed by
+ * a nul character, e.g. a string or a memory-mapped file whose size is not a
+ * multiple of the page size.
+ */
+
+mmd_t *					/* O - Root node in markdown */
+mmdLoadBuffer(mmd_t      *root,		/* I - Root node for document or `NULL` for a new document */
+              const char *buffer,	/* I - Markdown text */
+              size_t     length)	/* I - Length of Markdown text */
+{
+  _mmd_filebuf_t file;			/* File buffer */
+
+
+  file.fp     = NULL;
+  file.bufptr = (char *)buffer;
+  file.bufend = (char *)buffer + length;
+
+  return (mmd_load(root, &file));
+}
+
+
 /*
  * 'mmdLoadFile()' - Load a markdown file into nodes from a stdio file.
  */
@@ -490,1099 +516,1087 @@ mmd_t *					/* O - First node in markdown */
 mmdLoadFile(mmd_t *root,
             FILE  *fp)			/* I - File to load */
 {
-  size_t	i;			/* Looping var */
-  _mmd_doc_t	doc;			/* Document */
-  _mmd_ref_t	*reference;		/* Current reference */
-  mmd_t		*block = NULL;		/* Current block */
-  mmd_type_t	type;			/* Type for line */
   _mmd_filebuf_t file;			/* File buffer */
-  char		line[8192],		/* Read line */
-		*linestart,		/* Start of line */
-		*lineptr,		/* Pointer into line */
-		*lineend,		/* End of line */
-		*temp;			/* Temporary pointer */
-  int		newindent;		/* New indentation */
-  int		blank_code = 0;		/* Saved indented blank code line */
-  mmd_type_t	columns[256];		/* Alignment of table columns */
-  int		num_columns = 0,	/* Number of columns in table */
-		rows = 0;		/* Number of rows in table */
-  _mmd_stack_t	stack[32],		/* Block stack */
-		*stackptr = stack;	/* Pointer to top of stack */
 
 
- /*
-  * Create an empty document as needed...
-  */
+  memset(&file, 0, sizeof(file));
+  file.fp = fp;
 
-  DEBUG_printf("mmdLoadFile: mmd_options=%d%s%s\n", mmd_options, (mmd_options & MMD_OPTION_METADATA) ? " METADATA" : "", (mmd_options & MMD_OPTION_TABLES) ? " TABLES" : "");
+  return (mmd_load(root, &file));
+}
 
-  memset(&doc, 0, sizeof(doc));
 
-  if (root)
-    doc.root = root;
-  else
-    doc.root = mmd_add(NULL, MMD_TYPE_DOCUMENT, 0, NULL, NULL);
+/*
+ * 'mmdLoadString()' - Load a markdown string into nodes.
+ */
 
-  if (!doc.root)
-    return (NULL);
+mmd_t *					/* O - Root node in markdown */
+mmdLoadString(mmd_t      *root,		/* I - Root node for document or `NULL` for a new document */
+              const char *s)		/* I - String to load */
+{
+  return (mmdLoadBuffer(root, s, strlen(s)));
+}
 
- /*
-  * Initialize the block stack...
-  */
 
-  memset(stack, 0, sizeof(stack));
-  stackptr->parent = doc.root;
+/*
+ * 'mmdSetOptions()' - Set (enable/disable) support for various markdown options.
+ */
 
- /*
-  * Read lines until end-of-file...
-  */
+void
+mmdSetOptions(mmd_option_t options)	/* I - Options */
+{
+  mmd_options = options;
+}
 
-  memset(&file, 0, sizeof(file));
-  file.fp = fp;
 
-#ifdef __clang_analyzer__
-  memset(line, 0, sizeof(line));
-#endif // __clang_analyzer__
+/*
+ * 'mmd_add()' - Add a new markdown node.
+ */
 
-  while ((lineptr = mmd_read_line(&file, line, sizeof(line))) != NULL)
-  {
-    DEBUG_printf("%03d	%-12s  %s", stackptr->indent, mmd_type_string(stackptr->parent->type) + 9, lineptr);
-#if DEBUG
-    if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
-      DEBUG2_printf("	  blank_code=%d\n", blank_code);
-#endif /* DEBUG */
+static mmd_t *				/* O - New node */
+mmd_add(mmd_t	   *parent,		/* I - Parent node */
+	mmd_type_t type,		/* I - Node type */
+	int	   whitespace,		/* I - 1 if whitespace precedes this node */
+	char	   *text,		/* I - Text, if any */
+	char	   *url)		/* I - URL, if any */
+{
+  mmd_t		*temp;			/* New node */
+  size_t	textlen = text ? strlen(text) + 1 : 0;
+					/* Length of text */
 
-    linestart = lineptr;
 
-    while (isspace(*lineptr & 255))
-      lineptr ++;
+  DEBUG2_printf("Adding %s to %p(%s), whitespace=%d, text=\"%s\", url=\"%s\"\n", mmd_type_string(type), parent, parent ? mmd_type_string(parent->type) : "", whitespace, text ? text : "(null)", url ? url : "(null)");
 
-    DEBUG2_printf("	line indent=%d\n", (int)(lineptr - line));
-    DEBUG2_printf("	stackptr=%d\n", (int)(stackptr - stack));
+  if (!parent && type != MMD_TYPE_DOCUMENT)
+    return (NULL);			/* Only document nodes can be at the root */
 
-    if (!*lineptr && stackptr->parent->type == MMD_TYPE_TABLE)
-    {
-      DEBUG2_puts("END TABLE\n");
-      stackptr --;
-      block = NULL;
-      continue;
-    }
-    else if (*lineptr == '>' && (lineptr - linestart) < 4)
+  if ((temp = calloc(1, sizeof(mmd_t) + textlen)) != NULL)
+  {
+    if (parent)
     {
      /*
-      * Block quote.  See if there is an existing blockquote...
+      * Add node to the parent...
       */
 
-      DEBUG_printf("	 BLOCKQUOTE (stackptr=%ld)\n", stackptr - stack);
+      temp->parent = parent;
 
-      if (stackptr == stack || stack[1].parent->type != MMD_TYPE_BLOCK_QUOTE)
+      if (parent->last_child)
       {
-	block		 = NULL;
-	stackptr	 = stack + 1;
-	stackptr->parent = mmd_add(doc.root, MMD_TYPE_BLOCK_QUOTE, 0, NULL, NULL);
-	stackptr->indent = 2;
-	stackptr->fence	 = '\0';
+	parent->last_child->next_sibling = temp;
+	temp->prev_sibling		 = parent->last_child;
+	parent->last_child		 = temp;
+      }
+      else
+      {
+	parent->first_child = parent->last_child = temp;
       }
-
-     /*
-      * Skip whitespace after the ">"...
-      */
-
-      lineptr ++;
-      if (isspace(*lineptr & 255))
-	lineptr ++;
-
-      linestart = lineptr;
-
-      while (isspace(*lineptr & 255))
-	lineptr ++;
-    }
-    else if (*lineptr != '>' && stackptr > stack && stack[1].parent->type == MMD_TYPE_BLOCK_QUOTE && (!block || *lineptr == '\n' || mmd_is_chars(lineptr, "- \t", 3) || mmd_is_chars(lineptr, "_ \t", 3) || mmd_is_chars(lineptr, "* \t", 3)))
-    {
-     /*
-      * Not a lazy continuation so terminate this block quote...
-      */
-
-      DEBUG_puts("     Terminating BLOCKQUOTE\n");
-      block    = NULL;
-      stackptr = stack;
     }
 
    /*
-    * Now handle all other markup not related to block quotes...
+    * Copy the node values...
     */
 
-    DEBUG2_printf("	stackptr=%d (%s), block=%p (%s)\n", (int)(stackptr - stack), mmd_type_string(stackptr->parent->type) + 9, block, block ? mmd_type_string(block->type) + 9 : "");
-    DEBUG2_printf("	strchr(lineptr, '|')=%p, mmd_is_table(&file, stackptr->indent)=%d\n", strchr(lineptr, '|'), mmd_is_table(&file, stackptr->indent));
-    DEBUG2_printf("	linestart=%d, lineptr=%d\n", (int)(linestart - line), (int)(lineptr - line));
-    DEBUG2_printf("	mmd_is_chars(lineptr, \"-\", 1)=%d\n", (int)mmd_is_chars(lineptr, "-", 1));
-    DEBUG2_printf("	mmd_is_chars(lineptr, \"=\", 1)=%d\n", (int)mmd_is_chars(lineptr, "=", 1));
+    temp->type	     = type;
+    temp->whitespace = whitespace;
 
-    if ((lineptr - line - stackptr->indent) < 4 && ((stackptr->parent->type != MMD_TYPE_CODE_BLOCK && !stackptr->fence && mmd_is_codefence(lineptr, '\0', 0, NULL)) || (stackptr->fence && mmd_is_codefence(lineptr, stackptr->fence, stackptr->fencelen, NULL))))
+    if (text)
     {
      /*
-      * Code fence...
+      * The text is stored after the node to save an allocation...
       */
 
-      DEBUG2_printf("stackptr->indent=%d, fence='%c', fencelen=%d\n", stackptr->indent, stackptr->fence, (int)stackptr->fencelen);
-
-      if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
-      {
-	DEBUG2_puts("Ending code block...\n");
-	stackptr --;
-      }
-      else if (stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
-      {
-	char	*language;		/* Language name, if any */
-
-	DEBUG2_printf("Starting code block with fence '%c'.\n", *lineptr);
+      temp->text = (char *)(temp + 1);
+      memcpy(temp->text, text, textlen);
+    }
 
-	block		     = NULL;
-	stackptr[1].parent   = mmd_add(stackptr->parent, MMD_TYPE_CODE_BLOCK, 0, NULL, NULL);
-	stackptr[1].indent   = lineptr - line;
-	stackptr[1].fence    = *lineptr;
-	stackptr[1].fencelen = mmd_is_codefence(lineptr, '\0', 0, &language);
-	stackptr ++;
+    if (url)
+      temp->url = strdup(url);
+  }
 
-	DEBUG2_printf("Code language=\"%s\"\n", language);
+  return (temp);
+}
 
-	if (language)
-	  stackptr->parent->extra = strdup(language);
 
-	blank_code = 0;
-      }
-      continue;
-    }
-    else if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK && (lineptr - line) >= stackptr->indent)
-    {
-      if (line[stackptr->indent] == '\n')
-      {
-	blank_code ++;
-      }
-      else
-      {
-	while (blank_code > 0)
-	{
-	  mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, "\n", NULL);
-	  blank_code --;
-	}
+/*
+ * 'mmd_free()' - Free memory used by a node.
+ */
 
-	mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, line + stackptr->indent, NULL);
-      }
-      continue;
-    }
-    else if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK && stackptr->fence)
-    {
-      DEBUG2_printf("	  fence='%c'\n", stackptr->fence);
+static void
+mmd_free(mmd_t *node)			/* I - Node */
+{
+  mmd_free_text(node);
+  free(node->url);
+  free(node->extra);
+  free(node);
+}
 
-      if (!*lineptr)
-      {
-	blank_code ++;
-      }
-      else
-      {
-	while (blank_code > 0)
-	{
-	  mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, "\n", NULL);
-	  blank_code --;
-	}
 
-	mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, lineptr, NULL);
-      }
-      continue;
-    }
-    else if (!strncmp(lineptr, "---", 3) && doc.root->first_child == NULL && (mmd_options & MMD_OPTION_METADATA))
-    {
-     /*
-      * Document metadata...
-      */
+/*
+ * 'mmd_free_text()' - Free the text of a node, unless it is stored with the
+ *                     node.
+ */
 
-      block = mmd_add(doc.root, MMD_TYPE_METADATA, 0, NULL, NULL);
+static void
+mmd_free_text(mmd_t *node)		/* I - Node */
+{
+  if (node->text != (char *)(node + 1))
+    free(node->text);
+}
 
-      while ((lineptr = mmd_read_line(&file, line, sizeof(line))) != NULL)
-      {
-	while (isspace(*lineptr & 255))
-	  lineptr ++;
 
-	if (!strncmp(lineptr, "---", 3) || !strncmp(lineptr, "...", 3))
-	  break;
+/*
+ * 'mmd_has_continuation()' - Determine whether the next line is a continuation
+ *			      of the current one.
+ */
 
-	lineend = lineptr + strlen(lineptr) - 1;
-	if (lineend > lineptr && *lineend == '\n')
-	  *lineend = '\0';
+static int				/* O - 1 if the next line continues, 0 otherwise */
+mmd_has_continuation(
+    const char	   *line,		/* I - Current line */
+    _mmd_filebuf_t *file,		/* I - File buffer */
+    int		   indent)		/* I - Indentation for current block */
+{
+  const char	*lineptr = line;	/* Pointer into current line */
+  const char	*fileptr = file->bufptr;/* Pointer into next line */
 
-	mmd_add(block, MMD_TYPE_METADATA_TEXT, 0, lineptr, NULL);
-      }
-      continue;
-    }
-    else if (block && block->type == MMD_TYPE_PARAGRAPH && (lineptr - linestart) < 4 && (lineptr - line) >= stackptr->indent && (mmd_is_chars(lineptr, "-", 1) || mmd_is_chars(lineptr, "=", 1)))
-    {
-      int ch = *lineptr;
 
-      DEBUG_puts("     SETEXT HEADING\n");
+  if (*fileptr == '\n' || *fileptr == '\r')
+    return (0);
 
-      lineptr += 3;
-      while (*lineptr == ch)
-	lineptr ++;
-      while (isspace(*lineptr & 255))
-	lineptr ++;
+  do
+  {
+    while (isspace(*lineptr & 255))
+      lineptr ++;
 
-      if (!*lineptr)
-      {
-	if (ch == '=')
-	  block->type = MMD_TYPE_HEADING_1;
-	else
-	  block->type = MMD_TYPE_HEADING_2;
+    if (*lineptr == '[' && (lineptr - line - indent) < 4 && (*fileptr == ' ' || *fileptr == '\t'))
+      return (1);
 
-	block = NULL;
-	continue;
-      }
+    while (isspace(*fileptr & 255))
+      fileptr ++;
 
-      type = MMD_TYPE_PARAGRAPH;
-    }
-    else if ((lineptr - linestart) < 4 && (mmd_is_chars(lineptr, "- \t", 3) || mmd_is_chars(lineptr, "_ \t", 3) || mmd_is_chars(lineptr, "* \t", 3)))
+    if (*lineptr == '>' && *fileptr == '>')
     {
-      DEBUG_puts("     THEMATIC BREAK\n");
+      lineptr ++;
+      fileptr ++;
+    }
+    else if (*fileptr == '>')
+      return (0);
 
-      if (line[0] == '>')
-	stackptr = stack + 1;
-      else
-	stackptr = stack;
+    if (*fileptr == '\n' || *fileptr == '\r')
+      return (0);
+  }
+  while (isspace(*lineptr & 255) || isspace(*fileptr & 255));
 
-      mmd_add(stackptr->parent, MMD_TYPE_THEMATIC_BREAK, 0, NULL, NULL);
-//      type  = MMD_TYPE_PARAGRAPH;
-      block = NULL;
-      continue;
-    }
-    else if ((*lineptr == '-' || *lineptr == '+' || *lineptr == '*') && (lineptr[1] == '\t' || lineptr[1] == ' '))
-    {
-     /*
-      * Bulleted list...
-      */
+  if (*lineptr == '#')
+    return (0);
 
-      DEBUG_puts("     UNORDERED LIST\n");
+  if (strchr("-+*", *fileptr) && isspace(fileptr[1] & 255))
+  {
+   /*
+    * Bullet list item...
+    */
 
-      lineptr	+= 2;
-      linestart = lineptr;
-      newindent = linestart - line;
+    return (0);
+  }
 
-      while (isspace(*lineptr & 255))
-	lineptr ++;
+  if (isdigit(*fileptr & 255))
+  {
+   /*
+    * Ordered list item...
+    */
 
-      while (stackptr > stack && stackptr->indent > newindent)
-	stackptr --;
+    while (*fileptr && isdigit(*fileptr & 255))
+      fileptr ++;
 
-      if (stackptr > stack && stackptr->parent->type == MMD_TYPE_LIST_ITEM && stackptr->indent == newindent)
-	stackptr --;
+    if (*fileptr == '.' || *fileptr == '(')
+      return (0);
+  }
 
-      if (stackptr > stack && stackptr->parent->type == MMD_TYPE_ORDERED_LIST && stackptr->indent == newindent)
-	stackptr --;
+  if (mmd_is_codefence((char *)fileptr, '\0', 0, NULL))
+    return (0);
 
-      if (stackptr > stack && stackptr->parent->type == MMD_TYPE_BLOCK_QUOTE && line[0] != '>')
-	stackptr --;
+  if (mmd_is_chars(fileptr, "- \t", 3) || mmd_is_chars(fileptr, "_ \t", 3) || mmd_is_chars(fileptr, "* \t", 3))
+  {
+   /*
+    * Thematic break...
+    */
 
-      if (stackptr->parent->type != MMD_TYPE_UNORDERED_LIST && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
-      {
-	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_UNORDERED_LIST, 0, NULL, NULL);
-	stackptr[1].indent = linestart - line;
-	stackptr[1].fence  = '\0';
-	stackptr ++;
-      }
+    return (0);
+  }
 
-      if (stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
-      {
-	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_LIST_ITEM, 0, NULL, NULL);
-	stackptr[1].indent = linestart - line;
-	stackptr[1].fence  = '\0';
-	stackptr ++;
-      }
+  if (mmd_is_chars(fileptr, "-", 1) || mmd_is_chars(fileptr, "=", 1))
+  {
+   /*
+    * Heading...
+    */
 
-      type  = MMD_TYPE_PARAGRAPH;
-      block = NULL;
+    return (0);
+  }
 
-      if (mmd_is_chars(lineptr, "- \t", 3) || mmd_is_chars(lineptr, "_ \t", 3) || mmd_is_chars(lineptr, "* \t", 3))
-      {
-	mmd_add(stackptr->parent, MMD_TYPE_THEMATIC_BREAK, 0, NULL, NULL);
-	continue;
-      }
+  if (*fileptr == '#')
+  {
+   /*
+    * Possible heading...
+    */
+
+    int count = 0;
+
+    while (*fileptr == '#')
+    {
+      fileptr ++;
+      count ++;
     }
-    else if (isdigit(*lineptr & 255))
+
+    if (count <= 6)
+      return (0);
+  }
+
+  return ((fileptr - file->bufptr) <= indent);
+}
+
+
+/*
+ * 'mmd_is_chars()' - Determine whether a line consists solely of whitespace
+ *		      and the specified character.
+ */
+
+static size_t				/* O - 1 if as specified, 0 otherwise */
+mmd_is_chars(const char *lineptr,	/* I - Current line */
+	     const char *chars,		/* I - Non-space character */
+	     size_t	minchars)	/* I - Minimum number of non-space characters */
+{
+  size_t	found_ch = 0;		/* Did we find the specified characters? */
+
+  while (*lineptr == *chars)
+  {
+    found_ch ++;
+    lineptr ++;
+  }
+
+  if (minchars > 1)
+  {
+    while (*lineptr && strchr(chars, *lineptr))
     {
-     /*
-      * Ordered list?
-      */
+      if (*lineptr == *chars)
+	found_ch ++;
 
-      DEBUG_puts("     ORDERED LIST?\n");
+      lineptr ++;
+    }
+  }
 
-      temp = lineptr + 1;
+  while (*lineptr && isspace(*lineptr & 255) && *lineptr != '\n')
+    lineptr ++;
 
-      while (isdigit(*temp & 255))
-	temp ++;
+  if ((*lineptr && *lineptr != '\n') || found_ch < minchars)
+    return (0);
+  else
+    return (found_ch);
+}
 
-      if ((*temp == '.' || *temp == ')') && (temp[1] == '\t' || temp[1] == ' '))
-      {
-       /*
-	* Yes, ordered list.
-	*/
 
-	lineptr	  = temp + 2;
-	linestart = lineptr;
-	newindent = linestart - line;
+/*
+ * 'mmd_is_codefence()' - Determine whether the line contains a code fence.
+ */
 
-	while (isspace(*lineptr & 255))
-	  lineptr ++;
+static size_t				/* O - Length of fence or 0 otherwise */
+mmd_is_codefence(char	*lineptr,	/* I - Line */
+		 char	fence,		/* I - Current fence character, if any */
+		 size_t fencelen,	/* I - Current fence length */
+		 char	**language)	/* O - Language name, if any */
+{
+  char		match = fence;		/* Character to match */
+  size_t	len = 0;		/* Length of fence chars */
 
-	while (stackptr > stack && stackptr->indent > newindent)
-	  stackptr --;
 
-	if (stackptr->parent->type == MMD_TYPE_LIST_ITEM && stackptr->indent == newindent)
-	  stackptr --;
+  if (language)
+    *language = NULL;
 
-	if (stackptr->parent->type == MMD_TYPE_UNORDERED_LIST && stackptr->indent == newindent)
-	  stackptr --;
+  if (!match)
+  {
+    if (*lineptr == '~' || *lineptr == '`')
+      match = *lineptr;
+    else
+      return (0);
+  }
 
-	if (stackptr->parent->type == MMD_TYPE_BLOCK_QUOTE && line[0] != '>')
-	  stackptr --;
+  while (*lineptr == match)
+  {
+    lineptr ++;
+    len ++;
+  }
 
-	if (stackptr->parent->type != MMD_TYPE_ORDERED_LIST && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
-	{
-	  stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_ORDERED_LIST, 0, NULL, NULL);
-	  stackptr[1].indent = linestart - line;
-	  stackptr[1].fence  = '\0';
-	  stackptr ++;
-	}
+  if (len < 3 || (fencelen && len < fencelen))
+    return (0);
 
-	if (stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
-	{
-	  stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_LIST_ITEM, 0, NULL, NULL);
-	  stackptr[1].indent = linestart - line;
-	  stackptr[1].fence  = '\0';
-	  stackptr ++;
-	}
+  if (*lineptr && *lineptr != '\n' && fence)
+    return (0);
+  else if (*lineptr && *lineptr != '\n' && !fence)
+  {
+    if (match == '`' && strchr(lineptr, match))
+      return (0);
 
-	type  = MMD_TYPE_PARAGRAPH;
-	block = NULL;
-      }
-      else
-      {
-       /*
-	* No, just a regular paragraph...
-	*/
+    while (isspace(*lineptr & 255))
+      lineptr ++;
 
-	type = block ? block->type : MMD_TYPE_PARAGRAPH;
-      }
-    }
-    else if (*lineptr == '#' && (lineptr - linestart) < 4)
+    if (*lineptr && language)
     {
-     /*
-      * Heading, count the number of '#' for the heading level...
-      */
+      *language = lineptr;
 
-      DEBUG_puts("     HEADING?\n");
+      while (*lineptr && !isspace(*lineptr & 255))
+	lineptr ++;
+      *lineptr = '\0';
+    }
+  }
+
+  return (len);
+}
+
+
+/*
+ * 'mmd_is_table()' - Look ahead to see if the next line contains a heading
+ *		      divider for a table.
+ */
+
+static int				/* O - 1 if this is a table, 0 otherwise */
+mmd_is_table(_mmd_filebuf_t *file,	/* I - File to read from */
+	     int	    indent)	/* I - Indentation of table line */
+{
+  const char	*ptr;			/* Pointer into buffer */
+
+
+  ptr = file->bufptr;
+  while (*ptr)
+  {
+    if (!strchr(" \t>", *ptr))
+      break;
+
+    ptr ++;
+  }
+
+  if ((ptr - file->bufptr - indent) >= 4)
+    return (0);
+
+  while (*ptr)
+  {
+    if (!strchr(" \t:-|", *ptr))
+      break;
+
+    ptr ++;
+  }
+
+  return (*ptr == '\r' || *ptr == '\n');
+}
+
+
+/*
+ * 'mmd_load()' - Load a markdown document from a file buffer.
+ */
+
+static mmd_t *				/* O - Root node in markdown */
+mmd_load(mmd_t          *root,		/* I - Root node for document or `NULL` for a new document */
+         _mmd_filebuf_t *file)		/* I - File buffer */
+{
+  size_t	i;			/* Looping var */
+  _mmd_doc_t	doc;			/* Document */
+  _mmd_ref_t	*reference;		/* Current reference */
+  mmd_t		*block = NULL;		/* Current block */
+  mmd_type_t	type;			/* Type for line */
+  char		line[8192],		/* Read line */
+		*linestart,		/* Start of line */
+		*lineptr,		/* Pointer into line */
+		*lineend,		/* End of line */
+		*temp;			/* Temporary pointer */
+  int		newindent;		/* New indentation */
+  int		blank_code = 0;		/* Saved indented blank code line */
+  mmd_type_t	columns[256];		/* Alignment of table columns */
+  int		num_columns = 0,	/* Number of columns in table */
+		rows = 0;		/* Number of rows in table */
+  _mmd_stack_t	stack[32],		/* Block stack */
+		*stackptr = stack;	/* Pointer to top of stack */
 
-      newindent = lineptr - line;
-      temp	= lineptr + 1;
 
-      while (*temp == '#')
-	temp ++;
+ /*
+  * Create an empty document as needed...
+  */
 
-      if ((temp - lineptr) <= 6 && isspace(*temp & 255))
-      {
-       /*
-	* Heading 1-6...
-	*/
+  DEBUG_printf("mmd_load: mmd_options=%d%s%s\n", mmd_options, (mmd_options & MMD_OPTION_METADATA) ? " METADATA" : "", (mmd_options & MMD_OPTION_TABLES) ? " TABLES" : "");
 
-	type  = MMD_TYPE_HEADING_1 + (temp - lineptr - 1);
-	block = NULL;
+  memset(&doc, 0, sizeof(doc));
 
-       /*
-	* Skip whitespace after "#"...
-	*/
+  if (root)
+    doc.root = root;
+  else
+    doc.root = mmd_add(NULL, MMD_TYPE_DOCUMENT, 0, NULL, NULL);
 
-	lineptr = temp;
-	while (isspace(*lineptr & 255))
-	  lineptr ++;
+  if (!doc.root)
+    return (NULL);
 
-	linestart = lineptr;
+ /*
+  * Initialize the block stack...
+  */
 
-       /*
-	* Strip trailing "#" characters and whitespace...
-	*/
+  memset(stack, 0, sizeof(stack));
+  stackptr->parent = doc.root;
 
-	temp = lineptr + strlen(lineptr) - 1;
-	while (temp > lineptr && isspace(*temp & 255))
-	  *temp-- = '\0';
-	while (temp > lineptr && *temp == '#')
-	  temp --;
-	if (isspace(*temp & 255))
-	{
-	  while (temp > lineptr && isspace(*temp & 255))
-	    *temp-- = '\0';
-	}
-	else if (temp == lineptr)
-	  *temp = '\0';
+ /*
+  * Read lines until end-of-file...
+  */
 
-	while (stackptr > stack && stackptr->indent > newindent)
-	  stackptr --;
+#ifdef __clang_analyzer__
+  memset(line, 0, sizeof(line));
+#endif // __clang_analyzer__
 
-	block = mmd_add(stackptr->parent, type, 0, NULL, NULL);
-      }
-      else
-      {
-       /*
-	* More than 6 #'s, just treat as a paragraph...
-	*/
+  while ((lineptr = mmd_read_line(file, line, sizeof(line))) != NULL)
+  {
+    DEBUG_printf("%03d	%-12s  %s", stackptr->indent, mmd_type_string(stackptr->parent->type) + 9, lineptr);
+#if DEBUG
+    if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
+      DEBUG2_printf("	  blank_code=%d\n", blank_code);
+#endif /* DEBUG */
 
-	type = MMD_TYPE_PARAGRAPH;
-      }
-    }
-    else if (block && block->type >= MMD_TYPE_HEADING_1 && block->type <= MMD_TYPE_HEADING_6)
-    {
-      DEBUG_puts("     PARAGRAPH\n");
+    linestart = lineptr;
 
-      type  = MMD_TYPE_PARAGRAPH;
-      block = NULL;
-    }
-    else if (!block)
-    {
-      type = MMD_TYPE_PARAGRAPH;
+    while (isspace(*lineptr & 255))
+      lineptr ++;
 
-      if (lineptr == line && stackptr->parent->type != MMD_TYPE_TABLE)
-	stackptr = stack;
-    }
-    else
-      type = block->type;
+    DEBUG2_printf("	line indent=%d\n", (int)(lineptr - line));
+    DEBUG2_printf("	stackptr=%d\n", (int)(stackptr - stack));
 
-    if (!*lineptr)
+    if (!*lineptr && stackptr->parent->type == MMD_TYPE_TABLE)
     {
-      if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
-	blank_code ++;
-      else if (stackptr->parent->type == MMD_TYPE_BLOCK_QUOTE && line[0] != '>')
-	stackptr --;
-
+      DEBUG2_puts("END TABLE\n");
+      stackptr --;
       block = NULL;
       continue;
     }
-    else if (!strcmp(lineptr, "+"))
-    {
-      if (block)
-      {
-	if (block->type == MMD_TYPE_LIST_ITEM)
-	  block = mmd_add(block, MMD_TYPE_PARAGRAPH, 0, NULL, NULL);
-	else if (block->parent->type == MMD_TYPE_LIST_ITEM)
-	  block = mmd_add(block->parent, MMD_TYPE_PARAGRAPH, 0, NULL, NULL);
-	else
-	  block = NULL;
-      }
-      continue;
-    }
-    else if ((mmd_options & MMD_OPTION_TABLES) && strchr(lineptr, '|') && (stackptr->parent->type == MMD_TYPE_TABLE || mmd_is_table(&file, stackptr->indent)))
+    else if (*lineptr == '>' && (lineptr - linestart) < 4)
     {
      /*
-      * Table...
+      * Block quote.  See if there is an existing blockquote...
       */
 
-      int	col;			/* Current column */
-      char	*start,			/* Start of column/cell */
-		*end;			/* End of column/cell */
-      mmd_t	*row = NULL,		/* Current row */
-		*cell;			/* Current cell */
-
-      DEBUG2_printf("TABLE stackptr->parent=%p (%d), rows=%d\n", stackptr->parent, stackptr->parent->type, rows);
-
-      if (stackptr->parent->type != MMD_TYPE_TABLE && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
-      {
-	DEBUG2_printf("ADDING NEW TABLE to %p (%s)\n", stackptr->parent, mmd_type_string(stackptr->parent->type));
-
-	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_TABLE, 0, NULL, NULL);
-	stackptr[1].indent = stackptr->indent;
-	stackptr[1].fence  = '\0';
-	stackptr ++;
-
-	block = mmd_add(stackptr->parent, MMD_TYPE_TABLE_HEADER, 0, NULL, NULL);
-
-	for (col = 0; col < (int)(sizeof(columns) / sizeof(columns[0])); col ++)
-	  columns[col] = MMD_TYPE_TABLE_BODY_CELL_LEFT;
+      DEBUG_printf("	 BLOCKQUOTE (stackptr=%ld)\n", stackptr - stack);
 
-	num_columns = 0;
-	rows	    = -1;
-      }
-      else if (rows > 0)
+      if (stackptr == stack || stack[1].parent->type != MMD_TYPE_BLOCK_QUOTE)
       {
-	if (rows == 1)
-	  block = mmd_add(stackptr->parent, MMD_TYPE_TABLE_BODY, 0, NULL, NULL);
+	block		 = NULL;
+	stackptr	 = stack + 1;
+	stackptr->parent = mmd_add(doc.root, MMD_TYPE_BLOCK_QUOTE, 0, NULL, NULL);
+	stackptr->indent = 2;
+	stackptr->fence	 = '\0';
       }
-      else
-	block = NULL;
 
-      if (block)
-	row = mmd_add(block, MMD_TYPE_TABLE_ROW, 0, NULL, NULL);
+     /*
+      * Skip whitespace after the ">"...
+      */
 
-      if (*lineptr == '|')
-	lineptr ++;			/* Skip leading pipe */
+      lineptr ++;
+      if (isspace(*lineptr & 255))
+	lineptr ++;
 
-      if ((end = lineptr + strlen(lineptr) - 1) > lineptr)
-      {
-	while ((*end == '\n' || *end == 'r') && end > lineptr)
-	  end --;
+      linestart = lineptr;
 
-	if (end > lineptr && *end == '|')
-	  *end = '\0';			/* Truncate trailing pipe */
-      }
+      while (isspace(*lineptr & 255))
+	lineptr ++;
+    }
+    else if (*lineptr != '>' && stackptr > stack && stack[1].parent->type == MMD_TYPE_BLOCK_QUOTE && (!block || *lineptr == '\n' || mmd_is_chars(lineptr, "- \t", 3) || mmd_is_chars(lineptr, "_ \t", 3) || mmd_is_chars(lineptr, "* \t", 3)))
+    {
+     /*
+      * Not a lazy continuation so terminate this block quote...
+      */
 
-      for (col = 0; lineptr && *lineptr && col < (int)(sizeof(columns) / sizeof(columns[0])); col ++)
-      {
-       /*
-	* Get the bounds of the stackptr->parent cell...
-	*/
+      DEBUG_puts("     Terminating BLOCKQUOTE\n");
+      block    = NULL;
+      stackptr = stack;
+    }
 
-	start = lineptr;
-	if ((lineptr = strchr(lineptr + 1, '|')) != NULL)
-	  *lineptr++ = '\0';
+   /*
+    * Now handle all other markup not related to block quotes...
+    */
 
-	if (block)
-	{
-	 /*
-	  * Add a cell to this row...
-	  */
+    DEBUG2_printf("	stackptr=%d (%s), block=%p (%s)\n", (int)(stackptr - stack), mmd_type_string(stackptr->parent->type) + 9, block, block ? mmd_type_string(block->type) + 9 : "");
+    DEBUG2_printf("	strchr(lineptr, '|')=%p, mmd_is_table(file, stackptr->indent)=%d\n", strchr(lineptr, '|'), mmd_is_table(file, stackptr->indent));
+    DEBUG2_printf("	linestart=%d, lineptr=%d\n", (int)(linestart - line), (int)(lineptr - line));
+    DEBUG2_printf("	mmd_is_chars(lineptr, \"-\", 1)=%d\n", (int)mmd_is_chars(lineptr, "-", 1));
+    DEBUG2_printf("	mmd_is_chars(lineptr, \"=\", 1)=%d\n", (int)mmd_is_chars(lineptr, "=", 1));
 
-	  if (block->type == MMD_TYPE_TABLE_HEADER)
-	    cell = mmd_add(row, MMD_TYPE_TABLE_HEADER_CELL, 0, NULL, NULL);
-	  else
-	    cell = mmd_add(row, columns[col], 0, NULL, NULL);
+    if ((lineptr - line - stackptr->indent) < 4 && ((stackptr->parent->type != MMD_TYPE_CODE_BLOCK && !stackptr->fence && mmd_is_codefence(lineptr, '\0', 0, NULL)) || (stackptr->fence && mmd_is_codefence(lineptr, stackptr->fence, stackptr->fencelen, NULL))))
+    {
+     /*
+      * Code fence...
+      */
 
-	  mmd_parse_inline(&doc, cell, start);
-	}
-	else
-	{
-	 /*
-	  * Process separator row for alignment...
-	  */
+      DEBUG2_printf("stackptr->indent=%d, fence='%c', fencelen=%d\n", stackptr->indent, stackptr->fence, (int)stackptr->fencelen);
 
-	  while (isspace(*start & 255))
-	    start ++;
+      if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
+      {
+	DEBUG2_puts("Ending code block...\n");
+	stackptr --;
+      }
+      else if (stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
+      {
+	char	*language;		/* Language name, if any */
 
-	  for (end = start + strlen(start) - 1; end > start && isspace(*end & 255); end --)
-	    ;				/* Find the last non-space character */
+	DEBUG2_printf("Starting code block with fence '%c'.\n", *lineptr);
 
-	  if (*start == ':' && *end == ':')
-	    columns[col] = MMD_TYPE_TABLE_BODY_CELL_CENTER;
-	  else if (*end == ':')
-	    columns[col] = MMD_TYPE_TABLE_BODY_CELL_RIGHT;
+	block		     = NULL;
+	stackptr[1].parent   = mmd_add(stackptr->parent, MMD_TYPE_CODE_BLOCK, 0, NULL, NULL);
+	stackptr[1].indent   = lineptr - line;
+	stackptr[1].fence    = *lineptr;
+	stackptr[1].fencelen = mmd_is_codefence(lineptr, '\0', 0, &language);
+	stackptr ++;
 
-	  DEBUG2_printf("COLUMN %d SEPARATOR=\"%s\", TYPE=%d\n", col, start, columns[col]);
-	}
-      }
+	DEBUG2_printf("Code language=\"%s\"\n", language);
 
-     /*
-      * Make sure the table is balanced...
-      */
+	if (language)
+	  stackptr->parent->extra = strdup(language);
 
-      if (col > num_columns)
+	blank_code = 0;
+      }
+      continue;
+    }
+    else if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK && (lineptr - line) >= stackptr->indent)
+    {
+      if (line[stackptr->indent] == '\n')
       {
-	num_columns = col;
+	blank_code ++;
       }
-      else if (block && block->type != MMD_TYPE_TABLE_HEADER)
+      else
       {
-	while (col < num_columns)
+	while (blank_code > 0)
 	{
-	  mmd_add(row, columns[col], 0, NULL, NULL);
-	  col ++;
+	  mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, "\n", NULL);
+	  blank_code --;
 	}
-      }
 
-      rows ++;
+	mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, line + stackptr->indent, NULL);
+      }
       continue;
     }
-    else if (stackptr->parent->type == MMD_TYPE_TABLE)
-    {
-      DEBUG2_puts("END TABLE\n");
-      stackptr --;
-      block = NULL;
-    }
-
-    if (stackptr->parent->type != MMD_TYPE_CODE_BLOCK && (!block || block->type == MMD_TYPE_CODE_BLOCK) && (lineptr - linestart) >= (stackptr->indent + 4))
+    else if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK && stackptr->fence)
     {
-     /*
-      * Indented code block.
-      */
+      DEBUG2_printf("	  fence='%c'\n", stackptr->fence);
 
-      if (stackptr->parent->type != MMD_TYPE_CODE_BLOCK && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
+      if (!*lineptr)
       {
-	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_CODE_BLOCK, 0, NULL, NULL);
-	stackptr[1].indent = stackptr->indent + 4;
-	stackptr[1].fence  = '\0';
-	stackptr ++;
-
-	blank_code = 0;
+	blank_code ++;
       }
-
-      while (blank_code > 0)
+      else
       {
-	mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, "\n", NULL);
-	blank_code --;
-      }
-
-      mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, line + stackptr->indent, NULL);
+	while (blank_code > 0)
+	{
+	  mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, "\n", NULL);
+	  blank_code --;
+	}
 
+	mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, lineptr, NULL);
+      }
       continue;
     }
-
-    if (!block || block->type != type)
+    else if (!strncmp(lineptr, "---", 3) && doc.root->first_child == NULL && (mmd_options & MMD_OPTION_METADATA))
     {
-      if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
-	stackptr --;
-
-      block = mmd_add(stackptr->parent, type, 0, NULL, NULL);
-    }
+     /*
+      * Document metadata...
+      */
 
-   /*
-    * Read continuation lines before parsing this...
-    */
+      block = mmd_add(doc.root, MMD_TYPE_METADATA, 0, NULL, NULL);
 
-    while (mmd_has_continuation(line, &file, stackptr->indent))
-    {
-      char *ptr = line + strlen(line);
+      while ((lineptr = mmd_read_line(file, line, sizeof(line))) != NULL)
+      {
+	while (isspace(*lineptr & 255))
+	  lineptr ++;
 
-      if (!mmd_read_line(&file, ptr, sizeof(line) - (size_t)(ptr - line)))
-	break;
-      else if (line[0] == '>' && *ptr == '>')
-	memmove(ptr, ptr + 1, strlen(ptr));
-    }
+	if (!strncmp(lineptr, "---", 3) || !strncmp(lineptr, "...", 3))
+	  break;
 
-    mmd_parse_inline(&doc, block, lineptr);
+	lineend = lineptr + strlen(lineptr) - 1;
+	if (lineend > lineptr && *lineend == '\n')
+	  *lineend = '\0';
 
-    if (block->type == MMD_TYPE_PARAGRAPH && !block->first_child)
-    {
-      mmd_remove(block);
-      mmd_free(block);
-      block = NULL;
+	mmd_add(block, MMD_TYPE_METADATA_TEXT, 0, lineptr, NULL);
+      }
+      continue;
     }
-  }
-
- /*
-  * Free any references...
-  */
-
-  for (i = doc.num_references, reference = doc.references; i > 0; i --, reference ++)
-  {
-    if (reference->pending)
+    else if (block && block->type == MMD_TYPE_PARAGRAPH && (lineptr - linestart) < 4 && (lineptr - line) >= stackptr->indent && (mmd_is_chars(lineptr, "-", 1) || mmd_is_chars(lineptr, "=", 1)))
     {
-      char	text[8192];		/* Reference text */
-      size_t	j;			/* Looping var */
+      int ch = *lineptr;
 
-      DEBUG2_printf("Clearing links for '%s'.\n", reference->name);
-      snprintf(text, sizeof(text), "[%s]", reference->name);
+      DEBUG_puts("     SETEXT HEADING\n");
 
-      for (j = 0; j < reference->num_pending; j ++)
+      lineptr += 3;
+      while (*lineptr == ch)
+	lineptr ++;
+      while (isspace(*lineptr & 255))
+	lineptr ++;
+
+      if (!*lineptr)
       {
-	free(reference->pending[j]->text);
-	reference->pending[j]->text = strdup(text);
-	reference->pending[j]->type = MMD_TYPE_NORMAL_TEXT;
+	if (ch == '=')
+	  block->type = MMD_TYPE_HEADING_1;
+	else
+	  block->type = MMD_TYPE_HEADING_2;
+
+	block = NULL;
+	continue;
       }
 
-      free(reference->pending);
+      type = MMD_TYPE_PARAGRAPH;
     }
+    else if ((lineptr - linestart) < 4 && (mmd_is_chars(lineptr, "- \t", 3) || mmd_is_chars(lineptr, "_ \t", 3) || mmd_is_chars(lineptr, "* \t", 3)))
+    {
+      DEBUG_puts("     THEMATIC BREAK\n");
 
-    free(reference->name);
-    free(reference->url);
-  }
-
-  free(doc.references);
-
- /*
-  * Return the root node...
-  */
-
-  return (doc.root);
-}
-
-
-/*
- * 'mmdLoadString()' - Load a markdown string into nodes.
- */
-
-mmd_t *					/* O - Root node in markdown */
-mmdLoadString(mmd_t      *root,		/* I - Root node for document or `NULL` for a new document */
-              const char *s)		/* I - String to load */
-{
-  FILE		*fp;			/* File */
-
-
-#if _WIN32
- /*
-  * Windows does not provide the POSIX fmemopen, so create a temporary file and
-  * have MMD read it...
-  */
+      if (line[0] == '>')
+	stackptr = stack + 1;
+      else
+	stackptr = stack;
 
-  char		tempfile[1024];		/* Temporary filename */
+      mmd_add(stackptr->parent, MMD_TYPE_THEMATIC_BREAK, 0, NULL, NULL);
+//      type  = MMD_TYPE_PARAGRAPH;
+      block = NULL;
+      continue;
+    }
+    else if ((*lineptr == '-' || *lineptr == '+' || *lineptr == '*') && (lineptr[1] == '\t' || lineptr[1] == ' '))
+    {
+     /*
+      * Bulleted list...
+      */
 
-  if (tmpnam_s(tempfile, sizeof(tempfile)))
-    return (root);
+      DEBUG_puts("     UNORDERED LIST\n");
 
-  if ((fp = fopen(tempfile, "w+")) == NULL)
-    return (root);
+      lineptr	+= 2;
+      linestart = lineptr;
+      newindent = linestart - line;
 
-  fputs(s, fp);
-  rewind(fp);
+      while (isspace(*lineptr & 255))
+	lineptr ++;
 
-#else // POSIX
- /*
-  * Open the string as a file...
-  */
+      while (stackptr > stack && stackptr->indent > newindent)
+	stackptr --;
 
-  if ((fp = fmemopen((void *)s, strlen(s), "r")) == NULL)
-    return (root);
-#endif // _WIN32
+      if (stackptr > stack && stackptr->parent->type == MMD_TYPE_LIST_ITEM && stackptr->indent == newindent)
+	stackptr --;
 
- /*
-  * Load the string...
-  */
+      if (stackptr > stack && stackptr->parent->type == MMD_TYPE_ORDERED_LIST && stackptr->indent == newindent)
+	stackptr --;
 
-  root = mmdLoadFile(root, fp);
+      if (stackptr > stack && stackptr->parent->type == MMD_TYPE_BLOCK_QUOTE && line[0] != '>')
+	stackptr --;
 
- /*
-  * Close the memory file...
-  */
+      if (stackptr->parent->type != MMD_TYPE_UNORDERED_LIST && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
+      {
+	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_UNORDERED_LIST, 0, NULL, NULL);
+	stackptr[1].indent = linestart - line;
+	stackptr[1].fence  = '\0';
+	stackptr ++;
+      }
 
-  fclose(fp);
+      if (stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
+      {
+	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_LIST_ITEM, 0, NULL, NULL);
+	stackptr[1].indent = linestart - line;
+	stackptr[1].fence  = '\0';
+	stackptr ++;
+      }
 
-#if _WIN32
- /*
-  * Remove the temporary file...
-  */
+      type  = MMD_TYPE_PARAGRAPH;
+      block = NULL;
 
-  unlink(tempfile);
-#endif // _WIN32
+      if (mmd_is_chars(lineptr, "- \t", 3) || mmd_is_chars(lineptr, "_ \t", 3) || mmd_is_chars(lineptr, "* \t", 3))
+      {
+	mmd_add(stackptr->parent, MMD_TYPE_THEMATIC_BREAK, 0, NULL, NULL);
+	continue;
+      }
+    }
+    else if (isdigit(*lineptr & 255))
+    {
+     /*
+      * Ordered list?
+      */
 
-  return (root);
-}
+      DEBUG_puts("     ORDERED LIST?\n");
 
+      temp = lineptr + 1;
 
-/*
- * 'mmdSetOptions()' - Set (enable/disable) support for various markdown options.
- */
+      while (isdigit(*temp & 255))
+	temp ++;
 
-void
-mmdSetOptions(mmd_option_t options)	/* I - Options */
-{
-  mmd_options = options;
-}
+      if ((*temp == '.' || *temp == ')') && (temp[1] == '\t' || temp[1] == ' '))
+      {
+       /*
+	* Yes, ordered list.
+	*/
 
+	lineptr	  = temp + 2;
+	linestart = lineptr;
+	newindent = linestart - line;
 
-/*
- * 'mmd_add()' - Add a new markdown node.
- */
+	while (isspace(*lineptr & 255))
+	  lineptr ++;
 
-static mmd_t *				/* O - New node */
-mmd_add(mmd_t	   *parent,		/* I - Parent node */
-	mmd_type_t type,		/* I - Node type */
-	int	   whitespace,		/* I - 1 if whitespace precedes this node */
-	char	   *text,		/* I - Text, if any */
-	char	   *url)		/* I - URL, if any */
-{
-  mmd_t		*temp;			/* New node */
+	while (stackptr > stack && stackptr->indent > newindent)
+	  stackptr --;
 
+	if (stackptr->parent->type == MMD_TYPE_LIST_ITEM && stackptr->indent == newindent)
+	  stackptr --;
 
-  DEBUG2_printf("Adding %s to %p(%s), whitespace=%d, text=\"%s\", url=\"%s\"\n", mmd_type_string(type), parent, parent ? mmd_type_string(parent->type) : "", whitespace, text ? text : "(null)", url ? url : "(null)");
+	if (stackptr->parent->type == MMD_TYPE_UNORDERED_LIST && stackptr->indent == newindent)
+	  stackptr --;
 
-  if (!parent && type != MMD_TYPE_DOCUMENT)
-    return (NULL);			/* Only document nodes can be at the root */
+	if (stackptr->parent->type == MMD_TYPE_BLOCK_QUOTE && line[0] != '>')
+	  stackptr --;
 
-  if ((temp = calloc(1, sizeof(mmd_t))) != NULL)
-  {
-    if (parent)
-    {
-     /*
-      * Add node to the parent...
-      */
+	if (stackptr->parent->type != MMD_TYPE_ORDERED_LIST && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
+	{
+	  stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_ORDERED_LIST, 0, NULL, NULL);
+	  stackptr[1].indent = linestart - line;
+	  stackptr[1].fence  = '\0';
+	  stackptr ++;
+	}
 
-      temp->parent = parent;
+	if (stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
+	{
+	  stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_LIST_ITEM, 0, NULL, NULL);
+	  stackptr[1].indent = linestart - line;
+	  stackptr[1].fence  = '\0';
+	  stackptr ++;
+	}
 
-      if (parent->last_child)
-      {
-	parent->last_child->next_sibling = temp;
-	temp->prev_sibling		 = parent->last_child;
-	parent->last_child		 = temp;
+	type  = MMD_TYPE_PARAGRAPH;
+	block = NULL;
       }
       else
       {
-	parent->first_child = parent->last_child = temp;
+       /*
+	* No, just a regular paragraph...
+	*/
+
+	type = block ? block->type : MMD_TYPE_PARAGRAPH;
       }
     }
+    else if (*lineptr == '#' && (lineptr - linestart) < 4)
+    {
+     /*
+      * Heading, count the number of '#' for the heading level...
+      */
 
-   /*
-    * Copy the node values...
-    */
+      DEBUG_puts("     HEADING?\n");
 
-    temp->type	     = type;
-    temp->whitespace = whitespace;
+      newindent = lineptr - line;
+      temp	= lineptr + 1;
 
-    if (text)
-      temp->text = strdup(text);
+      while (*temp == '#')
+	temp ++;
 
-    if (url)
-      temp->url = strdup(url);
-  }
+      if ((temp - lineptr) <= 6 && isspace(*temp & 255))
+      {
+       /*
+	* Heading 1-6...
+	*/
 
-  return (temp);
-}
+	type  = MMD_TYPE_HEADING_1 + (temp - lineptr - 1);
+	block = NULL;
 
+       /*
+	* Skip whitespace after "#"...
+	*/
 
-/*
- * 'mmd_free()' - Free memory used by a node.
- */
+	lineptr = temp;
+	while (isspace(*lineptr & 255))
+	  lineptr ++;
 
-static void
-mmd_free(mmd_t *node)			/* I - Node */
-{
-  free(node->text);
-  free(node->url);
-  free(node->extra);
-  free(node);
-}
+	linestart = lineptr;
 
+       /*
+	* Strip trailing "#" characters and whitespace...
+	*/
 
-/*
- * 'mmd_has_continuation()' - Determine whether the next line is a continuation
- *			      of the current one.
- */
+	temp = lineptr + strlen(lineptr) - 1;
+	while (temp > lineptr && isspace(*temp & 255))
+	  *temp-- = '\0';
+	while (temp > lineptr && *temp == '#')
+	  temp --;
+	if (isspace(*temp & 255))
+	{
+	  while (temp > lineptr && isspace(*temp & 255))
+	    *temp-- = '\0';
+	}
+	else if (temp == lineptr)
+	  *temp = '\0';
 
-static int				/* O - 1 if the next line continues, 0 otherwise */
-mmd_has_continuation(
-    const char	   *line,		/* I - Current line */
-    _mmd_filebuf_t *file,		/* I - File buffer */
-    int		   indent)		/* I - Indentation for current block */
-{
-  const char	*lineptr = line;	/* Pointer into current line */
-  const char	*fileptr = file->bufptr;/* Pointer into next line */
+	while (stackptr > stack && stackptr->indent > newindent)
+	  stackptr --;
 
+	block = mmd_add(stackptr->parent, type, 0, NULL, NULL);
+      }
+      else
+      {
+       /*
+	* More than 6 #'s, just treat as a paragraph...
+	*/
 
-  if (*fileptr == '\n' || *fileptr == '\r')
-    return (0);
+	type = MMD_TYPE_PARAGRAPH;
+      }
+    }
+    else if (block && block->type >= MMD_TYPE_HEADING_1 && block->type <= MMD_TYPE_HEADING_6)
+    {
+      DEBUG_puts("     PARAGRAPH\n");
 
-  do
-  {
-    while (isspace(*lineptr & 255))
-      lineptr ++;
+      type  = MMD_TYPE_PARAGRAPH;
+      block = NULL;
+    }
+    else if (!block)
+    {
+      type = MMD_TYPE_PARAGRAPH;
 
-    if (*lineptr == '[' && (lineptr - line - indent) < 4 && (*fileptr == ' ' || *fileptr == '\t'))
-      return (1);
+      if (lineptr == line && stackptr->parent->type != MMD_TYPE_TABLE)
+	stackptr = stack;
+    }
+    else
+      type = block->type;
 
-    while (isspace(*fileptr & 255))
-      fileptr ++;
+    if (!*lineptr)
+    {
+      if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
+	blank_code ++;
+      else if (stackptr->parent->type == MMD_TYPE_BLOCK_QUOTE && line[0] != '>')
+	stackptr --;
 
-    if (*lineptr == '>' && *fileptr == '>')
+      block = NULL;
+      continue;
+    }
+    else if (!strcmp(lineptr, "+"))
     {
-      lineptr ++;
-      fileptr ++;
+      if (block)
+      {
+	if (block->type == MMD_TYPE_LIST_ITEM)
+	  block = mmd_add(block, MMD_TYPE_PARAGRAPH, 0, NULL, NULL);
+	else if (block->parent->type == MMD_TYPE_LIST_ITEM)
+	  block = mmd_add(block->parent, MMD_TYPE_PARAGRAPH, 0, NULL, NULL);
+	else
+	  block = NULL;
+      }
+      continue;
     }
-    else if (*fileptr == '>')
-      return (0);
+    else if ((mmd_options & MMD_OPTION_TABLES) && strchr(lineptr, '|') && (stackptr->parent->type == MMD_TYPE_TABLE || mmd_is_table(file, stackptr->indent)))
+    {
+     /*
+      * Table...
+      */
 
-    if (*fileptr == '\n' || *fileptr == '\r')
-      return (0);
-  }
-  while (isspace(*lineptr & 255) || isspace(*fileptr & 255));
+      int	col;			/* Current column */
+      char	*start,			/* Start of column/cell */
+		*end;			/* End of column/cell */
+      mmd_t	*row = NULL,		/* Current row */
+		*cell;			/* Current cell */
 
-  if (*lineptr == '#')
-    return (0);
+      DEBUG2_printf("TABLE stackptr->parent=%p (%d), rows=%d\n", stackptr->parent, stackptr->parent->type, rows);
 
-  if (strchr("-+*", *fileptr) && isspace(fileptr[1] & 255))
-  {
-   /*
-    * Bullet list item...
-    */
+      if (stackptr->parent->type != MMD_TYPE_TABLE && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
+      {
+	DEBUG2_printf("ADDING NEW TABLE to %p (%s)\n", stackptr->parent, mmd_type_string(stackptr->parent->type));
 
-    return (0);
-  }
+	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_TABLE, 0, NULL, NULL);
+	stackptr[1].indent = stackptr->indent;
+	stackptr[1].fence  = '\0';
+	stackptr ++;
 
-  if (isdigit(*fileptr & 255))
-  {
-   /*
-    * Ordered list item...
-    */
+	block = mmd_add(stackptr->parent, MMD_TYPE_TABLE_HEADER, 0, NULL, NULL);
 
-    while (*fileptr && isdigit(*fileptr & 255))
-      fileptr ++;
+	for (col = 0; col < (int)(sizeof(columns) / sizeof(columns[0])); col ++)
+	  columns[col] = MMD_TYPE_TABLE_BODY_CELL_LEFT;
 
-    if (*fileptr == '.' || *fileptr == '(')
-      return (0);
-  }
+	num_columns = 0;
+	rows	    = -1;
+      }
+      else if (rows > 0)
+      {
+	if (rows == 1)
+	  block = mmd_add(stackptr->parent, MMD_TYPE_TABLE_BODY, 0, NULL, NULL);
+      }
+      else
+	block = NULL;
 
-  if (mmd_is_codefence((char *)fileptr, '\0', 0, NULL))
-    return (0);
+      if (block)
+	row = mmd_add(block, MMD_TYPE_TABLE_ROW, 0, NULL, NULL);
 
-  if (mmd_is_chars(fileptr, "- \t", 3) || mmd_is_chars(fileptr, "_ \t", 3) || mmd_is_chars(fileptr, "* \t", 3))
-  {
-   /*
-    * Thematic break...
-    */
+      if (*lineptr == '|')
+	lineptr ++;			/* Skip leading pipe */
 
-    return (0);
-  }
+      if ((end = lineptr + strlen(lineptr) - 1) > lineptr)
+      {
+	while ((*end == '\n' || *end == 'r') && end > lineptr)
+	  end --;
 
-  if (mmd_is_chars(fileptr, "-", 1) || mmd_is_chars(fileptr, "=", 1))
-  {
-   /*
-    * Heading...
-    */
+	if (end > lineptr && *end == '|')
+	  *end = '\0';			/* Truncate trailing pipe */
+      }
 
-    return (0);
-  }
+      for (col = 0; lineptr && *lineptr && col < (int)(sizeof(columns) / sizeof(columns[0])); col ++)
+      {
+       /*
+	* Get the bounds of the stackptr->parent cell...
+	*/
 
-  if (*fileptr == '#')
-  {
-   /*
-    * Possible heading...
-    */
+	start = lineptr;
+	if ((lineptr = strchr(lineptr + 1, '|')) != NULL)
+	  *lineptr++ = '\0';
 
-    int count = 0;
+	if (block)
+	{
+	 /*
+	  * Add a cell to this row...
+	  */
 
-    while (*fileptr == '#')
-    {
-      fileptr ++;
-      count ++;
-    }
+	  if (block->type == MMD_TYPE_TABLE_HEADER)
+	    cell = mmd_add(row, MMD_TYPE_TABLE_HEADER_CELL, 0, NULL, NULL);
+	  else
+	    cell = mmd_add(row, columns[col], 0, NULL, NULL);
 
-    if (count <= 6)
-      return (0);
-  }
+	  mmd_parse_inline(&doc, cell, start);
+	}
+	else
+	{
+	 /*
+	  * Process separator row for alignment...
+	  */
 
-  return ((fileptr - file->bufptr) <= indent);
-}
+	  while (isspace(*start & 255))
+	    start ++;
 
+	  for (end = start + strlen(start) - 1; end > start && isspace(*end & 255); end --)
+	    ;				/* Find the last non-space character */
 
-/*
- * 'mmd_is_chars()' - Determine whether a line consists solely of whitespace
- *		      and the specified character.
- */
+	  if (*start == ':' && *end == ':')
+	    columns[col] = MMD_TYPE_TABLE_BODY_CELL_CENTER;
+	  else if (*end == ':')
+	    columns[col] = MMD_TYPE_TABLE_BODY_CELL_RIGHT;
 
-static size_t				/* O - 1 if as specified, 0 otherwise */
-mmd_is_chars(const char *lineptr,	/* I - Current line */
-	     const char *chars,		/* I - Non-space character */
-	     size_t	minchars)	/* I - Minimum number of non-space characters */
-{
-  size_t	found_ch = 0;		/* Did we find the specified characters? */
+	  DEBUG2_printf("COLUMN %d SEPARATOR=\"%s\", TYPE=%d\n", col, start, columns[col]);
+	}
+      }
 
-  while (*lineptr == *chars)
-  {
-    found_ch ++;
-    lineptr ++;
-  }
+     /*
+      * Make sure the table is balanced...
+      */
 
-  if (minchars > 1)
-  {
-    while (*lineptr && strchr(chars, *lineptr))
-    {
-      if (*lineptr == *chars)
-	found_ch ++;
+      if (col > num_columns)
+      {
+	num_columns = col;
+      }
+      else if (block && block->type != MMD_TYPE_TABLE_HEADER)
+      {
+	while (col < num_columns)
+	{
+	  mmd_add(row, columns[col], 0, NULL, NULL);
+	  col ++;
+	}
+      }
 
-      lineptr ++;
+      rows ++;
+      continue;
+    }
+    else if (stackptr->parent->type == MMD_TYPE_TABLE)
+    {
+      DEBUG2_puts("END TABLE\n");
+      stackptr --;
+      block = NULL;
     }
-  }
 
-  while (*lineptr && isspace(*lineptr & 255) && *lineptr != '\n')
-    lineptr ++;
+    if (stackptr->parent->type != MMD_TYPE_CODE_BLOCK && (!block || block->type == MMD_TYPE_CODE_BLOCK) && (lineptr - linestart) >= (stackptr->indent + 4))
+    {
+     /*
+      * Indented code block.
+      */
 
-  if ((*lineptr && *lineptr != '\n') || found_ch < minchars)
-    return (0);
-  else
-    return (found_ch);
-}
+      if (stackptr->parent->type != MMD_TYPE_CODE_BLOCK && stackptr < (stack + sizeof(stack) / sizeof(stack[0]) - 1))
+      {
+	stackptr[1].parent = mmd_add(stackptr->parent, MMD_TYPE_CODE_BLOCK, 0, NULL, NULL);
+	stackptr[1].indent = stackptr->indent + 4;
+	stackptr[1].fence  = '\0';
+	stackptr ++;
 
+	blank_code = 0;
+      }
 
-/*
- * 'mmd_is_codefence()' - Determine whether the line contains a code fence.
- */
+      while (blank_code > 0)
+      {
+	mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, "\n", NULL);
+	blank_code --;
+      }
 
-static size_t				/* O - Length of fence or 0 otherwise */
-mmd_is_codefence(char	*lineptr,	/* I - Line */
-		 char	fence,		/* I - Current fence character, if any */
-		 size_t fencelen,	/* I - Current fence length */
-		 char	**language)	/* O - Language name, if any */
-{
-  char		match = fence;		/* Character to match */
-  size_t	len = 0;		/* Length of fence chars */
+      mmd_add(stackptr->parent, MMD_TYPE_CODE_TEXT, 0, line + stackptr->indent, NULL);
 
+      continue;
+    }
 
-  if (language)
-    *language = NULL;
+    if (!block || block->type != type)
+    {
+      if (stackptr->parent->type == MMD_TYPE_CODE_BLOCK)
+	stackptr --;
 
-  if (!match)
-  {
-    if (*lineptr == '~' || *lineptr == '`')
-      match = *lineptr;
-    else
-      return (0);
-  }
+      block = mmd_add(stackptr->parent, type, 0, NULL, NULL);
+    }
 
-  while (*lineptr == match)
-  {
-    lineptr ++;
-    len ++;
-  }
+   /*
+    * Read continuation lines before parsing this...
+    */
 
-  if (len < 3 || (fencelen && len < fencelen))
-    return (0);
+    while (mmd_has_continuation(line, file, stackptr->indent))
+    {
+      char *ptr = line + strlen(line);
 
-  if (*lineptr && *lineptr != '\n' && fence)
-    return (0);
-  else if (*lineptr && *lineptr != '\n' && !fence)
-  {
-    if (match == '`' && strchr(lineptr, match))
-      return (0);
+      if (!mmd_read_line(file, ptr, sizeof(line) - (size_t)(ptr - line)))
+	break;
+      else if (line[0] == '>' && *ptr == '>')
+	memmove(ptr, ptr + 1, strlen(ptr));
+    }
 
-    while (isspace(*lineptr & 255))
-      lineptr ++;
+    mmd_parse_inline(&doc, block, lineptr);
 
-    if (*lineptr && language)
+    if (block->type == MMD_TYPE_PARAGRAPH && !block->first_child)
     {
-      *language = lineptr;
-
-      while (*lineptr && !isspace(*lineptr & 255))
-	lineptr ++;
-      *lineptr = '\0';
+      mmd_remove(block);
+      mmd_free(block);
+      block = NULL;
     }
   }
 
-  return (len);
-}
-
+ /*
+  * Free any references...
+  */
 
-/*
- * 'mmd_is_table()' - Look ahead to see if the next line contains a heading
- *		      divider for a table.
- */
+  for (i = doc.num_references, reference = doc.references; i > 0; i --, reference ++)
+  {
+    if (reference->pending)
+    {
+      char	text[8192];		/* Reference text */
+      size_t	j;			/* Looping var */
 
-static int				/* O - 1 if this is a table, 0 otherwise */
-mmd_is_table(_mmd_filebuf_t *file,	/* I - File to read from */
-	     int	    indent)	/* I - Indentation of table line */
-{
-  const char	*ptr;			/* Pointer into buffer */
+      DEBUG2_printf("Clearing links for '%s'.\n", reference->name);
+      snprintf(text, sizeof(text), "[%s]", reference->name);
 
+      for (j = 0; j < reference->num_pending; j ++)
+      {
+	mmd_free_text(reference->pending[j]);
+	reference->pending[j]->text = strdup(text);
+	reference->pending[j]->type = MMD_TYPE_NORMAL_TEXT;
+      }
 
-  ptr = file->bufptr;
-  while (*ptr)
-  {
-    if (!strchr(" \t>", *ptr))
-      break;
+      free(reference->pending);
+    }
 
-    ptr ++;
+    free(reference->name);
+    free(reference->url);
+    free(reference->title);
   }
 
-  if ((ptr - file->bufptr - indent) >= 4)
-    return (0);
-
-  while (*ptr)
-  {
-    if (!strchr(" \t:-|", *ptr))
-      break;
+  free(doc.references);
 
-    ptr ++;
-  }
+ /*
+  * Return the root node...
+  */
 
-  return (*ptr == '\r' || *ptr == '\n');
+  return (doc.root);
 }
 
 
@@ -2141,6 +2155,9 @@ mmd_read_buffer(_mmd_filebuf_t *file)	/* I - File buffer */
   size_t	bytes;			/* Bytes read */
 
 
+  if (!file->fp)
+    return;				/* Memory buffers are read in place */
+
   if (file->bufptr && file->bufptr > file->buffer)
   {
    /*
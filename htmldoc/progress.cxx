@@ -32,6 +32,34 @@ static FILE	*error_log = NULL;
  */
 
 static int	progress_visible = 0;
+static volatile int progress_stop = 0;	/* Stop the current conversion? */
+
+
+/*
+ * 'progress_cancel()' - Ask the current conversion to stop.
+ *
+ * The request is checked between paragraphs, images, and pages so that the
+ * conversion can stop cleanly from another thread.  Pass 0 before starting
+ * the next conversion.
+ */
+
+void
+progress_cancel(int cancel)	/* I - 1 to cancel, 0 to reset */
+{
+  progress_stop = cancel;
+}
+
+
+/*
+ * 'progress_cancelled()' - Return whether the current conversion was
+ *                          cancelled.
+ */
+
+int				/* O - 1 if cancelled, 0 otherwise */
+progress_cancelled(void)
+{
+  return (progress_stop);
+}
 
 
 /*
@@ -52,6 +80,8 @@ progress_error(HDerror    error,	/* I - Error number */
 
   if (error)
     Errors ++;
+  else if (!StatusMessages)
+    return;
 
   va_start(ap, format);
   vsnprintf(text, sizeof(text), format, ap);
@@ -156,7 +186,7 @@ progress_show(const char *format,	/* I - Printf-style format string */
               ...)			/* I - Additional args as needed */
 {
   va_list	ap;			/* Argument pointer */
-  static char	text[2048];		/* Formatted text string */
+  char		text[2048];		/* Formatted text string */
 
 
   va_start(ap, format);
@@ -186,9 +216,9 @@ progress_show(const char *format,	/* I - Printf-style format string */
   {
     fprintf(stderr, "\r%-79.79s", text);
     fflush(stderr);
-  }
 
-  progress_visible = 1;
+    progress_visible = 1;
+  }
 }
 
 
@@ -48,6 +48,8 @@ typedef enum
  * Prototypes...
  */
 
+extern void	progress_cancel(int cancel);
+extern int	progress_cancelled(void);
 extern void	progress_error(HDerror error, const char *format, ...)
 #    ifdef __GNUC__
 __attribute__ ((__format__ (__printf__, 2, 3)))
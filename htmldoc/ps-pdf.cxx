@@ -30,6 +30,8 @@
 
 /*#define DEBUG*/
 #include "htmldoc.h"
+#include "flate.h"
+#include "links.h"
 #include "markdown.h"
 #include "md5-private.h"
 #define md5_append _cupsMD5Append
@@ -38,6 +40,8 @@
 typedef unsigned char md5_byte_t;
 #define md5_state_t _cups_md5_state_t
 #include "rc4.h"
+#include "thread.h"
+#include "type1.h"
 #include <stdarg.h>
 #include <ctype.h>
 #include <time.h>
@@ -51,8 +55,6 @@ typedef unsigned char md5_byte_t;
 
 #include <fcntl.h>
 
-#include <zlib.h>
-
 extern "C" {		/* Workaround for JPEG header problems... */
 #include <jpeglib.h>	/* JPEG/JFIF image definitions */
 }
@@ -81,6 +83,16 @@ extern "C" {		/* Workaround for JPEG header problems... */
 #define RENDER_LINK	3		/* Hyperlink */
 #define RENDER_BG	4		/* Background image */
 
+#define RENDER_BLOCK	8192		/* Size of page arena blocks */
+
+#define SIZE_BUCKETS	256		/* Initial size cache hash buckets */
+
+#define LINEAR_NONE	-1		/* Object isn't used by a page */
+#define LINEAR_SHARED	-2		/* Object is used by several pages */
+#define LINEAR_OPEN	-3		/* Object is needed to open the document */
+
+#define OBJSTM_OBJECTS	100		/* Maximum objects in an object stream */
+
 
 /*
  * Structures...
@@ -112,13 +124,6 @@ typedef struct render_str		/**** Render entity structure ****/
   }	data;
 } render_t;
 
-typedef struct				/**** Named link position structure */
-{
-  short		page,			/* Page # */
-		top;			/* Top position */
-  uchar		name[124];		/* Reference name */
-} link_t;
-
 typedef struct				//// Page information
 {
   int		width,			// Width of page in points
@@ -131,6 +136,7 @@ typedef struct				//// Page information
 		landscape;		// Landscape orientation?
   render_t	*start,			// First render element
 		*end;			// Last render element
+  hd_arena_t	*arena;			// Memory for render elements
   uchar		*url,                   // URL/file
                 *chapter,		// Chapter text
 		*heading;		// Heading text
@@ -149,6 +155,11 @@ typedef struct				//// Page information
   int		nup;			// Number up pages
   int		outpage;		// Output page #
   float		outmatrix[2][3];	// Transform matrix
+
+  // Streaming support
+  long		stream_pos,		// Position in stream file
+		stream_length;		// Length of streamed page or 0
+  unsigned	stream_fonts;		// Fonts used by streamed page
 } page_t;
 
 typedef struct				//// Output page info
@@ -158,6 +169,160 @@ typedef struct				//// Output page info
   int		annot_object;		// Annotation object
 } outpage_t;
 
+typedef struct hdsize_s			//// Cached cell/table size
+{
+  struct hdsize_s *next;		// Next entry in hash bucket
+  tree_t	*node;			// Cell or table node
+  float		avail,			// Available width (right - left)
+		print_width,		// PagePrintWidth when measured
+		print_length;		// PagePrintLength when measured
+  int		depends;		// Does the size depend on avail?
+  float		width,			// Required width
+		minwidth,		// Minimum width
+		prefwidth,		// Preferred width
+		minheight;		// Minimum height
+} hdsize_t;
+
+#define HD_FRAG_BLOCK	1024		// Fragments per block
+
+typedef struct hdfrag_s			//// Flattened paragraph fragment
+{
+  struct hdfrag_s *prev,		// Previous fragment
+		*next;			// Next fragment
+  tree_t	*node;			// Text, image, anchor, or break node
+  markup_t	markup;			// Markup code
+  uchar		red,			// Color, changed for links
+		green,
+		blue;
+  float		width,			// Width, changed for images and spaces
+		height;			// Height, changed for images
+} hdfrag_t;
+
+typedef struct hdfragblock_s		//// Block of fragments
+{
+  struct hdfragblock_s *next;		// Next block
+  hdfrag_t	frags[HD_FRAG_BLOCK];	// Fragments
+} hdfragblock_t;
+
+typedef struct				//// Page content stream for workers
+{
+  uchar		*data;			// Uncompressed content
+  size_t	length,			// Length of content
+		alloc;			// Allocated size of content
+  int		*writes;		// flate_write() lengths, < 0 to flush
+  size_t	num_writes,		// Number of writes
+		alloc_writes;		// Allocated writes
+  uchar		*comp;			// Compressed content
+  size_t	comp_length,		// Length of compressed content
+		comp_alloc;		// Allocated size of compressed content
+  int		error;			// Non-zero on error
+  hd_job_t	*job;			// Compression job
+} hdstream_t;
+
+typedef struct hdfontblob_s		//// Serialized font program
+{
+  struct hdfontblob_s *next;		// Next blob for font
+  char		*glyphs;		// Characters and glyphs in the subset
+  int		level;			// Compression level, -1 for PostScript
+  uchar		*data;			// Font resource or stream data
+  size_t	length;			// Length of data
+  int		length1,		// Length of cleartext portion
+		length2,		// Length of encrypted portion
+		length3;		// Length of trailer
+  char		tag[7];			// Subset tag, if any
+} hdfontblob_t;
+
+typedef struct				//// AFM character metrics
+{
+  int		code,			// Character code or -1
+		width;			// Character width
+  char		name[64];		// Glyph name or ""
+} hdfontchar_t;
+
+typedef struct				//// Cached font program and metrics
+{
+  char		*datadir;		// Data directory for font
+  hd_type1_t	*program;		// Original font program
+  int		have_metrics,		// Have AFM metrics?
+		ascent,			// Ascent above baseline
+		cap_height,		// Ascent of CAPITALS
+		x_height,		// Ascent of lowercase
+		descent,		// Decent below baseline
+		bbox[4],		// Bounding box
+		italic_angle;		// Angle for italics
+  size_t	num_chars;		// Number of AFM characters
+  hdfontchar_t	*chars;			// AFM characters, in file order
+  int		num_blobs;		// Number of serialized programs
+  hdfontblob_t	*blobs;			// Serialized programs, most recent first
+} hdfont_t;
+
+typedef struct				//// Object in a linearized PDF file
+{
+  int		offset,			// Offset in temporary file
+		length,			// Length in temporary file
+		stream,			// Offset of stream data or 0
+		first_edit,		// First token to rewrite
+		num_edits,		// Number of tokens to rewrite
+		owner,			// Page using object or LINEAR_xxx
+		first,			// Used by the first page?
+		mark,			// Last search that reached the object
+		number,			// Object number in linearized file
+		new_offset,		// Offset in linearized file
+		new_length,		// Length in linearized file
+		shared;			// Shared object identifier or -1
+} hdlinobj_t;
+
+typedef struct				//// Token to rewrite in a linearized object
+{
+  int		offset,			// Offset from start of object
+		length,			// Length of token
+		value,			// Object number or 0 for a string
+		new_length;		// Length of re-encrypted string
+} hdlinedit_t;
+
+typedef struct				//// Page in a linearized PDF file
+{
+  int		start,			// First object in file order
+		num_objects,		// Number of objects
+		length,			// Length of objects
+		content_offset,		// Offset of content stream from page
+		content_length,		// Length of content stream
+		first_id,		// First shared object identifier
+		num_ids;		// Number of shared object identifiers
+} hdlinpage_t;
+
+typedef struct				//// Linearization data
+{
+  int		num_objects;		// Number of objects
+  hdlinobj_t	*objs;			// Objects, by temporary object number
+  int		num_edits,		// Number of edits
+		alloc_edits;		// Allocated edits
+  hdlinedit_t	*edits;			// Tokens to rewrite
+  int		*order,			// Objects in file order
+		*stack,			// Search stack
+		*reached,		// Objects reached by search
+		mark;			// Current search
+  hdlinpage_t	*pages;			// Pages
+  int		num_ids,		// Number of shared object identifiers
+		alloc_ids,		// Allocated identifiers
+		*ids;			// Shared object identifiers for pages
+  int		first_open,		// First document-level object
+		first_page,		// First object in first page section
+		num_first,		// Number of objects in first page section
+		first_shared,		// First object in shared objects section
+		first_other,		// First object in other objects section
+		lin_number,		// Linearization dictionary object
+		hint_number,		// Hint stream object
+		size;			// Number of objects, plus one
+  uchar		*hint;			// Hint stream data
+  size_t	hint_length,		// Length of hint stream data
+		hint_alloc;		// Allocated hint stream data
+  unsigned	hint_bits;		// Pending bits
+  int		hint_count,		// Number of pending bits
+		hint_error,		// Non-zero on error
+		shared_offset;		// Offset of shared object hint table
+} hdlinear_t;
+
 
 /*
  * Local globals...
@@ -188,9 +353,31 @@ static tree_t	*current_heading;
 static size_t	num_outpages = 0;
 static outpage_t *outpages = NULL;
 
-static size_t	num_links = 0,
-		alloc_links = 0;
-static link_t	*links = NULL;
+static hd_links_t *links = NULL;
+
+static hd_arena_t *size_arena = NULL;	// Memory for cached sizes
+static hdsize_t	**size_buckets = NULL;	// Size cache hash buckets
+static size_t	num_sizes = 0,		// Number of cached sizes
+		num_size_buckets = 0;	// Number of hash buckets
+static int	size_depends = 0,	// Current size depends on avail?
+		size_level = 0;		// Current table nesting level
+static int	size_hits = 0,		// Number of size cache hits
+		size_misses = 0;	// Number of size cache misses
+
+static hdfragblock_t *frag_blocks = NULL,
+					// Fragment blocks
+		*frag_current = NULL;	// Block for the next fragment
+static int	frag_used = 0;		// Fragments used in current block
+static tree_t	frag_break;		// Node for breaks between blocks
+
+static FILE	*stream_file = NULL;	// Temporary file for finished pages
+static char	stream_filename[1024];	// Name of temporary file
+static int	stream_active = 0,	// Write pages as they are finished?
+		stream_hold = 0,	// Tables/lists that may draw on earlier pages
+		stream_page = 0,	// Next page to write
+		stream_count = 0;	// Number of pages written early
+static uchar	stream_chars[TYPE_MAX * STYLE_MAX][256];
+					// Characters used by streamed pages
 
 static uchar	list_types[16];
 static int	list_values[16];
@@ -233,14 +420,18 @@ static float	render_size,
 		render_startx,
 		render_spacing;
 
-static int		compressor_active = 0;
-static z_stream		compressor;
-static uchar		comp_buffer[8192];
+static hd_flate_t	*compressor = NULL;
+static hdstream_t	*comp_capture = NULL;
+static uchar		comp_buffer[16384];
+static size_t		comp_bufused = 0;
 static uchar		encrypt_key[16];
 static int		encrypt_len;
 static rc4_context_t	encrypt_state;
 static md5_byte_t	file_id[16];
 
+static hdfont_t		font_cache[TYPE_MAX][STYLE_MAX];
+					// Fonts reused by later exports
+
 
 /*
  * Local functions...
@@ -259,6 +450,9 @@ static void	pspdf_prepare_outpages();
 static void	pspdf_prepare_page(int page);
 static void	pspdf_prepare_heading(int page, int print_page, uchar **format,
 		                      int y, char *page_text, int page_len);
+static int	pspdf_stream_check(tree_t *t);
+static int	pspdf_stream_format(const char *s);
+static void	pspdf_stream_pages(int page);
 static void	ps_write_document(uchar *author, uchar *creator,
 		                  uchar *copyright, uchar *keywords,
 				  uchar *subject, uchar *lang);
@@ -268,7 +462,9 @@ static void	ps_write_background(FILE *out);
 static void	pdf_write_document(uchar *author, uchar *creator,
 		                   uchar *copyright, uchar *keywords,
 				   uchar *subject, uchar *lang, tree_t *doc, tree_t *toc);
-static void	pdf_write_outpage(FILE *out, int outpage);
+static void	pdf_write_outpages(FILE *out);
+static void	pdf_write_outpage(FILE *out, int outpage, hdstream_t *stream);
+static void	pdf_render_outpage(FILE *out, int outpage);
 static void	pdf_write_page(FILE *out, int page);
 static void	pdf_write_resources(FILE *out, int page);
 #ifdef DEBUG_TOC
@@ -284,13 +480,50 @@ static int	pdf_count_headings(tree_t *toc);
 static int	pdf_start_object(FILE *out, int array = 0);
 static void	pdf_start_stream(FILE *out);
 static void	pdf_end_object(FILE *out);
+static void	pdf_linearize(FILE *in, FILE *out);
+static hdlinedit_t *pdf_lin_add_edit(hdlinear_t *lin);
+static void	pdf_lin_add_id(hdlinear_t *lin, int id);
+static int	pdf_lin_bits(int value);
+static int	pdf_lin_digits(int value);
+static void	pdf_lin_flush(hdlinear_t *lin);
+static void	pdf_lin_hints(hdlinear_t *lin);
+static void	pdf_lin_length(hdlinear_t *lin, int number);
+static void	pdf_lin_put(hdlinear_t *lin, unsigned value, int bits);
+static int	pdf_lin_reach(hdlinear_t *lin, int start);
+static int	pdf_lin_read(FILE *in, int offset, int length, uchar **data,
+		             size_t *alloc);
+static void	pdf_lin_rekey(uchar *data, int length, int from, int to);
+static int	pdf_lin_scan(hdlinear_t *lin, int number, uchar *data);
+static int	pdf_lin_string(uchar *ptr, uchar *end, uchar **next);
+static int	pdf_lin_trailer(hdlinear_t *lin, char *buffer, size_t bufsize,
+		                int prev);
+static void	pdf_lin_write(hdlinear_t *lin, FILE *out, int number,
+		              uchar *data);
+static void	pdf_write_objstms(FILE *in, FILE *out);
+static int	pdf_write_objstm(FILE *out, int number, int count,
+		                 const char *header, hdstream_t *body);
 
 static void	encrypt_init(void);
-static void	flate_open_stream(FILE *out);
+static void	encrypt_setup(rc4_context_t *context, int number);
+static void	flate_open_stream(FILE *out, hd_flate_type_t type);
 static void	flate_close_stream(FILE *out);
+static void	flate_output(FILE *out, uchar *buf, size_t length);
 static void	flate_puts(const char *s, FILE *out);
 static void	flate_printf(FILE *out, const char *format, ...);
 static void	flate_write(FILE *out, uchar *inbuf, int length, int flush=0);
+static void	flate_flush(FILE *out);
+static void	flate_send(FILE *out, uchar *buf, int length, int flush);
+static void	flate_capture(hdstream_t *stream, uchar *buf, int length,
+		              int flush);
+static void	flate_stream(hdstream_t *stream);
+static void	flate_stream_output(hdstream_t *stream, uchar *buf,
+		                    size_t length);
+
+static hdfont_t	*font_get(typeface_t typeface, style_t style);
+static hdfontblob_t *font_get_blob(hdfont_t *font, typeface_t typeface,
+		              style_t style, const uchar *chars);
+static int	font_get_metrics(hdfont_t *font, typeface_t typeface,
+		                 style_t style);
 
 static void	parse_contents(tree_t *t, float left, float width, float bottom,
 		               float length, float *y, int *page, int *heading,
@@ -321,32 +554,46 @@ static void	parse_comment(tree_t *t, float *left, float *width, float *bottom,
 static void	check_pages(int page);
 
 static void	add_link(uchar *name, int page, int top);
-static link_t	*find_link(uchar *name);
-static int	compare_links(link_t *n1, link_t *n2);
+static hd_link_t *find_link(uchar *name);
 
 static void	find_background(tree_t *t);
+static void	prefetch_image(image_t *img);
+static void	prefetch_images(tree_t *t);
 static void	write_background(int page, FILE *out);
 
 static render_t	*new_render(int page, int type, double x, double y,
 		            double width, double height, void *data,
 			    render_t *insert = 0);
+static void	free_render(page_t *p);
 static float	get_cell_size(tree_t *t, float left, float right,
 		              float *minwidth, float *prefwidth,
 			      float *minheight);
 static float	get_table_size(tree_t *t, float left, float right,
 		               float *minwidth, float *prefwidth,
 			       float *minheight);
-static tree_t	*flatten_tree(tree_t *t);
+static hdsize_t	*find_size(tree_t *t, float avail);
+static void	add_size(tree_t *t, float avail, float width, float minwidth,
+		         float prefwidth, float minheight);
+static void	free_sizes(void);
+static hdfrag_t	*flatten_tree(tree_t *t);
+static void	flatten_free(hdfrag_t *flat);
+static hdfrag_t	*flatten_nodes(tree_t *t, hdfrag_t *flat);
+static void	free_frags(void);
+static void	get_image_size(tree_t *t, float *width, float *height);
 static float	get_width(uchar *s, int typeface, int style, int size);
+static hdfrag_t	*new_frag(hdfrag_t *prev, tree_t *node, markup_t markup);
 static void	update_image_size(tree_t *t);
 static uchar	*get_title(tree_t *doc);
 static FILE	*open_file(void);
+static void	remove_output(void);
+static char	*format_number(char *s, float f, int digits);
 static void	set_color(FILE *out, float *rgb);
 static void	set_font(FILE *out, int typeface, int style, float size);
 static void	set_pos(FILE *out, float x, float y);
 static void	write_prolog(FILE *out, int pages, uchar *author,
 		             uchar *creator, uchar *copyright,
 			     uchar *keywords, uchar *subject);
+static void	write_buffer(FILE *out, const char *buffer, size_t length);
 static void	ps_hex(FILE *out, uchar *data, int length);
 #ifdef HTMLDOC_ASCII85
 static void	ps_ascii85(FILE *out, uchar *data, int length, int eod = 0);
@@ -355,14 +602,17 @@ static void	jpg_init(j_compress_ptr cinfo);
 static boolean	jpg_empty(j_compress_ptr cinfo);
 static void	jpg_term(j_compress_ptr cinfo);
 static void	jpg_setup(FILE *out, image_t *img, j_compress_ptr cinfo);
+static int	jpg_passthrough(image_t *img);
 static int	compare_rgb(unsigned *rgb1, unsigned *rgb2);
 static void	write_image(FILE *out, render_t *r, int write_obj = 0);
+static int	write_jpeg(FILE *out, render_t *r, int write_obj);
 static void	write_imagemask(FILE *out, render_t *r);
 static void	write_string(FILE *out, uchar *s, int compress);
 static void	write_text(FILE *out, render_t *r);
 static void	write_trailer(FILE *out, int pages, uchar *lang);
 static int	write_type1(FILE *out, typeface_t typeface,
-			    style_t style);
+			    style_t style, const uchar *chars,
+			    char *name, size_t namesize);
 static void	write_utf16(FILE *out, uchar *s);
 
 
@@ -409,6 +659,15 @@ pspdf_export(tree_t *document,	/* I - Document to export */
   int		needspace;	/* Need whitespace */
 
 
+ /*
+  * Set the compression for each kind of stream...
+  */
+
+  if (Compression)
+    hd_flate_setup(Compression);
+
+  hd_stats_begin(HD_PHASE_LAYOUT);
+
  /*
   * Figure out the printable area of the output page...
   */
@@ -515,6 +774,20 @@ pspdf_export(tree_t *document,	/* I - Document to export */
   find_background(document);
   get_color((uchar *)LinkColor, link_color);
 
+ /*
+  * Decode images on worker threads while the document is formatted...
+  */
+
+  prefetch_image(lh_image);
+  prefetch_image(logo_image);
+
+  for (int hfi = 0; hfi < MAX_HF_IMAGES; hfi ++)
+    prefetch_image(hfimage[hfi]);
+
+  prefetch_image(background_image);
+
+  prefetch_images(document);
+
  /*
   * Initialize page rendering variables...
   */
@@ -541,14 +814,15 @@ pspdf_export(tree_t *document,	/* I - Document to export */
   localtime_r(&doc_time, &doc_date);
   gmtime_r(&doc_time, &doc_gmdate);
 
-  num_headings   = 0;
-  alloc_headings = 0;
-  heading_pages  = NULL;
-  heading_tops   = NULL;
-  num_links      = 0;
-  alloc_links    = 0;
-  links          = NULL;
-  num_pages      = 0;
+  num_headings    = 0;
+  alloc_headings  = 0;
+  heading_pages   = NULL;
+  heading_tops    = NULL;
+  links           = hd_links_new();
+  size_hits       = 0;
+  size_misses     = 0;
+  num_pages       = 0;
+  current_heading = NULL;
 
   DEBUG_printf(("pspdf_export: TitlePage = %d, TitleImage = \"%s\"\n",
                 TitlePage, TitleImage));
@@ -579,15 +853,17 @@ pspdf_export(tree_t *document,	/* I - Document to export */
       {
 	progress_error(HD_ERROR_FILE_NOT_FOUND,
 	               "Unable to find title file \"%s\"!", TitleImage);
+	hd_stats_end();
 	return (1);
       }
 
       // Write a title page from HTML source...
-      if ((fp = fopen(title_file, "rb")) == NULL)
+      if ((fp = file_open(title_file, "rb")) == NULL)
       {
 	progress_error(HD_ERROR_FILE_NOT_FOUND,
 	               "Unable to open title file \"%s\" - %s!",
                        TitleImage, strerror(errno));
+	hd_stats_end();
 	return (1);
       }
 
@@ -802,8 +1078,32 @@ pspdf_export(tree_t *document,	/* I - Document to export */
 
   y = top;
 
+  // Write PostScript pages to a temporary file as soon as they are finished,
+  // unless something needs the final page count or changes the global page
+  // settings used when writing...
+  stream_active = 0;
+  stream_hold   = 0;
+  stream_page   = 0;
+  stream_count  = 0;
+
+  memset(stream_chars, 0, sizeof(stream_chars));
+
+  if (PSLevel > 0 && pspdf_stream_check(document))
+  {
+    for (pos = 0; pos < 3; pos ++)
+      if (!pspdf_stream_format(Header[pos]) ||
+          !pspdf_stream_format(Header1[pos]) ||
+          !pspdf_stream_format(Footer[pos]))
+        break;
+
+    if (pos == 3 && (stream_file = file_temp(stream_filename, sizeof(stream_filename))) != NULL)
+      stream_active = 1;
+  }
+
   parse_doc(document, &left, &right, &bottom, &top, &x, &y, &page, NULL, &needspace);
 
+  stream_active = 0;
+
   if (PageDuplex && (num_pages & 1))
   {
     if (PSLevel == 0)
@@ -819,7 +1119,8 @@ pspdf_export(tree_t *document,	/* I - Document to export */
 
   for (chapter = 1; chapter <= TocDocCount; chapter ++)
     for (page = chapter_starts[chapter]; page <= chapter_ends[chapter]; page ++)
-      pspdf_prepare_page(page);
+      if (!pages[page].stream_length)
+        pspdf_prepare_page(page);
 
  /*
   * Parse the table-of-contents if necessary...
@@ -890,11 +1191,22 @@ pspdf_export(tree_t *document,	/* I - Document to export */
   if (TocDocCount > MAX_CHAPTERS)
     TocDocCount = MAX_CHAPTERS;
 
+  hd_stats_end();
+  hd_stats_add(HD_COUNT_PAGES, num_pages);
+
  /*
   * Do we have any pages?
   */
 
-  if (num_pages > 0 && TocDocCount > 0)
+  if (progress_cancelled())
+  {
+   /*
+    * Cancelled, don't write anything...
+    */
+
+    pspdf_debug_stats();
+  }
+  else if (num_pages > 0 && TocDocCount > 0)
   {
    /*
     * Yes, write the document to disk...
@@ -902,8 +1214,6 @@ pspdf_export(tree_t *document,	/* I - Document to export */
 
     pspdf_prepare_outpages();
 
-    pspdf_debug_stats();
-
     progress_error(HD_ERROR_NONE, "PAGES: %d", (int)num_outpages);
 
     if (PSLevel > 0)
@@ -911,6 +1221,13 @@ pspdf_export(tree_t *document,	/* I - Document to export */
     else
       pdf_write_document(author, creator, copyright, keywords, subject, lang,
                          document, toc);
+
+    // Don't leave a partial document behind if the conversion was cancelled
+    // while writing...
+    if (progress_cancelled())
+      remove_output();
+
+    pspdf_debug_stats();
   }
   else
   {
@@ -931,17 +1248,25 @@ pspdf_export(tree_t *document,	/* I - Document to export */
   if (doc_title != NULL)
     free(doc_title);
 
-  if (alloc_links)
+  hd_links_delete(links);
+  links = NULL;
+
+  free_frags();
+
+  // Remove the stream file now so that --server and library callers don't
+  // collect one temporary file per document...
+  if (stream_file)
   {
-    free(links);
+    fclose(stream_file);
+    stream_file = NULL;
 
-    num_links    = 0;
-    alloc_links  = 0;
-    links        = NULL;
+    unlink(stream_filename);
   }
 
   for (i = 0; i < (int)num_pages; i ++)
   {
+    free_render(pages + i);
+
     if ((i == 0 || pages[i].chapter != pages[i - 1].chapter) &&
         pages[i].chapter)
       free(pages[i].chapter);
@@ -1025,8 +1350,11 @@ pspdf_debug_stats()
 {
   const char	*debug;			// HTMLDOC_DEBUG env var
   int		i;			// Looping var
-  render_t	*r;			// Render node
+  size_t	used;			// Bytes used in page arena
   int		bytes;			// Number of bytes
+  size_t	pixels,			// Bytes of decoded image pixels
+		peak;			// Most bytes of decoded image pixels
+  int		evicted;		// Number of pixel buffers evicted
 
 
   if ((debug = getenv("HTMLDOC_DEBUG")) == NULL ||
@@ -1038,21 +1366,46 @@ pspdf_debug_stats()
   bytes += alloc_pages * sizeof(page_t);
   for (i = 0; i < (int)num_pages; i ++)
   {
-    for (r = pages[i].start; r != NULL; r = r->next)
-    {
-      bytes += sizeof(render_t);
-
-      if (r->type == RENDER_TEXT)
-        bytes += strlen((char *)r->data.text.buffer);
-    }
+    hd_arena_stats(pages[i].arena, &used, NULL, NULL);
+    bytes += (int)used;
   }
 
   bytes += num_outpages * sizeof(outpage_t);
-  bytes += alloc_links * sizeof(link_t);
+  bytes += hd_links_memory(links);
   bytes += alloc_objects * sizeof(int);
 
   progress_error(HD_ERROR_NONE, "DEBUG: Render Data = %d kbytes",
                  (bytes + 1023) / 1024);
+  progress_error(HD_ERROR_NONE, "DEBUG: Table Size Cache = %d hits, %d misses",
+                 size_hits, size_misses);
+  progress_error(HD_ERROR_NONE, "DEBUG: Streamed Pages = %d", stream_count);
+
+  image_stats(&pixels, &peak, &evicted);
+
+  progress_error(HD_ERROR_NONE, "DEBUG: Image Pixels = %d kbytes, %d kbytes peak, %d evicted",
+                 (int)((pixels + 1023) / 1024), (int)((peak + 1023) / 1024), evicted);
+}
+
+
+/*
+ * 'pspdf_preload()' - Load the font programs and metrics for all typefaces.
+ *
+ * Later exports in this process, and in processes forked from it, reuse the
+ * loaded fonts.
+ */
+
+void
+pspdf_preload(void)
+{
+  int		typeface,		/* Current typeface */
+		style;			/* Current style */
+  hdfont_t	*font;			/* Font */
+
+
+  for (typeface = 0; typeface < TYPE_MAX; typeface ++)
+    for (style = 0; style < STYLE_MAX; style ++)
+      if ((font = font_get((typeface_t)typeface, (style_t)style)) != NULL)
+        font_get_metrics(font, (typeface_t)typeface, (style_t)style);
 }
 
 
@@ -1386,9 +1739,11 @@ pspdf_prepare_outpages()
   for (i = 0; i < (int)num_headings; i ++)
     printf("heading_pages[%d] = %d\n", i, heading_pages[i]);
 
-  for (i = 0; i < (int)num_links; i ++)
+  hd_link_t **sorted = hd_links_sorted(links);
+
+  for (i = 0; i < (int)hd_links_count(links); i ++)
     printf("links[%d].name = \"%s\", page = %d\n", i,
-           links[i].name, links[i].page);
+           sorted[i]->name, sorted[i]->page);
 #endif // DEBUG
 }
 
@@ -1871,6 +2226,146 @@ pspdf_prepare_heading(int   page,	// I - Page number
 }
 
 
+/*
+ * 'pspdf_stream_check()' - See if a document can be streamed.
+ *
+ * Pages can only be written as they are finished when no comment in the
+ * document changes the duplex or landscape settings or uses a page count
+ * in a header or footer.
+ */
+
+static int				// O - 1 if the document can be streamed
+pspdf_stream_check(tree_t *t)		// I - Document tree
+{
+  const char	*ptr;			// Pointer into comment
+
+
+  for (; t != NULL; t = t->next)
+  {
+    if (t->markup == MARKUP_COMMENT && t->data)
+    {
+      if (!pspdf_stream_format((char *)t->data))
+        return (0);
+
+      for (ptr = (char *)t->data; *ptr; ptr ++)
+        if (!strncasecmp(ptr, "DUPLEX", 6) || !strncasecmp(ptr, "LANDSCAPE", 9))
+          return (0);
+    }
+
+    if (t->child && !pspdf_stream_check(t->child))
+      return (0);
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'pspdf_stream_format()' - See if a header/footer format can be streamed.
+ */
+
+static int				// O - 1 if no page counts are used
+pspdf_stream_format(const char *s)	// I - Format string or NULL
+{
+  if (!s)
+    return (1);
+
+  while ((s = strchr(s, '$')) != NULL)
+  {
+    s ++;
+
+    if (!strncasecmp(s, "PAGES", 5) || !strncasecmp(s, "CHAPTERPAGES", 12))
+      return (0);
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'pspdf_stream_pages()' - Write finished pages to the stream file.
+ *
+ * Each page gets its headers and footers and is written to the temporary
+ * stream file, freeing its render list.  ps_write_page() copies the saved
+ * page when the document is written.
+ *
+ * The pages cannot go straight to the output file because the prolog lists
+ * the fonts and images used by every page, and the title and table-of-contents
+ * pages that come first are only formatted once the body is done.  This bounds
+ * memory use, not the time until the first byte is written.
+ */
+
+static void
+pspdf_stream_pages(int page)		// I - Current page
+{
+  int		c,			// Chapter for page
+		current,		// Current chapter
+		i;			// Font index
+  float		print_width,		// Current printable width
+		print_length;		// Current printable length
+  page_t	*p;			// Page to write
+  render_t	*r;			// Current render data
+  uchar		*s;			// Pointer into text
+
+
+  if (chapter < 1 || chapter_starts[1] < 0)
+    return;
+
+  if (stream_page < chapter_starts[1])
+    stream_page = chapter_starts[1];
+
+  if (page > (int)num_pages)
+    page = (int)num_pages;
+
+  if (stream_page >= page)
+    return;
+
+  // pspdf_prepare_page() uses these globals, so save them for the parser...
+  current      = chapter;
+  print_width  = PagePrintWidth;
+  print_length = PagePrintLength;
+
+  for (; stream_page < page; stream_page ++)
+  {
+    // Find the chapter for the page, skipping pages outside of any chapter...
+    for (c = current; c > 0; c --)
+      if (chapter_starts[c] >= 0 && chapter_starts[c] <= stream_page)
+        break;
+
+    if (c < 1 || (chapter_ends[c] >= 0 && stream_page > chapter_ends[c]))
+      continue;
+
+    chapter = c;
+    p       = pages + stream_page;
+
+    pspdf_prepare_page(stream_page);
+
+    for (r = p->start; r != NULL; r = r->next)
+      if (r->type == RENDER_TEXT)
+      {
+        i = r->data.text.typeface * STYLE_MAX + r->data.text.style;
+
+	p->stream_fonts |= 1U << i;
+
+        for (s = r->data.text.buffer; *s; s ++)
+	  stream_chars[i][*s] = 1;
+      }
+
+    p->stream_pos = ftell(stream_file);
+
+    ps_write_page(stream_file, stream_page);
+
+    p->stream_length = ftell(stream_file) - p->stream_pos;
+
+    stream_count ++;
+  }
+
+  chapter         = current;
+  PagePrintWidth  = print_width;
+  PagePrintLength = print_length;
+}
+
+
 /*
  * 'ps_write_document()' - Write all render entities to PostScript file(s).
  */
@@ -1923,7 +2418,7 @@ ps_write_document(uchar *author,	/* I - Author of document */
                    keywords, subject);
     }
 
-    for (page = 0; page < chapter_outstarts[first]; page ++)
+    for (page = 0; page < chapter_outstarts[first] && !progress_cancelled(); page ++)
       ps_write_outpage(out, page);
 
     if (OutputFiles)
@@ -1936,7 +2431,7 @@ ps_write_document(uchar *author,	/* I - Author of document */
     }
   }
 
-  for (chapter = first; chapter <= TocDocCount; chapter ++)
+  for (chapter = first; chapter <= TocDocCount && !progress_cancelled(); chapter ++)
   {
     if (chapter_starts[chapter] < 0)
       continue;
@@ -1956,7 +2451,7 @@ ps_write_document(uchar *author,	/* I - Author of document */
     }
 
     for (page = chapter_outstarts[chapter];
-         page < chapter_outends[chapter];
+         page < chapter_outends[chapter] && !progress_cancelled();
          page ++)
       ps_write_outpage(out, page);
 
@@ -1984,7 +2479,9 @@ ps_write_document(uchar *author,	/* I - Author of document */
 
     progress_error(HD_ERROR_NONE, "BYTES: %ld", ftell(out));
 
-    if (out != stdout)
+    if (out == OutputFile)
+      fflush(out);
+    else if (out != stdout)
       fclose(out);
   }
 
@@ -2178,10 +2675,12 @@ static void
 ps_write_page(FILE  *out,	/* I - Output file */
               int   page)	/* I - Page number */
 {
-  render_t	*r,		/* Render pointer */
-		*next;		/* Next render */
+  render_t	*r;		/* Render pointer */
   page_t	*p;		/* Current page */
   const char	*debug;		/* HTMLDOC_DEBUG environment variable */
+  char		buffer[8192];	/* Copy buffer */
+  long		bytes;		/* Bytes left to copy */
+  size_t	count;		/* Bytes read */
 
 
   if (page < 0 || page >= (int)alloc_pages)
@@ -2191,6 +2690,26 @@ ps_write_page(FILE  *out,	/* I - Output file */
 
   DEBUG_printf(("ps_write_page(%p, %d)\n", (void *)out, page));
 
+  if (p->stream_length > 0)
+  {
+   /*
+    * Copy the page that was written while formatting...
+    */
+
+    fseek(stream_file, p->stream_pos, SEEK_SET);
+
+    for (bytes = p->stream_length; bytes > 0; bytes -= (long)count)
+    {
+      if ((count = fread(buffer, 1, bytes > (long)sizeof(buffer) ? sizeof(buffer) : (size_t)bytes, stream_file)) == 0)
+        break;
+
+      fwrite(buffer, 1, count, out);
+    }
+
+    p->stream_fonts = 0;
+    return;
+  }
+
  /*
   * Clear the render cache...
   */
@@ -2254,16 +2773,11 @@ ps_write_page(FILE  *out,	/* I - Output file */
   * Render all text elements, freeing used memory as we go...
   */
 
-  for (r = p->start, next = NULL; r != NULL; r = next)
-  {
+  for (r = p->start; r != NULL; r = r->next)
     if (r->type == RENDER_TEXT)
       write_text(out, r);
 
-    next = r->next;
-    free(r);
-  }
-
-  p->start = NULL;
+  free_render(p);
 
   if ((debug = getenv("HTMLDOC_DEBUG")) != NULL && strstr(debug, "margin"))
   {
@@ -2324,7 +2838,9 @@ pdf_write_document(uchar  *author,	// I - Author of document
                    tree_t *toc)		// I - Table of contents tree
 {
   int		i;			// Looping variable
-  FILE		*out;			// Output file
+  FILE		*out,			// Output file
+		*final = NULL;		// Final output file
+  char		temp_filename[1024];	// Temporary file for rewritten output
   int		outpage,		// Current page #
 		heading;		// Current heading #
   int		bytes;			// Number of bytes
@@ -2343,6 +2859,21 @@ pdf_write_document(uchar  *author,	// I - Author of document
     return;
   }
 
+  // Linearized files and files with object streams are written to a
+  // temporary file and then rewritten...
+  if (PDFLinearize || PDFVersion >= 15)
+  {
+    final = out;
+
+    if ((out = file_temp(temp_filename, sizeof(temp_filename))) == NULL)
+    {
+      progress_error(HD_ERROR_WRITE_ERROR,
+                     "Unable to create temporary file - %s\n", strerror(errno));
+      out   = final;
+      final = NULL;
+    }
+  }
+
   // Clear the objects array...
   num_objects   = 0;
   alloc_objects = 0;
@@ -2401,8 +2932,35 @@ pdf_write_document(uchar  *author,	// I - Author of document
   fputs("]", out);
   pdf_end_object(out);
 
-  for (outpage = 0; outpage < (int)num_outpages; outpage ++)
-    pdf_write_outpage(out, outpage);
+  pdf_write_outpages(out);
+
+  if (progress_cancelled())
+  {
+   /*
+    * Stop without finishing the document, the remaining objects would be
+    * numbered wrong...
+    */
+
+    if (final)
+    {
+      fclose(out);
+      unlink(temp_filename);
+      out = final;
+    }
+
+    if (out == OutputFile)
+      fflush(out);
+    else
+      fclose(out);
+
+    free(objects);
+
+    num_objects   = 0;
+    alloc_objects = 0;
+    objects       = NULL;
+
+    return;
+  }
 
   if (OutputType == OUTPUT_BOOK && TocLevels > 0)
   {
@@ -2431,6 +2989,18 @@ pdf_write_document(uchar  *author,	// I - Author of document
 
   write_trailer(out, 0, lang);
 
+  if (final)
+  {
+    if (PDFLinearize)
+      pdf_linearize(out, final);
+    else
+      pdf_write_objstms(out, final);
+
+    // The temporary file is removed when the program exits...
+    fclose(out);
+    out = final;
+  }
+
   progress_error(HD_ERROR_NONE, "BYTES: %ld", ftell(out));
 
   if (CGIMode)
@@ -2457,13 +3027,16 @@ pdf_write_document(uchar  *author,	// I - Author of document
 	   "\r\n", ftell(out), filename);
   }
 
-  fclose(out);
+  if (out == OutputFile)
+    fflush(out);
+  else
+    fclose(out);
 
   //
   // If we are sending the output to stdout, copy the temp file now...
   //
 
-  if (!OutputPath[0])
+  if (!OutputPath[0] && !OutputFile)
   {
 #ifdef WIN32
     // Make sure we are in binary mode...  stupid Microsoft!
@@ -2613,13 +3186,97 @@ pdf_write_resources(FILE *out,		/* I - Output file */
 }
 
 
+/*
+ * 'pdf_write_outpages()' - Write all output pages.
+ *
+ * When compressing with more than one thread, the content streams of the
+ * next few pages are rendered ahead into memory and deflated by the worker
+ * threads while the earlier pages are written.  The workers compress the
+ * same data with the same flushes as flate_write(), so the output is
+ * identical.  Pages that cannot be captured or compressed in memory are
+ * written the serial way instead.  No more pages are written once the
+ * conversion is cancelled.
+ */
+
+static void
+pdf_write_outpages(FILE *out)		/* I - Output file */
+{
+  int		outpage,		/* Current output page */
+		next,			/* Next output page to render */
+		window;			/* Number of pages to render ahead */
+  hd_pool_t	*pool;			/* Compression threads */
+  hdstream_t	*streams;		/* Content streams */
+
+
+  if (!Compression || Threads == 1 || (pool = hd_pool_new(Threads)) == NULL)
+    pool = NULL;
+  else if (hd_pool_threads(pool) < 2)
+  {
+    hd_pool_delete(pool);
+    pool = NULL;
+  }
+
+  if (!pool || (streams = (hdstream_t *)calloc(num_outpages, sizeof(hdstream_t))) == NULL)
+  {
+    hd_pool_delete(pool);
+
+    for (outpage = 0; outpage < (int)num_outpages && !progress_cancelled(); outpage ++)
+      pdf_write_outpage(out, outpage, NULL);
+
+    return;
+  }
+
+  window = 4 * hd_pool_threads(pool);
+
+  for (outpage = 0, next = 0; outpage < (int)num_outpages; outpage ++)
+  {
+    // Render pages ahead of the current one...
+    for (; next < (int)num_outpages && next < (outpage + window) && !progress_cancelled(); next ++)
+    {
+      comp_capture = streams + next;
+      pdf_render_outpage(out, next);
+      flate_flush(out);
+      comp_capture = NULL;
+
+      streams[next].job = hd_job_add(pool, (hd_job_func_t)flate_stream, streams + next);
+    }
+
+    // Stop once cancelled and the pages rendered so far are freed...
+    if (outpage >= next)
+      break;
+
+    // Then write the current page once it is compressed...
+    hd_job_wait(streams[outpage].job);
+
+    free(streams[outpage].data);
+    free(streams[outpage].writes);
+
+    if (!progress_cancelled())
+    {
+      // Fall back to rendering and compressing the page here if it could not
+      // be captured or compressed, which reports any errors itself...
+      if (streams[outpage].error || !streams[outpage].job)
+        pdf_write_outpage(out, outpage, NULL);
+      else
+        pdf_write_outpage(out, outpage, streams + outpage);
+    }
+
+    free(streams[outpage].comp);
+  }
+
+  hd_pool_delete(pool);
+  free(streams);
+}
+
+
 /*
  * 'pdf_write_outpage()' - Write an output page.
  */
 
 static void
-pdf_write_outpage(FILE *out,	/* I - Output file */
-                  int  outpage)	/* I - Output page number */
+pdf_write_outpage(FILE       *out,	/* I - Output file */
+                  int        outpage,	/* I - Output page number */
+		  hdstream_t *stream)	/* I - Compressed content or NULL */
 {
   int		i;		/* Looping var */
   page_t	*p;		/* Current page */
@@ -2679,18 +3336,69 @@ pdf_write_outpage(FILE *out,	/* I - Output file */
 
   pdf_start_stream(out);
 
-  flate_open_stream(out);
+  if (stream)
+  {
+   /*
+    * Write the content that was compressed by a worker thread...
+    */
 
- /*
-  * Render all of the pages...
-  */
+    if (Encryption)
+    {
+      encrypt_init();
+      rc4_encrypt(&encrypt_state, stream->comp, stream->comp, stream->comp_length);
+    }
 
-  switch (op->nup)
+    if (stream->comp_length > 0)
+      fwrite(stream->comp, stream->comp_length, 1, out);
+  }
+  else
   {
-    case 1 :
-        pdf_write_page(out, op->pages[0]);
-	break;
-
+   /*
+    * Render all of the pages...
+    */
+
+    flate_open_stream(out, HD_FLATE_CONTENT);
+    pdf_render_outpage(out, outpage);
+    flate_close_stream(out);
+  }
+
+ /*
+  * Close out the page...
+  */
+
+  pdf_end_object(out);
+
+  for (i = 0; i < op->nup; i ++)
+  {
+    if (op->pages[i] < 0)
+      break;
+
+    free_render(pages + op->pages[i]);
+  }
+}
+
+
+/*
+ * 'pdf_render_outpage()' - Write the content stream for an output page.
+ */
+
+static void
+pdf_render_outpage(FILE *out,		/* I - Output file */
+                   int  outpage)	/* I - Output page number */
+{
+  int		i;		/* Looping var */
+  page_t	*p;		/* Current page */
+  outpage_t	*op;		/* Output page */
+
+
+  op = outpages + outpage;
+
+  switch (op->nup)
+  {
+    case 1 :
+        pdf_write_page(out, op->pages[0]);
+	break;
+
     default :
         for (i = 0; i < op->nup; i ++)
 	{
@@ -2708,14 +3416,6 @@ pdf_write_outpage(FILE *out,	/* I - Output file */
 	}
 	break;
   }
-
- /*
-  * Close out the page...
-  */
-
-  flate_close_stream(out);
-
-  pdf_end_object(out);
 }
 
 
@@ -2727,8 +3427,7 @@ static void
 pdf_write_page(FILE  *out,	/* I - Output file */
                int   page)	/* I - Page number */
 {
-  render_t	*r,		/* Render pointer */
-		*next;		/* Next render */
+  render_t	*r;		/* Render pointer */
   float		box[3];		/* RGB color for boxes */
   page_t	*p;		/* Current page */
   const char	*debug;		/* HTMLDOC_DEBUG environment variable */
@@ -2822,17 +3521,10 @@ pdf_write_page(FILE  *out,	/* I - Output file */
   render_y        = -1.0f;
   render_spacing  = -1.0f;
 
-  for (r = p->start, next = NULL; r != NULL; r = next)
-  {
+  for (r = p->start; r != NULL; r = r->next)
     if (r->type == RENDER_TEXT)
       write_text(out, r);
 
-    next = r->next;
-    free(r);
-  }
-
-  p->start = NULL;
-
   flate_puts("ET\n", out);
 
   if ((debug = getenv("HTMLDOC_DEBUG")) != NULL && strstr(debug, "margin"))
@@ -3113,7 +3805,7 @@ pdf_write_files(FILE   *out,		// I - Output file
 		alloc_text;		// Allocated text?
   uchar		*text;			// Entry text
   tree_t	*temp;			// Current node
-  link_t	*link;			// Link to file...
+  hd_link_t	*link;			// Link to file...
   float		x, y;			// Position of link
 
 
@@ -3214,6 +3906,7 @@ pdf_count_headings(tree_t *toc)	/* I - TOC entry */
 static int	pdf_stream_length = 0;
 static int	pdf_stream_start = 0;
 static int	pdf_object_type = 0;
+static int	pdf_xref_offset = 0;
 
 
 /*
@@ -3328,7 +4021,7 @@ pdf_write_links(FILE *out)		/* I - Output file */
   render_t	*r,			/* Current render primitive */
 		*rlast,			/* Last render link primitive */
 		*rprev;			/* Previous render primitive */
-  link_t	*link;			/* Local link */
+  hd_link_t	*link;			/* Local link */
   page_t	*p;			/* Current page */
   outpage_t	*op;			/* Current output page */
 
@@ -3361,7 +4054,6 @@ pdf_write_links(FILE *out)		/* I - Output file */
 
 	    // Delete this render primitive...
 	    rprev->next = r->next;
-	    free(r);
 	    r = rprev;
 	  }
 	  else
@@ -3386,7 +4078,7 @@ pdf_write_links(FILE *out)		/* I - Output file */
   */
 
   if (PDFVersion >= 12)
-    pages_object += num_links + 3;
+    pages_object += (int)hd_links_count(links) + 3;
 
  /*
   * Stop here if we won't be generating links in the output...
@@ -3621,18 +4313,25 @@ pdf_write_links(FILE *out)		/* I - Output file */
 static void
 pdf_write_names(FILE *out)		/* I - Output file */
 {
-  int		i;			/* Looping var */
-  uchar		*s;			/* Current character in name */
-  link_t	*link;			/* Local link */
+  int		i,			/* Looping var */
+		num_links;		/* Number of links */
+  char		*s;			/* Current character in name */
+  hd_link_t	**sorted,		/* Links sorted by name */
+		*link;			/* Local link */
+
+
+  if ((sorted = hd_links_sorted(links)) == NULL)
+    return;
 
+  num_links = (int)hd_links_count(links);
 
  /*
   * Convert all link names to lowercase...
   */
 
-  for (i = num_links, link = links; i > 0; i --, link ++)
-    for (s = link->name; *s != '\0'; s ++)
-      *s = (uchar)tolower(*s);
+  for (i = 0; i < num_links; i ++)
+    for (s = sorted[i]->name; *s != '\0'; s ++)
+      *s = (char)tolower(*s & 255);
 
  /*
   * Write the root name tree entry...
@@ -3657,22 +4356,24 @@ pdf_write_names(FILE *out)		/* I - Output file */
   pdf_start_object(out);
 
   fputs("/Limits[", out);
-  write_string(out, links[0].name, 0);
-  write_string(out, links[num_links - 1].name, 0);
+  write_string(out, (uchar *)sorted[0]->name, 0);
+  write_string(out, (uchar *)sorted[num_links - 1]->name, 0);
   fputs("]", out);
 
   fputs("/Names[", out);
-  for (i = 1, link = links; i <= (int)num_links; i ++, link ++)
+  for (i = 0; i < num_links; i ++)
   {
-    write_string(out, link->name, 0);
-    fprintf(out, "%d 0 R", (int)num_objects + i);
+    write_string(out, (uchar *)sorted[i]->name, 0);
+    fprintf(out, "%d 0 R", (int)num_objects + i + 1);
   }
   fputs("]", out);
 
   pdf_end_object(out);
 
-  for (i = num_links, link = links; i > 0; i --, link ++)
+  for (i = 0; i < num_links; i ++)
   {
+    link = sorted[i];
+
     pdf_start_object(out);
     float x, y;
 
@@ -3689,244 +4390,1775 @@ pdf_write_names(FILE *out)		/* I - Output file */
 
 
 /*
- * 'render_contents()' - Render a single heading.
+ * 'pdf_linearize()' - Copy a PDF file to the output file in linearized order.
+ *
+ * The objects in the temporary file are renumbered and written in the order
+ * described in Annex F of the PDF specification: the catalog and first page
+ * come first, followed by a hint stream and the remaining pages, shared
+ * objects, and everything else.  This lets viewers show the first page (and
+ * fetch other pages using byte ranges) before the whole file is downloaded.
  */
 
 static void
-render_contents(tree_t *t,		/* I - Tree to parse */
-                float  left,		/* I - Left margin */
-                float  right,		/* I - Printable width */
-                float  bottom,		/* I - Bottom margin */
-                float  top,		/* I - Printable top */
-                float  *y,		/* IO - Y position */
-                int    *page,		/* IO - Page # */
-	        int    heading,		/* I - Heading # */
-	        tree_t *chap)		/* I - Chapter heading */
+pdf_linearize(FILE *in,			// I - Temporary file
+              FILE *out)		// I - Output file
 {
-  float		x,
-		width,
-		numberwidth,
-		height,
-		rgb[3];
-  int		hpage;
-  uchar		number[1024],
-		*nptr,
-		*link;
-  tree_t	*flat,
-		*temp,
-		*next;
-  render_t	*r;
-  float		dot_width;
+  int		i,			// Looping var
+		num,			// Number of objects reached
+		page,			// Current page
+		number,			// Object number
+		offset,			// Current offset, without hint stream
+		hint_offset,		// Offset of hint stream
+		hint_length,		// Length of hint stream object
+		first_end,		// End of first page section
+		xref_offset,		// Offset of main xref table
+		file_length;		// Length of file
+  hdlinear_t	lin;			// Linearization data
+  hdlinobj_t	*obj;			// Current object
+  hdlinpage_t	*p;			// Current page
+  char		lindict[256],		// Linearization dictionary
+		trailer[512];		// Trailer dictionary
+  uchar		*data = NULL;		// Object data
+  size_t	alloc = 0,		// Allocated object data
+		bytes;			// Bytes to copy
+  static const char *suffix = "endstream\nendobj\n";
+					// End of stream objects
+
+
+  memset(&lin, 0, sizeof(lin));
+
+  lin.num_objects = (int)num_objects;
+
+  if (num_outpages < 1 || lin.num_objects < 1)
+    goto copy;
+
+  if ((lin.objs = (hdlinobj_t *)calloc((size_t)lin.num_objects + 1, sizeof(hdlinobj_t))) == NULL ||
+      (lin.order = (int *)calloc((size_t)lin.num_objects + 1, sizeof(int))) == NULL ||
+      (lin.stack = (int *)calloc((size_t)lin.num_objects + 1, sizeof(int))) == NULL ||
+      (lin.reached = (int *)calloc((size_t)lin.num_objects + 1, sizeof(int))) == NULL ||
+      (lin.pages = (hdlinpage_t *)calloc(num_outpages + 1, sizeof(hdlinpage_t))) == NULL)
+    goto copy;
 
+ /*
+  * Find the object references and strings in each object...
+  */
 
-  DEBUG_printf(("render_contents(t=%p, left=%.1f, right=%.1f, bottom=%.1f, top=%.1f, y=%.1f, page=%d, heading=%d, chap=%p)\n",
-                (void *)t, left, right, bottom, top, *y, *page, heading, (void *)chap));
+  for (i = 1; i <= lin.num_objects; i ++)
+  {
+    obj         = lin.objs + i;
+    obj->offset = objects[i];
+    obj->length = (i < lin.num_objects ? objects[i + 1] : pdf_xref_offset) - objects[i];
+    obj->owner  = LINEAR_NONE;
+    obj->shared = -1;
 
-  if (!t)
-    return;
+    if (!pdf_lin_read(in, obj->offset, obj->length, &data, &alloc) ||
+        !pdf_lin_scan(&lin, i, data))
+      goto copy;
 
-  dot_width = _htmlSizes[SIZE_P] * _htmlWidths[t->typeface][t->style]['.'] * 0.001f;
+    if (obj->stream && ((obj->length - obj->stream) < 17 ||
+                        memcmp(data + obj->length - 17, suffix, 17)))
+      goto copy;
+  }
 
  /*
-  * Put the text...
+  * The catalog, encryption dictionary, and outlines (when shown initially)
+  * are needed to open the document...
   */
 
-  flat = flatten_tree(t->child->child);
-
-  for (height = 0.0, temp = flat; temp != NULL; temp = temp->next)
-    if (temp->height > height)
-      height = temp->height;
+  lin.objs[root_object].owner = LINEAR_OPEN;
+  if (Encryption && encrypt_object > 0)
+    lin.objs[encrypt_object].owner = LINEAR_OPEN;
 
-  height *= _htmlSpacings[SIZE_P] / _htmlSizes[SIZE_P];
+  for (page = 0; page < (int)num_outpages; page ++)
+    lin.objs[pages_object + 2 * page + 1].owner = page;
 
-  if (t->indent)
-    x = left + 18.0f + 18.0f * t->indent;
-  else
-    x = left;
+  if (PDFPageMode == PDF_OUTLINE && outline_object > 0)
+  {
+    lin.objs[outline_object].owner = LINEAR_OPEN;
 
-  *y -= height;
+    for (i = 0, num = pdf_lin_reach(&lin, outline_object); i < num; i ++)
+      lin.objs[lin.reached[i]].owner = LINEAR_OPEN;
+  }
 
  /*
-  * Get the width of the page number, leave room for three dots...
+  * Then find the objects used by each page...
   */
 
-  if (heading >= 0 && heading < (int)num_headings)
-  {
-    hpage       = heading_pages[heading];
-    numberwidth = (float)(get_width((uchar *)pages[hpage].page_text, t->typeface, t->style, t->size) + 3.0f * dot_width);
-  }
-  else
+  for (page = 0; page < (int)num_outpages; page ++)
   {
-    hpage       = 0;
-    numberwidth = 0.0f;
+    lin.objs[pages_object + 2 * page + 1].first = page == 0;
+
+    for (i = 0, num = pdf_lin_reach(&lin, pages_object + 2 * page + 1); i < num; i ++)
+    {
+      obj = lin.objs + lin.reached[i];
+
+      if (obj->owner == LINEAR_NONE)
+        obj->owner = page;
+      else if (obj->owner != page)
+        obj->owner = LINEAR_SHARED;
+
+      if (page == 0)
+        obj->first = 1;
+    }
   }
 
-  for (temp = flat; temp != NULL; temp = next)
+ /*
+  * Put the objects in file order: the document-level objects, first page,
+  * remaining pages, shared objects, and other objects...
+  */
+
+  num = 0;
+
+  lin.first_open = num;
+  lin.order[num ++] = root_object;
+  if (Encryption && encrypt_object > 0)
+    lin.order[num ++] = encrypt_object;
+  for (i = 1; i <= lin.num_objects; i ++)
+    if (lin.objs[i].owner == LINEAR_OPEN && i != root_object && i != encrypt_object)
+      lin.order[num ++] = i;
+
+  for (page = 0; page < (int)num_outpages; page ++)
   {
-    rgb[0] = temp->red / 255.0f;
-    rgb[1] = temp->green / 255.0f;
-    rgb[2] = temp->blue / 255.0f;
+    p        = lin.pages + page;
+    p->start = num;
 
-    if ((x + temp->width) >= (right - numberwidth))
+    lin.order[num ++] = pages_object + 2 * page + 1;
+    lin.order[num ++] = pages_object + 2 * page + 2;
+
+    for (i = 1; i <= lin.num_objects; i ++)
     {
-     /*
-      * Too wide to fit, continue on the next line
-      */
+      if (i == (pages_object + 2 * page + 1) || i == (pages_object + 2 * page + 2))
+        continue;
 
-      *y -= _htmlSpacings[SIZE_P];
-      x  = left + 36.0f * t->indent;
+      if (lin.objs[i].owner == page ||
+          (page == 0 && lin.objs[i].owner == LINEAR_SHARED && lin.objs[i].first))
+        lin.order[num ++] = i;
     }
 
-    if (*y < bottom)
-    {
-      (*page) ++;
-      if (Verbosity)
-	progress_show("Formatting page %d", *page);
+    p->num_objects = num - p->start;
+  }
 
-      width = get_width((uchar *)TocTitle, _htmlHeadingFont, STYLE_BOLD, SIZE_H1);
-      *y = (float)(top - _htmlSpacings[SIZE_H1]);
-      x  = (float)(left + 0.5f * (right - left - width));
-      r = new_render(*page, RENDER_TEXT, x, *y, 0, 0, TocTitle);
-      r->data.text.typeface = _htmlHeadingFont;
-      r->data.text.style    = STYLE_BOLD;
-      r->data.text.size     = (float)_htmlSizes[SIZE_H1];
-      get_color(_htmlTextColor, r->data.text.rgb);
+  lin.first_page   = lin.pages[0].start;
+  lin.num_first    = lin.pages[0].num_objects;
+  lin.first_shared = num;
 
-      *y -= _htmlSpacings[SIZE_H1];
+  for (i = 1; i <= lin.num_objects; i ++)
+    if (lin.objs[i].owner == LINEAR_SHARED && !lin.objs[i].first)
+      lin.order[num ++] = i;
 
-      if (t->indent)
-	x = left + 18.0f + 18.0f * t->indent;
-      else
-	x = left;
+  lin.first_other = num;
 
-      if (chap != t)
-      {
-        *y += height;
-        render_contents(chap, left, right, bottom, top, y, page, -1, 0);
-	*y -= _htmlSpacings[SIZE_P];
-      }
-    }
+  lin.order[num ++] = pages_object;
+  for (i = 1; i <= lin.num_objects; i ++)
+    if (lin.objs[i].owner == LINEAR_NONE && i != pages_object)
+      lin.order[num ++] = i;
 
-    if (temp->link != NULL)
-    {
-      link = htmlGetVariable(temp->link, (uchar *)"HREF");
+  if (num != lin.num_objects)
+  {
+    progress_error(HD_ERROR_INTERNAL_ERROR,
+                   "Internal error: %d of %d objects linearized", num,
+                   lin.num_objects);
+    goto copy;
+  }
 
-     /*
-      * Add a page link...
-      */
+ /*
+  * Number the objects: 1 to N for the remaining pages, shared objects, and
+  * other objects, so that the main cross-reference table covers them, then
+  * N + 1 for the linearization dictionary, followed by the document-level
+  * objects, hint stream, and first page...
+  */
 
-      new_render(*page, RENDER_LINK, x, *y, temp->width, temp->height, link);
+  number = 1;
 
-      if (PSLevel == 0 && Links)
-      {
-        memcpy(rgb, link_color, sizeof(rgb));
+  for (i = lin.first_page + lin.num_first; i < lin.num_objects; i ++)
+    lin.objs[lin.order[i]].number = number ++;
 
-	temp->red   = (uchar)(link_color[0] * 255.0);
-	temp->green = (uchar)(link_color[1] * 255.0);
-	temp->blue  = (uchar)(link_color[2] * 255.0);
+  lin.lin_number = number ++;
 
-        if (LinkStyle)
-	  new_render(*page, RENDER_BOX, x, *y - 1, temp->width, 0,
-	             link_color);
-      }
-    }
+  for (i = lin.first_open; i < lin.first_page; i ++)
+    lin.objs[lin.order[i]].number = number ++;
 
-    if ((link = htmlGetVariable(temp, (uchar *)"ID")) != NULL)
-    {
-     /*
-      * Add a target link...
-      */
+  lin.hint_number = number ++;
 
-      add_link(link, *page, (int)(*y + height));
-    }
+  for (i = lin.first_page; i < (lin.first_page + lin.num_first); i ++)
+    lin.objs[lin.order[i]].number = number ++;
 
-    switch (temp->markup)
-    {
-      case MARKUP_A :
-          if ((link = htmlGetVariable(temp, (uchar *)"NAME")) != NULL)
-          {
-           /*
-            * Add a target link...
-            */
+  lin.size = number;
 
-            add_link(link, *page, (int)(*y + height));
-          }
-          break;
+  for (i = 1; i <= lin.num_objects; i ++)
+    pdf_lin_length(&lin, i);
 
-      case MARKUP_NONE :
-          if (temp->data == NULL)
-            break;
+ /*
+  * The shared object hint table lists the first page objects followed by the
+  * shared objects section...
+  */
 
-	  if (temp->underline)
-	    new_render(*page, RENDER_BOX, x, *y - 1, temp->width, 0, rgb);
+  for (i = 0; i < lin.num_first; i ++)
+    lin.objs[lin.order[lin.first_page + i]].shared = i;
 
-	  if (temp->strikethrough)
-	    new_render(*page, RENDER_BOX, x, *y + temp->height * 0.25f,
-		       temp->width, 0, rgb);
+  for (i = lin.first_shared; i < lin.first_other; i ++)
+    lin.objs[lin.order[i]].shared = lin.num_first + i - lin.first_shared;
 
-          r = new_render(*page, RENDER_TEXT, x, *y, 0, 0, temp->data);
-          r->data.text.typeface = temp->typeface;
-          r->data.text.style    = temp->style;
-          r->data.text.size     = (float)_htmlSizes[temp->size];
-          memcpy(r->data.text.rgb, rgb, sizeof(rgb));
+ /*
+  * Lay out the file without the hint stream, since the offsets in the hint
+  * tables do not include it...
+  */
 
-          if (temp->superscript)
-            r->y += height - temp->height;
-          else if (temp->subscript)
-            r->y -= height * _htmlSizes[0] / _htmlSpacings[0] -
-		    temp->height;
-	  break;
+  offset = objects[1];
 
-      case MARKUP_IMG :
-	  update_image_size(temp);
-	  new_render(*page, RENDER_IMAGE, x, *y, temp->width, temp->height,
-		     image_find((char *)htmlGetVariable(temp, (uchar *)"REALSRC")));
-	  break;
+  offset += snprintf(lindict, sizeof(lindict), "%d 0 obj<</Linearized 1/L %-10d/H[%-10d %-10d]/O %d/E %-10d/N %d/T %-10d>>endobj\n", lin.lin_number, 0, 0, 0, lin.objs[pages_object + 1].number, 0, (int)num_outpages, 0);
 
-      default :
-	  break;
-    }
+  offset += (int)strlen("xref\n  \n") + pdf_lin_digits(lin.lin_number) +
+            pdf_lin_digits(lin.size - lin.lin_number) +
+	    20 * (lin.size - lin.lin_number) +
+	    pdf_lin_trailer(&lin, trailer, sizeof(trailer), 0);
 
-    x += temp->width;
-    next = temp->next;
-    free(temp);
+  for (i = lin.first_open; i < lin.first_page; i ++)
+  {
+    lin.objs[lin.order[i]].new_offset = offset;
+    offset += lin.objs[lin.order[i]].new_length;
   }
 
-  if (numberwidth > 0.0f)
+  hint_offset = offset;
+
+  for (i = lin.first_page; i < lin.num_objects; i ++)
   {
-   /*
-    * Draw dots leading up to the page number...
-    */
+    lin.objs[lin.order[i]].new_offset = offset;
+    offset += lin.objs[lin.order[i]].new_length;
+  }
 
-    width = (float)(numberwidth - 3.0 * dot_width + x);
+ /*
+  * Collect the shared objects used by each page and build the hint tables...
+  */
 
-    for (nptr = number;
-         nptr < (number + sizeof(number) - 1) && width < right;
-	 width += dot_width)
-      *nptr++ = '.';
+  for (page = 0; page < (int)num_outpages; page ++)
+  {
+    p              = lin.pages + page;
+    p->first_id    = lin.num_ids;
+    obj            = lin.objs + lin.order[p->start + p->num_objects - 1];
+    p->length      = obj->new_offset + obj->new_length - lin.objs[lin.order[p->start]].new_offset;
+    obj            = lin.objs + lin.order[p->start + 1];
+    p->content_offset = obj->new_offset - lin.objs[lin.order[p->start]].new_offset;
+    p->content_length = obj->new_length;
 
-    if (nptr > number)
-      nptr --;
+    if (page == 0)
+      continue;
 
-    strlcpy((char *)nptr, pages[hpage].page_text, sizeof(number) - (size_t)(nptr - number));
+    for (i = 0, num = pdf_lin_reach(&lin, lin.order[p->start]); i < num; i ++)
+    {
+      obj = lin.objs + lin.reached[i];
 
-    r = new_render(*page, RENDER_TEXT, right - width + x, *y, 0, 0, number);
-    r->data.text.typeface = t->typeface;
-    r->data.text.style    = t->style;
-    r->data.text.size     = (float)_htmlSizes[t->size];
-    memcpy(r->data.text.rgb, rgb, sizeof(rgb));
+      if (obj->owner == LINEAR_SHARED)
+        pdf_lin_add_id(&lin, obj->shared);
+    }
+
+    p->num_ids = lin.num_ids - p->first_id;
   }
-}
 
+  pdf_lin_hints(&lin);
 
-/*
- * 'count_headings()' - Count the number of headings in the TOC.
- */
+  if (lin.hint_error)
+    goto copy;
 
-static int
-count_headings(tree_t *t)		// I - Tree to count
-{
-  int	count;				// Number of headings...
+  if (Encryption)
+  {
+    rc4_context_t	rc4;		// Encryption context
+
+    encrypt_setup(&rc4, lin.hint_number);
+    rc4_encrypt(&rc4, lin.hint, lin.hint, lin.hint_length);
+  }
+
+  hint_length = snprintf(trailer, sizeof(trailer), "%d 0 obj<</S %d/Length %d>>stream\n", lin.hint_number, lin.shared_offset, (int)lin.hint_length) + (int)lin.hint_length + 17;
+
+ /*
+  * Now compute the final offsets...
+  */
+
+  for (i = lin.first_page; i < lin.num_objects; i ++)
+    lin.objs[lin.order[i]].new_offset += hint_length;
+
+  obj         = lin.objs + lin.order[lin.first_page + lin.num_first - 1];
+  first_end   = obj->new_offset + obj->new_length;
+  xref_offset = offset + hint_length;
+  file_length = xref_offset + (int)strlen("xref\n0  \n") +
+                pdf_lin_digits(lin.lin_number) + 20 * lin.lin_number +
+		snprintf(trailer, sizeof(trailer), "trailer\n<</Size %d>>\nstartxref\n%d\n%%%%EOF\n", lin.size, objects[1] + (int)strlen(lindict));
+
+ /*
+  * Write the header, linearization dictionary, and first page cross-reference
+  * table...
+  */
+
+  if (!pdf_lin_read(in, 0, objects[1], &data, &alloc))
+    goto copy;
+
+  fwrite(data, (size_t)objects[1], 1, out);
+
+  fprintf(out, "%d 0 obj<</Linearized 1/L %-10d/H[%-10d %-10d]/O %d/E %-10d/N %d/T %-10d>>endobj\n", lin.lin_number, file_length, hint_offset, hint_length, lin.objs[pages_object + 1].number, first_end, (int)num_outpages, xref_offset + (int)strlen("xref\n0  ") + pdf_lin_digits(lin.lin_number));
+
+  fprintf(out, "xref\n%d %d \n", lin.lin_number, lin.size - lin.lin_number);
+  fprintf(out, "%010d 00000 n \n", objects[1]);
+  for (i = lin.first_open; i < lin.first_page; i ++)
+    fprintf(out, "%010d 00000 n \n", lin.objs[lin.order[i]].new_offset);
+  fprintf(out, "%010d 00000 n \n", hint_offset);
+  for (i = lin.first_page; i < (lin.first_page + lin.num_first); i ++)
+    fprintf(out, "%010d 00000 n \n", lin.objs[lin.order[i]].new_offset);
+
+  pdf_lin_trailer(&lin, trailer, sizeof(trailer), xref_offset);
+  fputs(trailer, out);
+
+ /*
+  * Then the objects and hint stream...
+  */
+
+  for (i = lin.first_open; i < lin.num_objects; i ++)
+  {
+    if (i == lin.first_page)
+    {
+      fprintf(out, "%d 0 obj<</S %d/Length %d>>stream\n", lin.hint_number, lin.shared_offset, (int)lin.hint_length);
+      fwrite(lin.hint, lin.hint_length, 1, out);
+      fputs(suffix, out);
+    }
+
+    obj = lin.objs + lin.order[i];
+
+    if (!pdf_lin_read(in, obj->offset, obj->length, &data, &alloc))
+    {
+      progress_error(HD_ERROR_READ_ERROR, "Unable to read temporary file - %s",
+                     strerror(errno));
+      break;
+    }
+
+    pdf_lin_write(&lin, out, lin.order[i], data);
+  }
+
+ /*
+  * And finally the main cross-reference table...
+  */
+
+  if (ftell(out) != xref_offset)
+    progress_error(HD_ERROR_INTERNAL_ERROR,
+                   "Internal error: xref at %ld instead of %d", ftell(out),
+		   xref_offset);
+
+  fprintf(out, "xref\n0 %d \n", lin.lin_number);
+  fputs("0000000000 65535 f \n", out);
+  for (i = lin.first_page + lin.num_first; i < lin.num_objects; i ++)
+    fprintf(out, "%010d 00000 n \n", lin.objs[lin.order[i]].new_offset);
+  fprintf(out, "trailer\n<</Size %d>>\nstartxref\n%d\n%%%%EOF\n", lin.size,
+          objects[1] + (int)strlen(lindict));
+
+  goto done;
+
+ /*
+  * If we can't linearize the file, copy it as-is...
+  */
+
+  copy:
+
+  progress_error(HD_ERROR_INTERNAL_ERROR, "Unable to linearize PDF file.");
+
+  if (pdf_lin_read(in, 0, 0, &data, &alloc))
+  {
+    rewind(in);
+    while ((bytes = fread(data, 1, alloc, in)) > 0)
+      fwrite(data, 1, bytes, out);
+  }
+
+  done:
+
+  free(data);
+  free(lin.objs);
+  free(lin.edits);
+  free(lin.order);
+  free(lin.stack);
+  free(lin.reached);
+  free(lin.pages);
+  free(lin.ids);
+  free(lin.hint);
+}
+
+
+/*
+ * 'pdf_lin_add_edit()' - Add a token to rewrite in the current object.
+ */
+
+static hdlinedit_t *			// O - New edit or NULL on error
+pdf_lin_add_edit(hdlinear_t *lin)	// I - Linearization data
+{
+  hdlinedit_t	*temp;			// New edits
+
+
+  if (lin->num_edits >= lin->alloc_edits)
+  {
+    if ((temp = (hdlinedit_t *)realloc(lin->edits, (size_t)(lin->alloc_edits + 4096) * sizeof(hdlinedit_t))) == NULL)
+      return (NULL);
+
+    lin->edits       = temp;
+    lin->alloc_edits += 4096;
+  }
+
+  return (lin->edits + lin->num_edits ++);
+}
+
+
+/*
+ * 'pdf_lin_add_id()' - Add a shared object identifier for a page.
+ */
+
+static void
+pdf_lin_add_id(hdlinear_t *lin,		// I - Linearization data
+               int        id)		// I - Shared object identifier
+{
+  int	*temp;				// New identifiers
+
+
+  if (lin->num_ids >= lin->alloc_ids)
+  {
+    if ((temp = (int *)realloc(lin->ids, (size_t)(lin->alloc_ids + 1024) * sizeof(int))) == NULL)
+    {
+      lin->hint_error = 1;
+      return;
+    }
+
+    lin->ids       = temp;
+    lin->alloc_ids += 1024;
+  }
+
+  lin->ids[lin->num_ids ++] = id;
+}
+
+
+/*
+ * 'pdf_lin_bits()' - Return the number of bits needed for a value.
+ */
+
+static int				// O - Number of bits
+pdf_lin_bits(int value)			// I - Value
+{
+  int	bits;				// Number of bits
+
+
+  for (bits = 0; value > 0; value >>= 1)
+    bits ++;
+
+  return (bits);
+}
+
+
+/*
+ * 'pdf_lin_digits()' - Return the number of digits in an object number.
+ */
+
+static int				// O - Number of digits
+pdf_lin_digits(int value)		// I - Value
+{
+  int	digits;				// Number of digits
+
+
+  for (digits = 1; value > 9; value /= 10)
+    digits ++;
+
+  return (digits);
+}
+
+
+/*
+ * 'pdf_lin_flush()' - Pad the hint stream to a byte boundary.
+ */
+
+static void
+pdf_lin_flush(hdlinear_t *lin)		// I - Linearization data
+{
+  if (lin->hint_count > 0)
+    pdf_lin_put(lin, 0, 8 - lin->hint_count);
+}
+
+
+/*
+ * 'pdf_lin_hints()' - Write the page offset and shared object hint tables.
+ */
+
+static void
+pdf_lin_hints(hdlinear_t *lin)		// I - Linearization data
+{
+  int		i, j,			// Looping vars
+		page,			// Current page
+		num_pages = (int)num_outpages,
+					// Number of pages
+		num_shared,		// Number of shared object entries
+		min[5],			// Least values
+		max[5],			// Greatest values
+		bits[5],		// Bits for values
+		max_id = 0;		// Greatest shared object identifier
+  hdlinpage_t	*p;			// Current page
+  hdlinobj_t	*obj;			// Current object
+
+
+ /*
+  * Page offset hint table header...
+  */
+
+  for (i = 0; i < 5; i ++)
+  {
+    min[i] = 0x7fffffff;
+    max[i] = 0;
+  }
+
+  for (page = 0, p = lin->pages; page < num_pages; page ++, p ++)
+  {
+    int	values[5] =			// Values for page
+    {
+      p->num_objects,
+      p->length,
+      p->content_offset,
+      p->content_length,
+      p->num_ids
+    };
+
+    for (i = 0; i < 5; i ++)
+    {
+      if (values[i] < min[i])
+        min[i] = values[i];
+      if (values[i] > max[i])
+        max[i] = values[i];
+    }
+  }
+
+  for (i = 0; i < lin->num_ids; i ++)
+    if (lin->ids[i] > max_id)
+      max_id = lin->ids[i];
+
+  for (i = 0; i < 4; i ++)
+    bits[i] = pdf_lin_bits(max[i] - min[i]);
+
+  bits[4] = pdf_lin_bits(max[4]);
+
+  pdf_lin_put(lin, (unsigned)min[0], 32);
+  pdf_lin_put(lin, (unsigned)lin->objs[lin->order[lin->first_page]].new_offset, 32);
+  pdf_lin_put(lin, (unsigned)bits[0], 16);
+  pdf_lin_put(lin, (unsigned)min[1], 32);
+  pdf_lin_put(lin, (unsigned)bits[1], 16);
+  pdf_lin_put(lin, (unsigned)min[2], 32);
+  pdf_lin_put(lin, (unsigned)bits[2], 16);
+  pdf_lin_put(lin, (unsigned)min[3], 32);
+  pdf_lin_put(lin, (unsigned)bits[3], 16);
+  pdf_lin_put(lin, (unsigned)bits[4], 16);
+  pdf_lin_put(lin, (unsigned)pdf_lin_bits(max_id), 16);
+  pdf_lin_put(lin, 0, 16);		// No fractional positions
+  pdf_lin_put(lin, 1, 16);
+
+ /*
+  * Per-page entries, which are stored item by item...
+  */
+
+  for (page = 0, p = lin->pages; page < num_pages; page ++, p ++)
+    pdf_lin_put(lin, (unsigned)(p->num_objects - min[0]), bits[0]);
+  pdf_lin_flush(lin);
+
+  for (page = 0, p = lin->pages; page < num_pages; page ++, p ++)
+    pdf_lin_put(lin, (unsigned)(p->length - min[1]), bits[1]);
+  pdf_lin_flush(lin);
+
+  for (page = 0, p = lin->pages; page < num_pages; page ++, p ++)
+    pdf_lin_put(lin, (unsigned)p->num_ids, bits[4]);
+  pdf_lin_flush(lin);
+
+  for (page = 0, p = lin->pages; page < num_pages; page ++, p ++)
+    for (i = 0; i < p->num_ids; i ++)
+      pdf_lin_put(lin, (unsigned)lin->ids[p->first_id + i], pdf_lin_bits(max_id));
+  pdf_lin_flush(lin);
+
+  for (page = 0, p = lin->pages; page < num_pages; page ++, p ++)
+    pdf_lin_put(lin, (unsigned)(p->content_offset - min[2]), bits[2]);
+  pdf_lin_flush(lin);
+
+  for (page = 0, p = lin->pages; page < num_pages; page ++, p ++)
+    pdf_lin_put(lin, (unsigned)(p->content_length - min[3]), bits[3]);
+  pdf_lin_flush(lin);
+
+ /*
+  * Shared object hint table header...
+  */
+
+  lin->shared_offset = (int)lin->hint_length;
+
+  num_shared = lin->num_first + lin->first_other - lin->first_shared;
+
+  if (lin->first_shared < lin->first_other)
+  {
+    obj = lin->objs + lin->order[lin->first_shared];
+
+    pdf_lin_put(lin, (unsigned)obj->number, 32);
+    pdf_lin_put(lin, (unsigned)obj->new_offset, 32);
+  }
+  else
+  {
+    pdf_lin_put(lin, 0, 32);
+    pdf_lin_put(lin, 0, 32);
+  }
+
+  pdf_lin_put(lin, (unsigned)lin->num_first, 32);
+  pdf_lin_put(lin, (unsigned)num_shared, 32);
+  pdf_lin_put(lin, 0, 16);		// Each group is a single object
+
+  min[0] = 0x7fffffff;
+  max[0] = 0;
+
+  for (i = 0; i < num_shared; i ++)
+  {
+    j   = i < lin->num_first ? lin->first_page + i : lin->first_shared + i - lin->num_first;
+    obj = lin->objs + lin->order[j];
+
+    if (obj->new_length < min[0])
+      min[0] = obj->new_length;
+    if (obj->new_length > max[0])
+      max[0] = obj->new_length;
+  }
+
+  bits[0] = pdf_lin_bits(max[0] - min[0]);
+
+  pdf_lin_put(lin, (unsigned)min[0], 32);
+  pdf_lin_put(lin, (unsigned)bits[0], 16);
+
+ /*
+  * Shared object entries: group lengths and MD5 signature flags...
+  */
+
+  for (i = 0; i < num_shared; i ++)
+  {
+    j   = i < lin->num_first ? lin->first_page + i : lin->first_shared + i - lin->num_first;
+    obj = lin->objs + lin->order[j];
+
+    pdf_lin_put(lin, (unsigned)(obj->new_length - min[0]), bits[0]);
+  }
+  pdf_lin_flush(lin);
+
+  for (i = 0; i < num_shared; i ++)
+    pdf_lin_put(lin, 0, 1);
+  pdf_lin_flush(lin);
+}
+
+
+/*
+ * 'pdf_lin_length()' - Compute the length of a renumbered object.
+ */
+
+static void
+pdf_lin_length(hdlinear_t *lin,		// I - Linearization data
+               int        number)	// I - Object number in temporary file
+{
+  int		i;			// Looping var
+  hdlinobj_t	*obj = lin->objs + number;
+					// Object
+  hdlinedit_t	*edit;			// Current edit
+
+
+  obj->new_length = obj->length - pdf_lin_digits(number) + pdf_lin_digits(obj->number);
+
+  for (i = obj->num_edits, edit = lin->edits + obj->first_edit; i > 0; i --, edit ++)
+  {
+    if (edit->value)
+      obj->new_length += pdf_lin_digits(lin->objs[edit->value].number) - edit->length;
+    else
+      obj->new_length += edit->new_length - edit->length;
+  }
+}
+
+
+/*
+ * 'pdf_lin_put()' - Add bits to the hint stream.
+ */
+
+static void
+pdf_lin_put(hdlinear_t *lin,		// I - Linearization data
+            unsigned   value,		// I - Value
+	    int        bits)		// I - Number of bits
+{
+  uchar	*temp;				// New hint data
+
+
+  while (bits > 0)
+  {
+    bits --;
+
+    lin->hint_bits = (lin->hint_bits << 1) | ((value >> bits) & 1);
+
+    if (++ lin->hint_count < 8)
+      continue;
+
+    if (lin->hint_length >= lin->hint_alloc)
+    {
+      if ((temp = (uchar *)realloc(lin->hint, lin->hint_alloc + 4096)) == NULL)
+      {
+        lin->hint_error = 1;
+	return;
+      }
+
+      lin->hint       = temp;
+      lin->hint_alloc += 4096;
+    }
+
+    lin->hint[lin->hint_length ++] = (uchar)lin->hint_bits;
+    lin->hint_bits  = 0;
+    lin->hint_count = 0;
+  }
+}
+
+
+/*
+ * 'pdf_lin_reach()' - Find the objects used by a page or outline.
+ *
+ * Page objects, the page tree, and the catalog are not followed, so links to
+ * other pages do not pull them in.
+ */
+
+static int				// O - Number of objects reached
+pdf_lin_reach(hdlinear_t *lin,		// I - Linearization data
+              int        start)		// I - Starting object
+{
+  int		i,			// Looping var
+		number,			// Current object
+		num_stack = 0,		// Objects on stack
+		num_reached = 0;	// Objects reached
+  hdlinobj_t	*obj;			// Referenced object
+  hdlinedit_t	*edit;			// Current edit
+
+
+  lin->mark ++;
+  lin->objs[start].mark = lin->mark;
+  lin->stack[num_stack ++] = start;
+
+  while (num_stack > 0)
+  {
+    number = lin->stack[-- num_stack];
+
+    for (i = lin->objs[number].num_edits, edit = lin->edits + lin->objs[number].first_edit; i > 0; i --, edit ++)
+    {
+      if (!edit->value)
+        continue;
+
+      obj = lin->objs + edit->value;
+
+      if (obj->mark == lin->mark || obj->owner == LINEAR_OPEN ||
+          edit->value == pages_object ||
+          (edit->value > pages_object && edit->value <= (pages_object + 2 * (int)num_outpages) && ((edit->value - pages_object) & 1)))
+        continue;
+
+      obj->mark = lin->mark;
+
+      lin->reached[num_reached ++] = edit->value;
+      lin->stack[num_stack ++]     = edit->value;
+    }
+  }
+
+  return (num_reached);
+}
+
+
+/*
+ * 'pdf_lin_read()' - Read part of the temporary file.
+ */
+
+static int				// O - 1 on success, 0 on error
+pdf_lin_read(FILE   *in,		// I  - Temporary file
+             int    offset,		// I  - Offset in file
+	     int    length,		// I  - Number of bytes
+             uchar  **data,		// IO - Data buffer
+	     size_t *alloc)		// IO - Allocated size of buffer
+{
+  uchar	*temp;				// New buffer
+
+
+  if ((size_t)length >= *alloc || !*data)
+  {
+    size_t newalloc = (size_t)length + 8192;
+					// New size of buffer
+
+    if ((temp = (uchar *)realloc(*data, newalloc)) == NULL)
+      return (0);
+
+    *data  = temp;
+    *alloc = newalloc;
+  }
+
+  if (length == 0)
+    return (1);
+
+  return (!fseek(in, offset, SEEK_SET) && fread(*data, (size_t)length, 1, in) == 1);
+}
+
+
+/*
+ * 'pdf_lin_rekey()' - Re-encrypt a string or stream for a new object number.
+ */
+
+static void
+pdf_lin_rekey(uchar *data,		// I - Data
+              int   length,		// I - Length of data
+              int   from,		// I - Old object number
+	      int   to)			// I - New object number
+{
+  rc4_context_t	rc4;			// Encryption context
+
+
+  encrypt_setup(&rc4, from);
+  rc4_encrypt(&rc4, data, data, (size_t)length);
+
+  encrypt_setup(&rc4, to);
+  rc4_encrypt(&rc4, data, data, (size_t)length);
+}
+
+
+/*
+ * 'pdf_lin_scan()' - Find the object references and strings in an object.
+ *
+ * With encryption, strings and stream data use a key based on the object
+ * number, so they are re-encrypted when the object is renumbered.
+ */
+
+static int				// O - 1 on success, 0 on error
+pdf_lin_scan(hdlinear_t *lin,		// I - Linearization data
+             int        number,		// I - Object number
+	     uchar      *data)		// I - Object data
+{
+  hdlinobj_t	*obj = lin->objs + number;
+					// Object
+  uchar		*ptr,			// Pointer into object
+		*end,			// End of object
+		*start;			// Start of token
+  int		num_values = 0,		// Number of pending integers
+		values[2],		// Pending integers
+		offsets[2],		// Offsets of pending integers
+		lengths[2],		// Lengths of pending integers
+		value,			// Integer value
+		encrypted;		// Re-encrypt strings?
+  hdlinedit_t	*edit;			// New edit
+
+
+  obj->first_edit = lin->num_edits;
+  encrypted       = Encryption && number != encrypt_object;
+
+  for (ptr = data + pdf_lin_digits(number) + 6, end = data + obj->length; ptr < end;)
+  {
+    if (isspace(*ptr))
+    {
+      ptr ++;
+      continue;
+    }
+
+    start = ptr;
+
+    if (*ptr == '(' || (*ptr == '<' && (ptr + 1) < end && ptr[1] != '<'))
+    {
+     /*
+      * Strings only need to be rewritten for encryption...
+      */
+
+      value      = 2 * pdf_lin_string(ptr, end, &ptr) + 2;
+      num_values = 0;
+
+      if (encrypted)
+      {
+        if ((edit = pdf_lin_add_edit(lin)) == NULL)
+	  return (0);
+
+        edit->offset     = (int)(start - data);
+	edit->length     = (int)(ptr - start);
+	edit->value      = 0;
+	edit->new_length = value;
+      }
+    }
+    else if (strchr("<>[]{}", *ptr))
+    {
+      if ((*ptr == '<' || *ptr == '>') && (ptr + 1) < end && ptr[1] == *ptr)
+        ptr += 2;
+      else
+        ptr ++;
+
+      num_values = 0;
+      continue;
+    }
+    else if (*ptr == ')')
+    {
+      return (0);
+    }
+    else
+    {
+      for (ptr ++; ptr < end && !isspace(*ptr) && !strchr("()<>[]{}/%", *ptr); ptr ++);
+
+      if ((ptr - start) == 1 && *start == 'R' && num_values == 2)
+      {
+       /*
+        * Object reference...
+	*/
+
+        if (values[0] < 1 || values[0] > lin->num_objects)
+	  return (0);
+
+        if ((edit = pdf_lin_add_edit(lin)) == NULL)
+	  return (0);
+
+	edit->offset     = offsets[0];
+	edit->length     = lengths[0];
+	edit->value      = values[0];
+	edit->new_length = 0;
+	num_values       = 0;
+      }
+      else if (isdigit(*start))
+      {
+       /*
+        * Integer, which might be part of a reference...
+	*/
+
+        uchar *digits;			// Pointer into integer
+
+        for (value = 0, digits = start; digits < ptr && isdigit(*digits); digits ++)
+	  value = value * 10 + *digits - '0';
+
+        if (digits < ptr || (ptr - start) > 9)
+	{
+	  num_values = 0;
+	  continue;
+	}
+
+	if (num_values == 2)
+	{
+	  values[0]  = values[1];
+	  offsets[0] = offsets[1];
+	  lengths[0] = lengths[1];
+	  num_values = 1;
+	}
+
+	values[num_values]  = value;
+	offsets[num_values] = (int)(start - data);
+	lengths[num_values] = (int)(ptr - start);
+	num_values ++;
+	continue;
+      }
+      else if ((ptr - start) == 6 && !memcmp(start, "stream", 6))
+      {
+        if (ptr < end && *ptr == '\r')
+	  ptr ++;
+	if (ptr < end && *ptr == '\n')
+	  ptr ++;
+
+        obj->stream = (int)(ptr - data);
+	break;
+      }
+      else if ((ptr - start) == 6 && !memcmp(start, "endobj", 6))
+      {
+        break;
+      }
+      else
+      {
+        num_values = 0;
+	continue;
+      }
+    }
+  }
+
+  obj->num_edits = lin->num_edits - obj->first_edit;
+
+  return (1);
+}
+
+
+/*
+ * 'pdf_lin_string()' - Decode a literal or hex string in place.
+ */
+
+static int				// O - Number of bytes
+pdf_lin_string(uchar *ptr,		// I - Start of string
+               uchar *end,		// I - End of object
+	       uchar **next)		// O - End of string
+{
+  uchar	*start = ptr,			// Start of string
+	*out = ptr;			// Output pointer
+  int	ch,				// Current character
+	depth = 1,			// Parenthesis depth
+	digit = -1;			// Pending hex digit
+
+
+  if (*ptr++ == '<')
+  {
+    for (; ptr < end && *ptr != '>'; ptr ++)
+    {
+      if (isxdigit(*ptr))
+      {
+        ch = isdigit(*ptr) ? *ptr - '0' : tolower(*ptr) - 'a' + 10;
+
+        if (digit < 0)
+	{
+	  digit = ch;
+	}
+	else
+	{
+	  *out++ = (uchar)((digit << 4) | ch);
+	  digit  = -1;
+	}
+      }
+    }
+
+    if (digit >= 0)
+      *out++ = (uchar)(digit << 4);
+
+    if (ptr < end)
+      ptr ++;
+  }
+  else
+  {
+    while (ptr < end)
+    {
+      if ((ch = *ptr++) == '\\' && ptr < end)
+      {
+        switch (ch = *ptr++)
+	{
+	  case 'n' :
+	      ch = '\n';
+	      break;
+	  case 'r' :
+	      ch = '\r';
+	      break;
+	  case 't' :
+	      ch = '\t';
+	      break;
+	  case 'b' :
+	      ch = '\b';
+	      break;
+	  case 'f' :
+	      ch = '\f';
+	      break;
+	  case '\r' :
+	      if (ptr < end && *ptr == '\n')
+	        ptr ++;
+	  case '\n' :
+	      continue;
+	  default :
+	      if (ch >= '0' && ch <= '7')
+	      {
+	        ch -= '0';
+
+		if (ptr < end && *ptr >= '0' && *ptr <= '7')
+		{
+		  ch = ch * 8 + *ptr++ - '0';
+
+		  if (ptr < end && *ptr >= '0' && *ptr <= '7')
+		    ch = ch * 8 + *ptr++ - '0';
+		}
+	      }
+	      break;
+	}
+      }
+      else if (ch == '(')
+        depth ++;
+      else if (ch == ')' && -- depth == 0)
+        break;
+
+      *out++ = (uchar)ch;
+    }
+  }
+
+  *next = ptr;
+
+  return ((int)(out - start));
+}
+
+
+/*
+ * 'pdf_lin_trailer()' - Format the trailer for the first page section.
+ */
+
+static int				// O - Length of trailer
+pdf_lin_trailer(hdlinear_t *lin,	// I - Linearization data
+                char       *buffer,	// I - Buffer
+		size_t     bufsize,	// I - Size of buffer
+		int        prev)	// I - Offset of main xref table
+{
+  int	i;				// Looping var
+  char	id[33],				// File ID
+	encrypt[64];			// Encrypt entry
+
+
+  for (i = 0; i < 16; i ++)
+    snprintf(id + 2 * i, sizeof(id) - 2 * (size_t)i, "%02x", file_id[i]);
+
+  if (Encryption)
+    snprintf(encrypt, sizeof(encrypt), "/Encrypt %d 0 R", lin->objs[encrypt_object].number);
+  else
+    encrypt[0] = '\0';
+
+  return (snprintf(buffer, bufsize, "trailer\n<</Size %d/Prev %-10d/Root %d 0 R/Info %d 0 R/ID[<%s><%s>]%s>>\nstartxref\n0\n%%%%EOF\n", lin->size, prev, lin->objs[root_object].number, lin->objs[info_object].number, id, id, encrypt));
+}
+
+
+/*
+ * 'pdf_lin_write()' - Write a renumbered object.
+ */
+
+static void
+pdf_lin_write(hdlinear_t *lin,		// I - Linearization data
+              FILE       *out,		// I - Output file
+	      int        number,	// I - Object number in temporary file
+	      uchar      *data)		// I - Object data
+{
+  int		i, j,			// Looping vars
+		pos,			// Position in object
+		bytes;			// Bytes in string
+  hdlinobj_t	*obj = lin->objs + number;
+					// Object
+  hdlinedit_t	*edit;			// Current edit
+  uchar		*end;			// End of string
+
+
+  fprintf(out, "%d 0 obj", obj->number);
+
+  pos = pdf_lin_digits(number) + 6;
+
+  for (i = obj->num_edits, edit = lin->edits + obj->first_edit; i > 0; i --, edit ++)
+  {
+    fwrite(data + pos, (size_t)(edit->offset - pos), 1, out);
+
+    if (edit->value)
+    {
+      fprintf(out, "%d", lin->objs[edit->value].number);
+    }
+    else
+    {
+      bytes = pdf_lin_string(data + edit->offset, data + obj->length, &end);
+
+      pdf_lin_rekey(data + edit->offset, bytes, number, obj->number);
+
+      putc('<', out);
+      for (j = 0; j < bytes; j ++)
+        fprintf(out, "%02x", data[edit->offset + j]);
+      putc('>', out);
+    }
+
+    pos = edit->offset + edit->length;
+  }
+
+  if (obj->stream && Encryption && number != encrypt_object)
+  {
+    fwrite(data + pos, (size_t)(obj->stream - pos), 1, out);
+
+    pos = obj->length - 17;
+
+    pdf_lin_rekey(data + obj->stream, pos - obj->stream, number, obj->number);
+    fwrite(data + obj->stream, (size_t)(pos - obj->stream), 1, out);
+  }
+
+  fwrite(data + pos, (size_t)(obj->length - pos), 1, out);
+}
+
+
+/*
+ * 'pdf_write_objstms()' - Copy a PDF file to the output file using object
+ *                         streams and a cross-reference stream.
+ *
+ * Objects other than streams and the encryption dictionary are packed into
+ * object streams, and the cross-reference table and trailer are replaced by a
+ * cross-reference stream (PDF 1.5).  The objects keep their numbers, but
+ * strings in packed objects are decrypted since the object stream is
+ * encrypted as a whole.
+ */
+
+static void
+pdf_write_objstms(FILE *in,		// I - Temporary file
+                  FILE *out)		// I - Output file
+{
+  int		i, j, k,		// Looping vars
+		pos,			// Position in object
+		bytes,			// Bytes in string
+		count,			// Objects in current object stream
+		number,			// Current object stream
+		num_packed,		// Number of packed objects
+		xref_object,		// Cross-reference stream object
+		xref_offset,		// Offset of cross-reference stream
+		type,			// Type of cross-reference entry
+		field2,			// Offset or object stream
+		field3,			// Generation or index
+		*offsets = NULL;	// Offsets of object streams
+  hdlinear_t	lin;			// Object data
+  hdlinobj_t	*obj;			// Current object
+  hdlinedit_t	*edit;			// Current edit
+  hdstream_t	body,			// Objects in current object stream
+		xref;			// Cross-reference stream data
+  rc4_context_t	rc4;			// Decryption context
+  char		header[OBJSTM_OBJECTS * 24 + 1],
+					// Object stream header
+		hex[1024];		// Hex string buffer
+  uchar		*data = NULL,		// Object data
+		*end,			// End of string
+		temp,			// Unfiltered entry byte
+		entry[8],		// Cross-reference entry
+		prev[8];		// Previous cross-reference entry
+  size_t	alloc = 0;		// Allocated object data
+  static const char *suffix = "endobj\n";
+					// End of objects
+
+
+  memset(&lin, 0, sizeof(lin));
+  memset(&body, 0, sizeof(body));
+  memset(&xref, 0, sizeof(xref));
+
+  lin.num_objects = (int)num_objects;
+
+  if (lin.num_objects < 1 ||
+      (lin.objs = (hdlinobj_t *)calloc((size_t)lin.num_objects + 1, sizeof(hdlinobj_t))) == NULL)
+    goto copy;
+
+ /*
+  * Find the strings in each object and the objects that can be packed...
+  */
+
+  for (i = 1, num_packed = 0; i <= lin.num_objects; i ++)
+  {
+    obj         = lin.objs + i;
+    obj->offset = objects[i];
+    obj->length = (i < lin.num_objects ? objects[i + 1] : pdf_xref_offset) - objects[i];
+
+    if (!pdf_lin_read(in, obj->offset, obj->length, &data, &alloc) ||
+        !pdf_lin_scan(&lin, i, data))
+      goto copy;
+
+    if (obj->stream || (Encryption && i == encrypt_object))
+      continue;
+
+    if (obj->length < (pdf_lin_digits(i) + 13) ||
+        memcmp(data + obj->length - 7, suffix, 7))
+      goto copy;
+
+    obj->owner = 1;
+    num_packed ++;
+  }
+
+  number      = lin.num_objects;
+  xref_object = lin.num_objects + (num_packed + OBJSTM_OBJECTS - 1) / OBJSTM_OBJECTS + 1;
+
+  if ((offsets = (int *)calloc((size_t)(xref_object - lin.num_objects), sizeof(int))) == NULL)
+    goto copy;
+
+  if (!pdf_lin_read(in, 0, objects[1], &data, &alloc))
+    goto copy;
+
+  fwrite(data, (size_t)objects[1], 1, out);
+
+ /*
+  * Copy streams and pack everything else...
+  */
+
+  for (i = 1, count = 0, header[0] = '\0'; i <= lin.num_objects; i ++)
+  {
+    obj = lin.objs + i;
+
+    if (!pdf_lin_read(in, obj->offset, obj->length, &data, &alloc))
+    {
+      progress_error(HD_ERROR_READ_ERROR, "Unable to read temporary file - %s",
+                     strerror(errno));
+      break;
+    }
+
+    if (!obj->owner)
+    {
+      obj->new_offset = (int)ftell(out);
+      fwrite(data, (size_t)obj->length, 1, out);
+      continue;
+    }
+
+    if (count == 0)
+      number ++;
+
+    obj->owner  = number;
+    obj->number = count;
+
+    snprintf(header + strlen(header), sizeof(header) - strlen(header), "%d %d ", i, (int)body.length);
+
+    pos = pdf_lin_digits(i) + 6;
+
+    for (j = obj->num_edits, edit = lin.edits + obj->first_edit; j > 0; j --, edit ++)
+    {
+      if (edit->value)
+        continue;
+
+      flate_capture(&body, data + pos, edit->offset - pos, 0);
+
+      bytes = pdf_lin_string(data + edit->offset, data + obj->length, &end);
+
+      encrypt_setup(&rc4, i);
+      rc4_encrypt(&rc4, data + edit->offset, data + edit->offset, (size_t)bytes);
+
+      flate_capture(&body, (uchar *)"<", 1, 0);
+      for (pos = 0; pos < bytes; pos += (int)sizeof(hex) / 2)
+      {
+        for (k = 0; k < (int)sizeof(hex) / 2 && (pos + k) < bytes; k ++)
+	  snprintf(hex + 2 * k, sizeof(hex) - 2 * (size_t)k, "%02x", data[edit->offset + pos + k]);
+
+        flate_capture(&body, (uchar *)hex, 2 * k, 0);
+      }
+      flate_capture(&body, (uchar *)">", 1, 0);
+
+      pos = edit->offset + edit->length;
+    }
+
+    flate_capture(&body, data + pos, obj->length - 7 - pos, 0);
+    flate_capture(&body, (uchar *)"\n", 1, 0);
+
+    if (++ count == OBJSTM_OBJECTS)
+    {
+      offsets[number - lin.num_objects - 1] = pdf_write_objstm(out, number, count, header, &body);
+
+      count     = 0;
+      header[0] = '\0';
+    }
+  }
+
+  if (count > 0)
+    offsets[number - lin.num_objects - 1] = pdf_write_objstm(out, number, count, header, &body);
+
+ /*
+  * Then write the cross-reference stream, using the PNG "up" predictor to
+  * help compression...
+  */
+
+  xref_offset = (int)ftell(out);
+
+  memset(prev, 0, sizeof(prev));
+
+  for (i = 0; i <= xref_object; i ++)
+  {
+    if (i == 0)
+    {
+      type   = 0;
+      field2 = 0;
+      field3 = 65535;
+    }
+    else if (i == xref_object)
+    {
+      type   = 1;
+      field2 = xref_offset;
+      field3 = 0;
+    }
+    else if (i > lin.num_objects)
+    {
+      type   = 1;
+      field2 = offsets[i - lin.num_objects - 1];
+      field3 = 0;
+    }
+    else if (lin.objs[i].owner)
+    {
+      type   = 2;
+      field2 = lin.objs[i].owner;
+      field3 = lin.objs[i].number;
+    }
+    else
+    {
+      type   = 1;
+      field2 = lin.objs[i].new_offset;
+      field3 = 0;
+    }
+
+    entry[0] = 2;
+    entry[1] = (uchar)type;
+    entry[2] = (uchar)(field2 >> 24);
+    entry[3] = (uchar)(field2 >> 16);
+    entry[4] = (uchar)(field2 >> 8);
+    entry[5] = (uchar)field2;
+    entry[6] = (uchar)(field3 >> 8);
+    entry[7] = (uchar)field3;
+
+    if (Compression)
+    {
+      for (j = 1; j < 8; j ++)
+      {
+        temp     = entry[j];
+        entry[j] = (uchar)(entry[j] - prev[j]);
+	prev[j]  = temp;
+      }
+
+      flate_capture(&xref, entry, 8, 0);
+    }
+    else
+      flate_capture(&xref, entry + 1, 7, 0);
+  }
+
+  hd_stats_begin(HD_PHASE_COMPRESS);
+
+  if (Compression && !hd_flate_buffer(HD_FLATE_OBJECT, xref.data, xref.length, &xref.comp, &xref.comp_length))
+    xref.error = 1;
+
+  hd_stats_end();
+
+  if (xref.error)
+    progress_error(HD_ERROR_OUT_OF_MEMORY,
+                   "Unable to allocate memory for cross-reference stream.");
+
+  fprintf(out, "%d 0 obj<</Type/XRef/Size %d/W[1 4 2]/Root %d 0 R/Info %d 0 R/ID[<", xref_object, xref_object + 1, root_object, info_object);
+  for (i = 0; i < 16; i ++)
+    fprintf(out, "%02x", file_id[i]);
+  fputs("><", out);
+  for (i = 0; i < 16; i ++)
+    fprintf(out, "%02x", file_id[i]);
+  fputs(">]", out);
+
+  if (Encryption)
+    fprintf(out, "/Encrypt %d 0 R", encrypt_object);
+
+  if (Compression)
+  {
+    fprintf(out, "/Filter/FlateDecode/DecodeParms<</Columns 7/Predictor 12>>/Length %d>>stream\n", (int)xref.comp_length);
+    fwrite(xref.comp, xref.comp_length, 1, out);
+  }
+  else
+  {
+    fprintf(out, "/Length %d>>stream\n", (int)xref.length);
+    fwrite(xref.data, xref.length, 1, out);
+  }
+
+  fputs("endstream\nendobj\n", out);
+  fprintf(out, "startxref\n%d\n%%%%EOF\n", xref_offset);
+
+  goto done;
+
+ /*
+  * If we can't use object streams, copy the file as-is...
+  */
+
+  copy:
+
+  progress_error(HD_ERROR_INTERNAL_ERROR, "Unable to write object streams.");
+
+  if (pdf_lin_read(in, 0, 0, &data, &alloc))
+  {
+    rewind(in);
+    while ((bytes = (int)fread(data, 1, alloc, in)) > 0)
+      fwrite(data, 1, (size_t)bytes, out);
+  }
+
+  done:
+
+  free(data);
+  free(offsets);
+  free(lin.objs);
+  free(lin.edits);
+  free(body.data);
+  free(body.writes);
+  free(xref.data);
+  free(xref.writes);
+  free(xref.comp);
+}
+
+
+/*
+ * 'pdf_write_objstm()' - Write an object stream.
+ */
+
+static int				// O - Offset of object stream
+pdf_write_objstm(FILE       *out,	// I - Output file
+                 int        number,	// I - Object number
+		 int        count,	// I - Number of objects
+		 const char *header,	// I - Object numbers and offsets
+		 hdstream_t *body)	// I - Objects
+{
+  int		offset;			// Offset of object stream
+  hdstream_t	objstm;			// Object stream data
+  uchar		*data;			// Stream data
+  size_t	length;			// Length of stream data
+  rc4_context_t	rc4;			// Encryption context
+
+
+  memset(&objstm, 0, sizeof(objstm));
+
+  flate_capture(&objstm, (uchar *)header, (int)strlen(header), 0);
+  flate_capture(&objstm, body->data, (int)body->length, 0);
+
+  if (Compression)
+  {
+    hd_stats_begin(HD_PHASE_COMPRESS);
+
+    if (!hd_flate_buffer(HD_FLATE_OBJECT, objstm.data, objstm.length, &objstm.comp, &objstm.comp_length))
+      objstm.error = 1;
+
+    hd_stats_end();
+
+    data   = objstm.comp;
+    length = objstm.comp_length;
+  }
+  else
+  {
+    data   = objstm.data;
+    length = objstm.length;
+  }
+
+  if (objstm.error || body->error)
+    progress_error(HD_ERROR_OUT_OF_MEMORY,
+                   "Unable to allocate memory for object stream.");
+
+  if (Encryption)
+  {
+    encrypt_setup(&rc4, number);
+    rc4_encrypt(&rc4, data, data, length);
+  }
+
+  offset = (int)ftell(out);
+
+  fprintf(out, "%d 0 obj<</Type/ObjStm/N %d/First %d", number, count, (int)strlen(header));
+  if (Compression)
+    fputs("/Filter/FlateDecode", out);
+  fprintf(out, "/Length %d>>stream\n", (int)length);
+  if (length > 0)
+    fwrite(data, length, 1, out);
+  fputs("endstream\nendobj\n", out);
+
+  free(objstm.data);
+  free(objstm.writes);
+  free(objstm.comp);
+
+  body->length     = 0;
+  body->num_writes = 0;
+
+  return (offset);
+}
+
+
+/*
+ * 'render_contents()' - Render a single heading.
+ */
+
+static void
+render_contents(tree_t *t,		/* I - Tree to parse */
+                float  left,		/* I - Left margin */
+                float  right,		/* I - Printable width */
+                float  bottom,		/* I - Bottom margin */
+                float  top,		/* I - Printable top */
+                float  *y,		/* IO - Y position */
+                int    *page,		/* IO - Page # */
+	        int    heading,		/* I - Heading # */
+	        tree_t *chap)		/* I - Chapter heading */
+{
+  float		x,
+		width,
+		numberwidth,
+		height,
+		rgb[3];
+  int		hpage;
+  uchar		number[1024],
+		*nptr,
+		*link;
+  hdfrag_t	*flat,
+		*temp;
+  render_t	*r;
+  float		dot_width;
+
+
+  DEBUG_printf(("render_contents(t=%p, left=%.1f, right=%.1f, bottom=%.1f, top=%.1f, y=%.1f, page=%d, heading=%d, chap=%p)\n",
+                (void *)t, left, right, bottom, top, *y, *page, heading, (void *)chap));
+
+  if (!t)
+    return;
+
+  dot_width = _htmlSizes[SIZE_P] * _htmlWidths[t->typeface][t->style]['.'] * 0.001f;
+
+ /*
+  * Put the text...
+  */
+
+  flat = flatten_tree(t->child->child);
+
+  for (height = 0.0, temp = flat; temp != NULL; temp = temp->next)
+    if (temp->height > height)
+      height = temp->height;
+
+  height *= _htmlSpacings[SIZE_P] / _htmlSizes[SIZE_P];
+
+  if (t->indent)
+    x = left + 18.0f + 18.0f * t->indent;
+  else
+    x = left;
+
+  *y -= height;
+
+ /*
+  * Get the width of the page number, leave room for three dots...
+  */
+
+  if (heading >= 0 && heading < (int)num_headings)
+  {
+    hpage       = heading_pages[heading];
+    numberwidth = (float)(get_width((uchar *)pages[hpage].page_text, t->typeface, t->style, t->size) + 3.0f * dot_width);
+  }
+  else
+  {
+    hpage       = 0;
+    numberwidth = 0.0f;
+  }
+
+  for (temp = flat; temp != NULL; temp = temp->next)
+  {
+    rgb[0] = temp->red / 255.0f;
+    rgb[1] = temp->green / 255.0f;
+    rgb[2] = temp->blue / 255.0f;
+
+    if ((x + temp->width) >= (right - numberwidth))
+    {
+     /*
+      * Too wide to fit, continue on the next line
+      */
+
+      *y -= _htmlSpacings[SIZE_P];
+      x  = left + 36.0f * t->indent;
+    }
+
+    if (*y < bottom)
+    {
+      (*page) ++;
+      if (Verbosity)
+	progress_show("Formatting page %d", *page);
+
+      width = get_width((uchar *)TocTitle, _htmlHeadingFont, STYLE_BOLD, SIZE_H1);
+      *y = (float)(top - _htmlSpacings[SIZE_H1]);
+      x  = (float)(left + 0.5f * (right - left - width));
+      r = new_render(*page, RENDER_TEXT, x, *y, 0, 0, TocTitle);
+      r->data.text.typeface = _htmlHeadingFont;
+      r->data.text.style    = STYLE_BOLD;
+      r->data.text.size     = (float)_htmlSizes[SIZE_H1];
+      get_color(_htmlTextColor, r->data.text.rgb);
+
+      *y -= _htmlSpacings[SIZE_H1];
+
+      if (t->indent)
+	x = left + 18.0f + 18.0f * t->indent;
+      else
+	x = left;
+
+      if (chap != t)
+      {
+        *y += height;
+        render_contents(chap, left, right, bottom, top, y, page, -1, 0);
+	*y -= _htmlSpacings[SIZE_P];
+      }
+    }
+
+    if (temp->node->link != NULL)
+    {
+      link = htmlGetVariable(temp->node->link, (uchar *)"HREF");
+
+     /*
+      * Add a page link...
+      */
+
+      new_render(*page, RENDER_LINK, x, *y, temp->width, temp->height, link);
+
+      if (PSLevel == 0 && Links)
+      {
+        memcpy(rgb, link_color, sizeof(rgb));
+
+	temp->red   = (uchar)(link_color[0] * 255.0);
+	temp->green = (uchar)(link_color[1] * 255.0);
+	temp->blue  = (uchar)(link_color[2] * 255.0);
+
+        if (LinkStyle)
+	  new_render(*page, RENDER_BOX, x, *y - 1, temp->width, 0,
+	             link_color);
+      }
+    }
+
+    if ((link = htmlGetVariable(temp->node, (uchar *)"ID")) != NULL)
+    {
+     /*
+      * Add a target link...
+      */
+
+      add_link(link, *page, (int)(*y + height));
+    }
+
+    switch (temp->markup)
+    {
+      case MARKUP_A :
+          if ((link = htmlGetVariable(temp->node, (uchar *)"NAME")) != NULL)
+          {
+           /*
+            * Add a target link...
+            */
+
+            add_link(link, *page, (int)(*y + height));
+          }
+          break;
+
+      case MARKUP_NONE :
+          if (temp->node->data == NULL)
+            break;
+
+	  if (temp->node->underline)
+	    new_render(*page, RENDER_BOX, x, *y - 1, temp->width, 0, rgb);
+
+	  if (temp->node->strikethrough)
+	    new_render(*page, RENDER_BOX, x, *y + temp->height * 0.25f,
+		       temp->width, 0, rgb);
+
+          r = new_render(*page, RENDER_TEXT, x, *y, 0, 0, temp->node->data);
+          r->data.text.typeface = temp->node->typeface;
+          r->data.text.style    = temp->node->style;
+          r->data.text.size     = (float)_htmlSizes[temp->node->size];
+          memcpy(r->data.text.rgb, rgb, sizeof(rgb));
+
+          if (temp->node->superscript)
+            r->y += height - temp->height;
+          else if (temp->node->subscript)
+            r->y -= height * _htmlSizes[0] / _htmlSpacings[0] -
+		    temp->height;
+	  break;
+
+      case MARKUP_IMG :
+	  get_image_size(temp->node, &temp->width, &temp->height);
+	  new_render(*page, RENDER_IMAGE, x, *y, temp->width, temp->height,
+		     image_find((char *)htmlGetVariable(temp->node, (uchar *)"REALSRC")));
+	  break;
+
+      default :
+	  break;
+    }
+
+    x += temp->width;
+  }
+
+  flatten_free(flat);
+
+  if (numberwidth > 0.0f)
+  {
+   /*
+    * Draw dots leading up to the page number...
+    */
+
+    width = (float)(numberwidth - 3.0 * dot_width + x);
+
+    for (nptr = number;
+         nptr < (number + sizeof(number) - 1) && width < right;
+	 width += dot_width)
+      *nptr++ = '.';
+
+    if (nptr > number)
+      nptr --;
+
+    strlcpy((char *)nptr, pages[hpage].page_text, sizeof(number) - (size_t)(nptr - number));
+
+    r = new_render(*page, RENDER_TEXT, right - width + x, *y, 0, 0, number);
+    r->data.text.typeface = t->typeface;
+    r->data.text.style    = t->style;
+    r->data.text.size     = (float)_htmlSizes[t->size];
+    memcpy(r->data.text.rgb, rgb, sizeof(rgb));
+  }
+}
+
+
+/*
+ * 'count_headings()' - Count the number of headings in the TOC.
+ */
+
+static int
+count_headings(tree_t *t)		// I - Tree to count
+{
+  int	count;				// Number of headings...
 
 
   count = 0;
@@ -4072,10 +6304,7 @@ parse_doc(tree_t *t,		/* I - Tree to parse */
 	  tree_t *cpara,	/* I - Current paragraph */
 	  int    *needspace)	/* I - Need whitespace before this element */
 {
-  int		i;		/* Looping var */
-  tree_t	*para,		/* Phoney paragraph tree entry */
-		*temp;		/* Paragraph entry */
-  var_t		*var;		/* Variable entry */
+  tree_t	*para;		/* Phoney paragraph tree entry */
   uchar		*name;		/* ID name */
   uchar		*style;		/* STYLE attribute */
   float		width,		/* Width of horizontal rule */
@@ -4095,6 +6324,12 @@ parse_doc(tree_t *t,		/* I - Tree to parse */
 
   while (t != NULL)
   {
+    if (progress_cancelled())
+      break;
+
+    if (stream_active && !stream_hold)
+      pspdf_stream_pages(*page);
+
     if (t->markup == MARKUP_FILE)
       current_url = htmlGetVariable(t, (uchar *)"_HD_URL");
 
@@ -4245,26 +6480,7 @@ parse_doc(tree_t *t,		/* I - Tree to parse */
 	      t->data != NULL && strcmp((char *)t->data, " ") == 0)
 	    break;
 
-          if ((temp = htmlAddTree(para, t->markup, t->data)) != NULL)
-          {
-	    temp->link          = t->link;
-            temp->width         = t->width;
-            temp->height        = t->height;
-            temp->typeface      = t->typeface;
-            temp->style         = t->style;
-            temp->size          = t->size;
-            temp->underline     = t->underline;
-            temp->strikethrough = t->strikethrough;
-            temp->superscript   = t->superscript;
-            temp->subscript     = t->subscript;
-            temp->halignment    = t->halignment;
-            temp->valignment    = t->valignment;
-            temp->red           = t->red;
-            temp->green         = t->green;
-            temp->blue          = t->blue;
-            for (i = 0, var = t->vars; i < t->nvars; i ++, var ++)
-              htmlSetVariable(temp, var->name, var->value);
-          }
+          htmlCopyTree(para, t);
           break;
 
       case MARKUP_TABLE :
@@ -4275,7 +6491,16 @@ parse_doc(tree_t *t,		/* I - Tree to parse */
             para->child = para->last_child = NULL;
           }
 
+          // Cached cell sizes are only reused within the outermost table...
+          size_level ++;
+          stream_hold ++;
+          hd_stats_begin(HD_PHASE_TABLE);
           parse_table(t, *left, *right, *bottom, *top, x, y, page, *needspace);
+          hd_stats_end();
+          stream_hold --;
+          if (-- size_level == 0)
+            free_sizes();
+
 	  *needspace = 0;
           break;
 
@@ -4441,7 +6666,9 @@ parse_doc(tree_t *t,		/* I - Tree to parse */
 	    *needspace = 0;
           }
 
+          stream_hold ++;
           parse_list(t, left, right, bottom, top, x, y, page, *needspace);
+          stream_hold --;
 
           *x         = *left;
           *needspace = t->next && t->next->markup != MARKUP_LI &&
@@ -4597,26 +6824,7 @@ parse_doc(tree_t *t,		/* I - Tree to parse */
               para->indent     = t->indent;
             }
 
-            if ((temp = htmlAddTree(para, t->markup, t->data)) != NULL)
-            {
-	      temp->link          = t->link;
-              temp->width         = t->width;
-              temp->height        = t->height;
-              temp->typeface      = t->typeface;
-              temp->style         = t->style;
-              temp->size          = t->size;
-              temp->underline     = t->underline;
-              temp->strikethrough = t->strikethrough;
-              temp->superscript   = t->superscript;
-              temp->subscript     = t->subscript;
-              temp->halignment    = t->halignment;
-              temp->valignment    = t->valignment;
-              temp->red           = t->red;
-              temp->green         = t->green;
-              temp->blue          = t->blue;
-              for (i = 0, var = t->vars; i < t->nvars; i ++, var ++)
-        	htmlSetVariable(temp, var->name, var->value);
-            }
+            htmlCopyTree(para, t);
 	  }
 
       default :
@@ -4818,7 +7026,8 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
         	int    needspace)/* I - Need whitespace? */
 {
   int		whitespace;	/* Non-zero if a fragment ends in whitespace */
-  tree_t	*flat,
+  hdfrag_t	*frags,
+		*flat,
 		*start,
 		*end,
 		*prev,
@@ -4845,7 +7054,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
   uchar		line[10240],
 		*lineptr,
 		*dataptr;
-  tree_t	*linetype;
+  hdfrag_t	*linetype;
   float		linex,
 		linewidth;
   int		firstline;
@@ -4854,7 +7063,8 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
   DEBUG_printf(("parse_paragraph(t=%p, left=%.1f, right=%.1f, bottom=%.1f, top=%.1f, x=%.1f, y=%.1f, page=%d, needspace=%d\n",
                 (void *)t, left, right, bottom, top, *x, *y, *page, needspace));
 
-  flat        = flatten_tree(t->child);
+  frags       = flatten_tree(t->child);
+  flat        = frags;
   image_left  = left;
   image_right = right;
   image_y     = 0;
@@ -4872,15 +7082,12 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
   for (temp = flat, prev = NULL; temp != NULL;)
   {
-    if (temp->markup == MARKUP_IMG)
-      update_image_size(temp);
-
     if (temp->markup == MARKUP_IMG &&
-        (align = htmlGetVariable(temp, (uchar *)"ALIGN")))
+        (align = htmlGetVariable(temp->node, (uchar *)"ALIGN")))
     {
-      if ((border = htmlGetVariable(temp, (uchar *)"BORDER")) != NULL)
+      if ((border = htmlGetVariable(temp->node, (uchar *)"BORDER")) != NULL)
 	borderspace = (float)atof((char *)border);
-      else if (temp->link)
+      else if (temp->node->link)
 	borderspace = 1;
       else
 	borderspace = 0;
@@ -4889,7 +7096,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
       if (strcasecmp((char *)align, "LEFT") == 0)
       {
-        if ((vspace = htmlGetVariable(temp, (uchar *)"VSPACE")) != NULL)
+        if ((vspace = htmlGetVariable(temp->node, (uchar *)"VSPACE")) != NULL)
 	  *y -= atoi((char *)vspace);
 
         if (*y < (bottom + temp->height + 2 * borderspace))
@@ -4903,7 +7110,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
         if (borderspace > 0.0f)
 	{
-	  if (temp->link && PSLevel == 0)
+	  if (temp->node->link && PSLevel == 0)
 	    memcpy(rgb, link_color, sizeof(rgb));
 	  else
 	  {
@@ -4933,10 +7140,10 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
         new_render(*page, RENDER_IMAGE, image_left + borderspace,
 	           *y - temp->height, temp->width, temp->height,
-		   image_find((char *)htmlGetVariable(temp, (uchar *)"REALSRC")));
+		   image_find((char *)htmlGetVariable(temp->node, (uchar *)"REALSRC")));
 
-        if (temp->link &&
-	    (link = htmlGetVariable(temp->link, (uchar *)"_HD_FULL_HREF")) != NULL)
+        if (temp->node->link &&
+	    (link = htmlGetVariable(temp->node->link, (uchar *)"_HD_FULL_HREF")) != NULL)
         {
 	 /*
 	  * Add a page link...
@@ -4957,7 +7164,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 	if (temp_y < image_y || image_y == 0)
 	  image_y = temp_y;
 
-        if ((hspace = htmlGetVariable(temp, (uchar *)"HSPACE")) != NULL)
+        if ((hspace = htmlGetVariable(temp->node, (uchar *)"HSPACE")) != NULL)
 	  image_left += atoi((char *)hspace);
 
         if (prev != NULL)
@@ -4968,12 +7175,11 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
         if (temp->next != NULL)
           temp->next->prev = prev;
 
-        free(temp);
         temp = prev;
       }
       else if (strcasecmp((char *)align, "RIGHT") == 0)
       {
-        if ((vspace = htmlGetVariable(temp, (uchar *)"VSPACE")) != NULL)
+        if ((vspace = htmlGetVariable(temp->node, (uchar *)"VSPACE")) != NULL)
 	  *y -= atoi((char *)vspace);
 
         if (*y < (bottom + temp->height + 2 * borderspace))
@@ -4990,7 +7196,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
         if (borderspace > 0.0f)
 	{
-	  if (temp->link && PSLevel == 0)
+	  if (temp->node->link && PSLevel == 0)
 	    memcpy(rgb, link_color, sizeof(rgb));
 	  else
 	  {
@@ -5019,10 +7225,10 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
         new_render(*page, RENDER_IMAGE, image_right + borderspace,
 	           *y - temp->height, temp->width, temp->height,
-		   image_find((char *)htmlGetVariable(temp, (uchar *)"REALSRC")));
+		   image_find((char *)htmlGetVariable(temp->node, (uchar *)"REALSRC")));
 
-        if (temp->link &&
-	    (link = htmlGetVariable(temp->link, (uchar *)"_HD_FULL_HREF")) != NULL)
+        if (temp->node->link &&
+	    (link = htmlGetVariable(temp->node->link, (uchar *)"_HD_FULL_HREF")) != NULL)
         {
 	 /*
 	  * Add a page link...
@@ -5041,7 +7247,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 	if (temp_y < image_y || image_y == 0)
 	  image_y = temp_y;
 
-        if ((hspace = htmlGetVariable(temp, (uchar *)"HSPACE")) != NULL)
+        if ((hspace = htmlGetVariable(temp->node, (uchar *)"HSPACE")) != NULL)
 	  image_right -= atoi((char *)hspace);
 
         if (prev != NULL)
@@ -5052,7 +7258,6 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
         if (temp->next != NULL)
           temp->next->prev = prev;
 
-        free(temp);
         temp = prev;
       }
     }
@@ -5099,11 +7304,11 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
       while (temp != NULL && !whitespace)
       {
-        if (temp->markup == MARKUP_NONE && temp->data[0] == ' ')
+        if (temp->markup == MARKUP_NONE && temp->node->data[0] == ' ')
 	{
           if (temp == start)
-            temp_width -= _htmlWidths[temp->typeface][temp->style][' '] *
-                          _htmlSizes[temp->size] * 0.001f;
+            temp_width -= _htmlWidths[temp->node->typeface][temp->node->style][' '] *
+                          _htmlSizes[temp->node->size] * 0.001f;
           else if (temp_width > 0.0f)
 	    whitespace = 1;
 	}
@@ -5115,9 +7320,9 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
         if (temp->markup == MARKUP_IMG)
 	{
-	  if ((border = htmlGetVariable(temp, (uchar *)"BORDER")) != NULL)
+	  if ((border = htmlGetVariable(temp->node, (uchar *)"BORDER")) != NULL)
 	    borderspace = (float)atof((char *)border);
-	  else if (temp->link)
+	  else if (temp->node->link)
 	    borderspace = 1;
 	  else
 	    borderspace = 0;
@@ -5136,9 +7341,9 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 	{
 	  break;
 	}
-	else if (prev->markup == MARKUP_NONE && *(prev->data))
+	else if (prev->markup == MARKUP_NONE && *(prev->node->data))
 	{
-	  int	ch = prev->data[strlen((char *)prev->data) - 1];
+	  int	ch = prev->node->data[strlen((char *)prev->node->data) - 1];
 
 	  if (_htmlUTF8)
 	    ch = _htmlUnicode[ch];
@@ -5182,7 +7387,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
       prev = temp;
 
       if (temp->markup == MARKUP_NONE)
-        num_chars += strlen((char *)temp->data);
+        num_chars += strlen((char *)temp->node->data);
 
       if (temp->height > height)
         height = temp->height;
@@ -5198,9 +7403,9 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
         temp_height = (float)(temp->height * _htmlSpacings[0] / _htmlSizes[0]);
       else
       {
-	if ((border = htmlGetVariable(temp, (uchar *)"BORDER")) != NULL)
+	if ((border = htmlGetVariable(temp->node, (uchar *)"BORDER")) != NULL)
 	  borderspace = (float)atof((char *)border);
-	else if (temp->link)
+	else if (temp->node->link)
 	  borderspace = 1;
 	else
 	  borderspace = 0;
@@ -5233,14 +7438,14 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
       if (temp->markup != MARKUP_A)
         break;
 
-    if (temp != NULL && temp->markup == MARKUP_NONE && temp->data[0] == ' ')
+    if (temp != NULL && temp->markup == MARKUP_NONE && temp->node->data[0] == ' ')
     {
       // Drop leading space...
-      for (dataptr = temp->data; *dataptr; dataptr ++)
+      for (dataptr = temp->node->data; *dataptr; dataptr ++)
         *dataptr = dataptr[1];
       *dataptr = '\0';
 
-      temp_width = _htmlWidths[temp->typeface][temp->style][' '] * _htmlSizes[temp->size] * 0.001f;
+      temp_width = _htmlWidths[temp->node->typeface][temp->node->style][' '] * _htmlSizes[temp->node->size] * 0.001f;
       temp->width -= temp_width;
       num_chars --;
     }
@@ -5300,7 +7505,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
     while (temp != end)
     {
-      if (temp->link != NULL && PSLevel == 0 && Links &&
+      if (temp->node->link != NULL && PSLevel == 0 && Links &&
           temp->markup == MARKUP_NONE)
       {
 	temp->red   = (uchar)(link_color[0] * 255.0);
@@ -5315,33 +7520,32 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
       if (linetype != NULL &&
 	  (temp->markup != MARKUP_NONE ||
-	   temp->typeface != linetype->typeface ||
-	   temp->style != linetype->style ||
-	   temp->size != linetype->size ||
-	   temp->superscript != linetype->superscript ||
-	   temp->subscript != linetype->subscript ||
+	   temp->node->typeface != linetype->node->typeface ||
+	   temp->node->style != linetype->node->style ||
+	   temp->node->size != linetype->node->size ||
+	   temp->node->superscript != linetype->node->superscript ||
+	   temp->node->subscript != linetype->node->subscript ||
 	   temp->red != linetype->red ||
 	   temp->green != linetype->green ||
 	   temp->blue != linetype->blue))
       {
         r = new_render(*page, RENDER_TEXT, linex - linewidth, *y,
 	               linewidth, linetype->height, line);
-	r->data.text.typeface = linetype->typeface;
-	r->data.text.style    = linetype->style;
-	r->data.text.size     = (float)_htmlSizes[linetype->size];
+	r->data.text.typeface = linetype->node->typeface;
+	r->data.text.style    = linetype->node->style;
+	r->data.text.size     = (float)_htmlSizes[linetype->node->size];
 	r->data.text.spacing  = char_spacing;
         memcpy(r->data.text.rgb, rgb, sizeof(rgb));
 
-	if (linetype->superscript)
+	if (linetype->node->superscript)
           r->y += height - linetype->height;
-        else if (linetype->subscript)
+        else if (linetype->node->subscript)
           r->y -= height - linetype->height;
 
-        free(linetype);
         linetype = NULL;
       }
 
-      if ((link = htmlGetVariable(temp, (uchar *)"ID")) != NULL)
+      if ((link = htmlGetVariable(temp->node, (uchar *)"ID")) != NULL)
       {
        /*
 	* Add a target link...
@@ -5353,7 +7557,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
       switch (temp->markup)
       {
         case MARKUP_A :
-            if ((link = htmlGetVariable(temp, (uchar *)"NAME")) != NULL)
+            if ((link = htmlGetVariable(temp->node, (uchar *)"NAME")) != NULL)
             {
              /*
               * Add a target link...
@@ -5367,7 +7571,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
             break;
 
         case MARKUP_NONE :
-            if (temp->data == NULL)
+            if (temp->node->data == NULL)
               break;
 
 	    if (((temp->width - right + left) > 0.001 ||
@@ -5387,14 +7591,14 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 	      rgb[2] = temp->blue / 255.0f;
 	    }
 
-            strlcpy((char *)lineptr, (char *)temp->data, sizeof(line) - (size_t)(lineptr - line));
+            strlcpy((char *)lineptr, (char *)temp->node->data, sizeof(line) - (size_t)(lineptr - line));
 
             temp_width = temp->width + char_spacing * strlen((char *)lineptr);
 
-	    if (temp->underline || (temp->link && LinkStyle && PSLevel == 0))
+	    if (temp->node->underline || (temp->node->link && LinkStyle && PSLevel == 0))
 	      new_render(*page, RENDER_BOX, linex, *y - 1, temp_width, 0, rgb);
 
-	    if (temp->strikethrough)
+	    if (temp->node->strikethrough)
 	      new_render(*page, RENDER_BOX, linex, *y + temp->height * 0.25f,
 	                 temp_width, 0, rgb);
 
@@ -5420,9 +7624,9 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 			     "truncation or overlapping may occur!", *page + 1);
             }
 
-	    if ((border = htmlGetVariable(temp, (uchar *)"BORDER")) != NULL)
+	    if ((border = htmlGetVariable(temp->node, (uchar *)"BORDER")) != NULL)
 	      borderspace = (float)atof((char *)border);
-	    else if (temp->link)
+	    else if (temp->node->link)
 	      borderspace = 1;
 	    else
 	      borderspace = 0;
@@ -5431,7 +7635,7 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
             temp_width += 2 * borderspace;
 
-	    switch (temp->valignment)
+	    switch (temp->node->valignment)
 	    {
 	      case ALIGN_TOP :
 		  offset = height - temp->height - 2 * borderspace;
@@ -5463,14 +7667,14 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
 
 	    new_render(*page, RENDER_IMAGE, linex + borderspace,
 	               *y + offset + borderspace, temp->width, temp->height,
-		       image_find((char *)htmlGetVariable(temp, (uchar *)"REALSRC")));
+		       image_find((char *)htmlGetVariable(temp->node, (uchar *)"REALSRC")));
             whitespace = 0;
 	    temp_width = temp->width + 2 * borderspace;
 	    break;
       }
 
-      if (temp->link != NULL &&
-          (link = htmlGetVariable(temp->link, (uchar *)"_HD_FULL_HREF")) != NULL)
+      if (temp->node->link != NULL &&
+          (link = htmlGetVariable(temp->node->link, (uchar *)"_HD_FULL_HREF")) != NULL)
       {
        /*
 	* Add a page link...
@@ -5482,11 +7686,6 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
       linex += temp_width;
       prev = temp;
       temp = temp->next;
-      if (prev != linetype)
-      {
-        free(prev);
-        prev = NULL;
-      }
     }
 
    /*
@@ -5497,18 +7696,17 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
     {
       r = new_render(*page, RENDER_TEXT, linex - linewidth, *y,
                      linewidth, linetype->height, line);
-      r->data.text.typeface = linetype->typeface;
-      r->data.text.style    = linetype->style;
+      r->data.text.typeface = linetype->node->typeface;
+      r->data.text.style    = linetype->node->style;
       r->data.text.spacing  = char_spacing;
-      r->data.text.size     = (float)_htmlSizes[linetype->size];
+      r->data.text.size     = (float)_htmlSizes[linetype->node->size];
       memcpy(r->data.text.rgb, rgb, sizeof(rgb));
 
-      if (linetype->superscript)
+      if (linetype->node->superscript)
         r->y += height - linetype->height;
-      else if (linetype->subscript)
+      else if (linetype->node->subscript)
         r->y -= height - linetype->height;
 
-      free(linetype);
       linetype = NULL;
     }
 
@@ -5538,6 +7736,8 @@ parse_paragraph(tree_t *t,	/* I - Tree to parse */
     }
   }
 
+  flatten_free(frags);
+
   *x = left;
   if (*y > image_y && image_y > 0.0f && image_page == *page)
     *y = image_y;
@@ -5569,7 +7769,7 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
           int    *page,		/* IO - Page # */
           int    needspace)	/* I - Need whitespace? */
 {
-  tree_t	*flat, *start, *next;
+  hdfrag_t	*frags, *flat, *start;
   uchar		*link,
 		line[10240],
 		*lineptr,
@@ -5592,22 +7792,18 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
   if (*y < top && needspace)
     *y -= _htmlSpacings[SIZE_P];
 
-  flat = flatten_tree(t->child);
-
-  if (flat == NULL)
+  if ((frags = flatten_tree(t->child)) == NULL)
     return;
 
-  if (flat->markup == MARKUP_NONE && flat->data != NULL)
+  flat = frags;
+
+  if (flat->markup == MARKUP_NONE && flat->node->data != NULL)
   {
     // Skip leading blank line, if present...
-    for (dataptr = flat->data; isspace(*dataptr); dataptr ++);
+    for (dataptr = flat->node->data; isspace(*dataptr); dataptr ++);
 
     if (!*dataptr)
-    {
-      next = flat->next;
-      free(flat);
-      flat = next;
-    }
+      flat = flat->next;
   }
 
   while (flat != NULL)
@@ -5617,7 +7813,7 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
       if (flat->height > height)
         height = flat->height;
 
-      if (flat->markup == MARKUP_BR || (flat->markup == MARKUP_NONE && flat->data && flat->data[0] && flat->data[strlen((char *)flat->data) - 1] == '\n'))
+      if (flat->markup == MARKUP_BR || (flat->markup == MARKUP_NONE && flat->node->data && flat->node->data[0] && flat->node->data[strlen((char *)flat->node->data) - 1] == '\n'))
         break;
     }
 
@@ -5646,8 +7842,8 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
       rgb[1] = start->green / 255.0f;
       rgb[2] = start->blue / 255.0f;
 
-      if (start->link &&
-	  (link = htmlGetVariable(start->link, (uchar *)"_HD_FULL_HREF")) != NULL)
+      if (start->node->link &&
+	  (link = htmlGetVariable(start->node->link, (uchar *)"_HD_FULL_HREF")) != NULL)
       {
        /*
 	* Add a page link...
@@ -5669,7 +7865,7 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
 	}
       }
 
-      if ((link = htmlGetVariable(start, (uchar *)"ID")) != NULL)
+      if ((link = htmlGetVariable(start->node, (uchar *)"ID")) != NULL)
       {
        /*
 	* Add a target link...
@@ -5681,11 +7877,11 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
       switch (start->markup)
       {
         case MARKUP_COMMENT :
-	    parse_comment(start, &left, &right, &bottom, &top, x, y, page, NULL, 0);
+	    parse_comment(start->node, &left, &right, &bottom, &top, x, y, page, NULL, 0);
             break;
 
 	case MARKUP_A :
-            if ((link = htmlGetVariable(start, (uchar *)"NAME")) != NULL)
+            if ((link = htmlGetVariable(start->node, (uchar *)"NAME")) != NULL)
             {
              /*
               * Add a target link...
@@ -5696,7 +7892,7 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
             break;
 
 	case MARKUP_NONE :
-            for (lineptr = line, dataptr = start->data;
+            for (lineptr = line, dataptr = start->node->data;
 		 *dataptr != '\0' && lineptr < (line + sizeof(line) - 1);
 		 dataptr ++)
               if (*dataptr == '\n')
@@ -5718,17 +7914,17 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
 
             *lineptr = '\0';
 
-            width = get_width(line, start->typeface, start->style, start->size);
+            width = get_width(line, start->node->typeface, start->node->style, start->node->size);
             r = new_render(*page, RENDER_TEXT, *x, *y, width, 0, line);
-            r->data.text.typeface = start->typeface;
-            r->data.text.style    = start->style;
-            r->data.text.size     = (float)_htmlSizes[start->size];
+            r->data.text.typeface = start->node->typeface;
+            r->data.text.style    = start->node->style;
+            r->data.text.size     = (float)_htmlSizes[start->node->size];
             memcpy(r->data.text.rgb, rgb, sizeof(rgb));
 
-	    if (start->underline)
+	    if (start->node->underline)
 	      new_render(*page, RENDER_BOX, *x, *y - 1, start->width, 0, rgb);
 
-	    if (start->strikethrough)
+	    if (start->node->strikethrough)
 	      new_render(*page, RENDER_BOX, *x, *y + start->height * 0.25f,
 	        	 start->width, 0, rgb);
 
@@ -5737,7 +7933,7 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
 
 	case MARKUP_IMG :
 	    new_render(*page, RENDER_IMAGE, *x, *y, start->width, start->height,
-		       image_find((char *)htmlGetVariable(start, (uchar *)"REALSRC")));
+		       image_find((char *)htmlGetVariable(start->node, (uchar *)"REALSRC")));
 
             *x += start->width;
             col ++;
@@ -5747,10 +7943,7 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
             break;
       }
 
-      next = start->next;
-      free(start);
-      start = next;
-
+      start = start->next;
     }
 
     if ((*x - right) > 0.001 && OverflowErrors)
@@ -5761,6 +7954,8 @@ parse_pre(tree_t *t,		/* I - Tree to parse */
     *y -= _htmlSpacings[t->size] - _htmlSizes[t->size];
   }
 
+  flatten_free(frags);
+
   *x = left;
 }
 
@@ -8735,6 +10930,37 @@ find_background(tree_t *t)	/* I - Document to search */
 }
 
 
+/*
+ * 'prefetch_image()' - Start decoding an image unless it will be copied as-is.
+ */
+
+static void
+prefetch_image(image_t *img)	/* I - Image */
+{
+  if (img && !jpg_passthrough(img))
+    image_prefetch(img, !OutputColor);
+}
+
+
+/*
+ * 'prefetch_images()' - Start decoding the images in a document.
+ */
+
+static void
+prefetch_images(tree_t *t)	/* I - Document to search */
+{
+  while (t != NULL)
+  {
+    if (t->markup == MARKUP_IMG)
+      prefetch_image(image_find((char *)htmlGetVariable(t, (uchar *)"REALSRC")));
+    else if (t->child != NULL)
+      prefetch_images(t->child);
+
+    t = t->next;
+  }
+}
+
+
 /*
  * 'write_background()' - Write the background image/color for to the current
  *                        page.
@@ -8856,15 +11082,19 @@ new_render(int      page,		/* I - Page number (0-n) */
     return (&dummy);
   }
 
-  if ((type != RENDER_TEXT && type != RENDER_LINK) || data == NULL)
-    r = (render_t *)calloc(sizeof(render_t), 1);
-  else
-  {
+  hd_stats_add(HD_COUNT_RENDERS, 1);
+
+  if (data == NULL &&
+      (type == RENDER_TEXT || type == RENDER_IMAGE || type == RENDER_LINK))
+    return (NULL);
+
+  if (type == RENDER_TEXT || type == RENDER_LINK)
     datalen = strlen((char *)data);
-    r       = (render_t *)calloc(sizeof(render_t) + datalen, 1);
-  }
 
-  if (r == NULL)
+  if (pages[page].arena == NULL)
+    pages[page].arena = hd_arena_new(RENDER_BLOCK);
+
+  if ((r = (render_t *)hd_arena_alloc(pages[page].arena, sizeof(render_t) + datalen)) == NULL)
   {
     progress_error(HD_ERROR_OUT_OF_MEMORY,
                    "Unable to allocate memory on page %d\n", (int)page + 1);
@@ -8881,32 +11111,17 @@ new_render(int      page,		/* I - Page number (0-n) */
   switch (type)
   {
     case RENDER_TEXT :
-        if (data == NULL)
-        {
-          free(r);
-          return (NULL);
-        }
 	// Safe because buffer is allocated...
         memcpy((char *)r->data.text.buffer, (char *)data, datalen);
         get_color(_htmlTextColor, r->data.text.rgb);
         break;
     case RENDER_IMAGE :
-        if (data == NULL)
-        {
-          free(r);
-          return (NULL);
-        }
         r->data.image = (image_t *)data;
         break;
     case RENDER_BOX :
         memcpy(r->data.box, data, sizeof(r->data.box));
         break;
     case RENDER_LINK :
-        if (data == NULL)
-        {
-          free(r);
-          return (NULL);
-        }
 	// Safe because buffer is allocated...
         memcpy((char *)r->data.link, (char *)data, datalen);
         break;
@@ -8941,6 +11156,21 @@ new_render(int      page,		/* I - Page number (0-n) */
 }
 
 
+/*
+ * 'free_render()' - Free all of the rendering structures for a page.
+ */
+
+static void
+free_render(page_t *p)			/* I - Page */
+{
+  hd_arena_delete(p->arena);
+
+  p->arena = NULL;
+  p->start = NULL;
+  p->end   = NULL;
+}
+
+
 /*
  * 'check_pages()' - Allocate memory for more pages as needed...
  */
@@ -9000,8 +11230,12 @@ check_pages(int page)	// I - Current page
       else
       {
 	memcpy(temp, temp - 1, sizeof(page_t));
-	temp->start = NULL;
-	temp->end   = NULL;
+	temp->start         = NULL;
+	temp->end           = NULL;
+	temp->arena         = NULL;
+	temp->stream_pos    = 0;
+	temp->stream_length = 0;
+	temp->stream_fonts  = 0;
       }
 
       temp->url = current_url;
@@ -9041,7 +11275,7 @@ add_link(uchar *name,		/* I - Name of link */
          int   page,		/* I - Page # */
          int   top)		/* I - Y position */
 {
-  link_t	*temp;		/* New name */
+  hd_link_t	*temp;		/* New name */
 
 
   if (name == NULL)
@@ -9049,48 +11283,16 @@ add_link(uchar *name,		/* I - Name of link */
 
   DEBUG_printf(("add_link(name=\"%s\", page=%d, top=%d)\n", name, page, top));
 
-  if ((temp = find_link(name)) != NULL)
+  if ((temp = hd_links_add(links, (char *)name)) == NULL)
   {
-    temp->page = (short)page;
-    temp->top  = (short)top;
+    progress_error(HD_ERROR_OUT_OF_MEMORY,
+                   "Unable to allocate memory for %d links - %s",
+                   (int)hd_links_count(links) + 1, strerror(errno));
+    return;
   }
-  else
-  {
-    // See if we need to allocate memory for links...
-    if (num_links >= alloc_links)
-    {
-      // Allocate more links...
-      alloc_links += ALLOC_LINKS;
-
-      if (num_links == 0)
-        temp = (link_t *)malloc(sizeof(link_t) * alloc_links);
-      else
-        temp = (link_t *)realloc(links, sizeof(link_t) * alloc_links);
-
-      if (temp == NULL)
-      {
-	progress_error(HD_ERROR_OUT_OF_MEMORY,
-                       "Unable to allocate memory for %d links - %s",
-	               (int)alloc_links, strerror(errno));
-        alloc_links -= ALLOC_LINKS;
-	return;
-      }
-
-      links = temp;
-    }
-
-    // Add a new link...
-    temp = links + num_links;
-    num_links ++;
-
-    strlcpy((char *)temp->name, (char *)name, sizeof(temp->name));
-    temp->page = (short)page;
-    temp->top  = (short)top;
 
-    if (num_links > 1)
-      qsort(links, num_links, sizeof(link_t),
-            (compare_func_t)compare_links);
-  }
+  temp->page = page;
+  temp->top  = top;
 }
 
 
@@ -9098,36 +11300,16 @@ add_link(uchar *name,		/* I - Name of link */
  * 'find_link()' - Find a named link...
  */
 
-static link_t *
+static hd_link_t *
 find_link(uchar *name)	/* I - Name to find */
 {
-  link_t	key,	/* Search key */
-		*match;	/* Matching name entry */
-
-
-  if (name == NULL || num_links == 0)
+  if (name == NULL)
     return (NULL);
 
   if (name[0] == '#')
     name ++;
 
-  strlcpy((char *)key.name, (char *)name, sizeof(key.name));
-  match = (link_t *)bsearch(&key, links, num_links, sizeof(link_t),
-                            (compare_func_t)compare_links);
-
-  return (match);
-}
-
-
-/*
- * 'compare_links()' - Compare two named links.
- */
-
-static int			/* O - 0 = equal, -1 or 1 = not equal */
-compare_links(link_t *n1,	/* I - First name */
-              link_t *n2)	/* I - Second name */
-{
-  return (strcasecmp((char *)n1->name, (char *)n2->name));
+  return (hd_links_find(links, (char *)name));
 }
 
 
@@ -9163,11 +11345,26 @@ get_cell_size(tree_t *t,		// I - Cell
 		minw,			// Local minimum width
 		prefw,			// Local preferred width
 		format_width;		// Working format width for images
+  hdsize_t	*size;			// Cached size
+  int		depends;		// Saved size_depends value
 
 
   DEBUG_printf(("get_cell_size(%p, %.1f, %.1f, %p, %p, %p)\n",
                 (void *)t, left, right, (void *)minwidth, (void *)prefwidth, (void *)minheight));
 
+  // See if we have already measured this cell...
+  if ((size = find_size(t, right - left)) != NULL)
+  {
+    *minwidth  = size->minwidth;
+    *prefwidth = size->prefwidth;
+    *minheight = size->minheight;
+
+    return (size->width);
+  }
+
+  depends      = size_depends;
+  size_depends = 0;
+
   // First see if the width has been specified for this cell...
   if ((var = htmlGetVariable(t, (uchar *)"WIDTH")) != NULL && *var && (var[strlen((char *)var) - 1] != '%' || (right - left) > 0.0f))
   {
@@ -9180,6 +11377,9 @@ get_cell_size(tree_t *t,		// I - Cell
   else
     width = 0.0f;
 
+  if (var && *var && var[strlen((char *)var) - 1] == '%')
+    size_depends = 1;
+
   if ((format_width = right - left) <= 0.0f)
     format_width = PagePrintWidth;
 
@@ -9258,6 +11458,9 @@ get_cell_size(tree_t *t,		// I - Cell
       case MARKUP_SPACER :
           frag_height = temp->height;
 
+          if (temp->data == NULL)
+            size_depends = 1;		// Breaks depend on format_width
+
 #ifdef TABLE_DEBUG2
           if (temp->markup == MARKUP_NONE)
 	    printf("FRAG(%s) = %.1f\n", temp->data, temp->width);
@@ -9452,6 +11655,9 @@ get_cell_size(tree_t *t,		// I - Cell
   DEBUG_printf(("get_cell_size(): width=%.1f, minw=%.1f, prefw=%.1f, minh=%.1f\n",
                 width, minw, prefw, minh));
 
+  add_size(t, right - left, width, minw, prefw, minh);
+  size_depends |= depends;
+
   return (width);
 }
 
@@ -9489,11 +11695,26 @@ get_table_size(tree_t *t,		// I - Table
   int		columns,		// Current number of columns
 		max_columns,		// Maximum columns
 		rows;			// Number of rows
+  hdsize_t	*size;			// Cached size
+  int		depends;		// Saved size_depends value
 
 
   DEBUG_printf(("get_table_size(%p, %.1f, %.1f, %p, %p, %p)\n",
                 (void *)t, left, right, (void *)minwidth, (void *)prefwidth, (void *)minheight));
 
+  // See if we have already measured this table...
+  if ((size = find_size(t, right - left)) != NULL)
+  {
+    *minwidth  = size->minwidth;
+    *prefwidth = size->prefwidth;
+    *minheight = size->minheight;
+
+    return (size->width);
+  }
+
+  depends      = size_depends;
+  size_depends = 0;
+
   // First see if the width has been specified for this table...
   if ((var = htmlGetVariable(t, (uchar *)"WIDTH")) != NULL && *var && (var[strlen((char *)var) - 1] != '%' || (right - left) > 0.0f))
   {
@@ -9506,6 +11727,9 @@ get_table_size(tree_t *t,		// I - Table
   else
     width = 0.0f;
 
+  if (var && *var && var[strlen((char *)var) - 1] == '%')
+    size_depends = 1;
+
   minw  = 0.0f;
   prefw = 0.0f;
 
@@ -9644,9 +11868,134 @@ get_table_size(tree_t *t,		// I - Table
   DEBUG_printf(("get_table_size(): width=%.1f, minw=%.1f, prefw=%.1f, minh=%.1f\n",
                 width, minw, prefw, minh));
 
+  add_size(t, right - left, width, minw, prefw, minh);
+  size_depends |= depends;
+
   return (width);
 }
 
+
+//
+// 'find_size()' - Find the cached size of a cell or table.
+//
+// Sizes that do not depend on the available width match any width.
+//
+
+static hdsize_t *			// O - Cached size or NULL
+find_size(tree_t *t,			// I - Cell or table
+          float  avail)			// I - Available width
+{
+  hdsize_t	*size;			// Current size
+
+
+  if (num_sizes > 0)
+  {
+    for (size = size_buckets[((size_t)t >> 4) & (num_size_buckets - 1)]; size; size = size->next)
+      if (size->node == t && (!size->depends || size->avail == avail) &&
+          size->print_width == PagePrintWidth &&
+          size->print_length == PagePrintLength)
+      {
+        size_hits ++;
+        size_depends |= size->depends;
+
+        return (size);
+      }
+  }
+
+  size_misses ++;
+
+  return (NULL);
+}
+
+
+//
+// 'add_size()' - Add the size of a cell or table to the cache.
+//
+
+static void
+add_size(tree_t *t,			// I - Cell or table
+         float  avail,			// I - Available width
+         float  width,			// I - Required width
+         float  minwidth,		// I - Minimum width
+         float  prefwidth,		// I - Preferred width
+         float  minheight)		// I - Minimum height
+{
+  hdsize_t	*size,			// New size
+		**buckets,		// New hash buckets
+		*next;			// Next size in old bucket
+  size_t	i,			// Looping var
+		num_buckets,		// New number of hash buckets
+		bucket;			// Hash bucket
+
+
+  // Sizes are only needed while a table is being formatted...
+  if (size_level == 0)
+    return;
+
+  if (!size_arena && (size_arena = hd_arena_new(0)) == NULL)
+    return;
+
+  // Grow the hash table as needed to keep the chains short...
+  if (num_sizes >= num_size_buckets)
+  {
+    num_buckets = num_size_buckets ? 2 * num_size_buckets : SIZE_BUCKETS;
+
+    if ((buckets = (hdsize_t **)calloc(num_buckets, sizeof(hdsize_t *))) == NULL)
+      return;
+
+    for (i = 0; i < num_size_buckets; i ++)
+      for (size = size_buckets[i]; size; size = next)
+      {
+        next       = size->next;
+        bucket     = ((size_t)size->node >> 4) & (num_buckets - 1);
+        size->next = buckets[bucket];
+        buckets[bucket] = size;
+      }
+
+    free(size_buckets);
+
+    size_buckets     = buckets;
+    num_size_buckets = num_buckets;
+  }
+
+  if ((size = (hdsize_t *)hd_arena_alloc(size_arena, sizeof(hdsize_t))) == NULL)
+    return;
+
+  size->node         = t;
+  size->avail        = avail;
+  size->print_width  = PagePrintWidth;
+  size->print_length = PagePrintLength;
+  size->depends      = size_depends;
+  size->width        = width;
+  size->minwidth     = minwidth;
+  size->prefwidth    = prefwidth;
+  size->minheight    = minheight;
+
+  bucket       = ((size_t)t >> 4) & (num_size_buckets - 1);
+  size->next   = size_buckets[bucket];
+  size_buckets[bucket] = size;
+
+  num_sizes ++;
+}
+
+
+//
+// 'free_sizes()' - Free all cached cell and table sizes.
+//
+
+static void
+free_sizes(void)
+{
+  hd_arena_delete(size_arena);
+  free(size_buckets);
+
+  size_arena       = NULL;
+  size_buckets     = NULL;
+  num_sizes        = 0;
+  num_size_buckets = 0;
+  size_depends     = 0;
+}
+
 #ifdef TABLE_DEBUG
 #  undef DEBUG_printf
 #  undef DEBUG_puts
@@ -9658,16 +12007,62 @@ get_table_size(tree_t *t,		// I - Table
 /*
  * 'flatten_tree()' - Flatten an HTML tree to only include the text, image,
  *                    link, and break markups.
+ *
+ * The fragments refer to the original nodes and are taken from a pool that
+ * is reused by later calls, so the caller must release them with
+ * flatten_free() using the returned pointer.
  */
 
-static tree_t *			/* O - Flattened markup tree */
+static hdfrag_t *		/* O - First fragment */
 flatten_tree(tree_t *t)		/* I - Markup tree to flatten */
 {
-  tree_t	*temp,		/* New tree node */
-		*flat;		/* Flattened tree */
+  hdfrag_t	*flat;		/* Flattened tree */
+
+
+  if ((flat = flatten_nodes(t, NULL)) == NULL)
+    return (NULL);
+
+  while (flat->prev != NULL)
+    flat = flat->prev;
+
+  return (flat);
+}
+
+
+/*
+ * 'flatten_free()' - Release a flattened tree and any fragments allocated
+ *                    after it.
+ */
+
+static void
+flatten_free(hdfrag_t *flat)	/* I - First fragment */
+{
+  hdfragblock_t	*block;		/* Current block */
+
+
+  for (block = frag_blocks; block; block = block->next)
+  {
+    if (flat >= block->frags && flat < (block->frags + HD_FRAG_BLOCK))
+    {
+      frag_current = block;
+      frag_used    = (int)(flat - block->frags);
+      break;
+    }
+  }
+}
+
+
+/*
+ * 'flatten_nodes()' - Add the text, image, link, and break markups to a
+ *                     flattened tree.
+ */
 
+static hdfrag_t *		/* O - Last fragment */
+flatten_nodes(tree_t   *t,	/* I - Markup tree to flatten */
+              hdfrag_t *flat)	/* I - Last fragment or NULL */
+{
+  hdfrag_t	*temp;		/* New fragment */
 
-  flat = NULL;
 
   while (t != NULL)
   {
@@ -9680,33 +12075,19 @@ flatten_tree(tree_t *t)		/* I - Markup tree to flatten */
       case MARKUP_BR :
       case MARKUP_SPACER :
       case MARKUP_IMG :
-	  temp = (tree_t *)calloc(sizeof(tree_t), 1);
-	  memcpy(temp, t, sizeof(tree_t));
-	  temp->parent = NULL;
-	  temp->child  = NULL;
-	  temp->prev   = flat;
-	  temp->next   = NULL;
-	  if (flat != NULL)
-            flat->next = temp;
+          if ((temp = new_frag(flat, t, t->markup)) == NULL)
+	    break;
+
           flat = temp;
 
           if (temp->markup == MARKUP_IMG)
-            update_image_size(temp);
+            get_image_size(t, &temp->width, &temp->height);
           break;
 
       case MARKUP_A :
-          if (htmlGetVariable(t, (uchar *)"NAME") != NULL)
-          {
-	    temp = (tree_t *)calloc(sizeof(tree_t), 1);
-	    memcpy(temp, t, sizeof(tree_t));
-	    temp->parent = NULL;
-	    temp->child  = NULL;
-	    temp->prev   = flat;
-	    temp->next   = NULL;
-	    if (flat != NULL)
-              flat->next = temp;
+          if (htmlGetVariable(t, (uchar *)"NAME") != NULL &&
+	      (temp = new_frag(flat, t, MARKUP_A)) != NULL)
             flat = temp;
-          }
 	  break;
 
       case MARKUP_P :
@@ -9736,15 +12117,8 @@ flatten_tree(tree_t *t)		/* I - Markup tree to flatten */
       case MARKUP_DT :
       case MARKUP_TR :
       case MARKUP_CAPTION :
-	  temp = (tree_t *)calloc(sizeof(tree_t), 1);
-	  temp->markup = MARKUP_BR;
-	  temp->parent = NULL;
-	  temp->child  = NULL;
-	  temp->prev   = flat;
-	  temp->next   = NULL;
-	  if (flat != NULL)
-            flat->next = temp;
-          flat = temp;
+          if ((temp = new_frag(flat, &frag_break, MARKUP_BR)) != NULL)
+            flat = temp;
           break;
 
       default :
@@ -9752,61 +12126,120 @@ flatten_tree(tree_t *t)		/* I - Markup tree to flatten */
     }
 
     if (t->child != NULL && t->markup != MARKUP_UNKNOWN)
+      flat = flatten_nodes(t->child, flat);
+
+    t = t->next;
+  }
+
+  return (flat);
+}
+
+
+/*
+ * 'free_frags()' - Free all fragment blocks.
+ */
+
+static void
+free_frags(void)
+{
+  hdfragblock_t	*next;		/* Next block */
+
+
+  while (frag_blocks)
+  {
+    next = frag_blocks->next;
+    free(frag_blocks);
+    frag_blocks = next;
+  }
+
+  frag_current = NULL;
+  frag_used    = 0;
+}
+
+
+/*
+ * 'new_frag()' - Add a fragment to a flattened tree.
+ */
+
+static hdfrag_t *		/* O - New fragment or NULL */
+new_frag(hdfrag_t *prev,	/* I - Previous fragment or NULL */
+         tree_t   *node,	/* I - Markup node */
+	 markup_t markup)	/* I - Markup code */
+{
+  hdfragblock_t	*block;		/* New block */
+  hdfrag_t	*temp;		/* New fragment */
+
+
+  if (!frag_current || frag_used >= HD_FRAG_BLOCK)
+  {
+    if ((block = frag_current ? frag_current->next : frag_blocks) == NULL)
     {
-      temp = flatten_tree(t->child);
+      if ((block = (hdfragblock_t *)calloc(1, sizeof(hdfragblock_t))) == NULL)
+      {
+	progress_error(HD_ERROR_OUT_OF_MEMORY,
+		       "Unable to allocate memory for paragraph fragments!");
+        return (NULL);
+      }
 
-      if (temp != NULL)
-        temp->prev = flat;
-      if (flat != NULL)
-        flat->next = temp;
+      if (frag_current)
+        frag_current->next = block;
       else
-        flat = temp;
+        frag_blocks = block;
     }
 
-    if (flat != NULL)
-      while (flat->next != NULL)
-        flat = flat->next;
-
-    t = t->next;
+    frag_current = block;
+    frag_used    = 0;
   }
 
-  if (flat == NULL)
-    return (NULL);
+  temp = frag_current->frags + frag_used;
+  frag_used ++;
 
-  while (flat->prev != NULL)
-    flat = flat->prev;
+  temp->prev   = prev;
+  temp->next   = NULL;
+  temp->node   = node;
+  temp->markup = markup;
+  temp->red    = node->red;
+  temp->green  = node->green;
+  temp->blue   = node->blue;
+  temp->width  = node->width;
+  temp->height = node->height;
 
-  return (flat);
+  if (prev != NULL)
+    prev->next = temp;
+
+  return (temp);
 }
 
 
 /*
- * 'update_image_size()' - Update the size of an image based upon the
- *                         printable width.
+ * 'get_image_size()' - Get the size of an image based upon the printable
+ *                      width.
  */
 
 static void
-update_image_size(tree_t *t)	/* I - Tree entry */
+get_image_size(tree_t *t,	/* I - Tree entry */
+               float  *width,	/* IO - Width in points */
+	       float  *height)	/* IO - Height in points */
 {
   image_t	*img;		/* Image file */
-  uchar		*width,		/* Width string */
-		*height;	/* Height string */
+  uchar		*wattr,		/* Width string */
+		*hattr;		/* Height string */
 
 
-  width  = htmlGetVariable(t, (uchar *)"WIDTH");
-  height = htmlGetVariable(t, (uchar *)"HEIGHT");
+  wattr = htmlGetVariable(t, (uchar *)"WIDTH");
+  hattr = htmlGetVariable(t, (uchar *)"HEIGHT");
 
-  if (width != NULL && *width && height != NULL && *height)
+  if (wattr != NULL && *wattr && hattr != NULL && *hattr)
   {
-    if (width[strlen((char *)width) - 1] == '%')
-      t->width = (float)(atof((char *)width) * PagePrintWidth / 100.0f);
+    if (wattr[strlen((char *)wattr) - 1] == '%')
+      *width = (float)(atof((char *)wattr) * PagePrintWidth / 100.0f);
     else
-      t->width = (float)(atoi((char *)width) * PagePrintWidth / _htmlBrowserWidth);
+      *width = (float)(atoi((char *)wattr) * PagePrintWidth / _htmlBrowserWidth);
 
-    if (height[strlen((char *)height) - 1] == '%')
-      t->height = (float)(atof((char *)height) * PagePrintWidth / 100.0f);
+    if (hattr[strlen((char *)hattr) - 1] == '%')
+      *height = (float)(atof((char *)hattr) * PagePrintWidth / 100.0f);
     else
-      t->height = (float)(atoi((char *)height) * PagePrintWidth / _htmlBrowserWidth);
+      *height = (float)(atoi((char *)hattr) * PagePrintWidth / _htmlBrowserWidth);
 
     return;
   }
@@ -9816,32 +12249,44 @@ update_image_size(tree_t *t)	/* I - Tree entry */
   if (img == NULL)
     return;
 
-  if (width != NULL && *width)
+  if (wattr != NULL && *wattr)
   {
-    if (width[strlen((char *)width) - 1] == '%')
-      t->width = (float)(atof((char *)width) * PagePrintWidth / 100.0f);
+    if (wattr[strlen((char *)wattr) - 1] == '%')
+      *width = (float)(atof((char *)wattr) * PagePrintWidth / 100.0f);
     else
-      t->width = (float)(atoi((char *)width) * PagePrintWidth / _htmlBrowserWidth);
+      *width = (float)(atoi((char *)wattr) * PagePrintWidth / _htmlBrowserWidth);
 
-    t->height = t->width * img->height / img->width;
+    *height = *width * img->height / img->width;
   }
-  else if (height != NULL && *height)
+  else if (hattr != NULL && *hattr)
   {
-    if (height[strlen((char *)height) - 1] == '%')
-      t->height = (float)(atof((char *)height) * PagePrintWidth / 100.0f);
+    if (hattr[strlen((char *)hattr) - 1] == '%')
+      *height = (float)(atof((char *)hattr) * PagePrintWidth / 100.0f);
     else
-      t->height = (float)(atoi((char *)height) * PagePrintWidth / _htmlBrowserWidth);
+      *height = (float)(atoi((char *)hattr) * PagePrintWidth / _htmlBrowserWidth);
 
-    t->width = t->height * img->width / img->height;
+    *width = *height * img->width / img->height;
   }
   else
   {
-    t->width  = (float)(img->width * PagePrintWidth / _htmlBrowserWidth);
-    t->height = (float)(img->height * PagePrintWidth / _htmlBrowserWidth);
+    *width  = (float)(img->width * PagePrintWidth / _htmlBrowserWidth);
+    *height = (float)(img->height * PagePrintWidth / _htmlBrowserWidth);
   }
 }
 
 
+/*
+ * 'update_image_size()' - Update the size of an image based upon the
+ *                         printable width.
+ */
+
+static void
+update_image_size(tree_t *t)	/* I - Tree entry */
+{
+  get_image_size(t, &t->width, &t->height);
+}
+
+
 /*
  * 'get_width()' - Get the width of a string in points.
  */
@@ -9852,24 +12297,11 @@ get_width(uchar *s,		/* I - String to scan */
           int   style,		/* I - Style code */
           int   size)		/* I - Size */
 {
-  uchar	*ptr;			/* Current character */
-  int	width;			/* Current width */
-
-
   DEBUG_printf(("get_width(\"%s\", %d, %d, %d)\n",
                 s == NULL ? "(null)" : (const char *)s,
                 typeface, style, size));
 
-  if (s == NULL)
-    return (0.0);
-
-  if (!_htmlWidthsLoaded[typeface][style])
-    htmlLoadFontWidths(typeface, style);
-
-  for (width = 0, ptr = s; *ptr != '\0'; ptr ++)
-    width += _htmlWidths[typeface][style][*ptr];
-
-  return (width * _htmlSizes[size] * 0.001f);
+  return (htmlGetTextWidth(s, typeface, style) * _htmlSizes[size] * 0.001f);
 }
 
 
@@ -9924,6 +12356,8 @@ open_file(void)
 
     return (fopen(filename, "wb+"));
   }
+  else if (OutputFile)
+    return (OutputFile);
   else if (OutputPath[0] != '\0')
     return (fopen(OutputPath, "wb+"));
   else if (PSLevel == 0)
@@ -9933,6 +12367,149 @@ open_file(void)
 }
 
 
+/*
+ * 'remove_output()' - Remove the output files of a cancelled conversion.
+ *
+ * Files passed in by the caller and standard output are left alone.
+ */
+
+static void
+remove_output(void)
+{
+  int	i;		/* Looping var */
+  char	filename[255];	/* Filename */
+
+
+  if (OutputFiles && PSLevel > 0)
+  {
+    snprintf(filename, sizeof(filename), "%s/cover.ps", OutputPath);
+    unlink(filename);
+
+    snprintf(filename, sizeof(filename), "%s/contents.ps", OutputPath);
+    unlink(filename);
+
+    for (i = 1; i <= TocDocCount; i ++)
+    {
+      snprintf(filename, sizeof(filename), "%s/doc%d.ps", OutputPath, i);
+      unlink(filename);
+    }
+  }
+  else if (OutputFiles)
+  {
+    snprintf(filename, sizeof(filename), "%s/doc.pdf", OutputPath);
+    unlink(filename);
+  }
+  else if (!OutputFile && OutputPath[0] != '\0')
+    unlink(OutputPath);
+}
+
+
+/*
+ * 'format_number()' - Format a number with up to "digits" decimal places.
+ *
+ * The number is rounded the same way as printf("%.Nf") and trailing zeros
+ * and the decimal point are dropped.  No nul is added.
+ */
+
+static char *				/* O - End of formatted number */
+format_number(char  *s,			/* I - Buffer, at least 64 bytes */
+              float f,			/* I - Number */
+	      int   digits)		/* I - Number of decimal places, 0-3 */
+{
+  static const unsigned scales[4] = { 1, 10, 100, 1000 };
+  double	t;			/* Scaled number */
+  unsigned	n,			/* Rounded and scaled number */
+		whole,			/* Whole part of number */
+		frac;			/* Fractional part of number */
+  char		temp[16],		/* Reversed digits */
+		*tempptr;		/* Pointer into digits */
+
+
+  if (digits < 0)
+    digits = 0;
+  else if (digits > 3)
+    digits = 3;
+
+ /*
+  * Scaling a float by a power of 10 up to 1000 is exact in a double, so the
+  * rounding below matches printf...
+  */
+
+  t = (double)f * scales[digits];
+
+  if (t < 0.0)
+    t = -t;
+
+  if (!(t < 4000000000.0))
+  {
+    // Huge numbers and NaN go through printf...
+    int	len = snprintf(s, 64, "%.*f", digits, f);
+
+    if (len >= 64)
+      len = 63;
+
+    if (digits > 0)
+    {
+      while (len > 1 && s[len - 1] == '0')
+        len --;
+
+      if (s[len - 1] == '.')
+        len --;
+    }
+
+    return (s + len);
+  }
+
+  n = (unsigned)t;
+  t -= n;
+
+  if (t > 0.5 || (t == 0.5 && (n & 1)))
+    n ++;
+
+  if (n == 0)
+  {
+    *s++ = '0';
+    return (s);
+  }
+
+  if (f < 0.0f)
+    *s++ = '-';
+
+  whole = n / scales[digits];
+  frac  = n % scales[digits];
+
+  tempptr = temp;
+  do
+  {
+    *tempptr++ = (char)('0' + whole % 10);
+    whole /= 10;
+  }
+  while (whole > 0);
+
+  while (tempptr > temp)
+    *s++ = *--tempptr;
+
+  if (frac > 0)
+  {
+    // Drop trailing zeros and then add the remaining digits...
+    while ((frac % 10) == 0)
+    {
+      frac /= 10;
+      digits --;
+    }
+
+    *s++ = '.';
+
+    for (tempptr = s + digits; tempptr > s; frac /= 10)
+      *--tempptr = (char)('0' + frac % 10);
+
+    s += digits;
+  }
+
+  return (s);
+}
+
+
 /*
  * 'set_color()' - Set the current text color...
  */
@@ -9941,6 +12518,10 @@ static void
 set_color(FILE  *out,	/* I - File to write to */
           float *rgb)	/* I - RGB color */
 {
+  char	buffer[256],	/* Output buffer */
+	*bufptr;	/* Pointer into buffer */
+
+
   if (rgb[0] == render_rgb[0] &&
       rgb[1] == render_rgb[1] &&
       rgb[2] == render_rgb[2])
@@ -9953,21 +12534,23 @@ set_color(FILE  *out,	/* I - File to write to */
   if (OutputColor)
   {
     // Output RGB color...
-    if (PSLevel > 0)
-      fprintf(out, "%.2f %.2f %.2f C ", rgb[0], rgb[1], rgb[2]);
-    else
-      flate_printf(out, "%.2f %.2f %.2f rg ", rgb[0], rgb[1], rgb[2]);
+    bufptr    = format_number(buffer, rgb[0], 2);
+    *bufptr++ = ' ';
+    bufptr    = format_number(bufptr, rgb[1], 2);
+    *bufptr++ = ' ';
+    bufptr    = format_number(bufptr, rgb[2], 2);
+
+    strcpy(bufptr, PSLevel > 0 ? " C " : " rg ");
   }
   else
   {
     // Output grayscale...
-    if (PSLevel > 0)
-      fprintf(out, "%.2f G ",
-              rgb[0] * 0.31f + rgb[1] * 0.61f + rgb[2] * 0.08f);
-    else
-      flate_printf(out, "%.2f g ",
-                   rgb[0] * 0.31f + rgb[1] * 0.61f + rgb[2] * 0.08f);
+    bufptr = format_number(buffer, rgb[0] * 0.31f + rgb[1] * 0.61f + rgb[2] * 0.08f, 2);
+
+    strcpy(bufptr, PSLevel > 0 ? " G " : " g ");
   }
+
+  write_buffer(out, buffer, strlen(buffer));
 }
 
 
@@ -9981,8 +12564,10 @@ set_font(FILE  *out,			/* I - File to write to */
          int   style,			/* I - Style code */
          float size)			/* I - Size */
 {
-  char	sizes[255],	/* Formatted string for size... */
-	*s;		/* Pointer to end of string */
+  char	buffer[256],			/* Output buffer */
+	*bufptr;			/* Pointer into buffer */
+  int	font;				/* Font number */
+  static const char *hex = "0123456789abcdef";
 
 
   if (typeface == render_typeface &&
@@ -9990,31 +12575,45 @@ set_font(FILE  *out,			/* I - File to write to */
       size == render_size)
     return;
 
- /*
-  * Format size and strip trailing 0's and decimals...
-  */
-
-  snprintf(sizes, sizeof(sizes), "%.1f", size);
-
-  for (s = sizes + strlen(sizes) - 1; s > sizes && *s == '0'; s --)
-    *s = '\0';
-
-  if (*s == '.')
-    *s = '\0';
+  font = typeface * 4 + style;
 
  /*
   * Set the new typeface, style, and size.
   */
 
+  bufptr = buffer;
+
   if (PSLevel > 0)
   {
     if (size != render_size)
-      fprintf(out, "%s FS", sizes);
+    {
+      bufptr = format_number(bufptr, size, 1);
+      memcpy(bufptr, " FS", 3);
+      bufptr += 3;
+    }
 
-    fprintf(out, "/F%x SF ", typeface * 4 + style);
+    *bufptr++ = '/';
+    *bufptr++ = 'F';
+    if (font > 15)
+      *bufptr++ = hex[font >> 4];
+    *bufptr++ = hex[font & 15];
+    memcpy(bufptr, " SF ", 4);
+    bufptr += 4;
   }
   else
-    flate_printf(out, "/F%x %s Tf ", typeface * 4 + style, sizes);
+  {
+    *bufptr++ = '/';
+    *bufptr++ = 'F';
+    if (font > 15)
+      *bufptr++ = hex[font >> 4];
+    *bufptr++ = hex[font & 15];
+    *bufptr++ = ' ';
+    bufptr    = format_number(bufptr, size, 1);
+    memcpy(bufptr, " Tf ", 4);
+    bufptr += 4;
+  }
+
+  write_buffer(out, buffer, (size_t)(bufptr - buffer));
 
   render_typeface = typeface;
   render_style    = style;
@@ -10031,9 +12630,8 @@ set_pos(FILE  *out,			/* I - File to write to */
         float x,			/* I - X position */
         float y)			/* I - Y position */
 {
-  char	xs[255],			/* Formatted string for X... */
-	ys[255],			/* Formatted string for Y... */
-	*s;				/* Pointer to end of string */
+  char	buffer[256],			/* Output buffer */
+	*bufptr;			/* Pointer into buffer */
 
 
   if (fabs(render_x - x) < 0.1 && fabs(render_y - y) < 0.1)
@@ -10045,43 +12643,56 @@ set_pos(FILE  *out,			/* I - File to write to */
 
   if (PSLevel > 0 || render_x == -1.0)
   {
-    snprintf(xs, sizeof(xs), "%.3f", x);
-    snprintf(ys, sizeof(ys), "%.3f", y);
+    bufptr    = format_number(buffer, x, 3);
+    *bufptr++ = ' ';
+    bufptr    = format_number(bufptr, y, 3);
   }
   else
   {
-    snprintf(xs, sizeof(xs), "%.3f", x - render_startx);
-    snprintf(ys, sizeof(ys), "%.3f", y - render_y);
+    bufptr    = format_number(buffer, x - render_startx, 3);
+    *bufptr++ = ' ';
+    bufptr    = format_number(bufptr, y - render_y, 3);
   }
 
- /*
-  * Strip trailing 0's and decimals...
-  */
+  if (PSLevel > 0)
+  {
+    memcpy(bufptr, " M", 2);
+    bufptr += 2;
+  }
+  else
+  {
+    memcpy(bufptr, " Td", 3);
+    bufptr += 3;
+  }
 
-  for (s = xs + strlen(xs) - 1; s > xs && *s == '0'; s --)
-    *s = '\0';
+  write_buffer(out, buffer, (size_t)(bufptr - buffer));
 
-  if (*s == '.')
-    *s = '\0';
+  render_x = render_startx = x;
+  render_y = y;
+}
 
-  for (s = ys + strlen(ys) - 1; s > ys && *s == '0'; s --)
-    *s = '\0';
 
-  if (*s == '.')
-    *s = '\0';
+/*
+ * 'write_buffer()' - Write formatted page content.
+ */
 
+static void
+write_buffer(FILE       *out,		/* I - File to write to */
+             const char *buffer,	/* I - Buffer */
+	     size_t     length)		/* I - Number of bytes */
+{
   if (PSLevel > 0)
-    fprintf(out, "%s %s M", xs, ys);
+    fwrite(buffer, 1, length, out);
   else
-    flate_printf(out, "%s %s Td", xs, ys);
-
-  render_x = render_startx = x;
-  render_y = y;
+    flate_write(out, (uchar *)buffer, (int)length);
 }
 
 
 /*
  * 'ps_hex()' - Print binary data as a series of hexadecimal numbers.
+ *
+ * The data is encoded a line at a time into a local buffer that is written
+ * in large blocks.
  */
 
 static void
@@ -10089,38 +12700,77 @@ ps_hex(FILE  *out,			/* I - File to print to */
        uchar *data,			/* I - Data to print */
        int   length)			/* I - Number of bytes to print */
 {
-  int		col;
+  int		count;			/* Bytes on the current line */
+  char		buffer[8192],		/* Output buffer */
+		*bufptr,		/* Pointer into buffer */
+		*bufend;		/* End of buffer */
   static const char *hex = "0123456789ABCDEF";
 
 
-  col = 0;
+  bufptr = buffer;
+  bufend = buffer + sizeof(buffer) - 81;
+
   while (length > 0)
   {
    /*
-    * Put the hex uchars out to the file; note that we don't use fprintf()
-    * for speed reasons...
+    * Encode up to 40 bytes (80 hex digits) per line...
     */
 
-    putc(hex[*data >> 4], out);
-    putc(hex[*data & 15], out);
+    if ((count = length) > 40)
+      count = 40;
+
+    length -= count;
+
+    for (; count > 0; count --, data ++)
+    {
+      *bufptr++ = hex[*data >> 4];
+      *bufptr++ = hex[*data & 15];
+    }
 
-    data ++;
-    length --;
+    *bufptr++ = '\n';
 
-    col = (col + 1) % 40;
-    if (col == 0)
-      putc('\n', out);
+    if (bufptr >= bufend)
+    {
+      fwrite(buffer, 1, (size_t)(bufptr - buffer), out);
+      bufptr = buffer;
+    }
   }
 
-  if (col > 0)
-    putc('\n', out);
+  if (bufptr > buffer)
+    fwrite(buffer, 1, (size_t)(bufptr - buffer), out);
 }
 
 
 
 #ifdef HTMLDOC_ASCII85
+/*
+ * 'ps_ascii85_group()' - Encode a 32-bit word as 5 base-85 characters.
+ */
+
+static inline char *			/* O - Next character in buffer */
+ps_ascii85_group(char     *bufptr,	/* I - Pointer into buffer */
+                 unsigned b)		/* I - 32-bit word */
+{
+  bufptr[4] = (char)(b % 85 + '!');
+  b /= 85;
+  bufptr[3] = (char)(b % 85 + '!');
+  b /= 85;
+  bufptr[2] = (char)(b % 85 + '!');
+  b /= 85;
+  bufptr[1] = (char)(b % 85 + '!');
+  b /= 85;
+  bufptr[0] = (char)(b + '!');
+
+  return (bufptr + 5);
+}
+
+
 /*
  * 'ps_ascii85()' - Print binary data as a series of base-85 numbers.
+ *
+ * Data is encoded 4 bytes at a time into a local buffer that is written in
+ * large blocks.  Up to 3 bytes are kept between calls until the next call
+ * or the end-of-data.
  */
 
 static void
@@ -10129,73 +12779,87 @@ ps_ascii85(FILE  *out,			/* I - File to print to */
 	   int   length,		/* I - Number of bytes to print */
 	   int   eod)			/* I - 1 = end-of-data */
 {
-  unsigned	b = 0;			/* Current 32-bit word */
-  uchar		c[5];			/* Base-85 encoded characters */
+  unsigned	b;			/* Current 32-bit word */
+  char		buffer[8192],		/* Output buffer */
+		*bufptr,		/* Pointer into buffer */
+		*bufend;		/* End of buffer */
   static int	col = 0;		/* Column */
   static uchar	leftdata[4];		/* Leftover data at the end */
   static int	leftcount = 0;		/* Size of leftover data */
 
 
-  length += leftcount;
+  bufptr = buffer;
+  bufend = buffer + sizeof(buffer) - 6;
 
-  while (length > 3)
+  if (leftcount > 0)
   {
-    switch (leftcount)
+    // Complete the leftover word from the last call...
+    while (leftcount < 4 && length > 0)
     {
-      case 0 :
-          b = (unsigned)((((((data[0] << 8) | data[1]) << 8) | data[2]) << 8) | data[3]);
-	  break;
-      case 1 :
-          b = (unsigned)((((((leftdata[0] << 8) | data[0]) << 8) | data[1]) << 8) | data[2]);
-	  break;
-      case 2 :
-          b = (unsigned)((((((leftdata[0] << 8) | leftdata[1]) << 8) | data[0]) << 8) | data[1]);
-	  break;
-      case 3 :
-          b = (unsigned)((((((leftdata[0] << 8) | leftdata[1]) << 8) | leftdata[2]) << 8) | data[0]);
-	  break;
+      leftdata[leftcount ++] = *data++;
+      length --;
     }
 
+    if (leftcount == 4)
+    {
+      b = (unsigned)((((((leftdata[0] << 8) | leftdata[1]) << 8) | leftdata[2]) << 8) | leftdata[3]);
+
+      if (col >= 76)
+      {
+        col       = 0;
+        *bufptr++ = '\n';
+      }
+
+      if (b == 0)
+      {
+        *bufptr++ = 'z';
+        col ++;
+      }
+      else
+      {
+        bufptr = ps_ascii85_group(bufptr, b);
+        col    += 5;
+      }
+
+      leftcount = 0;
+    }
+  }
+
+  while (length > 3)
+  {
+    b = (unsigned)((((((data[0] << 8) | data[1]) << 8) | data[2]) << 8) | data[3]);
+
     if (col >= 76)
     {
-      col = 0;
-      putc('\n', out);
+      col       = 0;
+      *bufptr++ = '\n';
     }
 
     if (b == 0)
     {
-      putc('z', out);
+      *bufptr++ = 'z';
       col ++;
     }
     else
     {
-      c[4] = (b % 85) + '!';
-      b /= 85;
-      c[3] = (b % 85) + '!';
-      b /= 85;
-      c[2] = (b % 85) + '!';
-      b /= 85;
-      c[1] = (b % 85) + '!';
-      b /= 85;
-      c[0] = (uchar)(b + '!');
-
-      fwrite(c, 1, 5, out);
-      col += 5;
+      bufptr = ps_ascii85_group(bufptr, b);
+      col    += 5;
     }
 
-    data      += 4 - leftcount;
-    length    -= 4 - leftcount;
-    leftcount = 0;
+    data   += 4;
+    length -= 4;
+
+    if (bufptr >= bufend)
+    {
+      fwrite(buffer, 1, (size_t)(bufptr - buffer), out);
+      bufptr = buffer;
+    }
   }
 
   if (length > 0)
   {
     // Copy any remainder into the leftdata array...
-    if ((length - leftcount) > 0)
-      memcpy(leftdata + leftcount, data, (size_t)(length - leftcount));
-
-    memset(leftdata + length, 0, (size_t)(4 - length));
-
+    memcpy(leftdata, data, (size_t)length);
     leftcount = length;
   }
 
@@ -10204,33 +12868,34 @@ ps_ascii85(FILE  *out,			/* I - File to print to */
     // Do the end-of-data dance...
     if (col >= 76)
     {
-      col = 0;
-      putc('\n', out);
+      col       = 0;
+      *bufptr++ = '\n';
     }
 
     if (leftcount > 0)
     {
       // Write the remaining bytes as needed...
-      b = (unsigned)((((((leftdata[0] << 8) | leftdata[1]) << 8) | leftdata[2]) << 8) | leftdata[3]);
+      char	c[5];			/* Base-85 encoded characters */
 
-      c[4] = (b % 85) + '!';
-      b /= 85;
-      c[3] = (b % 85) + '!';
-      b /= 85;
-      c[2] = (b % 85) + '!';
-      b /= 85;
-      c[1] = (b % 85) + '!';
-      b /= 85;
-      c[0] = (uchar)(b + '!');
+      memset(leftdata + leftcount, 0, (size_t)(4 - leftcount));
+
+      b = (unsigned)((((((leftdata[0] << 8) | leftdata[1]) << 8) | leftdata[2]) << 8) | leftdata[3]);
 
-      fwrite(c, (size_t)(leftcount + 1), 1, out);
+      ps_ascii85_group(c, b);
+      memcpy(bufptr, c, (size_t)(leftcount + 1));
+      bufptr += leftcount + 1;
 
       leftcount = 0;
     }
 
+    if (bufptr > buffer)
+      fwrite(buffer, 1, (size_t)(bufptr - buffer), out);
+
     fputs("~>\n", out);
     col = 0;
   }
+  else if (bufptr > buffer)
+    fwrite(buffer, 1, (size_t)(bufptr - buffer), out);
 }
 #endif // HTMLDOC_ASCII85
 
@@ -10358,6 +13023,20 @@ jpg_setup(FILE           *out,	/* I - Output file */
 }
 
 
+/*
+ * 'jpg_passthrough()' - Can the JPEG data for an image be copied as-is?
+ */
+
+static int				/* O - 1 if the data can be copied, 0 otherwise */
+jpg_passthrough(image_t *img)		/* I - Image */
+{
+  if (!img || PSLevel != 0 || (!OutputColor && img->depth != 1))
+    return (0);
+
+  return (img->jpeg == 1 || (img->jpeg == 2 && PDFVersion >= 13));
+}
+
+
 /*
  * 'compare_rgb()' - Compare two RGB colors...
  */
@@ -10408,6 +13087,9 @@ write_image(FILE     *out,		/* I - Output file */
   indices  = NULL;
   indwidth = 0;
 
+  if (!img->obj && jpg_passthrough(img) && write_jpeg(out, r, write_obj))
+    return;
+
   if (!img->pixels && !img->obj)
   {
     image_load(img->filename, !OutputColor, 1);
@@ -10425,38 +13107,19 @@ write_image(FILE     *out,		/* I - Output file */
   //       stuck with this workaround forever...
   if (PSLevel != 1 && PDFVersion >= 12 && img->obj == 0 && (img->use > 1 || !Encryption))
   {
+    ncolors = image_palette(img, colors);
+
     if (img->depth == 1)
     {
      /*
       * Greyscale image...
       */
 
-      memset(grays, 0, sizeof(grays));
-
-      for (i = img->width * img->height, pixel = img->pixels;
-	   i > 0;
-	   i --, pixel ++)
-	if (!grays[*pixel])
-	{
-          if (ncolors >= 16)
-	    break;
-
-	  grays[*pixel] = 1;
-	  ncolors ++;
-	}
-
-      if (i == 0)
-      {
-	for (i = 0, j = 0; i < 256; i ++)
-	  if (grays[i])
-	  {
-	    colors[j] = (unsigned)((((i << 8) | i) << 8) | i);
-	    grays[i]  = (uchar)j;
-	    j ++;
-	  }
-      }
-      else
+      if (ncolors > 16)
         ncolors = 0;
+
+      for (i = 0; i < ncolors; i ++)
+        grays[colors[i] & 255] = (uchar)i;
     }
     else
     {
@@ -10469,34 +13132,7 @@ write_image(FILE     *out,		/* I - Output file */
       else
         max_colors = 256;
 
-      for (i = img->width * img->height, pixel = img->pixels, match = NULL;
-	   i > 0;
-	   i --, pixel += 3)
-      {
-        key = (unsigned)((((pixel[0] << 8) | pixel[1]) << 8) | pixel[2]);
-
-	if (!match || *match != key)
-	{
-          if (ncolors > 0)
-            match = (unsigned *)bsearch(&key, colors, (size_t)ncolors, sizeof(unsigned), (compare_func_t)compare_rgb);
-          else
-            match = NULL;
-        }
-
-        if (match == NULL)
-        {
-          if (ncolors >= max_colors)
-            break;
-
-          colors[ncolors] = key;
-          ncolors ++;
-
-          if (ncolors > 1)
-            qsort(colors, (size_t)ncolors, sizeof(unsigned), (compare_func_t)compare_rgb);
-        }
-      }
-
-      if (i > 0)
+      if (ncolors > max_colors)
         ncolors = 0;
     }
   }
@@ -10768,7 +13404,7 @@ write_image(FILE     *out,		/* I - Output file */
             fputs("/Filter/FlateDecode", out);
 
           pdf_start_stream(out);
-          flate_open_stream(out);
+          flate_open_stream(out, HD_FLATE_IMAGE);
 	  if (img->maskscale == 8)
   	    flate_write(out, img->mask, img->width * img->height);
 	  else
@@ -10838,7 +13474,7 @@ write_image(FILE     *out,		/* I - Output file */
   	  fprintf(out, "/Width %d/Height %d/BitsPerComponent %d",
 	          img->width, img->height, indbits);
           pdf_start_stream(out);
-          flate_open_stream(out);
+          flate_open_stream(out, HD_FLATE_IMAGE);
 
           if (OutputJPEG && ncolors == 0)
 	  {
@@ -11017,7 +13653,7 @@ write_image(FILE     *out,		/* I - Output file */
 
 	    fputs("image\n", out);
 
-            flate_open_stream(out);
+            flate_open_stream(out, HD_FLATE_IMAGE);
 
 	    if (img->mask && img->maskscale == 8)
 	    {
@@ -11097,7 +13733,7 @@ write_image(FILE     *out,		/* I - Output file */
 
 	    fputs("image\n", out);
 
-            flate_open_stream(out);
+            flate_open_stream(out, HD_FLATE_IMAGE);
 
 	    if (img->mask && img->maskscale == 8)
 	    {
@@ -11270,20 +13906,99 @@ write_image(FILE     *out,		/* I - Output file */
           fputs("/DataSource currentfile/ASCIIHexDecode filter"
 	        ">>image\n", out);
 
-          ps_hex(out, img->pixels, img->width * img->depth * img->height);
-	  // End of data marker...
-	  fputs(">\n", out);
-#endif // HTMLDOC_ASCII85
-        }
+          ps_hex(out, img->pixels, img->width * img->depth * img->height);
+	  // End of data marker...
+	  fputs(">\n", out);
+#endif // HTMLDOC_ASCII85
+        }
+
+	fputs("GR\n", out);
+        break;
+  }
+
+  if (ncolors > 0)
+    free(indices);
+
+  image_unload(img);
+}
+
+
+/*
+ * 'write_jpeg()' - Copy a JPEG image file to a PDF file...
+ */
+
+static int				/* O - 1 if written, 0 on error */
+write_jpeg(FILE     *out,		/* I - Output file */
+           render_t *r,			/* I - Image to write */
+	   int      write_obj)		/* I - Write an object? */
+{
+  image_t	*img;			/* Image */
+  const char	*realname;		/* Real filename */
+  FILE		*fp = NULL;		/* JPEG file */
+  const uchar	*data;			/* Decoded data URI */
+  size_t	length;			/* Length of data URI */
+  uchar		buffer[8192];		/* Copy buffer */
+  size_t	bytes;			/* Bytes read */
+
+
+  img = r->data.image;
+
+  if ((realname = file_find(Path, img->filename)) == NULL)
+    return (0);
+
+  if ((data = file_data(realname, &length)) == NULL &&
+      (fp = fopen(realname, "rb")) == NULL)
+    return (0);
+
+  if (write_obj)
+  {
+    img->obj = pdf_start_object(out);
+
+    fputs("/Type/XObject/Subtype/Image", out);
+    if (img->depth == 1)
+      fputs("/ColorSpace/DeviceGray", out);
+    else
+      fputs("/ColorSpace/DeviceRGB", out);
+
+#ifdef HTMLDOC_INTERPOLATION
+    fputs("/Interpolate true", out);
+#endif // HTMLDOC_INTERPOLATION
+
+    fprintf(out, "/Filter/DCTDecode/Width %d/Height %d/BitsPerComponent 8",
+            img->width, img->height);
+    pdf_start_stream(out);
+
+    if (Encryption)
+      encrypt_init();
+
+    if (data)
+      flate_write(out, (uchar *)data, (int)length);
+    else
+      while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        flate_write(out, buffer, (int)bytes);
+
+    pdf_end_object(out);
+  }
+  else
+  {
+    flate_printf(out, "q %.1f 0 0 %.1f %.1f %.1f cm\n", r->width, r->height,
+	         r->x, r->y);
+    flate_printf(out, "BI/CS/%s/I true/W %d/H %d/BPC 8/F/DCT ID\n",
+                 img->depth == 1 ? "G" : "RGB", img->width, img->height);
+
+    if (data)
+      flate_write(out, (uchar *)data, (int)length);
+    else
+      while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        flate_write(out, buffer, (int)bytes);
 
-	fputs("GR\n", out);
-        break;
+    flate_write(out, (uchar *)"\nEI\nQ\n", 6, 1);
   }
 
-  if (ncolors > 0)
-    free(indices);
+  if (fp)
+    fclose(fp);
 
-  image_unload(img);
+  return (1);
 }
 
 
@@ -11426,6 +14141,11 @@ write_prolog(FILE  *out,		/* I - Output file */
 					/* Whether or not a font is used */
   int		font_desc[TYPE_MAX][STYLE_MAX];
 					/* Font descriptor objects */
+  uchar		fonts_chars[TYPE_MAX * STYLE_MAX][256],
+					/* Characters used in each font */
+		*s;			/* Pointer into text */
+  char		font_names[TYPE_MAX][STYLE_MAX][64];
+					/* Embedded font names */
   char		temp[1024];		/* Temporary string */
   md5_state_t	md5;			/* MD5 state */
   md5_byte_t	digest[16];		/* MD5 digest value */
@@ -11452,11 +14172,24 @@ write_prolog(FILE  *out,		/* I - Output file */
   memset(fonts_used, 0, sizeof(fonts_used));
   fonts_used[HeadFootType][HeadFootStyle] = 1;
 
+  memcpy(fonts_chars, stream_chars, sizeof(fonts_chars));
+
   for (page = 0; page < (int)num_pages; page ++)
+  {
     for (r = pages[page].start; r != NULL; r = r->next)
       if (r->type == RENDER_TEXT)
+      {
 	fonts_used[r->data.text.typeface][r->data.text.style] = 1;
 
+	for (s = r->data.text.buffer; *s; s ++)
+	  fonts_chars[r->data.text.typeface * STYLE_MAX + r->data.text.style][*s] = 1;
+      }
+
+    for (i = 0; i < (TYPE_MAX * STYLE_MAX); i ++)
+      if (pages[page].stream_fonts & (1U << i))
+	fonts_used[i / STYLE_MAX][i % STYLE_MAX] = 1;
+  }
+
 #ifdef DEBUG
   puts("The following fonts were used:");
   for (i = 0; i < TYPE_MAX; i ++)
@@ -11698,7 +14431,8 @@ write_prolog(FILE  *out,		/* I - Output file */
       if (EmbedFonts || !_htmlStandardFonts[i])
 	for (j = 0; j < STYLE_MAX; j ++)
           if (fonts_used[i][j])
-	    write_type1(out, (typeface_t)i, (style_t)j);
+	    write_type1(out, (typeface_t)i, (style_t)j,
+	                fonts_chars[i * STYLE_MAX + j], NULL, 0);
     }
 
    /*
@@ -12114,7 +14848,10 @@ write_prolog(FILE  *out,		/* I - Output file */
       if (EmbedFonts || !_htmlStandardFonts[i])
 	for (j = 0; j < STYLE_MAX; j ++)
           if (fonts_used[i][j])
-	    font_desc[i][j] = write_type1(out, (typeface_t )i, (style_t)j);
+	    font_desc[i][j] = write_type1(out, (typeface_t )i, (style_t)j,
+	                                  fonts_chars[i * STYLE_MAX + j],
+					  font_names[i][j],
+					  sizeof(font_names[i][j]));
 
     for (i = 0; i < TYPE_MAX; i ++)
       for (j = 0; j < STYLE_MAX; j ++)
@@ -12124,7 +14861,7 @@ write_prolog(FILE  *out,		/* I - Output file */
 
 	  fputs("/Type/Font", out);
 	  fputs("/Subtype/Type1", out);
-	  fprintf(out, "/BaseFont/%s", _htmlFonts[i][j]);
+	  fprintf(out, "/BaseFont/%s", font_desc[i][j] ? font_names[i][j] : _htmlFonts[i][j]);
 
           if (font_desc[i][j])
 	  {
@@ -12187,55 +14924,62 @@ write_string(FILE  *out,		/* I - Output file */
   }
   else
   {
-    uchar nbsp = 160;			// Non-breaking space char
+    uchar	nbsp = 160;		// Non-breaking space char
+    char	buffer[1024],		// Output buffer
+		*bufptr,		// Pointer into buffer
+		*bufend;		// End of buffer
 
-    if (compress)
-      flate_write(out, (uchar *)"(", 1);
-    else
-      putc('(', out);
 
     if (_htmlUTF8)
       nbsp = _htmlCharacters[160];
 
-    while (*s != '\0')
+   /*
+    * Quote the string into a local buffer that is written in blocks...
+    */
+
+    bufptr    = buffer;
+    bufend    = buffer + sizeof(buffer) - 5;
+    *bufptr++ = '(';
+
+    for (; *s != '\0'; s ++)
     {
-      if (*s == nbsp)
+      if (bufptr >= bufend)
       {
-       /* &nbsp; */
-	if (compress)
-	  flate_write(out, (uchar *)" ", 1);
+        if (compress)
+	  flate_write(out, (uchar *)buffer, (int)(bufptr - buffer));
 	else
-	  putc(' ', out);
+	  fwrite(buffer, 1, (size_t)(bufptr - buffer), out);
+
+        bufptr = buffer;
       }
-      else if (*s < 32 || *s > 126)
+
+      if (*s == nbsp)
       {
-	if (compress)
-	  flate_printf(out, "\\%o", *s);
-	else
-	  fprintf(out, "\\%o", *s);
+       /* &nbsp; */
+        *bufptr++ = ' ';
       }
-      else if (compress)
+      else if (*s < 32 || *s > 126)
       {
-	if (*s == '(' || *s == ')' || *s == '\\')
-	  flate_write(out, (uchar *)"\\", 1);
-
-	flate_write(out, s, 1);
+        *bufptr++ = '\\';
+	*bufptr++ = (char)('0' + (*s >> 6));
+	*bufptr++ = (char)('0' + ((*s >> 3) & 7));
+	*bufptr++ = (char)('0' + (*s & 7));
       }
       else
       {
 	if (*s == '(' || *s == ')' || *s == '\\')
-	  putc('\\', out);
+	  *bufptr++ = '\\';
 
-	putc(*s, out);
+	*bufptr++ = (char)*s;
       }
-
-      s ++;
     }
 
+    *bufptr++ = ')';
+
     if (compress)
-      flate_write(out, (uchar *)")", 1);
+      flate_write(out, (uchar *)buffer, (int)(bufptr - buffer));
     else
-      putc(')', out);
+      fwrite(buffer, 1, (size_t)(bufptr - buffer), out);
   }
 }
 
@@ -12264,13 +15008,24 @@ write_text(FILE     *out,	/* I - Output file */
   set_font(out, r->data.text.typeface, r->data.text.style, r->data.text.size);
   set_pos(out, r->x, r->y);
 
-  if (PSLevel > 0)
+  if (PSLevel > 0 ? r->data.text.spacing > 0.0f : r->data.text.spacing != render_spacing)
   {
-    if (r->data.text.spacing > 0.0f)
-      fprintf(out, " %.3f", r->data.text.spacing);
+    char	buffer[256],		/* Output buffer */
+		*bufptr;		/* Pointer into buffer */
+
+    buffer[0] = ' ';
+    bufptr    = format_number(buffer + 1, r->data.text.spacing, 3);
+
+    if (PSLevel == 0)
+    {
+      memcpy(bufptr, " Tc", 3);
+      bufptr += 3;
+
+      render_spacing = r->data.text.spacing;
+    }
+
+    write_buffer(out, buffer, (size_t)(bufptr - buffer));
   }
-  else if (r->data.text.spacing != render_spacing)
-    flate_printf(out, " %.3f Tc", render_spacing = r->data.text.spacing);
 
   write_string(out, r->data.text.buffer, PSLevel == 0);
 
@@ -12475,7 +15230,7 @@ write_trailer(FILE  *out,		/* I - Output file */
 
     pdf_end_object(out);
 
-    offset = ftell(out);
+    offset = pdf_xref_offset = ftell(out);
 
     fputs("xref\n", out);
     fprintf(out, "0 %d \n", (int)num_objects + 1);
@@ -12507,33 +15262,430 @@ write_trailer(FILE  *out,		/* I - Output file */
 }
 
 
+/*
+ * 'font_get()' - Get the cached font program for a typeface and style.
+ *
+ * Font programs and metrics are loaded once and reused by later exports in
+ * the same process.
+ */
+
+static hdfont_t *			/* O - Font or NULL on error */
+font_get(typeface_t typeface,		/* I - Typeface */
+         style_t    style)		/* I - Style */
+{
+  hdfont_t	*font;			/* Font */
+  hdfontblob_t	*blob;			/* Current blob */
+  char		filename[1024];		/* PFA filename */
+
+
+  font = font_cache[typeface] + style;
+
+  if (font->datadir && strcmp(font->datadir, _htmlData))
+  {
+   /*
+    * The data directory has changed, so flush the cached font...
+    */
+
+    while ((blob = font->blobs) != NULL)
+    {
+      font->blobs = blob->next;
+
+      free(blob->glyphs);
+      free(blob->data);
+      free(blob);
+    }
+
+    hd_type1_delete(font->program);
+    free(font->datadir);
+    free(font->chars);
+
+    memset(font, 0, sizeof(hdfont_t));
+  }
+
+  if (font->program)
+    return (font);
+
+ /*
+  * Try to load the PFA file for the Type1 font...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/fonts/%s.pfa", _htmlData,
+           _htmlFonts[typeface][style]);
+  if ((font->program = hd_type1_load(filename)) == NULL)
+  {
+#ifndef DEBUG
+    progress_error(HD_ERROR_FILE_NOT_FOUND,
+                   "Unable to open font file %s!", filename);
+#endif /* !DEBUG */
+    return (NULL);
+  }
+
+  if (!font->datadir)
+    font->datadir = strdup(_htmlData);
+
+  return (font);
+}
+
+
+/*
+ * 'font_get_blob()' - Get the serialized font program for a set of characters.
+ *
+ * PostScript output gets the complete font resource while PDF output gets
+ * the (compressed) font stream data.  The most recently used subsets are
+ * kept so that documents using the same characters share the same blob.
+ */
+
+static hdfontblob_t *			/* O - Blob or NULL on error */
+font_get_blob(hdfont_t    *font,	/* I - Font */
+              typeface_t  typeface,	/* I - Typeface */
+	      style_t     style,	/* I - Style */
+	      const uchar *chars)	/* I - Characters used */
+{
+  hdfontblob_t	*blob,			/* Current blob */
+		*prev;			/* Previous blob */
+  hd_type1_t	*sub,			/* Subset font program */
+		*program;		/* Font program to write */
+  const char	*glyphs[256];		/* Glyphs used */
+  char		key[256 * 68],		/* Characters and glyphs */
+		*keyptr;		/* Pointer into key */
+  int		ch;			/* Character value */
+  int		num_glyphs;		/* Number of glyphs used */
+  int		level;			/* Compression level */
+  size_t	i;			/* Looping var */
+  unsigned	hash;			/* Hash for subset tag */
+  uchar		*dataptr;		/* Pointer into data */
+  size_t	complen;		/* Length of compressed data */
+  static const char *hex = "0123456789abcdef";
+					/* Hex digits */
+
+
+ /*
+  * Only embed the glyphs for the characters that are used.  The Symbol and
+  * Dingbats fonts use their own encoding...
+  */
+
+  for (ch = 0, num_glyphs = 0, keyptr = key; ch < 256; ch ++)
+    if (chars[ch])
+    {
+      glyphs[num_glyphs] = typeface < TYPE_SYMBOL ? _htmlGlyphs[ch] : font->program->encoding[ch];
+
+      snprintf(keyptr, sizeof(key) - (size_t)(keyptr - key), "%d/%.63s ", ch,
+               glyphs[num_glyphs] ? glyphs[num_glyphs] : "");
+      keyptr += strlen(keyptr);
+
+      num_glyphs ++;
+    }
+
+  level = PSLevel ? -1 : Compression;
+
+ /*
+  * See if we already have this subset...
+  */
+
+  for (blob = font->blobs, prev = NULL; blob; prev = blob, blob = blob->next)
+    if (blob->level == level && !strcmp(blob->glyphs, key))
+    {
+      if (prev)
+      {
+        // Move to the front of the list...
+        prev->next  = blob->next;
+        blob->next  = font->blobs;
+        font->blobs = blob;
+      }
+
+      return (blob);
+    }
+
+ /*
+  * No, subset the font program...
+  */
+
+  for (ch = 0; ch < 256 && !font->program->encoding[ch]; ch ++);
+
+  if (typeface < TYPE_SYMBOL || ch < 256)
+    sub = hd_type1_subset(font->program, glyphs, num_glyphs);
+  else
+    sub = NULL;
+
+  program = sub ? sub : font->program;
+
+  if ((blob = (hdfontblob_t *)calloc(1, sizeof(hdfontblob_t))) == NULL ||
+      (blob->glyphs = strdup(key)) == NULL)
+  {
+    progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for font %s!", _htmlFonts[typeface][style]);
+    free(blob);
+    hd_type1_delete(sub);
+    return (NULL);
+  }
+
+  blob->level   = level;
+  blob->length1 = (int)program->clear_length;
+  blob->length2 = (int)program->data_length;
+  blob->length3 = (int)program->trailer_length;
+
+  if (sub)
+  {
+   /*
+    * PDF requires subset fonts to have a unique six letter tag...
+    */
+
+    for (ch = 0, hash = 2166136261U; ch < 256; ch ++)
+      hash = (hash ^ chars[ch] ^ (unsigned)ch) * 16777619U;
+    for (i = 0; _htmlFonts[typeface][style][i]; i ++)
+      hash = (hash ^ (unsigned)(_htmlFonts[typeface][style][i] & 255)) * 16777619U;
+
+    for (i = 0; i < 6; i ++, hash /= 26)
+      blob->tag[i] = (char)('A' + hash % 26);
+
+    blob->tag[6] = '\0';
+  }
+
+  if (PSLevel)
+  {
+   /*
+    * Serialize a Type1 font resource for the PostScript output, keeping the
+    * same name so the font is found by the rest of the prolog...
+    */
+
+    blob->length = strlen(_htmlFonts[typeface][style]) + 64 +
+                   program->clear_length + 2 * program->data_length +
+                   program->data_length / 32 + 1 + program->trailer_length;
+
+    if ((blob->data = (uchar *)malloc(blob->length)) != NULL)
+    {
+      snprintf((char *)blob->data, blob->length, "%%%%BeginResource: font %s\n", _htmlFonts[typeface][style]);
+      dataptr = blob->data + strlen((char *)blob->data);
+
+      memcpy(dataptr, program->clear, program->clear_length);
+      dataptr += program->clear_length;
+
+      for (i = 0; i < program->data_length; i ++)
+      {
+        *dataptr++ = (uchar)hex[program->data[i] >> 4];
+        *dataptr++ = (uchar)hex[program->data[i] & 15];
+
+        if ((i & 31) == 31)
+          *dataptr++ = '\n';
+      }
+
+      if (i & 31)
+        *dataptr++ = '\n';
+
+      memcpy(dataptr, program->trailer, program->trailer_length);
+      dataptr += program->trailer_length;
+
+      if (program->trailer_length > 0 && program->trailer[program->trailer_length - 1] != '\n')
+        *dataptr++ = '\n';
+
+      memcpy(dataptr, "%%EndResource\n", 14);
+      dataptr += 14;
+
+      blob->length = (size_t)(dataptr - blob->data);
+    }
+  }
+  else
+  {
+   /*
+    * Serialize the font stream for the PDF output...
+    */
+
+    blob->length = program->clear_length + program->data_length +
+                   program->trailer_length;
+
+    if ((blob->data = (uchar *)malloc(blob->length)) != NULL)
+    {
+      memcpy(blob->data, program->clear, program->clear_length);
+      memcpy(blob->data + program->clear_length, program->data,
+             program->data_length);
+      memcpy(blob->data + program->clear_length + program->data_length,
+             program->trailer, program->trailer_length);
+
+      if (Compression)
+      {
+        hd_stats_begin(HD_PHASE_COMPRESS);
+
+        if (!hd_flate_buffer(HD_FLATE_FONT, blob->data, blob->length, &dataptr, &complen))
+	  dataptr = NULL;
+
+        hd_stats_end();
+
+        free(blob->data);
+
+        blob->data   = dataptr;
+        blob->length = complen;
+      }
+    }
+  }
+
+  hd_type1_delete(sub);
+
+  if (!blob->data)
+  {
+    progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for font %s!", _htmlFonts[typeface][style]);
+    free(blob->glyphs);
+    free(blob);
+    return (NULL);
+  }
+
+ /*
+  * Add the blob to the front of the list, dropping the least recently used
+  * blob as needed...
+  */
+
+  blob->next  = font->blobs;
+  font->blobs = blob;
+
+  if (font->num_blobs < 8)
+  {
+    font->num_blobs ++;
+  }
+  else
+  {
+    for (prev = blob; prev->next->next; prev = prev->next);
+
+    free(prev->next->glyphs);
+    free(prev->next->data);
+    free(prev->next);
+
+    prev->next = NULL;
+  }
+
+  return (blob);
+}
+
+
+/*
+ * 'font_get_metrics()' - Load the AFM metrics for a cached font.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+font_get_metrics(hdfont_t   *font,	/* I - Font */
+                 typeface_t typeface,	/* I - Typeface */
+		 style_t    style)	/* I - Style */
+{
+  char		filename[1024];		/* AFM filename */
+  FILE		*fp;			/* AFM file */
+  char		line[1024];		/* Line from AFM file */
+  hdfontchar_t	*fc;			/* Current character */
+  size_t	alloc_chars;		/* Allocated characters */
+
+
+  if (font->have_metrics)
+    return (1);
+
+ /*
+  * Try to open the AFM file for the Type1 font...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/fonts/%s.afm", _htmlData,
+           _htmlFonts[typeface][style]);
+  if ((fp = fopen(filename, "r")) == NULL)
+  {
+#ifndef DEBUG
+    progress_error(HD_ERROR_FILE_NOT_FOUND,
+                   "Unable to open font width file %s!", filename);
+#endif /* !DEBUG */
+    return (0);
+  }
+
+ /*
+  * Set the default values (Courier)...
+  */
+
+  font->ascent       = 629;
+  font->cap_height   = 562;
+  font->x_height     = 426;
+  font->descent      = -157;
+  font->bbox[0]      = -28;
+  font->bbox[1]      = -250;
+  font->bbox[2]      = 628;
+  font->bbox[3]      = 805;
+  font->italic_angle = 0;
+
+  free(font->chars);
+
+  font->chars     = NULL;
+  font->num_chars = 0;
+  alloc_chars     = 0;
+
+ /*
+  * Read the AFM file...
+  */
+
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    if (strncmp(line, "ItalicAngle ", 12) == 0)
+      font->italic_angle = atoi(line + 12);
+    else if (strncmp(line, "FontBBox ", 9) == 0)
+      sscanf(line + 9, "%d%d%d%d", font->bbox + 0, font->bbox + 1,
+             font->bbox + 2, font->bbox + 3);
+    else if (strncmp(line, "CapHeight ", 10) == 0)
+      font->cap_height = atoi(line + 10);
+    else if (strncmp(line, "XHeight ", 8) == 0)
+      font->x_height = atoi(line + 8);
+    else if (strncmp(line, "Ascender ", 9) == 0)
+      font->ascent = atoi(line + 9);
+    else if (strncmp(line, "Descender ", 10) == 0)
+      font->descent = atoi(line + 10);
+    else if (strncmp(line, "C ", 2) == 0)
+    {
+      if (font->num_chars >= alloc_chars)
+      {
+        alloc_chars += 256;
+
+        if ((fc = (hdfontchar_t *)realloc(font->chars, alloc_chars * sizeof(hdfontchar_t))) == NULL)
+	{
+	  progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to allocate memory for font width file %s!", filename);
+	  break;
+	}
+
+        font->chars = fc;
+      }
+
+      fc = font->chars + font->num_chars;
+
+     /*
+      * Courier, Times, and Helvetica use the glyph name with the assigned
+      * charset while Symbol and Dingbats use their own encoding...
+      */
+
+      if (sscanf(line, "%*s%*s%*s%*s%d%*s%*s%63s", &fc->width, fc->name) != 2)
+        fc->name[0] = '\0';
+
+      if (sscanf(line, "%*s%d%*s%*s%d", &fc->code, &fc->width) != 2)
+        fc->code = -1;
+
+      if (fc->name[0] || fc->code >= 0)
+        font->num_chars ++;
+    }
+  }
+
+  fclose(fp);
+
+  font->have_metrics = 1;
+
+  return (1);
+}
+
+
 /*
  * 'write_type1()' - Write an embedded Type 1 font.
  */
 
 static int				/* O - Object number */
-write_type1(FILE       *out,		/* I - File to write to */
-            typeface_t typeface,	/* I - Typeface */
-	    style_t    style)		/* I - Style */
+write_type1(FILE        *out,		/* I - File to write to */
+            typeface_t  typeface,	/* I - Typeface */
+	    style_t     style,		/* I - Style */
+	    const uchar *chars,		/* I - Characters used */
+	    char        *name,		/* O - Font name for PDF */
+	    size_t      namesize)	/* I - Size of font name buffer */
 {
-  char		filename[1024];		/* PFA filename */
-  FILE		*fp;			/* PFA file */
+  hdfont_t	*font;			/* Font */
+  hdfontblob_t	*blob;			/* Serialized font program */
+  hdfontchar_t	*fc;			/* Current AFM character */
+  size_t	i;			/* Looping var */
   int		ch;			/* Character value */
-  int		width;			/* Width value */
-  char		glyph[64],		/* Glyph name */
-		line[1024],		/* Line from AFM file */
-		*lineptr,		/* Pointer into line */
-		*dataptr;		/* Pointer for data */
-  int		ascent,			/* Ascent above baseline */
-		cap_height,		/* Ascent of CAPITALS */
-		x_height,		/* Ascent of lowercase */
-		descent,		/* Decent below baseline */
-		bbox[4],		/* Bounding box */
-		italic_angle;		/* Angle for italics */
   int		widths[256];		/* Character widths */
-  int		length1,		/* Length1 value for font */
-		length2,		/* Length2 value for font */
-		length3;		/* Length3 value for font */
   static int	tflags[] =		/* PDF typeface flags */
 		{
 		  33,			/* Courier */
@@ -12562,19 +15714,18 @@ write_type1(FILE       *out,		/* I - File to write to */
   * sets.
   */
 
- /*
-  * Try to open the PFA file for the Type1 font...
-  */
-
-  snprintf(filename, sizeof(filename), "%s/fonts/%s.pfa", _htmlData,
-           _htmlFonts[typeface][style]);
-  if ((fp = fopen(filename, "r")) == NULL)
-  {
-#ifndef DEBUG
-    progress_error(HD_ERROR_FILE_NOT_FOUND,
-                   "Unable to open font file %s!", filename);
-#endif /* !DEBUG */
+  if ((font = font_get(typeface, style)) == NULL)
     return (0);
+
+  if ((blob = font_get_blob(font, typeface, style, chars)) == NULL)
+    return (0);
+
+  if (name)
+  {
+    if (blob->tag[0])
+      snprintf(name, namesize, "%s+%s", blob->tag, _htmlFonts[typeface][style]);
+    else
+      strlcpy(name, _htmlFonts[typeface][style], namesize);
   }
 
  /*
@@ -12587,204 +15738,85 @@ write_type1(FILE       *out,		/* I - File to write to */
     * Embed a Type1 font in the PostScript output...
     */
 
-    fprintf(out, "%%%%BeginResource: font %s\n", _htmlFonts[typeface][style]);
-
-    line[0] = '\0';
-
-    while (fgets(line, sizeof(line), fp) != NULL)
-      fputs(line, out);
-
-    if (line[0] && line[strlen(line) - 1] != '\n')
-      fputs("\n", out);
-
-    fputs("%%EndResource\n", out);
-
-    fclose(fp);
+    fwrite(blob->data, 1, blob->length, out);
   }
   else
   {
    /*
-    * Embed a Type1 font object in the PDF output...
+    * Embed a Type1 font object in the PDF output; the stream data is
+    * already compressed...
     */
 
-    length1 = 0;
-    length2 = 0;
-    length3 = 0;
-
-    while (fgets(line, sizeof(line), fp) != NULL)
-    {
-      length1 += strlen(line);
-      if (strstr(line, "currentfile eexec") != NULL)
-        break;
-    }
-
-    while (fgets(line, sizeof(line), fp) != NULL)
-    {
-      if (!strcmp(line, "00000000000000000000000000000000"
-                        "00000000000000000000000000000000\n"))
-        break;
-
-      length2 += (strlen(line) - 1) / 2;
-    }
-
-    length3 = strlen(line);
-    while (fgets(line, sizeof(line), fp) != NULL)
-      length3 += strlen(line);
-
-    rewind(fp);
-
     pdf_start_object(out);
-    fprintf(out, "/Length1 %d", length1);
-    fprintf(out, "/Length2 %d", length2);
-    fprintf(out, "/Length3 %d", length3);
+    fprintf(out, "/Length1 %d", blob->length1);
+    fprintf(out, "/Length2 %d", blob->length2);
+    fprintf(out, "/Length3 %d", blob->length3);
     if (Compression)
       fputs("/Filter/FlateDecode", out);
     pdf_start_stream(out);
-    flate_open_stream(out);
-
-    while (fgets(line, sizeof(line), fp) != NULL)
-    {
-      flate_puts(line, out);
-
-      if (strstr(line, "currentfile eexec") != NULL)
-        break;
-    }
-
-    while (fgets(line, sizeof(line), fp) != NULL)
-    {
-      if (!strcmp(line, "00000000000000000000000000000000"
-                        "00000000000000000000000000000000\n"))
-        break;
 
-      for (lineptr = line, dataptr = line; isxdigit(*lineptr); lineptr += 2)
-      {
-        if (isdigit(lineptr[0]))
-	  ch = (lineptr[0] - '0') << 4;
-	else
-	  ch = (tolower(lineptr[0] & 255) - 'a' + 10) << 4;
-
-        if (isdigit(lineptr[1]))
-	  ch |= lineptr[1] - '0';
-	else
-	  ch |= tolower(lineptr[1] & 255) - 'a' + 10;
-
-        *dataptr++ = (char)ch;
-      }
-
-      flate_write(out, (uchar *)line, dataptr - line);
-    }
-
-    flate_puts(line, out);
-    while (fgets(line, sizeof(line), fp) != NULL)
-      flate_puts(line, out);
+    if (Encryption)
+      encrypt_init();
 
-    flate_close_stream(out);
+    flate_write(out, blob->data, (int)blob->length);
 
     pdf_end_object(out);
 
-    fclose(fp);
-
-   /*
-    * Try to open the AFM file for the Type1 font...
-    */
-
-    snprintf(filename, sizeof(filename), "%s/fonts/%s.afm", _htmlData,
-             _htmlFonts[typeface][style]);
-    if ((fp = fopen(filename, "r")) == NULL)
-    {
-#ifndef DEBUG
-      progress_error(HD_ERROR_FILE_NOT_FOUND,
-                     "Unable to open font width file %s!", filename);
-#endif /* !DEBUG */
+    if (!font_get_metrics(font, typeface, style))
       return (0);
-    }
 
    /*
-    * Set the default values (Courier)...
+    * Get the character widths, defaulting to Courier...
     */
 
     for (ch = 0; ch < 256; ch ++)
       widths[ch] = 600;
 
-    ascent       = 629;
-    cap_height   = 562;
-    x_height     = 426;
-    descent      = -157;
-    bbox[0]      = -28;
-    bbox[1]      = -250;
-    bbox[2]      = 628;
-    bbox[3]      = 805;
-    italic_angle = 0;
-
-   /*
-    * Read the AFM file...
-    */
-
-    while (fgets(line, sizeof(line), fp) != NULL)
-    {
-      if (strncmp(line, "ItalicAngle ", 12) == 0)
-	italic_angle = atoi(line + 12);
-      else if (strncmp(line, "FontBBox ", 9) == 0)
-	sscanf(line + 9, "%d%d%d%d", bbox + 0, bbox + 1, bbox + 2, bbox + 3);
-      else if (strncmp(line, "CapHeight ", 10) == 0)
-	cap_height = atoi(line + 10);
-      else if (strncmp(line, "XHeight ", 8) == 0)
-	x_height = atoi(line + 8);
-      else if (strncmp(line, "Ascender ", 9) == 0)
-	ascent = atoi(line + 9);
-      else if (strncmp(line, "Descender ", 10) == 0)
-	descent = atoi(line + 10);
-      else if (strncmp(line, "C ", 2) == 0)
-      {
-	if (typeface < TYPE_SYMBOL)
-	{
-	 /*
-	  * Handle encoding of Courier, Times, and Helvetica using
-	  * assigned charset...
-	  */
-
-	  if (sscanf(line, "%*s%*s%*s%*s%d%*s%*s%63s", &width, glyph) != 2)
-	    continue;
+    for (i = font->num_chars, fc = font->chars; i > 0; i --, fc ++)
+    {
+      if (typeface < TYPE_SYMBOL)
+      {
+       /*
+	* Handle encoding of Courier, Times, and Helvetica using
+	* assigned charset...
+	*/
 
-	  for (ch = 0; ch < 256; ch ++)
-	    if (_htmlGlyphs[ch] && strcmp(_htmlGlyphs[ch], glyph) == 0)
-	      break;
+        if (!fc->name[0])
+	  continue;
 
-	  if (ch < 256)
-	    widths[ch] = width;
-	}
-	else
-	{
-	 /*
-	  * Symbol font uses its own encoding...
-	  */
+	for (ch = 0; ch < 256; ch ++)
+	  if (_htmlGlyphs[ch] && strcmp(_htmlGlyphs[ch], fc->name) == 0)
+	    break;
 
-	  if (sscanf(line, "%*s%d%*s%*s%d", &ch, &width) != 2)
-	    continue;
+	if (ch < 256)
+	  widths[ch] = fc->width;
+      }
+      else if (fc->code >= 0 && fc->code < 256)
+      {
+       /*
+	* Symbol font uses its own encoding...
+	*/
 
-	  if (ch >= 0 && ch < 256)
-	    widths[ch] = width;
-	}
+	widths[fc->code] = fc->width;
       }
     }
 
-    fclose(fp);
-
    /*
     * Write the font descriptor...
     */
 
     pdf_start_object(out);
     fputs("/Type/FontDescriptor", out);
-    fprintf(out, "/Ascent %d", ascent);
-    fprintf(out, "/Descent %d", descent);
-    fprintf(out, "/CapHeight %d", cap_height);
-    fprintf(out, "/XHeight %d", x_height);
-    fprintf(out, "/FontBBox[%d %d %d %d]", bbox[0], bbox[1], bbox[2], bbox[3]);
-    fprintf(out, "/ItalicAngle %d", italic_angle);
+    fprintf(out, "/Ascent %d", font->ascent);
+    fprintf(out, "/Descent %d", font->descent);
+    fprintf(out, "/CapHeight %d", font->cap_height);
+    fprintf(out, "/XHeight %d", font->x_height);
+    fprintf(out, "/FontBBox[%d %d %d %d]", font->bbox[0], font->bbox[1],
+            font->bbox[2], font->bbox[3]);
+    fprintf(out, "/ItalicAngle %d", font->italic_angle);
     fprintf(out, "/StemV %d", widths['v']);
     fprintf(out, "/Flags %d", tflags[typeface] | sflags[style]);
-    fprintf(out, "/FontName/%s", _htmlFonts[typeface][style]);
+    fprintf(out, "/FontName/%s", name ? name : _htmlFonts[typeface][style]);
     fprintf(out, "/FontFile %d 0 R", (int)num_objects - 1);
     pdf_end_object(out);
 
@@ -12887,6 +15919,18 @@ write_utf16(FILE  *out,			// I - File to write to
 
 static void
 encrypt_init(void)
+{
+  encrypt_setup(&encrypt_state, (int)num_objects);
+}
+
+
+/*
+ * 'encrypt_setup()' - Initialize a RC4 encryption context for an object.
+ */
+
+static void
+encrypt_setup(rc4_context_t *context,	/* I - RC4 context */
+              int           number)	/* I - Object number */
 {
   int		i;			/* Looping var */
   uchar		data[21],		/* Key data */
@@ -12902,9 +15946,9 @@ encrypt_init(void)
   for (i = 0, dataptr = data; i < encrypt_len; i ++)
     *dataptr++ = encrypt_key[i];
 
-  *dataptr++ = (uchar)num_objects;
-  *dataptr++ = (uchar)(num_objects >> 8);
-  *dataptr++ = (uchar)(num_objects >> 16);
+  *dataptr++ = (uchar)number;
+  *dataptr++ = (uchar)(number >> 8);
+  *dataptr++ = (uchar)(number >> 16);
   *dataptr++ = 0;
   *dataptr++ = 0;
 
@@ -12921,9 +15965,9 @@ encrypt_init(void)
   */
 
   if (encrypt_len > 11)
-    rc4_init(&encrypt_state, digest, 16);
+    rc4_init(context, digest, 16);
   else
-    rc4_init(&encrypt_state, digest, (size_t)(encrypt_len + 5));
+    rc4_init(context, digest, (size_t)(encrypt_len + 5));
 }
 
 
@@ -12932,7 +15976,8 @@ encrypt_init(void)
  */
 
 static void
-flate_open_stream(FILE *out)		/* I - Output file */
+flate_open_stream(FILE            *out,	/* I - Output file */
+                  hd_flate_type_t type)	/* I - Kind of stream */
 {
   if (Encryption && !PSLevel)
     encrypt_init();
@@ -12940,19 +15985,11 @@ flate_open_stream(FILE *out)		/* I - Output file */
   if (!Compression)
     return;
 
-  compressor_active = 1;
-  compressor.zalloc = (alloc_func)0;
-  compressor.zfree  = (free_func)0;
-  compressor.opaque = (voidpf)0;
-
-  if (deflateInit(&compressor, Compression) < Z_OK)
+  if ((compressor = hd_flate_new(type, (hd_flate_cb_t)flate_output, out)) == NULL)
   {
     progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to compress object in PDF file.");
     exit(1);
   }
-
-  compressor.next_out  = (Bytef *)comp_buffer;
-  compressor.avail_out = sizeof(comp_buffer);
 }
 
 
@@ -12963,8 +16000,7 @@ flate_open_stream(FILE *out)		/* I - Output file */
 static void
 flate_close_stream(FILE *out)		/* I - Output file */
 {
-  int	status;				/* Deflate status */
-
+  flate_flush(out);
 
   if (!Compression)
   {
@@ -12976,59 +16012,14 @@ flate_close_stream(FILE *out)		/* I - Output file */
     return;
   }
 
-  while ((status = deflate(&compressor, Z_FINISH)) != Z_STREAM_END)
-  {
-    if (status < Z_OK && status != Z_BUF_ERROR)
-    {
-      progress_error(HD_ERROR_OUT_OF_MEMORY, "deflate() failed (%d)", status);
-      return;
-    }
-
-    if (PSLevel)
-#ifdef HTMLDOC_ASCII85
-      ps_ascii85(out, comp_buffer,
-                 (uchar *)compressor.next_out - (uchar *)comp_buffer);
-#else
-      ps_hex(out, comp_buffer,
-             (uchar *)compressor.next_out - (uchar *)comp_buffer);
-#endif // HTMLDOC_ASCII85
-    else
-    {
-      if (Encryption)
-        rc4_encrypt(&encrypt_state, comp_buffer, comp_buffer,
-	            (uchar *)compressor.next_out - (uchar *)comp_buffer);
-
-      fwrite(comp_buffer, (size_t)((uchar *)compressor.next_out - (uchar *)comp_buffer), 1, out);
-    }
-
-    compressor.next_out  = (Bytef *)comp_buffer;
-    compressor.avail_out = sizeof(comp_buffer);
-  }
-
-  if ((uchar *)compressor.next_out > (uchar *)comp_buffer)
-  {
-    if (PSLevel)
-#ifdef HTMLDOC_ASCII85
-      ps_ascii85(out, comp_buffer,
-                 (uchar *)compressor.next_out - (uchar *)comp_buffer);
-#else
-      ps_hex(out, comp_buffer,
-             (uchar *)compressor.next_out - (uchar *)comp_buffer);
-#endif // HTMLDOC_ASCII85
-    else
-    {
-      if (Encryption)
-        rc4_encrypt(&encrypt_state, comp_buffer, comp_buffer,
-	            (uchar *)compressor.next_out - (uchar *)comp_buffer);
-
-      fwrite(comp_buffer, (size_t)((uchar *)compressor.next_out - (uchar *)comp_buffer), 1, out);
-    }
+  hd_stats_begin(HD_PHASE_COMPRESS);
 
-  }
+  if (!hd_flate_close(compressor))
+    progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to compress data.");
 
-  deflateEnd(&compressor);
+  hd_stats_end();
 
-  compressor_active = 0;
+  compressor = NULL;
 
 #ifdef HTMLDOC_ASCII85
   if (PSLevel)
@@ -13043,6 +16034,31 @@ flate_close_stream(FILE *out)		/* I - Output file */
 }
 
 
+/*
+ * 'flate_output()' - Write compressed data to the output file.
+ */
+
+static void
+flate_output(FILE   *out,		/* I - Output file */
+             uchar  *buf,		/* I - Compressed data */
+	     size_t length)		/* I - Number of bytes */
+{
+  if (PSLevel)
+#ifdef HTMLDOC_ASCII85
+    ps_ascii85(out, buf, (int)length);
+#else
+    ps_hex(out, buf, (int)length);
+#endif // HTMLDOC_ASCII85
+  else
+  {
+    if (Encryption)
+      rc4_encrypt(&encrypt_state, buf, buf, length);
+
+    fwrite(buf, length, 1, out);
+  }
+}
+
+
 /*
  * 'flate_puts()' - Write a character string to a compressed stream.
  */
@@ -13079,6 +16095,10 @@ flate_printf(FILE       *out,		/* I - Output file */
 
 /*
  * 'flate_write()' - Write data to a compressed stream.
+ *
+ * Small writes to a compressed or captured stream are collected in a buffer
+ * so the compressor sees larger blocks.  The buffer is sent before any write
+ * that flushes so the flushes happen in the same places.
  */
 
 static void
@@ -13087,49 +16107,69 @@ flate_write(FILE  *out,			/* I - Output file */
             int   length,		/* I - Number of bytes to write */
 	    int   flush)		/* I - Flush when writing data? */
 {
-  int	status;				/* Deflate status */
-
+  if (length <= 0)
+    return;
 
-  if (compressor_active)
+  if (compressor || comp_capture)
   {
-    compressor.next_in  = buf;
-    compressor.avail_in = (unsigned)length;
+    if (comp_bufused > 0 && (flush || (size_t)length > (sizeof(comp_buffer) - comp_bufused)))
+      flate_flush(out);
 
-    while (compressor.avail_in > 0)
+    if (!flush && (size_t)length < sizeof(comp_buffer))
     {
-      if (compressor.avail_out < (int)(sizeof(comp_buffer) / 8))
-      {
-	if (PSLevel)
-#ifdef HTMLDOC_ASCII85
-	  ps_ascii85(out, comp_buffer,
-                     (uchar *)compressor.next_out - (uchar *)comp_buffer);
-#else
-	  ps_hex(out, comp_buffer,
-                 (uchar *)compressor.next_out - (uchar *)comp_buffer);
-#endif // HTMLDOC_ASCII85
-	else
-	{
-	  if (Encryption)
-            rc4_encrypt(&encrypt_state, comp_buffer, comp_buffer,
-	        	(uchar *)compressor.next_out - (uchar *)comp_buffer);
+      memcpy(comp_buffer + comp_bufused, buf, (size_t)length);
+      comp_bufused += (size_t)length;
+      return;
+    }
+  }
 
-	  fwrite(comp_buffer, (size_t)((uchar *)compressor.next_out - (uchar *)comp_buffer), 1, out);
-	}
+  flate_send(out, buf, length, flush);
+}
 
-	compressor.next_out  = (Bytef *)comp_buffer;
-	compressor.avail_out = sizeof(comp_buffer);
-      }
 
-      status = deflate(&compressor, flush ? Z_FULL_FLUSH : Z_NO_FLUSH);
+/*
+ * 'flate_flush()' - Send any buffered data to the compressed stream.
+ */
 
-      if (status < Z_OK && status != Z_BUF_ERROR)
-      {
-	progress_error(HD_ERROR_OUT_OF_MEMORY, "deflate() failed (%d)", status);
-	return;
-      }
+static void
+flate_flush(FILE *out)			/* I - Output file */
+{
+  int	bytes = (int)comp_bufused;	/* Bytes in buffer */
 
-      flush = 0;
-    }
+
+  if (bytes > 0)
+  {
+    comp_bufused = 0;
+
+    flate_send(out, comp_buffer, bytes, 0);
+  }
+}
+
+
+/*
+ * 'flate_send()' - Send data to the compressor or output file.
+ */
+
+static void
+flate_send(FILE  *out,			/* I - Output file */
+           uchar *buf,			/* I - Buffer */
+           int   length,		/* I - Number of bytes to write */
+	   int   flush)			/* I - Flush when writing data? */
+{
+  if (comp_capture)
+  {
+    flate_capture(comp_capture, buf, length, flush);
+    return;
+  }
+
+  if (compressor)
+  {
+    hd_stats_begin(HD_PHASE_COMPRESS);
+
+    if (!hd_flate_write(compressor, buf, (size_t)length, flush))
+      progress_error(HD_ERROR_OUT_OF_MEMORY, "Unable to compress data.");
+
+    hd_stats_end();
   }
   else if (Encryption && !PSLevel)
   {
@@ -13156,3 +16196,146 @@ flate_write(FILE  *out,			/* I - Output file */
   else
     fwrite(buf, (size_t)length, 1, out);
 }
+
+
+/*
+ * 'flate_capture()' - Save data written to a page content stream.
+ *
+ * The length of each write is kept so that flate_stream() can repeat the
+ * full flushes that flate_write() would have made.
+ */
+
+static void
+flate_capture(hdstream_t *stream,	/* I - Content stream */
+              uchar      *buf,		/* I - Buffer */
+	      int        length,	/* I - Number of bytes to write */
+	      int        flush)		/* I - Flush when writing data? */
+{
+  size_t	alloc;			/* New allocation size */
+  void		*temp;			/* New buffer */
+
+
+  if (length <= 0 || stream->error)
+    return;
+
+  if ((stream->length + (size_t)length) > stream->alloc)
+  {
+    for (alloc = stream->alloc ? 2 * stream->alloc : 65536; alloc < (stream->length + (size_t)length); alloc *= 2);
+
+    if ((temp = realloc(stream->data, alloc)) == NULL)
+    {
+      stream->error = 1;
+      return;
+    }
+
+    stream->data  = (uchar *)temp;
+    stream->alloc = alloc;
+  }
+
+  if (stream->num_writes >= stream->alloc_writes)
+  {
+    alloc = stream->alloc_writes ? 2 * stream->alloc_writes : 1024;
+
+    if ((temp = realloc(stream->writes, alloc * sizeof(int))) == NULL)
+    {
+      stream->error = 1;
+      return;
+    }
+
+    stream->writes       = (int *)temp;
+    stream->alloc_writes = alloc;
+  }
+
+  memcpy(stream->data + stream->length, buf, (size_t)length);
+
+  stream->length += (size_t)length;
+  stream->writes[stream->num_writes ++] = flush ? -length : length;
+}
+
+
+/*
+ * 'flate_stream()' - Compress a captured content stream.
+ *
+ * This runs in a worker thread and must not touch any global state other
+ * than the compression settings.  Streams without flushes are compressed in
+ * a single call, which gives the same output as a series of writes.
+ */
+
+static void
+flate_stream(hdstream_t *stream)	/* I - Content stream */
+{
+  hd_flate_t	*f;			/* Compressor */
+  uchar		*ptr;			/* Pointer into content */
+  size_t	i;			/* Looping var */
+  int		length;			/* Length of write */
+
+
+  if (stream->error)
+    return;
+
+  for (i = 0; i < stream->num_writes; i ++)
+    if (stream->writes[i] < 0)
+      break;
+
+  if (i >= stream->num_writes)
+  {
+    if (!hd_flate_buffer(HD_FLATE_CONTENT, stream->data, stream->length, &stream->comp, &stream->comp_length))
+      stream->error = 1;
+
+    return;
+  }
+
+  if ((f = hd_flate_new(HD_FLATE_CONTENT, (hd_flate_cb_t)flate_stream_output, stream)) == NULL)
+  {
+    stream->error = 1;
+    return;
+  }
+
+  for (i = 0, ptr = stream->data; i < stream->num_writes; i ++, ptr += length)
+  {
+    if ((length = stream->writes[i]) < 0)
+    {
+      length = -length;
+
+      if (!hd_flate_write(f, ptr, (size_t)length, 1))
+        break;
+    }
+    else if (!hd_flate_write(f, ptr, (size_t)length, 0))
+      break;
+  }
+
+  if (!hd_flate_close(f))
+    stream->error = 1;
+}
+
+
+/*
+ * 'flate_stream_output()' - Add compressed data to a content stream.
+ */
+
+static void
+flate_stream_output(hdstream_t *stream,	/* I - Content stream */
+                    uchar      *buf,	/* I - Compressed data */
+		    size_t     length)	/* I - Number of bytes */
+{
+  size_t	alloc;			/* New allocation size */
+  uchar		*temp;			/* New buffer */
+
+
+  if ((stream->comp_length + length) > stream->comp_alloc)
+  {
+    for (alloc = stream->comp_alloc ? 2 * stream->comp_alloc : 16384; alloc < (stream->comp_length + length); alloc *= 2);
+
+    if ((temp = (uchar *)realloc(stream->comp, alloc)) == NULL)
+    {
+      stream->error = 1;
+      return;
+    }
+
+    stream->comp       = temp;
+    stream->comp_alloc = alloc;
+  }
+
+  memcpy(stream->comp + stream->comp_length, buf, length);
+  stream->comp_length += length;
+}
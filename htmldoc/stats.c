@@ -0,0 +1,369 @@
+/*
+ * Statistics functions for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "stats.h"
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef WIN32
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#  include <sys/resource.h>
+#endif /* WIN32 */
+
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif /* HAVE_PTHREAD_H */
+
+
+/*
+ * Local globals...
+ */
+
+#define HD_STATS_DEPTH	32		/* Maximum depth of nested phases */
+
+typedef struct hd_phase_stats_s		/* Statistics for a phase */
+{
+  size_t	calls;			/* Number of times phase was entered */
+  double	wall,			/* Elapsed time in seconds */
+		cpu;			/* Processor time in seconds */
+  size_t	allocs,			/* Memory arena allocations */
+		alloc_bytes;		/* Bytes allocated from memory arenas */
+} hd_phase_stats_t;
+
+int			hd_stats_enabled = 0;
+					/* Non-zero when collecting statistics */
+
+static const char * const stats_phases[HD_PHASE_MAX] =
+			{		/* Names of phases */
+			  "other",
+			  "fetch",
+			  "parse",
+			  "toc",
+			  "layout",
+			  "table",
+			  "image",
+			  "compress",
+			  "write"
+			};
+static const char * const stats_names[HD_COUNT_MAX] =
+			{		/* Names of counters */
+			  "allocs",
+			  "alloc_bytes",
+			  "pages",
+			  "render_primitives",
+			  "images",
+			  "fetch_bytes",
+			  "deflate_in_bytes",
+			  "deflate_out_bytes"
+			};
+static size_t		stats_counts[HD_COUNT_MAX];
+					/* Counters */
+static hd_phase_stats_t	stats_phase[HD_PHASE_MAX];
+					/* Statistics for each phase */
+static hd_phase_t	stats_stack[HD_STATS_DEPTH];
+					/* Stack of nested phases */
+static int		stats_depth = 0,/* Depth of stack */
+			stats_overflow = 0;
+					/* Phases not pushed on a full stack */
+static double		stats_start_wall,
+					/* Wall time at start */
+			stats_start_cpu,/* Processor time at start */
+			stats_last_wall,/* Wall time of last phase change */
+			stats_last_cpu;	/* Processor time of last phase change */
+static size_t		stats_last_allocs,
+					/* Allocations at last phase change */
+			stats_last_bytes;
+					/* Bytes allocated at last phase change */
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t	stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+					/* Lock for counters */
+static pthread_t	stats_thread;	/* Thread that tracks phases */
+#endif /* HAVE_PTHREAD_H */
+
+
+/*
+ * Local functions...
+ */
+
+static void	stats_times(double *wall, double *cpu);
+static void	stats_update(void);
+
+
+/*
+ * 'hd_stats_add()' - Add to a counter.
+ */
+
+void
+hd_stats_add(hd_count_t count,		/* I - Counter */
+             size_t     value)		/* I - Value to add */
+{
+  if (!hd_stats_enabled || count < HD_COUNT_ALLOCS || count >= HD_COUNT_MAX)
+    return;
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock(&stats_mutex);
+#endif /* HAVE_PTHREAD_H */
+
+  stats_counts[count] += value;
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock(&stats_mutex);
+#endif /* HAVE_PTHREAD_H */
+}
+
+
+/*
+ * 'hd_stats_begin()' - Start a phase.
+ *
+ * Phases are only tracked for the thread that called hd_stats_start().
+ * Each call must be matched by a call to hd_stats_end().
+ */
+
+void
+hd_stats_begin(hd_phase_t phase)	/* I - Phase */
+{
+  if (!hd_stats_enabled || phase < HD_PHASE_OTHER || phase >= HD_PHASE_MAX)
+    return;
+
+#ifdef HAVE_PTHREAD_H
+  if (!pthread_equal(pthread_self(), stats_thread))
+    return;
+#endif /* HAVE_PTHREAD_H */
+
+  if (stats_depth >= HD_STATS_DEPTH)
+  {
+    stats_overflow ++;
+    return;
+  }
+
+  stats_update();
+
+  stats_stack[stats_depth ++] = phase;
+  stats_phase[phase].calls ++;
+}
+
+
+/*
+ * 'hd_stats_end()' - Finish the current phase.
+ */
+
+void
+hd_stats_end(void)
+{
+  if (!hd_stats_enabled)
+    return;
+
+#ifdef HAVE_PTHREAD_H
+  if (!pthread_equal(pthread_self(), stats_thread))
+    return;
+#endif /* HAVE_PTHREAD_H */
+
+  if (stats_overflow > 0)
+  {
+    stats_overflow --;
+    return;
+  }
+
+  if (stats_depth > 0)
+  {
+    stats_update();
+    stats_depth --;
+  }
+}
+
+
+/*
+ * 'hd_stats_start()' - Start collecting statistics.
+ */
+
+void
+hd_stats_start(void)
+{
+  memset(stats_counts, 0, sizeof(stats_counts));
+  memset(stats_phase, 0, sizeof(stats_phase));
+
+  stats_depth       = 0;
+  stats_overflow    = 0;
+  stats_last_allocs = 0;
+  stats_last_bytes  = 0;
+
+  stats_times(&stats_start_wall, &stats_start_cpu);
+
+  stats_last_wall = stats_start_wall;
+  stats_last_cpu  = stats_start_cpu;
+
+#ifdef HAVE_PTHREAD_H
+  stats_thread = pthread_self();
+#endif /* HAVE_PTHREAD_H */
+
+  hd_stats_enabled = 1;
+}
+
+
+/*
+ * 'hd_stats_write()' - Write the statistics as a JSON object.
+ *
+ * Passing NULL or "-" writes to stderr.
+ */
+
+int					/* O - 1 on success, 0 on error */
+hd_stats_write(const char *filename)	/* I - File to write or NULL */
+{
+  FILE		*fp;			/* Output file */
+  int		i;			/* Looping var */
+  double	wall,			/* Current wall time */
+		cpu;			/* Current processor time */
+  long		maxrss = 0;		/* Peak memory use in kbytes */
+  int		status;			/* Write status */
+
+
+  if (!hd_stats_enabled)
+    return (0);
+
+  stats_update();
+  stats_times(&wall, &cpu);
+
+#ifndef WIN32
+  {
+    struct rusage	usage;		/* Resource usage */
+
+    if (!getrusage(RUSAGE_SELF, &usage))
+#  ifdef __APPLE__
+      maxrss = (long)(usage.ru_maxrss / 1024);
+#  else
+      maxrss = (long)usage.ru_maxrss;
+#  endif /* __APPLE__ */
+  }
+#endif /* !WIN32 */
+
+  if (!filename || !strcmp(filename, "-"))
+    fp = stderr;
+  else if ((fp = fopen(filename, "w")) == NULL)
+    return (0);
+
+  fprintf(fp, "{\n  \"version\": \"%s\",\n", SVERSION);
+  fprintf(fp, "  \"wall\": %.6f,\n", wall - stats_start_wall);
+  fprintf(fp, "  \"cpu\": %.6f,\n", cpu - stats_start_cpu);
+  fprintf(fp, "  \"max_rss_kbytes\": %ld,\n", maxrss);
+  fputs("  \"phases\": {\n", fp);
+
+  for (i = 0; i < HD_PHASE_MAX; i ++)
+    fprintf(fp, "    \"%s\": { \"calls\": %lu, \"wall\": %.6f, \"cpu\": %.6f, \"allocs\": %lu, \"alloc_bytes\": %lu }%s\n", stats_phases[i], (unsigned long)stats_phase[i].calls, stats_phase[i].wall, stats_phase[i].cpu, (unsigned long)stats_phase[i].allocs, (unsigned long)stats_phase[i].alloc_bytes, i < (HD_PHASE_MAX - 1) ? "," : "");
+
+  fputs("  },\n  \"counts\": {\n", fp);
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock(&stats_mutex);
+#endif /* HAVE_PTHREAD_H */
+
+  for (i = 0; i < HD_COUNT_MAX; i ++)
+    fprintf(fp, "    \"%s\": %lu%s\n", stats_names[i], (unsigned long)stats_counts[i], i < (HD_COUNT_MAX - 1) ? "," : "");
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock(&stats_mutex);
+#endif /* HAVE_PTHREAD_H */
+
+  fputs("  }\n}\n", fp);
+
+  status = !ferror(fp);
+
+  if (fp != stderr && fclose(fp))
+    status = 0;
+
+  return (status);
+}
+
+
+/*
+ * 'stats_times()' - Get the current wall and processor times.
+ */
+
+static void
+stats_times(double *wall,		/* O - Wall time in seconds */
+            double *cpu)		/* O - Processor time in seconds */
+{
+#ifdef WIN32
+  FILETIME	created,		/* Creation time */
+		exited,			/* Exit time */
+		kernel,			/* Kernel time */
+		user;			/* User time */
+
+
+  *wall = GetTickCount() * 0.001;
+
+  if (GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+    *cpu = ((((unsigned long long)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) + (((unsigned long long)user.dwHighDateTime << 32) | user.dwLowDateTime)) * 0.0000001;
+  else
+    *cpu = 0.0;
+
+#else
+  struct timeval	curtime;	/* Current time */
+  struct rusage		usage;		/* Resource usage */
+
+
+  gettimeofday(&curtime, NULL);
+
+  *wall = curtime.tv_sec + curtime.tv_usec * 0.000001;
+
+  if (!getrusage(RUSAGE_SELF, &usage))
+    *cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 0.000001 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 0.000001;
+  else
+    *cpu = 0.0;
+#endif /* WIN32 */
+}
+
+
+/*
+ * 'stats_update()' - Add the time and allocations since the last phase
+ *                    change to the current phase.
+ */
+
+static void
+stats_update(void)
+{
+  hd_phase_stats_t	*p;		/* Current phase */
+  double		wall,		/* Current wall time */
+			cpu;		/* Current processor time */
+  size_t		allocs,		/* Current allocations */
+			bytes;		/* Current bytes allocated */
+
+
+  p = stats_phase + (stats_depth > 0 ? stats_stack[stats_depth - 1] : HD_PHASE_OTHER);
+
+  stats_times(&wall, &cpu);
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock(&stats_mutex);
+#endif /* HAVE_PTHREAD_H */
+
+  allocs = stats_counts[HD_COUNT_ALLOCS];
+  bytes  = stats_counts[HD_COUNT_ALLOC_BYTES];
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock(&stats_mutex);
+#endif /* HAVE_PTHREAD_H */
+
+  p->wall        += wall - stats_last_wall;
+  p->cpu         += cpu - stats_last_cpu;
+  p->allocs      += allocs - stats_last_allocs;
+  p->alloc_bytes += bytes - stats_last_bytes;
+
+  stats_last_wall   = wall;
+  stats_last_cpu    = cpu;
+  stats_last_allocs = allocs;
+  stats_last_bytes  = bytes;
+}
@@ -0,0 +1,82 @@
+/*
+ * Statistics definitions for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+#ifndef _STATS_H_
+#  define _STATS_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include <stdlib.h>
+
+#  ifdef __cplusplus
+extern "C" {
+#  endif /* __cplusplus */
+
+
+/*
+ * Phases - time in a nested phase is only counted for the innermost one...
+ */
+
+typedef enum hd_phase_e			/**** Processing phases ****/
+{
+  HD_PHASE_OTHER,			/* Not in any other phase */
+  HD_PHASE_FETCH,			/* Fetching remote files */
+  HD_PHASE_PARSE,			/* Parsing HTML and Markdown files */
+  HD_PHASE_TOC,				/* Building the table of contents */
+  HD_PHASE_LAYOUT,			/* Formatting pages */
+  HD_PHASE_TABLE,			/* Formatting tables */
+  HD_PHASE_IMAGE,			/* Loading and decoding images */
+  HD_PHASE_COMPRESS,			/* Compressing streams */
+  HD_PHASE_WRITE,			/* Writing output files */
+  HD_PHASE_MAX
+} hd_phase_t;
+
+
+/*
+ * Counters - these can be updated from any thread...
+ */
+
+typedef enum hd_count_e			/**** Counters ****/
+{
+  HD_COUNT_ALLOCS,			/* Memory arena allocations */
+  HD_COUNT_ALLOC_BYTES,			/* Bytes allocated from memory arenas */
+  HD_COUNT_PAGES,			/* Formatted pages */
+  HD_COUNT_RENDERS,			/* Render primitives */
+  HD_COUNT_IMAGES,			/* Images loaded */
+  HD_COUNT_FETCH_BYTES,			/* Bytes fetched from remote servers */
+  HD_COUNT_DEFLATE_IN,			/* Bytes passed to the compressor */
+  HD_COUNT_DEFLATE_OUT,			/* Bytes from the compressor */
+  HD_COUNT_MAX
+} hd_count_t;
+
+
+/*
+ * Globals...
+ */
+
+extern int	hd_stats_enabled;	/* Non-zero when collecting statistics */
+
+
+/*
+ * Prototypes...
+ */
+
+extern void	hd_stats_add(hd_count_t count, size_t value);
+extern void	hd_stats_begin(hd_phase_t phase);
+extern void	hd_stats_end(void);
+extern void	hd_stats_start(void);
+extern int	hd_stats_write(const char *filename);
+
+#  ifdef __cplusplus
+}
+#  endif /* __cplusplus */
+
+#endif /* !_STATS_H_ */
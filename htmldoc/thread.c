@@ -0,0 +1,367 @@
+/*
+ * Thread pool functions for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "thread.h"
+#include "config.h"
+
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#  include <unistd.h>
+#endif /* HAVE_PTHREAD_H */
+
+
+/*
+ * Local globals...
+ */
+
+#define HD_POOL_MAX	64		/* Maximum number of worker threads */
+
+
+/*
+ * Local types...
+ */
+
+struct hd_job_s				/* Job */
+{
+  struct hd_job_s	*next;		/* Next job in queue */
+  hd_job_func_t		func;		/* Function to run */
+  void			*data;		/* Data for function */
+  int			done;		/* Has the job finished? */
+  hd_pool_t		*pool;		/* Pool that runs the job */
+};
+
+struct hd_pool_s			/* Thread pool */
+{
+  int			num_threads;	/* Number of worker threads */
+#ifdef HAVE_PTHREAD_H
+  pthread_t		threads[HD_POOL_MAX];
+					/* Worker threads */
+  pthread_mutex_t	mutex;		/* Lock for queue */
+  pthread_cond_t	queued,		/* Signalled when a job is queued */
+			finished;	/* Signalled when a job finishes */
+  hd_job_t		*first,		/* First job in queue */
+			*last;		/* Last job in queue */
+  int			shutdown;	/* Stop when the queue is empty? */
+#endif /* HAVE_PTHREAD_H */
+};
+
+struct hd_thread_s			/* Background thread */
+{
+#ifdef HAVE_PTHREAD_H
+  pthread_t		thread;		/* Thread */
+#endif /* HAVE_PTHREAD_H */
+  hd_job_func_t		func;		/* Function to run */
+  void			*data;		/* Data for function */
+};
+
+
+/*
+ * Local functions...
+ */
+
+#ifdef HAVE_PTHREAD_H
+static void	*run_jobs(hd_pool_t *pool);
+static void	*run_thread(hd_thread_t *thread);
+#endif /* HAVE_PTHREAD_H */
+
+
+/*
+ * 'hd_job_add()' - Add a job to a thread pool.
+ *
+ * The job must be passed to hd_job_wait() once its results are needed.
+ */
+
+hd_job_t *				/* O - Job or NULL on error */
+hd_job_add(hd_pool_t     *pool,		/* I - Thread pool */
+           hd_job_func_t func,		/* I - Function to run */
+	   void          *data)		/* I - Data for function */
+{
+  hd_job_t	*job;			/* New job */
+
+
+  if (!pool || !func)
+    return (NULL);
+
+  if ((job = (hd_job_t *)calloc(1, sizeof(hd_job_t))) == NULL)
+    return (NULL);
+
+  job->func = func;
+  job->data = data;
+  job->pool = pool;
+
+#ifdef HAVE_PTHREAD_H
+  if (pool->num_threads > 0)
+  {
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->last)
+      pool->last->next = job;
+    else
+      pool->first = job;
+
+    pool->last = job;
+
+    pthread_cond_signal(&pool->queued);
+    pthread_mutex_unlock(&pool->mutex);
+
+    return (job);
+  }
+#endif /* HAVE_PTHREAD_H */
+
+ /*
+  * No worker threads, run the job now...
+  */
+
+  (func)(data);
+  job->done = 1;
+
+  return (job);
+}
+
+
+/*
+ * 'hd_job_wait()' - Wait for a job to finish and free it.
+ */
+
+void
+hd_job_wait(hd_job_t *job)		/* I - Job */
+{
+  if (!job)
+    return;
+
+#ifdef HAVE_PTHREAD_H
+  if (job->pool->num_threads > 0)
+  {
+    pthread_mutex_lock(&job->pool->mutex);
+
+    while (!job->done)
+      pthread_cond_wait(&job->pool->finished, &job->pool->mutex);
+
+    pthread_mutex_unlock(&job->pool->mutex);
+  }
+#endif /* HAVE_PTHREAD_H */
+
+  free(job);
+}
+
+
+/*
+ * 'hd_pool_delete()' - Finish all queued jobs and free a thread pool.
+ */
+
+void
+hd_pool_delete(hd_pool_t *pool)		/* I - Thread pool */
+{
+#ifdef HAVE_PTHREAD_H
+  int	i;				/* Looping var */
+#endif /* HAVE_PTHREAD_H */
+
+
+  if (!pool)
+    return;
+
+#ifdef HAVE_PTHREAD_H
+  if (pool->num_threads > 0)
+  {
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->queued);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->num_threads; i ++)
+      pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->queued);
+    pthread_cond_destroy(&pool->finished);
+    pthread_mutex_destroy(&pool->mutex);
+  }
+#endif /* HAVE_PTHREAD_H */
+
+  free(pool);
+}
+
+
+/*
+ * 'hd_pool_new()' - Create a new thread pool.
+ *
+ * Passing 0 uses one thread per online processor.  A pool with fewer than
+ * two threads runs each job in the calling thread.
+ */
+
+hd_pool_t *				/* O - New thread pool or NULL */
+hd_pool_new(int num_threads)		/* I - Number of threads or 0 for auto */
+{
+  hd_pool_t	*pool;			/* New thread pool */
+
+
+  if ((pool = (hd_pool_t *)calloc(1, sizeof(hd_pool_t))) == NULL)
+    return (NULL);
+
+#ifdef HAVE_PTHREAD_H
+#  ifdef _SC_NPROCESSORS_ONLN
+  if (num_threads <= 0)
+    num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#  endif /* _SC_NPROCESSORS_ONLN */
+
+  if (num_threads > HD_POOL_MAX)
+    num_threads = HD_POOL_MAX;
+
+  if (num_threads < 2)
+    return (pool);
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->queued, NULL);
+  pthread_cond_init(&pool->finished, NULL);
+
+  for (pool->num_threads = 0; pool->num_threads < num_threads; pool->num_threads ++)
+    if (pthread_create(pool->threads + pool->num_threads, NULL, (void *(*)(void *))run_jobs, pool))
+      break;
+
+  if (pool->num_threads == 0)
+  {
+    pthread_cond_destroy(&pool->queued);
+    pthread_cond_destroy(&pool->finished);
+    pthread_mutex_destroy(&pool->mutex);
+  }
+
+#else
+  (void)num_threads;
+#endif /* HAVE_PTHREAD_H */
+
+  return (pool);
+}
+
+
+/*
+ * 'hd_pool_threads()' - Return the number of worker threads in a pool.
+ */
+
+int					/* O - Number of worker threads */
+hd_pool_threads(hd_pool_t *pool)	/* I - Thread pool */
+{
+  return (pool ? pool->num_threads : 0);
+}
+
+
+/*
+ * 'hd_thread_new()' - Run a function in a new thread.
+ *
+ * The thread must be passed to hd_thread_wait() once the function is done.
+ * NULL is returned when threads are not supported so the caller can run the
+ * function itself.
+ */
+
+hd_thread_t *				/* O - New thread or NULL */
+hd_thread_new(hd_job_func_t func,	/* I - Function to run */
+              void          *data)	/* I - Data for function */
+{
+#ifdef HAVE_PTHREAD_H
+  hd_thread_t	*thread;		/* New thread */
+
+
+  if (!func)
+    return (NULL);
+
+  if ((thread = (hd_thread_t *)calloc(1, sizeof(hd_thread_t))) == NULL)
+    return (NULL);
+
+  thread->func = func;
+  thread->data = data;
+
+  if (pthread_create(&thread->thread, NULL, (void *(*)(void *))run_thread, thread))
+  {
+    free(thread);
+    return (NULL);
+  }
+
+  return (thread);
+
+#else
+  (void)func;
+  (void)data;
+
+  return (NULL);
+#endif /* HAVE_PTHREAD_H */
+}
+
+
+/*
+ * 'hd_thread_wait()' - Wait for a thread to finish and free it.
+ */
+
+void
+hd_thread_wait(hd_thread_t *thread)	/* I - Thread */
+{
+  if (!thread)
+    return;
+
+#ifdef HAVE_PTHREAD_H
+  pthread_join(thread->thread, NULL);
+#endif /* HAVE_PTHREAD_H */
+
+  free(thread);
+}
+
+
+#ifdef HAVE_PTHREAD_H
+/*
+ * 'run_jobs()' - Run queued jobs until the pool is deleted.
+ */
+
+static void *				/* O - Thread exit status (unused) */
+run_jobs(hd_pool_t *pool)		/* I - Thread pool */
+{
+  hd_job_t	*job;			/* Current job */
+
+
+  pthread_mutex_lock(&pool->mutex);
+
+  for (;;)
+  {
+    while (!pool->first && !pool->shutdown)
+      pthread_cond_wait(&pool->queued, &pool->mutex);
+
+    if ((job = pool->first) == NULL)
+      break;
+
+    if ((pool->first = job->next) == NULL)
+      pool->last = NULL;
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    (job->func)(job->data);
+
+    pthread_mutex_lock(&pool->mutex);
+
+    job->done = 1;
+    pthread_cond_broadcast(&pool->finished);
+  }
+
+  pthread_mutex_unlock(&pool->mutex);
+
+  return (NULL);
+}
+
+
+/*
+ * 'run_thread()' - Run the function for a background thread.
+ */
+
+static void *				/* O - Thread exit status (unused) */
+run_thread(hd_thread_t *thread)		/* I - Thread */
+{
+  (thread->func)(thread->data);
+
+  return (NULL);
+}
+#endif /* HAVE_PTHREAD_H */
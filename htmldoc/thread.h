@@ -0,0 +1,59 @@
+/*
+ * Thread pool definitions for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+#ifndef _THREAD_H_
+#  define _THREAD_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include <stdlib.h>
+
+#  ifdef __cplusplus
+extern "C" {
+#  endif /* __cplusplus */
+
+
+/*
+ * Thread pool - a fixed set of worker threads that run jobs in the order
+ * they are added.  Without thread support jobs run as they are added...
+ */
+
+typedef struct hd_pool_s hd_pool_t;
+typedef struct hd_job_s hd_job_t;
+
+typedef void (*hd_job_func_t)(void *data);
+
+
+/*
+ * Threads - a single function run in the background until it returns.
+ * Without thread support no threads can be created...
+ */
+
+typedef struct hd_thread_s hd_thread_t;
+
+
+/*
+ * Prototypes...
+ */
+
+extern hd_job_t	*hd_job_add(hd_pool_t *pool, hd_job_func_t func, void *data);
+extern void	hd_job_wait(hd_job_t *job);
+extern void	hd_pool_delete(hd_pool_t *pool);
+extern hd_pool_t *hd_pool_new(int num_threads);
+extern int	hd_pool_threads(hd_pool_t *pool);
+extern hd_thread_t *hd_thread_new(hd_job_func_t func, void *data);
+extern void	hd_thread_wait(hd_thread_t *thread);
+
+#  ifdef __cplusplus
+}
+#  endif /* __cplusplus */
+
+#endif /* !_THREAD_H_ */
@@ -0,0 +1,450 @@
+/*
+ * Parsed document cache for HTMLDOC, a HTML document processing program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "htmldoc.h"
+#include "treecache.h"
+#include "md5-private.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+#ifdef WIN32
+#  include <io.h>
+#  include <direct.h>
+#else
+#  include <unistd.h>
+#endif // WIN32
+
+
+/*
+ * Cache file format - each cache file holds the parsed tree of one input
+ * file for one set of parsing options, which are described by the "key"
+ * string...
+ */
+
+typedef struct				// Cache file header
+{
+  char		magic[4];		// "HDTC"
+  unsigned	byteorder,		// HD_TREECACHE_BYTEORDER
+		key_length,		// Length of key + 1
+		num_depends,		// Number of dependencies
+		fonts;			// Font widths used, one bit per
+					// typeface and style
+  long long	size,			// Size of input file
+		mtime;			// Modification time of input file
+  unsigned char	md5[16];		// MD5 sum of input file
+} hd_treecache_header_t;
+
+typedef struct				// Dependency (image) information
+{
+  long long	size,			// Size of file
+		mtime;			// Modification time of file
+  unsigned	length;			// Length of filename + 1
+} hd_treecache_depend_t;
+
+#define HD_TREECACHE_BYTEORDER 0x01020304
+					// Native byte order check value
+
+
+/*
+ * Local globals...
+ */
+
+static char	treecache_dir[1024] = "";
+					// Cache directory
+
+
+/*
+ * Local functions...
+ */
+
+static int	get_depends(tree_t *t, FILE *fp, hd_treecache_header_t *header);
+static int	get_md5(const char *filename, unsigned char *md5);
+static void	get_name(const char *key, char *name, size_t namesize);
+static void	make_key(char *key, size_t keysize, const char *realname,
+		         const char *base);
+
+
+/*
+ * 'hd_treecache_init()' - Set the parsed document cache directory.
+ *
+ * The directory is created as needed.  Passing NULL or an empty string
+ * disables the cache.
+ */
+
+void
+hd_treecache_init(const char *directory)// I - Cache directory or NULL
+{
+  treecache_dir[0] = '\0';
+
+  if (!directory || !*directory)
+    return;
+
+#ifdef WIN32
+  if (access(directory, 0) && _mkdir(directory))
+#else
+  if (access(directory, 0) && mkdir(directory, 0700))
+#endif // WIN32
+  {
+    progress_error(HD_ERROR_WRITE_ERROR,
+                   "Unable to create tree cache directory \"%s\": %s",
+		   directory, strerror(errno));
+    return;
+  }
+
+  strlcpy(treecache_dir, directory, sizeof(treecache_dir));
+}
+
+
+/*
+ * 'hd_treecache_load()' - Load the cached tree of an input file.
+ *
+ * The cached tree is used when the key matches and the file has the same
+ * size and modification time or, failing that, the same MD5 sum, and the
+ * images it uses have not changed.
+ */
+
+int					// O - 1 if loaded, 0 otherwise
+hd_treecache_load(tree_t     *file,	// I - File node
+                  const char *filename,	// I - File/URL as given
+                  const char *realname,	// I - Local filename
+		  const char *base)	// I - Base directory
+{
+  FILE			*fp;		// Cache file
+  struct stat		fileinfo;	// Input file information
+  hd_treecache_header_t	header;		// Cache file header
+  hd_treecache_depend_t	depend;		// Dependency
+  unsigned		i;		// Looping var
+  unsigned char		md5[16];	// MD5 sum of input file
+  char			key[4096],	// Key string
+			name[1024],	// Cache filename
+			depname[1024];	// Dependency filename
+  int			status = 0;	// Load status
+
+
+  if (!treecache_dir[0] || file_method(filename) || stat(realname, &fileinfo))
+    return (0);
+
+  if (!_htmlInitialized)
+    htmlSetCharSet("iso-8859-1");
+
+  if (_htmlUTF8)
+    return (0);
+
+  make_key(key, sizeof(key), realname, base);
+  get_name(key, name, sizeof(name));
+
+  if ((fp = fopen(name, "rb")) == NULL)
+    return (0);
+
+  if (fread(&header, sizeof(header), 1, fp) != 1 ||
+      memcmp(header.magic, "HDTC", 4) ||
+      header.byteorder != HD_TREECACHE_BYTEORDER ||
+      header.key_length != (strlen(key) + 1) ||
+      header.size != (long long)fileinfo.st_size ||
+      fread(depname, 1, header.key_length, fp) != header.key_length ||
+      memcmp(depname, key, header.key_length))
+    goto done;
+
+  if (header.mtime != (long long)fileinfo.st_mtime)
+  {
+   /*
+    * The file has been touched, so see whether the content changed...
+    */
+
+    FILE *hfp;				// Header update file
+
+    if (!get_md5(realname, md5) || memcmp(md5, header.md5, sizeof(md5)))
+      goto done;
+
+    header.mtime = (long long)fileinfo.st_mtime;
+
+    if ((hfp = fopen(name, "r+b")) != NULL)
+    {
+      fwrite(&header, sizeof(header), 1, hfp);
+      fclose(hfp);
+    }
+  }
+
+  for (i = 0; i < header.num_depends; i ++)
+  {
+    struct stat depinfo;		// Dependency information
+
+    if (fread(&depend, sizeof(depend), 1, fp) != 1 ||
+        depend.length == 0 || depend.length > sizeof(depname) ||
+        fread(depname, 1, depend.length, fp) != depend.length ||
+	depname[depend.length - 1] ||
+	stat(depname, &depinfo) ||
+	depend.size != (long long)depinfo.st_size ||
+	depend.mtime != (long long)depinfo.st_mtime)
+      goto done;
+
+    image_load(depname, _htmlGrayscale);
+  }
+
+  if (htmlLoadTree(file, fp))
+    goto done;
+
+ /*
+  * Load the font widths like htmlReadFile() does...
+  */
+
+  for (i = 0; i < TYPE_MAX * STYLE_MAX; i ++)
+    if ((header.fonts & (1U << i)) && !_htmlWidthsLoaded[i / STYLE_MAX][i % STYLE_MAX])
+      htmlLoadFontWidths((int)i / STYLE_MAX, (int)i % STYLE_MAX);
+
+  status = 1;
+
+  done:
+
+  fclose(fp);
+
+  return (status);
+}
+
+
+/*
+ * 'hd_treecache_save()' - Save the tree of an input file in the cache.
+ *
+ * Files that embed other files or use remote or "data:" images are not
+ * cached since their trees depend on more than the local files.  UTF-8
+ * documents are not cached either since characters are mapped to 8-bit codes
+ * in the order they are first seen in a run.
+ */
+
+void
+hd_treecache_save(tree_t     *file,	// I - File node
+                  const char *filename,	// I - File/URL as given
+                  const char *realname,	// I - Local filename
+		  const char *base)	// I - Base directory
+{
+#ifndef WIN32
+  FILE			*fp;		// Cache file
+  int			fd;		// Cache file descriptor
+  struct stat		fileinfo;	// Input file information
+  hd_treecache_header_t	header;		// Cache file header
+  char			key[4096],	// Key string
+			name[1024],	// Cache filename
+			tempfile[1024];	// Temporary filename
+
+
+  if (!treecache_dir[0] || _htmlUTF8 || file_method(filename) ||
+      stat(realname, &fileinfo))
+    return;
+
+  memset(&header, 0, sizeof(header));
+
+  if (!get_md5(realname, header.md5))
+    return;
+
+  make_key(key, sizeof(key), realname, base);
+  get_name(key, name, sizeof(name));
+
+  memcpy(header.magic, "HDTC", 4);
+  header.byteorder  = HD_TREECACHE_BYTEORDER;
+  header.key_length = (unsigned)strlen(key) + 1;
+  header.size       = (long long)fileinfo.st_size;
+  header.mtime      = (long long)fileinfo.st_mtime;
+
+  snprintf(tempfile, sizeof(tempfile), "%s.XXXXXX", name);
+
+  if ((fd = mkstemp(tempfile)) < 0)
+    return;
+
+  fchmod(fd, 0600);
+
+  if ((fp = fdopen(fd, "wb")) == NULL)
+  {
+    close(fd);
+    unlink(tempfile);
+    return;
+  }
+
+ /*
+  * Write a placeholder header, then the key, dependencies, and tree...
+  */
+
+  if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+      fwrite(key, 1, header.key_length, fp) != header.key_length ||
+      !get_depends(file->child, fp, &header) ||
+      htmlSaveTree(file, fp) ||
+      fseek(fp, 0, SEEK_SET) ||
+      fwrite(&header, sizeof(header), 1, fp) != 1)
+  {
+    fclose(fp);
+    unlink(tempfile);
+    return;
+  }
+
+  if (fclose(fp) || rename(tempfile, name))
+    unlink(tempfile);
+#else
+  (void)file;
+  (void)filename;
+  (void)realname;
+  (void)base;
+#endif // !WIN32
+}
+
+
+/*
+ * 'get_depends()' - Write the images and find the fonts used by a tree.
+ */
+
+static int				// O  - 1 if cacheable, 0 otherwise
+get_depends(tree_t                *t,	// I  - Tree nodes
+            FILE                  *fp,	// I  - Cache file
+            hd_treecache_header_t *header)
+					// IO - Cache file header
+{
+  hd_treecache_depend_t	depend;		// Dependency
+  struct stat		depinfo;	// Dependency information
+  const char		*realsrc;	// Image file
+
+
+  for (; t; t = t->next)
+  {
+    if (t->markup == MARKUP_EMBED)
+      return (0);
+
+    if (t->markup == MARKUP_NONE)
+      header->fonts |= 1U << (t->typeface * STYLE_MAX + t->style);
+    else if (t->markup == MARKUP_IMG && htmlGetVariable(t, (uchar *)"SRC"))
+    {
+     /*
+      * Only cache local images, since temporary filenames change from run
+      * to run...
+      */
+
+      if ((realsrc = (const char *)htmlGetVariable(t, (uchar *)"REALSRC")) == NULL ||
+          strcmp(file_rlookup(realsrc), realsrc) ||
+	  stat(realsrc, &depinfo))
+        return (0);
+
+      depend.size   = (long long)depinfo.st_size;
+      depend.mtime  = (long long)depinfo.st_mtime;
+      depend.length = (unsigned)strlen(realsrc) + 1;
+
+      if (depend.length > 1024 ||
+          fwrite(&depend, sizeof(depend), 1, fp) != 1 ||
+          fwrite(realsrc, 1, depend.length, fp) != depend.length)
+        return (0);
+
+      header->num_depends ++;
+    }
+
+    if (t->child && !get_depends(t->child, fp, header))
+      return (0);
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'get_md5()' - Compute the MD5 sum of a file.
+ */
+
+static int				// O - 1 on success, 0 on error
+get_md5(const char    *filename,	// I - File to sum
+        unsigned char *md5)		// O - MD5 sum
+{
+  FILE			*fp;		// File
+  _cups_md5_state_t	state;		// MD5 state
+  unsigned char		buffer[65536];	// Read buffer
+  size_t		bytes;		// Bytes read
+
+
+  if ((fp = fopen(filename, "rb")) == NULL)
+    return (0);
+
+  _cupsMD5Init(&state);
+
+  while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    _cupsMD5Append(&state, buffer, (int)bytes);
+
+  _cupsMD5Finish(&state, md5);
+
+  if (ferror(fp))
+  {
+    fclose(fp);
+    return (0);
+  }
+
+  fclose(fp);
+
+  return (1);
+}
+
+
+/*
+ * 'get_name()' - Get the cache filename for a key.
+ */
+
+static void
+get_name(const char *key,		// I - Key string
+         char       *name,		// O - Filename
+	 size_t     namesize)		// I - Size of filename buffer
+{
+  int			i;		// Looping var
+  _cups_md5_state_t	state;		// MD5 state
+  unsigned char		sum[16];	// MD5 sum of key
+  char			hex[33];	// Hex version of sum
+  static const char	*hexdigits = "0123456789abcdef";
+					// Hex digits
+
+
+  _cupsMD5Init(&state);
+  _cupsMD5Append(&state, (const unsigned char *)key, (int)strlen(key));
+  _cupsMD5Finish(&state, sum);
+
+  for (i = 0; i < 16; i ++)
+  {
+    hex[2 * i]     = hexdigits[sum[i] >> 4];
+    hex[2 * i + 1] = hexdigits[sum[i] & 15];
+  }
+
+  hex[32] = '\0';
+
+  snprintf(name, namesize, "%s/%s.tree", treecache_dir, hex);
+}
+
+
+/*
+ * 'make_key()' - Make the key string for an input file.
+ *
+ * The key holds the filename and all of the settings that affect how a file
+ * is parsed or which errors are reported while parsing.
+ */
+
+static void
+make_key(char       *key,		// O - Key string
+         size_t     keysize,		// I - Size of key buffer
+         const char *realname,		// I - Local filename
+	 const char *base)		// I - Base directory
+{
+  int	i;				// Looping var
+  char	*ptr;				// Pointer into key
+
+
+  snprintf(key, keysize,
+           "HTMLDOC %s\nfile=%s\nbase=%s\npath=%s\ndatadir=%s\ncharset=%s\n"
+	   "ppi=%.4f\nbrowserwidth=%.1f\nfonts=%d,%d\ncolor=%02x%02x%02x\n"
+	   "gray=%d\nstrict=%d\nsizes=", SVERSION, realname, base, Path,
+	   _htmlData, _htmlCharSet, _htmlPPI, _htmlBrowserWidth, _htmlBodyFont,
+	   _htmlHeadingFont, _htmlTextColor[0], _htmlTextColor[1],
+	   _htmlTextColor[2], _htmlGrayscale, StrictHTML);
+
+  for (i = 0, ptr = key + strlen(key); i < 8; i ++, ptr += strlen(ptr))
+    snprintf(ptr, keysize - (size_t)(ptr - key), "%.2f/%.2f%s", _htmlSizes[i],
+             _htmlSpacings[i], i < 7 ? "," : "\n");
+}
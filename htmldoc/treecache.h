@@ -0,0 +1,31 @@
+/*
+ * Parsed document cache definitions for HTMLDOC, a HTML document processing
+ * program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+#ifndef _TREECACHE_H_
+#  define _TREECACHE_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include "html.h"
+
+
+/*
+ * Prototypes...
+ */
+
+extern void	hd_treecache_init(const char *directory);
+extern int	hd_treecache_load(tree_t *file, const char *filename,
+		                  const char *realname, const char *base);
+extern void	hd_treecache_save(tree_t *file, const char *filename,
+		                  const char *realname, const char *base);
+
+#endif /* !_TREECACHE_H_ */
@@ -0,0 +1,974 @@
+/*
+ * Type 1 font program functions for HTMLDOC, a HTML document processing
+ * program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "type1.h"
+#include "hdstring.h"
+#include <stdio.h>
+#include <ctype.h>
+
+
+/*
+ * Local globals...
+ */
+
+#define HD_TYPE1_EEXEC	55665		/* Initial key for eexec encryption */
+#define HD_TYPE1_CHARS	4330		/* Initial key for charstrings */
+
+static const char * const std_ascii[95] =
+{					/* StandardEncoding 32 to 126 */
+  "space", "exclam", "quotedbl", "numbersign", "dollar", "percent",
+  "ampersand", "quoteright", "parenleft", "parenright", "asterisk", "plus",
+  "comma", "hyphen", "period", "slash", "zero", "one", "two", "three", "four",
+  "five", "six", "seven", "eight", "nine", "colon", "semicolon", "less",
+  "equal", "greater", "question", "at", "A", "B", "C", "D", "E", "F", "G", "H",
+  "I", "J", "K", "L", "M", "N", "O", "P", "Q", "R", "S", "T", "U", "V", "W",
+  "X", "Y", "Z", "bracketleft", "backslash", "bracketright", "asciicircum",
+  "underscore", "quoteleft", "a", "b", "c", "d", "e", "f", "g", "h", "i", "j",
+  "k", "l", "m", "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y",
+  "z", "braceleft", "bar", "braceright", "asciitilde"
+};
+
+static const struct
+{
+  int			code;		/* Character code */
+  const char		*name;		/* Glyph name */
+}	std_high[] =			/* StandardEncoding 161 to 251 */
+{
+  { 161, "exclamdown" },	{ 162, "cent" },
+  { 163, "sterling" },		{ 164, "fraction" },
+  { 165, "yen" },		{ 166, "florin" },
+  { 167, "section" },		{ 168, "currency" },
+  { 169, "quotesingle" },	{ 170, "quotedblleft" },
+  { 171, "guillemotleft" },	{ 172, "guilsinglleft" },
+  { 173, "guilsinglright" },	{ 174, "fi" },
+  { 175, "fl" },		{ 177, "endash" },
+  { 178, "dagger" },		{ 179, "daggerdbl" },
+  { 180, "periodcentered" },	{ 182, "paragraph" },
+  { 183, "bullet" },		{ 184, "quotesinglbase" },
+  { 185, "quotedblbase" },	{ 186, "quotedblright" },
+  { 187, "guillemotright" },	{ 188, "ellipsis" },
+  { 189, "perthousand" },	{ 191, "questiondown" },
+  { 193, "grave" },		{ 194, "acute" },
+  { 195, "circumflex" },	{ 196, "tilde" },
+  { 197, "macron" },		{ 198, "breve" },
+  { 199, "dotaccent" },		{ 200, "dieresis" },
+  { 202, "ring" },		{ 203, "cedilla" },
+  { 205, "hungarumlaut" },	{ 206, "ogonek" },
+  { 207, "caron" },		{ 208, "emdash" },
+  { 225, "AE" },		{ 227, "ordfeminine" },
+  { 232, "Lslash" },		{ 233, "Oslash" },
+  { 234, "OE" },		{ 235, "ordmasculine" },
+  { 241, "ae" },		{ 245, "dotlessi" },
+  { 248, "lslash" },		{ 249, "oslash" },
+  { 250, "oe" },		{ 251, "germandbls" }
+};
+
+
+/*
+ * Local types...
+ */
+
+typedef struct type1_entry_s		/* Charstring or Subrs entry */
+{
+  size_t		start,		/* Start of entry, with leading space */
+			end,		/* End of entry */
+			name,		/* Offset of glyph name or Subrs index */
+			namelen,	/* Length of glyph name or index */
+			data,		/* Offset of charstring */
+			datalen,	/* Length of charstring */
+			rd,		/* Offset of "RD" token */
+			rdlen,		/* Length of "RD" token */
+			np;		/* Offset of "NP"/"ND" token(s) */
+  int			index,		/* Subrs index */
+			keep;		/* 0 = drop, 1 = keep, 2 = keep and scanned */
+} type1_entry_t;
+
+typedef struct type1_scan_s		/* Charstring scanning state */
+{
+  const unsigned char	*text;		/* Private dict */
+  size_t		lenIV;		/* Random bytes before charstrings */
+  type1_entry_t		*glyphs;	/* Charstrings */
+  int			num_glyphs;	/* Number of charstrings */
+  type1_entry_t		**subrs;	/* Subrs by index */
+  int			num_subrs;	/* Number of Subrs */
+  int			stack[24],	/* Charstring operand stack */
+			sp,		/* Charstring stack pointer */
+			ps[24],		/* PostScript operand stack */
+			psp;		/* PostScript stack pointer */
+} type1_scan_t;
+
+
+/*
+ * Local functions...
+ */
+
+static unsigned char	*type1_decrypt(const unsigned char *data, size_t length,
+			               unsigned key);
+static void		type1_encrypt(unsigned char *data, size_t length,
+			              unsigned key);
+static int		type1_entries(const unsigned char *text, size_t length,
+			              size_t *pos, int subrs,
+				      type1_entry_t **entries);
+static void		type1_keep(type1_scan_t *s, const char *name);
+static int		type1_number(const unsigned char *text, size_t length,
+			             size_t *pos, size_t *value);
+static int		type1_scan(type1_scan_t *s, type1_entry_t *e, int depth);
+static const char	*type1_standard(int code);
+static size_t		type1_token(const unsigned char *text, size_t length,
+			            size_t pos);
+
+
+/*
+ * 'hd_type1_delete()' - Free a Type 1 font program.
+ */
+
+void
+hd_type1_delete(hd_type1_t *font)	/* I - Font program */
+{
+  int	i;				/* Looping var */
+
+
+  if (!font)
+    return;
+
+  for (i = 0; i < 256; i ++)
+    free(font->encoding[i]);
+
+  free(font->clear);
+  free(font->data);
+  free(font);
+}
+
+
+/*
+ * 'hd_type1_load()' - Load a Type 1 font program from a PFA file.
+ */
+
+hd_type1_t *				/* O - Font program or NULL on error */
+hd_type1_load(const char *filename)	/* I - PFA file */
+{
+  FILE		*fp;			/* PFA file */
+  hd_type1_t	*font;			/* Font program */
+  long		size;			/* Size of file */
+  char		*text,			/* Contents of file */
+		*ptr,			/* Pointer into file */
+		*end,			/* End of file */
+		*line;			/* Start of current line */
+  unsigned char	*dataptr;		/* Pointer into encrypted data */
+  int		code,			/* Character code */
+		digits,			/* Number of hex digits */
+		value;			/* Byte value */
+  char		name[128];		/* Glyph name */
+
+
+  if ((fp = fopen(filename, "rb")) == NULL)
+    return (NULL);
+
+  if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET))
+  {
+    fclose(fp);
+    return (NULL);
+  }
+
+  if ((font = (hd_type1_t *)calloc(1, sizeof(hd_type1_t))) == NULL)
+  {
+    fclose(fp);
+    return (NULL);
+  }
+
+  if ((text = (char *)malloc((size_t)size + 1)) == NULL ||
+      fread(text, 1, (size_t)size, fp) != (size_t)size)
+  {
+    free(text);
+    free(font);
+    fclose(fp);
+    return (NULL);
+  }
+
+  fclose(fp);
+
+  text[size] = '\0';
+  end        = text + size;
+  font->clear = text;
+
+ /*
+  * The cleartext portion ends with the "currentfile eexec" line...
+  */
+
+  if ((ptr = strstr(text, "currentfile eexec")) == NULL ||
+      (ptr = strchr(ptr, '\n')) == NULL)
+  {
+    hd_type1_delete(font);
+    return (NULL);
+  }
+
+  ptr ++;
+  font->clear_length = (size_t)(ptr - text);
+
+ /*
+  * Grab the built-in encoding ("dup NNN /name put") of symbol fonts...
+  */
+
+  if ((line = strstr(text, "/Encoding")) != NULL && line < ptr &&
+      !strncmp(line, "/Encoding StandardEncoding", 26))
+    line = NULL;
+
+  while (line && (line = strstr(line, "dup ")) != NULL && line < ptr)
+  {
+    if (sscanf(line, "dup %d /%127s put", &code, name) == 2 &&
+        code >= 0 && code < 256 && !font->encoding[code])
+      font->encoding[code] = strdup(name);
+
+    line += 4;
+  }
+
+ /*
+  * Then convert the hex eexec data up to the line of zeros...
+  */
+
+  if ((font->data = (unsigned char *)malloc((size_t)(end - ptr) / 2 + 1)) == NULL)
+  {
+    hd_type1_delete(font);
+    return (NULL);
+  }
+
+  for (dataptr = font->data, digits = 0, value = 0; ptr < end; ptr ++)
+  {
+    if ((ptr == font->clear + font->clear_length || ptr[-1] == '\n') &&
+        !strncmp(ptr, "0000000000000000000000000000000000000000000000000000000000000000", 64))
+      break;
+
+    if (!isxdigit(*ptr & 255))
+      continue;
+
+    if (isdigit(*ptr & 255))
+      value = (value << 4) | (*ptr - '0');
+    else
+      value = (value << 4) | (tolower(*ptr & 255) - 'a' + 10);
+
+    if (++ digits == 2)
+    {
+      *dataptr++ = (unsigned char)value;
+      digits     = 0;
+      value      = 0;
+    }
+  }
+
+  font->data_length    = (size_t)(dataptr - font->data);
+  font->trailer        = ptr;
+  font->trailer_length = (size_t)(end - ptr);
+
+  return (font);
+}
+
+
+/*
+ * 'hd_type1_subset()' - Make a copy of a font program without unused glyphs.
+ *
+ * The ".notdef" glyph, the base and accent glyphs of kept accented ("seac")
+ * glyphs, and the Subrs they call are kept; unused Subrs are replaced by an
+ * empty subroutine so the remaining indices do not change.  Returns NULL if
+ * the font cannot be parsed.  The copy has no built-in encoding.
+ */
+
+hd_type1_t *				/* O - Subset font program or NULL */
+hd_type1_subset(const hd_type1_t *font,	/* I - Font program */
+                const char       **glyphs,
+					/* I - Names of glyphs to keep */
+		int              num_glyphs)
+					/* I - Number of glyph names */
+{
+  hd_type1_t	*sub;			/* Subset font program */
+  unsigned char	*text,			/* Decrypted Private dict */
+		*subset,		/* Subset Private dict */
+		*subptr,		/* Pointer into subset */
+		*cs;			/* Decrypted charstring */
+  size_t	length,			/* Length of Private dict */
+		pos,			/* Position in Private dict */
+		count_start,		/* Start of CharStrings count */
+		count_end,		/* End of CharStrings count */
+		first,			/* Start of first charstring */
+		last,			/* End of last charstring */
+		subrs_first,		/* Start of first Subrs entry */
+		subrs_last,		/* End of last Subrs entry */
+		value;			/* Number value */
+  type1_scan_t	s;			/* Scanning state */
+  type1_entry_t	*e,			/* Current entry */
+		*subrs;			/* Subrs entries */
+  int		i,			/* Looping var */
+		num_subrs,		/* Number of Subrs entries */
+		kept,			/* Number of charstrings kept */
+		changed;		/* Did we keep more glyphs? */
+  char		count[32];		/* New CharStrings count */
+
+
+  if (!font || !font->data || font->data_length < 4)
+    return (NULL);
+
+  length = font->data_length;
+
+  if ((text = type1_decrypt(font->data, length, HD_TYPE1_EEXEC)) == NULL)
+    return (NULL);
+
+  memset(&s, 0, sizeof(s));
+
+  s.text    = text;
+  s.lenIV   = 4;
+  subrs     = NULL;
+  num_subrs = 0;
+  subrs_first = subrs_last = 0;
+
+ /*
+  * Find the Subrs array and CharStrings dictionary...
+  */
+
+  for (pos = 0; pos + 6 < length; pos ++)
+    if (!memcmp(text + pos, "/lenIV", 6))
+    {
+      pos += 6;
+      if (!type1_number(text, length, &pos, &s.lenIV))
+        goto error;
+      break;
+    }
+
+  for (pos = 0; pos + 6 < length; pos ++)
+    if (!memcmp(text + pos, "/Subrs", 6))
+    {
+      pos += 6;
+
+      if (type1_number(text, length, &pos, &value) && value > 0 && value < 65536)
+      {
+        while (pos < length && isspace(text[pos]))
+	  pos ++;
+
+        subrs_first = pos = type1_token(text, length, pos);
+	num_subrs   = type1_entries(text, length, &pos, 1, &subrs);
+	subrs_last  = pos;
+
+        if (num_subrs > 0 &&
+	    (s.subrs = (type1_entry_t **)calloc(value, sizeof(type1_entry_t *))) != NULL)
+	{
+	  s.num_subrs = (int)value;
+
+	  for (i = 0, e = subrs; i < num_subrs; i ++, e ++)
+	    if (e->index >= 0 && e->index < s.num_subrs)
+	      s.subrs[e->index] = e;
+	}
+      }
+      break;
+    }
+
+  for (pos = 0; pos + 12 < length; pos ++)
+    if (!memcmp(text + pos, "/CharStrings", 12))
+      break;
+
+  if (pos + 12 >= length)
+    goto error;
+
+  pos += 12;
+
+  while (pos < length && isspace(text[pos]))
+    pos ++;
+
+  count_start = pos;
+
+  if (!type1_number(text, length, &pos, &value))
+    goto error;
+
+  count_end = pos;
+
+  for (; pos + 5 < length; pos ++)
+    if (!memcmp(text + pos, "begin", 5))
+      break;
+
+  if (pos + 5 >= length)
+    goto error;
+
+  first = pos += 5;
+
+  if ((s.num_glyphs = type1_entries(text, length, &pos, 0, &s.glyphs)) <= 0)
+    goto error;
+
+  last = pos;
+
+ /*
+  * Mark the glyphs to keep, then scan them for accented glyphs and Subrs...
+  */
+
+  type1_keep(&s, ".notdef");
+
+  for (i = 0; i < num_glyphs; i ++)
+    if (glyphs[i])
+      type1_keep(&s, glyphs[i]);
+
+  for (i = 0; i < 4 && i < s.num_subrs; i ++)
+    if (s.subrs[i])
+      s.subrs[i]->keep = 2;		/* Used by the flex and hint OtherSubrs */
+
+  do
+  {
+    for (i = 0, e = s.glyphs, changed = 0; i < s.num_glyphs; i ++, e ++)
+      if (e->keep == 1)
+      {
+        e->keep = 2;
+	changed = 1;
+	s.sp    = 0;
+	s.psp   = 0;
+
+	if (!type1_scan(&s, e, 0))
+	  goto error;
+      }
+  }
+  while (changed);
+
+ /*
+  * Copy the kept charstrings and Subrs to a new Private dict...
+  */
+
+  for (i = 0, kept = 0; i < s.num_glyphs; i ++)
+    if (s.glyphs[i].keep)
+      kept ++;
+
+  snprintf(count, sizeof(count), "%d", kept);
+
+  if ((subset = (unsigned char *)malloc(length + strlen(count) + 32 * (size_t)num_subrs)) == NULL)
+    goto error;
+
+  subptr = subset;
+
+  if (s.num_subrs > 0)
+  {
+    memcpy(subptr, text, subrs_first);
+    subptr += subrs_first;
+
+    for (i = 0, e = subrs; i < num_subrs; i ++, e ++)
+    {
+      if (e->keep)
+      {
+        memcpy(subptr, text + e->start, e->end - e->start);
+	subptr += e->end - e->start;
+	continue;
+      }
+
+     /*
+      * Replace unused Subrs with "return", keeping the random bytes...
+      */
+
+      if ((cs = type1_decrypt(text + e->data, e->datalen, HD_TYPE1_CHARS)) == NULL)
+      {
+        free(subset);
+	goto error;
+      }
+
+      memcpy(subptr, text + e->start, e->name + e->namelen - e->start);
+      subptr += e->name + e->namelen - e->start;
+      subptr += snprintf((char *)subptr, 32, " %d ", (int)s.lenIV + 1);
+      memcpy(subptr, text + e->rd, e->rdlen);
+      subptr += e->rdlen;
+      *subptr++ = ' ';
+
+      memcpy(subptr, cs, s.lenIV);
+      subptr[s.lenIV] = 11;
+      type1_encrypt(subptr, s.lenIV + 1, HD_TYPE1_CHARS);
+      subptr += s.lenIV + 1;
+
+      memcpy(subptr, text + e->data + e->datalen, e->end - e->data - e->datalen);
+      subptr += e->end - e->data - e->datalen;
+
+      free(cs);
+    }
+
+    memcpy(subptr, text + subrs_last, count_start - subrs_last);
+    subptr += count_start - subrs_last;
+  }
+  else
+  {
+    memcpy(subptr, text, count_start);
+    subptr += count_start;
+  }
+
+  memcpy(subptr, count, strlen(count));
+  subptr += strlen(count);
+  memcpy(subptr, text + count_end, first - count_end);
+  subptr += first - count_end;
+
+  for (i = 0, e = s.glyphs; i < s.num_glyphs; i ++, e ++)
+    if (e->keep)
+    {
+      memcpy(subptr, text + e->start, e->end - e->start);
+      subptr += e->end - e->start;
+    }
+
+  memcpy(subptr, text + last, length - last);
+  subptr += length - last;
+
+  type1_encrypt(subset, (size_t)(subptr - subset), HD_TYPE1_EEXEC);
+
+ /*
+  * Copy the cleartext and trailer to the new font program...
+  */
+
+  if ((sub = (hd_type1_t *)calloc(1, sizeof(hd_type1_t))) == NULL ||
+      (sub->clear = (char *)malloc(font->clear_length + font->trailer_length + 1)) == NULL)
+  {
+    free(sub);
+    free(subset);
+    goto error;
+  }
+
+  memcpy(sub->clear, font->clear, font->clear_length);
+  memcpy(sub->clear + font->clear_length, font->trailer, font->trailer_length);
+
+  sub->clear_length   = font->clear_length;
+  sub->data           = subset;
+  sub->data_length    = (size_t)(subptr - subset);
+  sub->trailer        = sub->clear + font->clear_length;
+  sub->trailer_length = font->trailer_length;
+
+  sub->trailer[sub->trailer_length] = '\0';
+
+  free(s.glyphs);
+  free(s.subrs);
+  free(subrs);
+  free(text);
+
+  return (sub);
+
+ /*
+  * If we get here the font could not be parsed...
+  */
+
+  error:
+
+  free(s.glyphs);
+  free(s.subrs);
+  free(subrs);
+  free(text);
+
+  return (NULL);
+}
+
+
+/*
+ * 'type1_decrypt()' - Decrypt eexec or charstring data.
+ */
+
+static unsigned char *			/* O - Decrypted copy or NULL */
+type1_decrypt(
+    const unsigned char *data,		/* I - Encrypted data */
+    size_t              length,		/* I - Length of data */
+    unsigned            key)		/* I - Initial key */
+{
+  unsigned char	*text;			/* Decrypted data */
+  size_t	i;			/* Looping var */
+
+
+  if ((text = (unsigned char *)malloc(length + 1)) == NULL)
+    return (NULL);
+
+  for (i = 0; i < length; i ++)
+  {
+    text[i] = (unsigned char)(data[i] ^ (key >> 8));
+    key     = ((data[i] + key) * 52845 + 22719) & 65535;
+  }
+
+  text[length] = '\0';
+
+  return (text);
+}
+
+
+/*
+ * 'type1_encrypt()' - Encrypt eexec or charstring data in place.
+ */
+
+static void
+type1_encrypt(unsigned char *data,	/* I - Data to encrypt */
+              size_t        length,	/* I - Length of data */
+	      unsigned      key)	/* I - Initial key */
+{
+  size_t	i;			/* Looping var */
+
+
+  for (i = 0; i < length; i ++)
+  {
+    data[i] = (unsigned char)(data[i] ^ (key >> 8));
+    key     = ((data[i] + key) * 52845 + 22719) & 65535;
+  }
+}
+
+
+/*
+ * 'type1_entries()' - Read the entries of the Subrs array or CharStrings dict.
+ *
+ * Subrs entries look like "dup index length RD <binary> NP" and CharStrings
+ * entries look like "/name length RD <binary> ND".
+ */
+
+static int				/* O  - Number of entries or -1 on error */
+type1_entries(
+    const unsigned char *text,		/* I  - Private dict */
+    size_t              length,		/* I  - Length of Private dict */
+    size_t              *pos,		/* IO - Position in Private dict */
+    int                 subrs,		/* I  - 1 for Subrs, 0 for CharStrings */
+    type1_entry_t       **entries)	/* O  - Entries */
+{
+  type1_entry_t	*e;			/* Current entry */
+  int		num_entries,		/* Number of entries */
+		alloc_entries;		/* Allocated entries */
+  size_t	i,			/* Position in Private dict */
+		last,			/* End of previous entry */
+		value;			/* Number value */
+
+
+  *entries      = NULL;
+  num_entries   = 0;
+  alloc_entries = 0;
+
+  for (i = last = *pos; i < length; last = i)
+  {
+    while (i < length && isspace(text[i]))
+      i ++;
+
+    if (subrs ? (i + 4 > length || memcmp(text + i, "dup", 3) || !isspace(text[i + 3])) :
+                (i >= length || text[i] != '/'))
+      break;
+
+    if (num_entries >= alloc_entries)
+    {
+      alloc_entries += 256;
+
+      if ((e = (type1_entry_t *)realloc(*entries, (size_t)alloc_entries * sizeof(type1_entry_t))) == NULL)
+        goto error;
+
+      *entries = e;
+    }
+
+    e = *entries + num_entries;
+
+    memset(e, 0, sizeof(type1_entry_t));
+
+    e->start = last;
+    e->index = -1;
+
+    if (subrs)
+    {
+      i += 3;
+
+      while (i < length && isspace(text[i]))
+	i ++;
+
+      e->name = i;
+
+      if (!type1_number(text, length, &i, &value))
+        goto error;
+
+      e->index = (int)value;
+    }
+    else
+    {
+      e->name = i + 1;
+      i       = type1_token(text, length, i);
+    }
+
+    e->namelen = i - e->name;
+
+    if (!type1_number(text, length, &i, &e->datalen))
+      goto error;
+
+    while (i < length && isspace(text[i]))
+      i ++;
+
+    e->rd    = i;
+    i        = type1_token(text, length, i);
+    e->rdlen = i - e->rd;
+    e->data  = ++ i;
+
+    if (e->rdlen == 0 || i + e->datalen > length)
+      goto error;
+
+    i += e->datalen;
+
+    while (i < length && isspace(text[i]))
+      i ++;
+
+    e->np = i;
+    i     = type1_token(text, length, i);
+
+    if (i - e->np == 8 && !memcmp(text + e->np, "noaccess", 8))
+    {
+      while (i < length && isspace(text[i]))
+	i ++;
+
+      i = type1_token(text, length, i);
+    }
+
+    e->end = i;
+
+    num_entries ++;
+  }
+
+  *pos = last;
+
+  return (num_entries);
+
+ /*
+  * If we get here there was a parse error...
+  */
+
+  error:
+
+  free(*entries);
+  *entries = NULL;
+
+  return (-1);
+}
+
+
+/*
+ * 'type1_keep()' - Mark a glyph to keep.
+ */
+
+static void
+type1_keep(type1_scan_t *s,		/* I - Scanning state */
+	   const char   *name)		/* I - Glyph name */
+{
+  int		i;			/* Looping var */
+  type1_entry_t	*e;			/* Current charstring */
+  size_t	namelen = strlen(name);	/* Length of name */
+
+
+  for (i = s->num_glyphs, e = s->glyphs; i > 0; i --, e ++)
+    if (e->namelen == namelen && !memcmp(s->text + e->name, name, namelen))
+    {
+      if (!e->keep)
+        e->keep = 1;
+      break;
+    }
+}
+
+
+/*
+ * 'type1_number()' - Read an unsigned integer.
+ */
+
+static int				/* O  - 1 on success, 0 on error */
+type1_number(const unsigned char *text,	/* I  - Private dict */
+             size_t              length,/* I  - Length of Private dict */
+	     size_t              *pos,	/* IO - Position in Private dict */
+	     size_t              *value)/* O  - Value */
+{
+  size_t	i = *pos;		/* Position in Private dict */
+
+
+  while (i < length && isspace(text[i]))
+    i ++;
+
+  if (i >= length || !isdigit(text[i]))
+    return (0);
+
+  for (*value = 0; i < length && isdigit(text[i]); i ++)
+    *value = *value * 10 + (size_t)(text[i] - '0');
+
+  *pos = i;
+
+  return (1);
+}
+
+
+/*
+ * 'type1_scan()' - Find the glyphs and Subrs used by a charstring.
+ *
+ * Only the operators that pass numbers to callsubr, seac, and the OtherSubrs
+ * are interpreted; every other operator clears the stack.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+type1_scan(type1_scan_t  *s,		/* I - Scanning state */
+           type1_entry_t *e,		/* I - Charstring or Subrs entry */
+	   int           depth)		/* I - Subroutine depth */
+{
+  unsigned char	*cs;			/* Decrypted charstring */
+  size_t	i,			/* Position in charstring */
+		len;			/* Length of number */
+  int		n,			/* Number of OtherSubr arguments */
+		value;			/* Number value */
+  const char	*base,			/* Base glyph of accented glyph */
+		*accent;		/* Accent glyph of accented glyph */
+  type1_entry_t	*subr;			/* Called Subrs entry */
+
+
+  if (e->datalen <= s->lenIV || depth > 10)
+    return (1);
+
+  if ((cs = type1_decrypt(s->text + e->data, e->datalen, HD_TYPE1_CHARS)) == NULL)
+    return (0);
+
+  for (i = s->lenIV; i < e->datalen;)
+  {
+    if (cs[i] >= 32)
+    {
+     /*
+      * Push a number...
+      */
+
+      len = cs[i] <= 246 ? 1 : cs[i] <= 254 ? 2 : 5;
+
+      if (i + len > e->datalen)
+        break;
+
+      if (cs[i] <= 246)
+	value = cs[i] - 139;
+      else if (cs[i] <= 250)
+	value = (cs[i] - 247) * 256 + cs[i + 1] + 108;
+      else if (cs[i] <= 254)
+	value = -(cs[i] - 251) * 256 - cs[i + 1] - 108;
+      else
+	value = (int)(((unsigned)cs[i + 1] << 24) | ((unsigned)cs[i + 2] << 16) | ((unsigned)cs[i + 3] << 8) | cs[i + 4]);
+
+      if (s->sp < (int)(sizeof(s->stack) / sizeof(s->stack[0])))
+        s->stack[s->sp ++] = value;
+
+      i += len;
+    }
+    else if (cs[i] == 10)
+    {
+     /*
+      * callsubr...
+      */
+
+      i ++;
+
+      if (s->sp < 1)
+        continue;
+
+      value = s->stack[-- s->sp];
+
+      if (value >= 0 && value < s->num_subrs && (subr = s->subrs[value]) != NULL)
+      {
+        if (!subr->keep)
+	  subr->keep = 2;
+
+        if (!type1_scan(s, subr, depth + 1))
+	{
+	  free(cs);
+	  return (0);
+	}
+      }
+    }
+    else if (cs[i] == 11 || cs[i] == 14)
+    {
+     /*
+      * return or endchar...
+      */
+
+      break;
+    }
+    else if (cs[i] == 12 && i + 1 < e->datalen)
+    {
+      switch (cs[i + 1])
+      {
+        case 6 :			/* seac - asb adx ady bchar achar */
+	    if (s->sp >= 5 && (base = type1_standard(s->stack[3])) != NULL &&
+		(accent = type1_standard(s->stack[4])) != NULL)
+	    {
+	      type1_keep(s, base);
+	      type1_keep(s, accent);
+	    }
+
+	    i = e->datalen;
+	    break;
+
+        case 12 :			/* div - a b div */
+	    if (s->sp >= 2)
+	    {
+	      s->sp --;
+	      s->stack[s->sp - 1] = s->stack[s->sp] ? s->stack[s->sp - 1] / s->stack[s->sp] : 0;
+	    }
+	    break;
+
+        case 16 :			/* callothersubr - args n othersubr# */
+	    if (s->sp >= 2)
+	    {
+	      s->sp -= 2;
+	      n     = s->stack[s->sp];
+
+	      for (; n > 0 && s->sp > 0; n --)
+	        if (s->psp < (int)(sizeof(s->ps) / sizeof(s->ps[0])))
+		  s->ps[s->psp ++] = s->stack[-- s->sp];
+		else
+		  s->sp --;
+	    }
+	    break;
+
+        case 17 :			/* pop - get result of OtherSubr */
+	    if (s->sp < (int)(sizeof(s->stack) / sizeof(s->stack[0])))
+	      s->stack[s->sp ++] = s->psp > 0 ? s->ps[-- s->psp] : 0;
+	    break;
+
+        default :
+	    s->sp = 0;
+	    break;
+      }
+
+      i += 2;
+    }
+    else
+    {
+      s->sp = 0;
+      i ++;
+    }
+  }
+
+  free(cs);
+
+  return (1);
+}
+
+
+/*
+ * 'type1_standard()' - Return the StandardEncoding glyph for a code.
+ */
+
+static const char *			/* O - Glyph name or NULL */
+type1_standard(int code)		/* I - Character code */
+{
+  size_t	i;			/* Looping var */
+
+
+  if (code >= 32 && code <= 126)
+    return (std_ascii[code - 32]);
+
+  for (i = 0; i < sizeof(std_high) / sizeof(std_high[0]); i ++)
+    if (std_high[i].code == code)
+      return (std_high[i].name);
+
+  return (NULL);
+}
+
+
+/*
+ * 'type1_token()' - Skip a token.
+ */
+
+static size_t				/* O - Position after token */
+type1_token(const unsigned char *text,	/* I - Private dict */
+            size_t              length,	/* I - Length of Private dict */
+	    size_t              pos)	/* I - Start of token */
+{
+  while (pos < length && !isspace(text[pos]))
+    pos ++;
+
+  return (pos);
+}
@@ -0,0 +1,55 @@
+/*
+ * Type 1 font program definitions for HTMLDOC, a HTML document processing
+ * program.
+ *
+ * Copyright 2011-2023 by Michael R Sweet.
+ *
+ * This program is free software.  Distribution and use rights are outlined in
+ * the file "COPYING".
+ */
+
+#ifndef _TYPE1_H_
+#  define _TYPE1_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include <stdlib.h>
+
+#  ifdef __cplusplus
+extern "C" {
+#  endif /* __cplusplus */
+
+
+/*
+ * Type 1 font program - the three parts of a PFA file, with the eexec
+ * portion converted from hex to binary...
+ */
+
+typedef struct hd_type1_s
+{
+  char			*clear;		/* Cleartext portion */
+  size_t		clear_length;	/* Length of cleartext portion */
+  unsigned char		*data;		/* Encrypted portion (binary) */
+  size_t		data_length;	/* Length of encrypted portion */
+  char			*trailer;	/* Zeros and cleartomark */
+  size_t		trailer_length;	/* Length of trailer */
+  char			*encoding[256];	/* Built-in encoding, if not standard */
+} hd_type1_t;
+
+
+/*
+ * Prototypes...
+ */
+
+extern void	hd_type1_delete(hd_type1_t *font);
+extern hd_type1_t *hd_type1_load(const char *filename);
+extern hd_type1_t *hd_type1_subset(const hd_type1_t *font,
+		                   const char **glyphs, int num_glyphs);
+
+#  ifdef __cplusplus
+}
+#  endif /* __cplusplus */
+
+#endif /* !_TYPE1_H_ */
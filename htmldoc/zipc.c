@@ -76,12 +76,28 @@
 #define ZIPC_EXTERNAL_FILE 0x81a40000	/* External attributes = file */
 
 #define ZIPC_READ_SIZE     8192         /* Size of buffered read buffer */
+#define ZIPC_PROBE_SIZE    32768        /* Bytes deflated before deciding whether compression pays off */
+#define ZIPC_CHUNK_SIZE    131072       /* Bytes deflated by each job */
+#define ZIPC_DICT_SIZE     32768        /* Bytes of preset dictionary for each job */
 
 
 /*
  * Local types...
  */
 
+typedef struct _zipc_chunk_s		/* Chunk of a file deflated by a job */
+{
+  void		*job;			/* Job that is deflating the chunk */
+  int		last;			/* Last chunk of the file? */
+  int		error;			/* zlib error, if any */
+  size_t	dict_length;		/* Length of preset dictionary */
+  unsigned char	dict[ZIPC_DICT_SIZE];	/* End of the previous chunk */
+  size_t	length;			/* Length of uncompressed data */
+  unsigned char	data[ZIPC_CHUNK_SIZE];	/* Uncompressed data */
+  size_t	comp_length;		/* Length of compressed data */
+  unsigned char	*comp;			/* Compressed data */
+} zipc_chunk_t;
+
 struct _zipc_s
 {
   FILE		*fp;			/* ZIP file */
@@ -94,6 +110,16 @@ struct _zipc_s
   z_stream	stream;			/* Deflate stream for current file */
   unsigned int	modtime;		/* MS-DOS modification date/time */
   char		buffer[16384];		/* Deflate buffer */
+  unsigned char	*probe;			/* Compression probe buffer (input + output) */
+  int		num_jobs;		/* Number of worker jobs for deflate */
+  zipc_job_add_cb_t job_add_cb;		/* Start job callback */
+  zipc_job_wait_cb_t job_wait_cb;	/* Wait for job callback */
+  void		*job_ctx;		/* Job callback context */
+  zipc_chunk_t	*chunk,			/* Chunk being filled */
+		**chunks;		/* Chunks being deflated, oldest first */
+  size_t	num_chunks;		/* Number of chunks being deflated */
+  size_t	deflate_in,		/* Bytes of deflated files */
+		deflate_out;		/* Bytes written for deflated files */
 #ifndef ZIPC_ONLY_WRITE
   char          *readbuffer,            /* Read buffer */
                 *readptr,               /* Current character in read buffer */
@@ -116,6 +142,9 @@ struct _zipc_file_s
   size_t        local_size;             /* Size of local header */
   size_t        compressed_pos;         /* Current read position in stream */
   size_t        uncompressed_pos;       /* Current read position in file */
+  int		probing;		/* Still deciding between store and deflate? */
+  size_t	probe_length;		/* Number of bytes in probe buffer */
+  int		chunked;		/* Deflating chunks with worker jobs? */
 };
 
 
@@ -133,6 +162,11 @@ static void             zipc_xml_unescape(char *buffer);
 #endif /* !ZIPC_ONLY_WRITE */
 #ifndef ZIPC_ONLY_READ
 static zipc_file_t	*zipc_add_file(zipc_t *zc, const char *filename, int compression);
+static void		zipc_chunk_deflate(zipc_chunk_t *chunk);
+static int		zipc_chunk_start(zipc_t *zc, zipc_file_t *zf, int last);
+static int		zipc_chunk_write(zipc_t *zc, zipc_file_t *zf);
+static int		zipc_finish_probe(zipc_t *zc, zipc_file_t *zf, int flush);
+static int		zipc_is_compressed(const char *filename);
 static int		zipc_write(zipc_t *zc, const void *buffer, size_t bytes);
 static int		zipc_write_dir_header(zipc_t *zc, zipc_file_t *zf);
 static int		zipc_write_local_header(zipc_t *zc, zipc_file_t *zf);
@@ -195,6 +229,12 @@ zipcClose(zipc_t *zc)			/* I - ZIP container */
   if (fclose(zc->fp))
     status = -1;
 
+  if (zc->probe)
+    free(zc->probe);
+
+  if (zc->chunks)
+    free(zc->chunks);
+
   if (zc->alloc_files)
     free(zc->files);
 
@@ -212,7 +252,7 @@ zipcClose(zipc_t *zc)			/* I - ZIP container */
  * container with the name "dstname".
  *
  * The "compressed" value determines whether the file is compressed within the
- * container.
+ * container - see @link zipcCreateFile@.
  */
 
 int                                     /* O - 0 on success, -1 on error */
@@ -220,7 +260,7 @@ zipcCopyFile(zipc_t *zc,                /* I - ZIP container */
              const char *dstname,       /* I - Destination file (in ZIP container) */
              const char *srcname,       /* I - Source file (on disk) */
              int        text,           /* I - 0 for binary, 1 for text */
-             int        compressed)     /* I - 0 for uncompressed, 1 for compressed */
+             int        compressed)     /* I - `ZIPC_STORED`, `ZIPC_DEFLATED`, or `ZIPC_AUTO` */
 {
   zipc_file_t   *dstfile;               /* Destination file */
   FILE          *srcfile;               /* Source file */
@@ -333,14 +373,18 @@ zipcCreateDirectory(
  * separated by the forward slash ("/").
  *
  * The "compressed" value determines whether the file is compressed within the
- * container.
+ * container.  `ZIPC_STORED` (0) stores the file as-is and `ZIPC_DEFLATED` (1)
+ * always compresses it.  `ZIPC_AUTO` stores files whose extension shows they
+ * are already compressed (PNG, JPEG, GIF, etc.) and compresses everything
+ * else, falling back to storing the file when the first 32k of data does not
+ * shrink by at least 1/16th.
  */
 
 zipc_file_t *				/* I - ZIP container file */
 zipcCreateFile(
     zipc_t     *zc,			/* I - ZIP container */
     const char *filename,		/* I - Filename in container */
-    int        compressed)		/* I - 0 for uncompressed, 1 for compressed */
+    int        compressed)		/* I - `ZIPC_STORED`, `ZIPC_DEFLATED`, or `ZIPC_AUTO` */
 {
   zipc_file_t	*zf;    		/* ZIP container file */
 
@@ -355,10 +399,43 @@ zipcCreateFile(
   * Add the file and write the header...
   */
 
-  zf = zipc_add_file(zc, filename, compressed);
+  if (compressed == ZIPC_AUTO)
+  {
+    if (zipc_is_compressed(filename))
+      compressed = ZIPC_STORED;
+    else if (!zc->probe && (zc->probe = malloc(2 * ZIPC_PROBE_SIZE)) == NULL)
+      compressed = ZIPC_DEFLATED;
+  }
+
+  if ((zf = zipc_add_file(zc, filename, compressed != ZIPC_STORED)) == NULL)
+    return (NULL);
+
   zf->flags |= ZIPC_FLAG_STREAMED;
   zf->external_attrs = ZIPC_EXTERNAL_FILE;
 
+  if (compressed == ZIPC_DEFLATED && zc->num_jobs > 0 && (zc->chunk = malloc(sizeof(zipc_chunk_t))) != NULL)
+  {
+   /*
+    * Deflate chunks of the file with the worker jobs...
+    */
+
+    deflateEnd(&zc->stream);
+
+    zc->chunk->length      = 0;
+    zc->chunk->dict_length = 0;
+    zf->chunked            = 1;
+  }
+  else if (compressed == ZIPC_AUTO)
+  {
+   /*
+    * Buffer the start of the file; the local header is written once we know
+    * which compression method wins...
+    */
+
+    zf->probing = 1;
+    return (zf);
+  }
+
   if (zipc_write_local_header(zc, zf))
     return (NULL);
   else
@@ -436,7 +513,24 @@ zipcFileFinish(zipc_file_t *zf)		/* I - ZIP container file */
 #ifndef ZIPC_ONLY_READ
   if (zc->mode == 'w')
   {
-    if (zf->method != ZIPC_COMP_STORE)
+    if (zf->probing)
+      status |= zipc_finish_probe(zc, zf, Z_FINISH);
+
+    if (zf->chunked)
+    {
+     /*
+      * Deflate the last chunk and write all of the chunks in order...
+      */
+
+      if (zipc_chunk_start(zc, zf, 1))
+        status = -1;
+
+      while (zc->num_chunks > 0)
+        status |= zipc_chunk_write(zc, zf);
+
+      zf->chunked = 0;
+    }
+    else if (zf->method != ZIPC_COMP_STORE)
     {
       int zstatus;			/* Deflate status */
 
@@ -465,6 +559,12 @@ zipcFileFinish(zipc_file_t *zf)		/* I - ZIP container file */
       deflateEnd(&zc->stream);
     }
 
+    if (zf->method == ZIPC_COMP_DEFLATE)
+    {
+      zc->deflate_in  += zf->uncompressed_size;
+      zc->deflate_out += zf->compressed_size;
+    }
+
     status |= zipc_write_local_trailer(zc, zf);
   }
 #endif /* !ZIPC_ONLY_READ */
@@ -671,6 +771,65 @@ zipcFileWrite(zipc_file_t *zf,		/* I - ZIP container file */
   zf->uncompressed_size += bytes;
   zf->crc32             = crc32(zf->crc32, (const Bytef *)data, (unsigned)bytes);
 
+  if (zf->chunked)
+  {
+   /*
+    * Fill chunks for the worker jobs...
+    */
+
+    while (bytes > 0)
+    {
+      size_t count;			/* Bytes to copy */
+
+      if (!zc->chunk)
+        return (-1);
+
+      count = ZIPC_CHUNK_SIZE - zc->chunk->length;
+
+      if (count > bytes)
+        count = bytes;
+
+      memcpy(zc->chunk->data + zc->chunk->length, data, count);
+      zc->chunk->length += count;
+
+      data  = (const char *)data + count;
+      bytes -= count;
+
+      if (zc->chunk->length == ZIPC_CHUNK_SIZE && zipc_chunk_start(zc, zf, 0))
+        return (-1);
+    }
+
+    return (0);
+  }
+
+  if (zf->probing)
+  {
+   /*
+    * Fill the probe buffer before deciding how to store the file...
+    */
+
+    size_t count = ZIPC_PROBE_SIZE - zf->probe_length;
+					/* Bytes to copy */
+
+    if (count > bytes)
+      count = bytes;
+
+    memcpy(zc->probe + zf->probe_length, data, count);
+    zf->probe_length += count;
+
+    if (zf->probe_length < ZIPC_PROBE_SIZE)
+      return (0);
+
+    if (zipc_finish_probe(zc, zf, Z_SYNC_FLUSH))
+      return (-1);
+
+    data  = (const char *)data + count;
+    bytes -= count;
+
+    if (bytes == 0)
+      return (0);
+  }
+
   if (zf->method == ZIPC_COMP_STORE)
   {
    /*
@@ -1248,6 +1407,60 @@ zipcOpenFile(zipc_t     *zc,            /* I - ZIP container */
 }
 
 
+#ifndef ZIPC_ONLY_READ
+/*
+ * 'zipcGetStats()' - Get the number of bytes deflated so far.
+ *
+ * Only files that are finished and stored with deflate compression are
+ * counted.
+ */
+
+void
+zipcGetStats(zipc_t *zc,		/* I - ZIP container */
+             size_t *deflate_in,	/* O - Bytes passed to deflate */
+             size_t *deflate_out)	/* O - Bytes from deflate */
+{
+  *deflate_in  = zc->deflate_in;
+  *deflate_out = zc->deflate_out;
+}
+
+
+/*
+ * 'zipcSetJobs()' - Deflate files using worker jobs.
+ *
+ * When "num_jobs" is 1 or more, files created with `ZIPC_DEFLATED` are split
+ * into 128k chunks that are deflated by jobs started with the "add_cb"
+ * callback, up to twice "num_jobs" chunks at a time.  Each chunk is primed
+ * with the end of the previous chunk, and the compressed chunks are written
+ * in order, so the output only depends on the data and not on the number of
+ * jobs.  Pass 0 to deflate each file as a single stream.
+ */
+
+void
+zipcSetJobs(
+    zipc_t             *zc,		/* I - ZIP container */
+    int                num_jobs,	/* I - Number of worker jobs */
+    zipc_job_add_cb_t  add_cb,		/* I - Start job callback */
+    zipc_job_wait_cb_t wait_cb,		/* I - Wait for job callback */
+    void               *ctx)		/* I - Callback context */
+{
+  if (zc->chunks)
+  {
+    free(zc->chunks);
+    zc->chunks = NULL;
+  }
+
+  zc->num_jobs    = 0;
+  zc->job_add_cb  = add_cb;
+  zc->job_wait_cb = wait_cb;
+  zc->job_ctx     = ctx;
+
+  if (num_jobs > 0 && add_cb && wait_cb && (zc->chunks = calloc(2 * (size_t)num_jobs, sizeof(zipc_chunk_t *))) != NULL)
+    zc->num_jobs = num_jobs;
+}
+#endif /* !ZIPC_ONLY_READ */
+
+
 /*
  * 'zipcXMLGetAttribute()' - Get the value of an attribute in an XML fragment.
  *
@@ -1430,6 +1643,289 @@ zipc_add_file(zipc_t     *zc,		/* I - ZIP container */
 
   return (temp);
 }
+
+
+/*
+ * 'zipc_chunk_deflate()' - Deflate a chunk of a file.
+ *
+ * This function runs in a worker job.  Chunks other than the last one end
+ * with a sync flush so that the compressed chunks can be concatenated.
+ */
+
+static void
+zipc_chunk_deflate(zipc_chunk_t *chunk)	/* I - Chunk */
+{
+  z_stream	stream;			/* Deflate stream */
+  size_t	alloc;			/* Allocated size of compressed data */
+  unsigned char	*temp;			/* New compressed data buffer */
+  int		flush = chunk->last ? Z_FINISH : Z_SYNC_FLUSH;
+					/* Flush mode */
+  int		zstatus;		/* Deflate status */
+
+
+  memset(&stream, 0, sizeof(stream));
+
+  if ((zstatus = deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)) < Z_OK)
+  {
+    chunk->error = zstatus;
+    return;
+  }
+
+  if (chunk->dict_length > 0)
+    deflateSetDictionary(&stream, chunk->dict, (uInt)chunk->dict_length);
+
+  alloc = deflateBound(&stream, (uLong)chunk->length) + 16;
+
+  if ((chunk->comp = malloc(alloc)) == NULL)
+  {
+    chunk->error = Z_MEM_ERROR;
+    deflateEnd(&stream);
+    return;
+  }
+
+  stream.next_in   = chunk->data;
+  stream.avail_in  = (uInt)chunk->length;
+  stream.next_out  = chunk->comp;
+  stream.avail_out = (uInt)alloc;
+
+  for (;;)
+  {
+    if ((zstatus = deflate(&stream, flush)) < Z_OK && zstatus != Z_BUF_ERROR)
+    {
+      chunk->error = zstatus;
+      break;
+    }
+
+    if (zstatus == Z_STREAM_END || (flush == Z_SYNC_FLUSH && stream.avail_in == 0 && stream.avail_out > 0))
+      break;
+
+   /*
+    * Out of room, grow the compressed data buffer...
+    */
+
+    if ((temp = realloc(chunk->comp, 2 * alloc)) == NULL)
+    {
+      chunk->error = Z_MEM_ERROR;
+      break;
+    }
+
+    chunk->comp      = temp;
+    stream.next_out  = temp + alloc - stream.avail_out;
+    stream.avail_out += (uInt)alloc;
+    alloc            *= 2;
+  }
+
+  chunk->comp_length = (size_t)(stream.next_out - chunk->comp);
+
+  deflateEnd(&stream);
+}
+
+
+/*
+ * 'zipc_chunk_start()' - Start deflating the current chunk of a file.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+zipc_chunk_start(zipc_t      *zc,	/* I - ZIP container */
+                 zipc_file_t *zf,	/* I - ZIP container file */
+                 int         last)	/* I - Last chunk of the file? */
+{
+  int		status = 0;		/* Return status */
+  zipc_chunk_t	*chunk = zc->chunk,	/* Chunk to deflate */
+		*next = NULL;		/* Next chunk */
+
+
+  if (!chunk)
+    return (-1);
+
+ /*
+  * Make room for the chunk...
+  */
+
+  if (zc->num_chunks >= 2 * (size_t)zc->num_jobs)
+    status |= zipc_chunk_write(zc, zf);
+
+ /*
+  * Prime the next chunk with the end of this one...
+  */
+
+  if (!last)
+  {
+    if ((next = malloc(sizeof(zipc_chunk_t))) == NULL)
+    {
+      zc->error = strerror(errno);
+      status    = -1;
+    }
+    else
+    {
+      next->length      = 0;
+      next->dict_length = chunk->length < ZIPC_DICT_SIZE ? chunk->length : ZIPC_DICT_SIZE;
+
+      memcpy(next->dict, chunk->data + chunk->length - next->dict_length, next->dict_length);
+    }
+  }
+
+ /*
+  * Then start deflating it...
+  */
+
+  chunk->last        = last;
+  chunk->error       = Z_OK;
+  chunk->comp        = NULL;
+  chunk->comp_length = 0;
+
+  if ((chunk->job = (zc->job_add_cb)(zc->job_ctx, (zipc_job_func_t)zipc_chunk_deflate, chunk)) == NULL)
+    zipc_chunk_deflate(chunk);
+
+  zc->chunks[zc->num_chunks ++] = chunk;
+  zc->chunk                     = next;
+
+  return (status);
+}
+
+
+/*
+ * 'zipc_chunk_write()' - Wait for the oldest chunk and write it.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+zipc_chunk_write(zipc_t      *zc,	/* I - ZIP container */
+                 zipc_file_t *zf)	/* I - ZIP container file */
+{
+  int		status = 0;		/* Return status */
+  zipc_chunk_t	*chunk = zc->chunks[0];	/* Oldest chunk */
+
+
+  if (chunk->job)
+    (zc->job_wait_cb)(chunk->job);
+
+  if (chunk->error < Z_OK)
+  {
+    zc->error = zipc_zlib_status(chunk->error);
+    status    = -1;
+  }
+  else
+  {
+    status |= zipc_write(zc, chunk->comp, chunk->comp_length);
+    zf->compressed_size += chunk->comp_length;
+  }
+
+  free(chunk->comp);
+  free(chunk);
+
+  zc->num_chunks --;
+  memmove(zc->chunks, zc->chunks + 1, zc->num_chunks * sizeof(zipc_chunk_t *));
+
+  return (status);
+}
+
+
+/*
+ * 'zipc_finish_probe()' - Choose between storing and deflating a file.
+ *
+ * The buffered start of the file is deflated into a buffer that is 1/16th
+ * smaller than the input.  If the output does not fit, compression is not
+ * worth the CPU and the file is stored instead.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+zipc_finish_probe(zipc_t      *zc,	/* I - ZIP container */
+                  zipc_file_t *zf,	/* I - ZIP container file */
+                  int         flush)	/* I - `Z_SYNC_FLUSH` or `Z_FINISH` */
+{
+  int		status = 0;		/* Return status */
+  int		zstatus;		/* Deflate status */
+  Bytef		*out = zc->probe + ZIPC_PROBE_SIZE;
+					/* Compressed probe data */
+  size_t	outsize = zf->probe_length - zf->probe_length / 16;
+					/* Largest acceptable compressed size */
+
+
+  zf->probing = 0;
+
+  zc->stream.next_in   = zc->probe;
+  zc->stream.avail_in  = (unsigned)zf->probe_length;
+  zc->stream.next_out  = out;
+  zc->stream.avail_out = (unsigned)outsize;
+
+  zstatus = deflate(&zc->stream, flush);
+
+  if (zstatus < Z_OK && zstatus != Z_BUF_ERROR)
+  {
+    zc->error = zipc_zlib_status(zstatus);
+    return (-1);
+  }
+
+  if (zc->stream.avail_in > 0 || zc->stream.avail_out == 0 || (flush == Z_FINISH && zstatus != Z_STREAM_END))
+  {
+   /*
+    * Poor ratio, store the file...
+    */
+
+    deflateEnd(&zc->stream);
+
+    zf->flags           &= ~ZIPC_FLAG_CMAX;
+    zf->method          = ZIPC_COMP_STORE;
+    zf->compressed_size = zf->probe_length;
+
+    status |= zipc_write_local_header(zc, zf);
+    status |= zipc_write(zc, zc->probe, zf->probe_length);
+  }
+  else
+  {
+   /*
+    * Good ratio, keep deflating...
+    */
+
+    zf->compressed_size = outsize - zc->stream.avail_out;
+
+    status |= zipc_write_local_header(zc, zf);
+    status |= zipc_write(zc, out, zf->compressed_size);
+
+    zc->stream.next_out  = (Bytef *)zc->buffer;
+    zc->stream.avail_out = sizeof(zc->buffer);
+  }
+
+  return (status);
+}
+
+
+/*
+ * 'zipc_is_compressed()' - Determine whether a file is already compressed
+ *                          based on its extension.
+ */
+
+static int				/* O - 1 if compressed, 0 otherwise */
+zipc_is_compressed(const char *filename)/* I - Filename in container */
+{
+  const char	*ext;			/* Filename extension */
+  char		temp[8],		/* Lowercase extension */
+		*tempptr;		/* Pointer into extension */
+  size_t	i;			/* Looping var */
+  static const char * const exts[] =	/* Compressed formats */
+  {
+    "docx", "epub", "gif", "gz", "jpeg", "jpg", "m4a", "mp3", "mp4", "odt",
+    "otf", "png", "webp", "woff", "woff2", "xz", "zip"
+  };
+
+
+  if ((ext = strrchr(filename, '.')) == NULL || strchr(ext, '/'))
+    return (0);
+
+  for (ext ++, tempptr = temp; *ext && tempptr < (temp + sizeof(temp) - 1); ext ++)
+    *tempptr++ = (char)tolower(*ext & 255);
+
+  if (*ext)
+    return (0);
+
+  *tempptr = '\0';
+
+  for (i = 0; i < (sizeof(exts) / sizeof(exts[0])); i ++)
+    if (!strcmp(temp, exts[i]))
+      return (1);
+
+  return (0);
+}
 #endif /* !ZIPC_ONLY_READ */
 
 
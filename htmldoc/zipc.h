@@ -51,6 +51,28 @@ typedef struct _zipc_s zipc_t;		/* ZIP container */
 typedef struct _zipc_file_s zipc_file_t;/* File/directory in ZIP container */
 
 
+/*
+ * Compression modes for zipcCopyFile and zipcCreateFile...
+ */
+
+#  define ZIPC_STORED	0		/* Store the file uncompressed */
+#  define ZIPC_DEFLATED	1		/* Always deflate the file */
+#  define ZIPC_AUTO	2		/* Store already-compressed media, deflate
+					 * everything else unless it won't shrink */
+
+
+/*
+ * Callbacks for deflating files with worker threads, see zipcSetJobs...
+ */
+
+typedef void (*zipc_job_func_t)(void *data);
+					/* Function run by a job */
+typedef void *(*zipc_job_add_cb_t)(void *ctx, zipc_job_func_t func, void *data);
+					/* Start a job, returning NULL to run it now */
+typedef void (*zipc_job_wait_cb_t)(void *job);
+					/* Wait for a job to finish and free it */
+
+
 /*
  * Functions...
  */
@@ -81,8 +103,10 @@ extern int		zipcFileXMLPrintf(zipc_file_t *zf, const char *format, ...)
 __attribute__ ((__format__ (__printf__, 2, 3)))
 #  endif /* __GNUC__ */
 ;
+extern void		zipcGetStats(zipc_t *zc, size_t *deflate_in, size_t *deflate_out);
 extern zipc_t		*zipcOpen(const char *filename, const char *mode);
 extern zipc_file_t      *zipcOpenFile(zipc_t *zc, const char *filename);
+extern void		zipcSetJobs(zipc_t *zc, int num_jobs, zipc_job_add_cb_t add_cb, zipc_job_wait_cb_t wait_cb, void *ctx);
 extern const char       *zipcXMLGetAttribute(const char *element, const char *attrname, char *buffer, size_t bufsize);
 
 #  ifdef __cplusplus
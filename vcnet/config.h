@@ -111,7 +111,6 @@ typedef __int64 ssize_t;
 
 #define ALLOC_FILES	10	/* Temporary/image files */
 #define ALLOC_HEADINGS	50	/* Headings */
-#define ALLOC_LINKS	100	/* Web links */
 #define ALLOC_OBJECTS	100	/* PDF objects */
 #define ALLOC_PAGES	10	/* PS/PDF pages */
 #define ALLOC_ROWS	20	/* Table rows */
@@ -148,6 +147,14 @@ typedef __int64 ssize_t;
 #define HAVE_LIBPNG 1
 
 
+/*
+ * Do we have the libdeflate or zlib-ng libraries for faster compression?
+ */
+
+/* #undef HAVE_LIBDEFLATE */
+/* #undef HAVE_ZLIB_NG */
+
+
 /*
  * Do we have the Xpm library?
  */
@@ -169,6 +176,20 @@ typedef __int64 ssize_t;
 #define HAVE_LOCALE_H 1
 
 
+/*
+ * Do we have the <sys/mman.h> header file for memory-mapped files?
+ */
+
+/* #undef HAVE_SYS_MMAN_H */
+
+
+/*
+ * Do we have the <pthread.h> header file for POSIX threads?
+ */
+
+/* #undef HAVE_PTHREAD_H */
+
+
 /*
  * Do we have some of the "standard" string functions?
  */
@@ -218,6 +239,21 @@ typedef __int64 ssize_t;
 #endif /* HAVE_ARC4RANDOM */
 
 
+/*
+ * Do we have the fmemopen() and open_memstream() functions for memory streams?
+ */
+
+/* #undef HAVE_FMEMOPEN */
+/* #undef HAVE_OPEN_MEMSTREAM */
+
+/*
+ * Do we have the fopencookie() or funopen() functions for custom streams?
+ */
+
+/* #undef HAVE_FOPENCOOKIE */
+/* #undef HAVE_FUNOPEN */
+
+
 /*
  * Do we have the long long type?
  */
@@ -242,3 +278,10 @@ typedef __int64 ssize_t;
 #ifndef HAVE_STRTOLL
 #  define strtoll(nptr,endptr,base) strtol((nptr), (endptr), (base))
 #endif /* !HAVE_STRTOLL */
+
+
+/*
+ * Does the CUPS library support the ETag and If-None-Match fields?
+ */
+
+/* #undef HAVE_HTTP_FIELD_ETAG */
@@ -30,7 +30,6 @@
 
 #define ALLOC_FILES	10	/* Temporary/image files */
 #define ALLOC_HEADINGS	50	/* Headings */
-#define ALLOC_LINKS	100	/* Web links */
 #define ALLOC_OBJECTS	100	/* PDF objects */
 #define ALLOC_PAGES	10	/* PS/PDF pages */
 #define ALLOC_ROWS	20	/* Table rows */
@@ -65,6 +64,14 @@
 #define HAVE_LIBPNG 1
 
 
+/*
+ * Do we have the libdeflate or zlib-ng libraries for faster compression?
+ */
+
+/* #undef HAVE_LIBDEFLATE */
+/* #undef HAVE_ZLIB_NG */
+
+
 /*
  * Do we have the Xpm library?
  */
@@ -86,6 +93,20 @@
 #define HAVE_LOCALE_H 1
 
 
+/*
+ * Do we have the <sys/mman.h> header file for memory-mapped files?
+ */
+
+#define HAVE_SYS_MMAN_H 1
+
+
+/*
+ * Do we have the <pthread.h> header file for POSIX threads?
+ */
+
+#define HAVE_PTHREAD_H 1
+
+
 /*
  * Do we have some of the "standard" string functions?
  */
@@ -135,6 +156,21 @@
 #endif /* HAVE_ARC4RANDOM */
 
 
+/*
+ * Do we have the fmemopen() and open_memstream() functions for memory streams?
+ */
+
+#define HAVE_FMEMOPEN 1
+#define HAVE_OPEN_MEMSTREAM 1
+
+/*
+ * Do we have the fopencookie() or funopen() functions for custom streams?
+ */
+
+/* #undef HAVE_FOPENCOOKIE */
+#define HAVE_FUNOPEN 1
+
+
 /*
  * Do we have the long long type?
  */
@@ -159,3 +195,10 @@
 #ifndef HAVE_STRTOLL
 #  define strtoll(nptr,endptr,base) strtol((nptr), (endptr), (base))
 #endif /* !HAVE_STRTOLL */
+
+
+/*
+ * Does the CUPS library support the ETag and If-None-Match fields?
+ */
+
+/* #undef HAVE_HTTP_FIELD_ETAG */